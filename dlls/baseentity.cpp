@@ -636,7 +636,11 @@ bool CBaseEntity::KeyValue( const char *szKeyName, const char *szValue )
 		for ( datamap_t *dmap = GetDataDescMap(); dmap != NULL; dmap = dmap->baseMap )
 		{
 			if ( ::ParseKeyvalue(this, dmap->dataDesc, dmap->dataNumFields, szKeyName, szValue) )
+			{
+				// "targetname" and "classname" land here
+				gEntList.UpdateEntityNameIndex( this );
 				return true;
+			}
 		}
 	}
 	else
@@ -664,6 +668,8 @@ bool CBaseEntity::KeyValue( const char *szKeyName, const char *szValue )
 
 			if ( ::ParseKeyvalue(this, dmap->dataDesc, dmap->dataNumFields, szKeyName, szValue) )
 			{
+				gEntList.UpdateEntityNameIndex( this );
+
 				if ( printKeyHits )
 					Msg( "(%s) key: %-16s value: %s\n", debugName, szKeyName, szValue );
 				
@@ -803,6 +809,8 @@ void CBaseEntity::SetClassname( const char *className )
 	{
 		pev->classname = m_iClassname;
 	}
+
+	gEntList.UpdateEntityNameIndex( this );
 }
 
 const char* CBaseEntity::GetClassname()
@@ -1038,6 +1046,7 @@ int CBaseEntity::DrawDebugTextOverlays(void)
 void CBaseEntity::SetName( string_t newName )
 {
 	m_iName = newName;
+	gEntList.UpdateEntityNameIndex( this );
 }
 
 
@@ -2406,6 +2415,8 @@ int CBaseEntity::Restore( IRestore &restore )
 		pev->classname = m_iClassname;
 	}
 
+	gEntList.UpdateEntityNameIndex( this );
+
     if ( pev && GetModelIndex() != 0 && GetModelName() != NULL_STRING && restore.GetPrecacheMode() )
 	{
 		Vector mins, maxs;
@@ -9,6 +9,7 @@
 #include "entitylist.h"
 #include "utlvector.h"
 #include "igamesystem.h"
+#include "stringpool.h"
 
 extern CBaseEntity *FindPickerEntity( CBasePlayer *pPlayer );
 static CUtlVector<IServerNetworkable*> g_DeleteList;
@@ -81,10 +82,80 @@ int AimTarget_ListCopy( CBaseEntity *pList[], int listMax )
 	return g_AimManager.ListCopy( pList, listMax );
 }
 
+//-----------------------------------------------------------------------------
+// CEntityNameIndex
+//-----------------------------------------------------------------------------
+CEntityNameIndex::CEntityNameIndex()
+{
+	memset( m_pIndexedName, 0, sizeof( m_pIndexedName ) );
+	memset( m_Hash, 0, sizeof( m_Hash ) );
+}
+
+void CEntityNameIndex::SetName( int iSlot, const char *pszName, const unsigned int *pSequence )
+{
+	if ( pszName && !*pszName )
+	{
+		pszName = NULL;
+	}
+
+	// string_ts don't change, so the same pointer is the same name
+	if ( m_pIndexedName[iSlot] == pszName )
+		return;
+
+	if ( m_pIndexedName[iSlot] )
+	{
+		m_Buckets[m_Hash[iSlot] & ( ENTITY_NAME_INDEX_BUCKETS - 1 )].FindAndRemove( iSlot );
+	}
+
+	m_pIndexedName[iSlot] = pszName;
+	if ( pszName )
+	{
+		m_Hash[iSlot] = CStringPool::HashString( pszName );
+		CUtlVector<unsigned short> &bucket = m_Buckets[m_Hash[iSlot] & ( ENTITY_NAME_INDEX_BUCKETS - 1 )];
+		bucket.InsertBefore( FirstAfter( bucket, pSequence[iSlot], pSequence ), iSlot );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Returns the index of the first slot in the bucket added after sequence
+//-----------------------------------------------------------------------------
+int CEntityNameIndex::FirstAfter( const CUtlVector<unsigned short> &bucket, unsigned int sequence, const unsigned int *pSequence ) const
+{
+	int lo = 0;
+	int hi = bucket.Count();
+	while ( lo < hi )
+	{
+		int mid = ( lo + hi ) / 2;
+		if ( pSequence[bucket[mid]] <= sequence )
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+int CEntityNameIndex::FindNext( unsigned int hash, unsigned int startSequence, const unsigned int *pSequence ) const
+{
+	const CUtlVector<unsigned short> &bucket = m_Buckets[hash & ( ENTITY_NAME_INDEX_BUCKETS - 1 )];
+	for ( int i = FirstAfter( bucket, startSequence, pSequence ); i < bucket.Count(); i++ )
+	{
+		if ( m_Hash[bucket[i]] == hash )
+			return bucket[i];
+	}
+	return -1;
+}
+
+
 CGlobalEntityList::CGlobalEntityList()
 {
 	m_iHighestEnt = m_iNumEnts = 0;
 	m_bClearingEntities = false;
+	memset( m_EntitySequence, 0, sizeof( m_EntitySequence ) );
+	m_nNextSequence = 1;
 }
 
 
@@ -250,11 +321,28 @@ bool CGlobalEntityList::IsEntityPtr( void *pTest )
 //-----------------------------------------------------------------------------
 CBaseEntity *CGlobalEntityList::FindEntityByClassname( CBaseEntity *pStartEntity, const char *szName )
 {
-	CBaseEntity *e = pStartEntity;
-	while ( (e = NextEnt(e)) != NULL )
+	if ( !szName || !szName[0] )
+	{
+		CBaseEntity *e = pStartEntity;
+		while ( (e = NextEnt(e)) != NULL )
+		{
+			if ( FStrEq( STRING(e->m_iClassname), szName ) )
+				return e;
+		}
+
+		return NULL;
+	}
+
+	unsigned int hash = CStringPool::HashString( szName );
+	unsigned int sequence = GetSearchStart( pStartEntity );
+	int iSlot;
+	while ( ( iSlot = m_ClassnameIndex.FindNext( hash, sequence, m_EntitySequence ) ) != -1 )
 	{
-		if ( FStrEq( STRING(e->m_iClassname), szName ) )
+		CBaseEntity *e = GetBaseEntityInSlot( iSlot );
+		if ( e && FStrEq( STRING(e->m_iClassname), szName ) )
 			return e;
+
+		sequence = m_EntitySequence[iSlot];
 	}
 
 	return NULL;
@@ -361,23 +449,31 @@ CBaseEntity *CGlobalEntityList::FindEntityByName( CBaseEntity *pStartEntity, con
 	else
 		wildcard = false;
 
+	if ( !wildcard )
+	{
+		unsigned int hash = CStringPool::HashString( szName );
+		unsigned int sequence = GetSearchStart( pStartEntity );
+		int iSlot;
+		while ( ( iSlot = m_NameIndex.FindNext( hash, sequence, m_EntitySequence ) ) != -1 )
+		{
+			CBaseEntity *e = GetBaseEntityInSlot( iSlot );
+			if ( e && stricmp( STRING(e->m_iName), szName ) == 0 )
+				return e;
+
+			sequence = m_EntitySequence[iSlot];
+		}
+
+		return NULL;
+	}
+
 	CBaseEntity *e = pStartEntity;
 	while ( (e = NextEnt(e)) != NULL )
 	{
 		if ( !e->m_iName )
 			continue;
 
-		if ( !wildcard )
-		{
-			if ( stricmp( STRING(e->m_iName), szName ) == 0 )
-				return e;
-		}
-		else
-		{
-			if ( _strnicmp( STRING(e->m_iName), szName, len ) == 0 )
-				return e;
-		}
-
+		if ( _strnicmp( STRING(e->m_iName), szName, len ) == 0 )
+			return e;
 	}
 
 	return NULL;
@@ -790,6 +886,34 @@ CBaseEntity *CGlobalEntityList::FindEntityNearestFacing( const Vector &origin, c
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the sequence a name search starting after pStartEntity
+//			should look after
+//-----------------------------------------------------------------------------
+unsigned int CGlobalEntityList::GetSearchStart( CBaseEntity *pStartEntity )
+{
+	if ( !pStartEntity )
+		return 0;
+
+	return m_EntitySequence[pStartEntity->GetRefEHandle().GetEntryIndex()];
+}
+
+void CGlobalEntityList::IndexEntityNames( CBaseEntity *pEntity, int iSlot )
+{
+	m_NameIndex.SetName( iSlot, STRING(pEntity->m_iName), m_EntitySequence );
+	m_ClassnameIndex.SetName( iSlot, STRING(pEntity->m_iClassname), m_EntitySequence );
+}
+
+void CGlobalEntityList::UpdateEntityNameIndex( CBaseEntity *pEntity )
+{
+	// Entities not in the list yet are indexed when they're added
+	CBaseHandle hEnt = pEntity->GetRefEHandle();
+	if ( hEnt == INVALID_EHANDLE_INDEX || GetBaseEntity( hEnt ) != pEntity )
+		return;
+
+	IndexEntityNames( pEntity, hEnt.GetEntryIndex() );
+}
+
 void CGlobalEntityList::OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle )
 {
 	int i = handle.GetEntryIndex();
@@ -804,6 +928,14 @@ void CGlobalEntityList::OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle )
 	Assert( pNet == dynamic_cast< IServerNetworkable* >( pEnt ) );
 
 	CBaseEntity *pBaseEnt = pNet->GetBaseEntity();
+
+	// New entities go at the end of the list
+	m_EntitySequence[i] = m_nNextSequence++;
+	if ( pBaseEnt )
+	{
+		IndexEntityNames( pBaseEnt, i );
+	}
+
 	for ( i = m_entityListeners.Count()-1; i >= 0; i-- )
 	{
 		m_entityListeners[i]->OnEntityCreated( pBaseEnt );
@@ -829,6 +961,10 @@ void CGlobalEntityList::OnRemoveEntity( IHandleEntity *pEnt, CBaseHandle handle
 	}
 #endif
 
+	int iSlot = handle.GetEntryIndex();
+	m_NameIndex.SetName( iSlot, NULL, m_EntitySequence );
+	m_ClassnameIndex.SetName( iSlot, NULL, m_EntitySequence );
+
 	m_iNumEnts--;
 }
 
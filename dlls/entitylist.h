@@ -19,6 +19,35 @@
 
 
 class IEntityListener;
+
+#define ENTITY_NAME_INDEX_BUCKETS	1024	// must be a power of two
+
+//-----------------------------------------------------------------------------
+// Purpose: Hashed index of entity list slots by name (or classname), so the
+//			searches by name don't have to walk the whole entity list. Each
+//			bucket keeps its slots in the order they were added to the list,
+//			which is the order NextEnt() returns them in.
+//-----------------------------------------------------------------------------
+class CEntityNameIndex
+{
+public:
+	CEntityNameIndex();
+
+	// Indexes a slot under pszName, or takes it out of the index if pszName is NULL or empty
+	void SetName( int iSlot, const char *pszName, const unsigned int *pSequence );
+
+	// Returns the first slot after startSequence whose name has the hash, or -1.
+	// Names are case insensitive, and different names can share a hash.
+	int FindNext( unsigned int hash, unsigned int startSequence, const unsigned int *pSequence ) const;
+
+private:
+	int FirstAfter( const CUtlVector<unsigned short> &bucket, unsigned int sequence, const unsigned int *pSequence ) const;
+
+	CUtlVector<unsigned short> m_Buckets[ENTITY_NAME_INDEX_BUCKETS];
+	const char		*m_pIndexedName[NUM_ENT_ENTRIES];	// what each slot was indexed under
+	unsigned int	m_Hash[NUM_ENT_ENTRIES];
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: a global list of all the entities in the game.  All iteration through
 //			entities is done through this object.
@@ -30,6 +59,12 @@ private:
 	int m_iHighestEnt; // the topmost used array index
 	int m_iNumEnts;
 
+	// lookups by name and classname
+	CEntityNameIndex m_NameIndex;
+	CEntityNameIndex m_ClassnameIndex;
+	unsigned int m_EntitySequence[NUM_ENT_ENTRIES];	// order each slot was added to the list in
+	unsigned int m_nNextSequence;
+
 	bool m_bClearingEntities;
 	CUtlVector<IEntityListener *>	m_entityListeners;
 
@@ -59,6 +94,10 @@ public:
 
 	void ReportEntityFlagsChanged( CBaseEntity *pEntity, unsigned int flagsOld, unsigned int flagsNow );
 
+	// Call after an entity's m_iName or m_iClassname may have changed so the name
+	// searches can find it. Cheap if neither changed.
+	void UpdateEntityNameIndex( CBaseEntity *pEntity );
+
 	// entity is about to be removed, notify the listeners
 	void NotifyRemoveEntity( CBaseHandle hEnt );
 	// iteration functions
@@ -114,6 +153,10 @@ protected:
 	virtual void OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle );
 	virtual void OnRemoveEntity( IHandleEntity *pEnt, CBaseHandle handle );
 
+private:
+	void IndexEntityNames( CBaseEntity *pEntity, int iSlot );
+	unsigned int GetSearchStart( CBaseEntity *pStartEntity );
+	CBaseEntity *GetBaseEntityInSlot( int iSlot ) const;
 };
 
 extern CGlobalEntityList gEntList;
@@ -155,6 +198,15 @@ inline CBaseEntity* CGlobalEntityList::GetBaseEntity( CBaseHandle hEnt ) const
 		return NULL;
 }
 
+inline CBaseEntity* CGlobalEntityList::GetBaseEntityInSlot( int iSlot ) const
+{
+	IServerNetworkable *pNet = (IServerNetworkable*)LookupEntityByNetworkIndex( iSlot );
+	if ( pNet )
+		return pNet->GetBaseEntity();
+	else
+		return NULL;
+}
+
 
 //-----------------------------------------------------------------------------
 // Common finds
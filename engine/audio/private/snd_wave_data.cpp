@@ -1,5 +1,9 @@
 #include "snd_wave_data.h"
 #include "riff.h"
+#include "snd_io.h"
+#include "filesystem.h"
+#include "../../filesystem_engine.h"
+#include "vstdlib/strtools.h"
 #include "tier0/platform.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -27,6 +31,10 @@ private:
 
 // UNDONE: Allocate this in cache instead?
 #define BUFFER_SIZE 16384
+
+// Stream read-ahead goes before map lumps and other background reads, since
+// running dry is audible.
+#define STREAM_READAHEAD_PRIORITY	1000
 //-----------------------------------------------------------------------------
 // Purpose: This is an instance of a stream.
 //			This contains the file handle and streaming buffer
@@ -49,11 +57,16 @@ public:
 private:
 	CWaveDataStream( const CWaveDataStream & );
 
+	void					StartReadAhead( int sampleIndex );
+	bool					FinishReadAhead( void );
+	void					CancelReadAhead( void );
+
 	CAudioSource			&m_source;					// wave source
 	IWaveStreamSource		*m_pStreamSource;			// streaming
 	int						m_sampleSize;				// size of a sample in bytes
 	int						m_bufferSize;				// size of buffer in samples
-	char					m_buffer[BUFFER_SIZE];		// buffer memory
+	char					*m_pBuffer;					// the buffer the mixer is reading from
+	char					m_buffers[2][BUFFER_SIZE];	// buffer memory, the other one is for read-ahead
 	int						m_sampleIndex;				// sample index of first sample in buffer
 	int						m_bufferCount;				// current count of samples in the buffer
 	int						m_waveSize;					// total number of samples in the file
@@ -61,6 +74,12 @@ private:
 	int						m_dataStart;
 	// UNDONE: Do we need this?  Just use the global?
 	IFileReadBinary			&m_io;						// I/O interface
+
+	// The next buffer is read in the background by the filesystem's I/O threads
+	char					m_asyncFileName[512];		// empty if the stream can't be read ahead
+	FSAsyncControl_t		m_hReadAhead;
+	int						m_readAheadIndex;			// sample index of the first sample being read ahead
+	int						m_readAheadCount;
 };
 
 
@@ -70,6 +89,11 @@ CWaveDataStream::CWaveDataStream( CAudioSource &source, IWaveStreamSource *pStre
 	// nothing in the buffer yet
 	m_bufferCount = 0;
 	m_sampleIndex = 0;
+	m_pBuffer = m_buffers[0];
+	m_asyncFileName[0] = 0;
+	m_hReadAhead = NULL;
+	m_readAheadIndex = 0;
+	m_readAheadCount = 0;
 
 	m_file = m_io.open( pFileName );
 
@@ -84,6 +108,13 @@ CWaveDataStream::CWaveDataStream( CAudioSource &source, IWaveStreamSource *pStre
 		// This is the size in samples (not bytes) of the wave itself
 		m_waveSize = fileSize / m_sampleSize;
 
+		// Streams read through the engine filesystem can be read ahead. This is the
+		// same name COM_IOReadBinary::open opens.
+		if ( &m_io == g_pSndIO )
+		{
+			Q_snprintf( m_asyncFileName, sizeof( m_asyncFileName ), ( pFileName[0] == '/' ) ? "sound%s" : "sound/%s", pFileName );
+		}
+
 		// UNDONE: Read a buffer here?
 	}
 }
@@ -92,10 +123,78 @@ CWaveDataStream::CWaveDataStream( CAudioSource &source, IWaveStreamSource *pStre
 // close the file
 CWaveDataStream::~CWaveDataStream( void ) 
 {
+	CancelReadAhead();
 	m_io.close( m_file );
 }
 
 
+// Queue a read of the buffer that starts at sampleIndex into the buffer the mixer isn't using
+void CWaveDataStream::StartReadAhead( int sampleIndex )
+{
+	if ( !m_asyncFileName[0] || m_hReadAhead || sampleIndex >= m_waveSize )
+		return;
+
+	int count = m_waveSize - sampleIndex;
+	if ( count > m_bufferSize )
+		count = m_bufferSize;
+
+	FileAsyncRequest_t request;
+	request.pszFilename = m_asyncFileName;
+	request.nOffset = m_dataStart + sampleIndex * m_sampleSize;
+	request.nBytes = count * m_sampleSize;
+	request.pData = ( m_pBuffer == m_buffers[0] ) ? m_buffers[1] : m_buffers[0];
+	request.priority = STREAM_READAHEAD_PRIORITY;
+
+	if ( g_pFileSystem->AsyncRead( request, &m_hReadAhead ) != FSASYNC_OK )
+	{
+		// Don't keep trying, just read it the old way
+		m_hReadAhead = NULL;
+		m_asyncFileName[0] = 0;
+		return;
+	}
+
+	m_readAheadIndex = sampleIndex;
+	m_readAheadCount = count;
+}
+
+
+// If the read-ahead is the buffer that's needed now, wait for it and switch to it
+bool CWaveDataStream::FinishReadAhead( void )
+{
+	if ( !m_hReadAhead )
+		return false;
+
+	if ( m_readAheadIndex != m_sampleIndex || m_readAheadCount != m_bufferCount )
+	{
+		CancelReadAhead();
+		return false;
+	}
+
+	int bytesRead = 0;
+	FSAsyncStatus_t status = g_pFileSystem->AsyncFinish( m_hReadAhead, true, NULL, &bytesRead );
+	g_pFileSystem->AsyncRelease( m_hReadAhead );
+	m_hReadAhead = NULL;
+
+	if ( status != FSASYNC_OK || bytesRead != m_bufferCount * m_sampleSize )
+		return false;
+
+	m_pBuffer = ( m_pBuffer == m_buffers[0] ) ? m_buffers[1] : m_buffers[0];
+	return true;
+}
+
+
+// The stream jumped somewhere else (looping, or skipping ahead)
+void CWaveDataStream::CancelReadAhead( void )
+{
+	if ( !m_hReadAhead )
+		return;
+
+	g_pFileSystem->AsyncAbort( m_hReadAhead );
+	g_pFileSystem->AsyncRelease( m_hReadAhead );
+	m_hReadAhead = NULL;
+}
+
+
 // Read data from the source - this is the primary function of a IWaveData subclass
 // Get the data from the buffer (or reload from disk)
 int CWaveDataStream::ReadSourceData( void **pData, int sampleIndex, int sampleCount, char copyBuf[AUDIOSOURCE_COPYBUF_SIZE] )
@@ -109,7 +208,7 @@ int CWaveDataStream::ReadSourceData( void **pData, int sampleIndex, int sampleCo
 		{
 			m_sampleIndex = sampleIndex;
 			m_bufferCount = 0;
-			m_io.seek( m_file, m_dataStart + sampleIndex );
+			CancelReadAhead();
 		}
 	}
 
@@ -143,9 +242,6 @@ int CWaveDataStream::ReadSourceData( void **pData, int sampleIndex, int sampleCo
 			// skip directly to next position
 			m_sampleIndex += sampleIndex;
 			sampleIndex = 0;
-
-			// move the file to the new position
-			m_io.seek( m_file, m_dataStart + (m_sampleIndex * m_sampleSize) );
 		}
 
 		// This is the maximum number of samples we could read from the file
@@ -159,18 +255,26 @@ int CWaveDataStream::ReadSourceData( void **pData, int sampleIndex, int sampleCo
 		if ( m_bufferCount > m_bufferSize )
 			m_bufferCount = m_bufferSize;
 
-		// read in the max bufferable, available samples
-		m_io.read( m_buffer, m_bufferCount * m_sampleSize, m_file );
+		// use the read-ahead if it's this buffer, otherwise read in the max bufferable, available samples.
+		// The file isn't positioned here after a loop, skip, or read-ahead, so always seek.
+		if ( !FinishReadAhead() )
+		{
+			m_io.seek( m_file, m_dataStart + (m_sampleIndex * m_sampleSize) );
+			m_io.read( m_pBuffer, m_bufferCount * m_sampleSize, m_file );
+		}
 
 		// do any conversion the source needs (mixer will decode/decompress)
-		m_pStreamSource->UpdateSamples( m_buffer, m_bufferCount );
+		m_pStreamSource->UpdateSamples( m_pBuffer, m_bufferCount );
+
+		// start on the next buffer while the mixer works on this one
+		StartReadAhead( m_sampleIndex + m_bufferCount );
 	}
 
 	// If we have some samples in the buffer that are within range of the request
 	if ( sampleIndex < m_bufferCount )
 	{
 		// Get the desired starting sample
-		*pData = (void *)&m_buffer[sampleIndex * m_sampleSize];
+		*pData = (void *)&m_pBuffer[sampleIndex * m_sampleSize];
 		// max available
 		int available = m_bufferCount - sampleIndex;
 		// clamp available to max requested
@@ -0,0 +1,393 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: bitbuf_bench checks the bf_write/bf_read field encoders against a
+//			bit at a time reference, which is how they used to write, and
+//			then times them.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "quakedef.h"
+#include "sys.h"
+#include "convar.h"
+#include "bitbuf.h"
+#include "coordsize.h"
+#include "vector.h"
+#include "vstdlib/strtools.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+#define BITBUF_BENCH_BYTES		( 64 * 1024 )
+#define BITBUF_BENCH_FIELDS		4096
+
+enum BitBufBenchOp_t
+{
+	BITBUF_OP_UBITLONG = 0,
+	BITBUF_OP_SBITLONG,
+	BITBUF_OP_COORD,
+	BITBUF_OP_VEC3COORD,
+	BITBUF_OP_NORMAL,
+	BITBUF_OP_VEC3NORMAL,
+	BITBUF_OP_BYTES,
+	BITBUF_OP_STRING,
+
+	BITBUF_OP_COUNT
+};
+
+struct BitBufBenchField_t
+{
+	int				m_Op;
+	int				m_nBits;
+	unsigned int	m_Value;
+	Vector			m_Vec;
+	char			m_Str[16];
+};
+
+static unsigned int s_BitBufBenchSeed;
+
+static unsigned int Host_BitBufBenchRandom()
+{
+	s_BitBufBenchSeed = s_BitBufBenchSeed * 1103515245 + 12345;
+	return ( s_BitBufBenchSeed >> 8 ) ^ ( s_BitBufBenchSeed << 13 );
+}
+
+static float Host_BitBufBenchCoord()
+{
+	switch ( Host_BitBufBenchRandom() % 4 )
+	{
+	case 0:		return 0.0f;
+	case 1:		return (float)( (int)( Host_BitBufBenchRandom() % 32768 ) - 16384 );
+	case 2:		return ( (int)( Host_BitBufBenchRandom() % 65536 ) - 32768 ) / 64.0f;
+	default:	return ( (int)( Host_BitBufBenchRandom() % 2000 ) - 1000 ) / 20000.0f;
+	}
+}
+
+static float Host_BitBufBenchNormal()
+{
+	return ( (int)( Host_BitBufBenchRandom() % 4001 ) - 2000 ) / 2000.0f;
+}
+
+static void Host_MakeBitBufBenchFields( BitBufBenchField_t *pFields, int nFields, unsigned int nSeed )
+{
+	s_BitBufBenchSeed = nSeed;
+	for ( int i = 0; i < nFields; i++ )
+	{
+		BitBufBenchField_t &field = pFields[i];
+		field.m_Op = Host_BitBufBenchRandom() % BITBUF_OP_COUNT;
+		field.m_nBits = 2 + Host_BitBufBenchRandom() % 31;
+
+		unsigned int nValue = Host_BitBufBenchRandom() ^ ( Host_BitBufBenchRandom() << 16 );
+		if ( field.m_Op == BITBUF_OP_SBITLONG && field.m_nBits < 32 )
+		{
+			int nRange = 1 << ( field.m_nBits - 1 );
+			nValue = ( nValue % ( 2u * nRange ) ) - nRange;
+		}
+		else if ( field.m_nBits < 32 )
+		{
+			nValue &= ( 1u << field.m_nBits ) - 1;
+		}
+		field.m_Value = nValue;
+
+		if ( field.m_Op == BITBUF_OP_NORMAL || field.m_Op == BITBUF_OP_VEC3NORMAL )
+		{
+			field.m_Vec.Init( Host_BitBufBenchNormal(), Host_BitBufBenchNormal(), Host_BitBufBenchNormal() );
+		}
+		else
+		{
+			field.m_Vec.Init( Host_BitBufBenchCoord(), Host_BitBufBenchCoord(), Host_BitBufBenchCoord() );
+		}
+
+		memset( field.m_Str, 0, sizeof( field.m_Str ) );
+		int nLen = Host_BitBufBenchRandom() % sizeof( field.m_Str );
+		for ( int j = 0; j < nLen; j++ )
+		{
+			field.m_Str[j] = 1 + Host_BitBufBenchRandom() % 255;
+		}
+		field.m_Str[nLen] = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The reference encoders, one bit at a time
+//-----------------------------------------------------------------------------
+static void Host_RefWriteBits( bf_write &buf, unsigned int nValue, int nBits )
+{
+	for ( int i = 0; i < nBits; i++ )
+	{
+		buf.WriteOneBit( ( nValue >> i ) & 1 );
+	}
+}
+
+static void Host_RefWriteBitCoord( bf_write &buf, float f )
+{
+	int signbit = (f <= -COORD_RESOLUTION);
+	int intval = (int)abs(f);
+	int fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
+
+	buf.WriteOneBit( intval );
+	buf.WriteOneBit( fractval );
+	if ( intval || fractval )
+	{
+		buf.WriteOneBit( signbit );
+		if ( intval )
+		{
+			Host_RefWriteBits( buf, intval - 1, COORD_INTEGER_BITS );
+		}
+		if ( fractval )
+		{
+			Host_RefWriteBits( buf, fractval, COORD_FRACTIONAL_BITS );
+		}
+	}
+}
+
+static void Host_RefWriteBitNormal( bf_write &buf, float f )
+{
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+	if ( fractval > NORMAL_DENOMINATOR )
+	{
+		fractval = NORMAL_DENOMINATOR;
+	}
+
+	buf.WriteOneBit( f <= -NORMAL_RESOLUTION );
+	Host_RefWriteBits( buf, fractval, NORMAL_FRACTIONAL_BITS );
+}
+
+static void Host_RefWriteField( bf_write &buf, const BitBufBenchField_t &field )
+{
+	int i;
+	switch ( field.m_Op )
+	{
+	case BITBUF_OP_UBITLONG:
+		Host_RefWriteBits( buf, field.m_Value, field.m_nBits );
+		break;
+
+	case BITBUF_OP_SBITLONG:
+		Host_RefWriteBits( buf, field.m_Value, field.m_nBits - 1 );
+		buf.WriteOneBit( (int)field.m_Value < 0 );
+		break;
+
+	case BITBUF_OP_COORD:
+		Host_RefWriteBitCoord( buf, field.m_Vec.x );
+		break;
+
+	case BITBUF_OP_VEC3COORD:
+		for ( i = 0; i < 3; i++ )
+		{
+			buf.WriteOneBit( (field.m_Vec[i] >= COORD_RESOLUTION) || (field.m_Vec[i] <= -COORD_RESOLUTION) );
+		}
+		for ( i = 0; i < 3; i++ )
+		{
+			if ( (field.m_Vec[i] >= COORD_RESOLUTION) || (field.m_Vec[i] <= -COORD_RESOLUTION) )
+			{
+				Host_RefWriteBitCoord( buf, field.m_Vec[i] );
+			}
+		}
+		break;
+
+	case BITBUF_OP_NORMAL:
+		Host_RefWriteBitNormal( buf, field.m_Vec.x );
+		break;
+
+	case BITBUF_OP_VEC3NORMAL:
+		for ( i = 0; i < 2; i++ )
+		{
+			buf.WriteOneBit( (field.m_Vec[i] >= NORMAL_RESOLUTION) || (field.m_Vec[i] <= -NORMAL_RESOLUTION) );
+		}
+		for ( i = 0; i < 2; i++ )
+		{
+			if ( (field.m_Vec[i] >= NORMAL_RESOLUTION) || (field.m_Vec[i] <= -NORMAL_RESOLUTION) )
+			{
+				Host_RefWriteBitNormal( buf, field.m_Vec[i] );
+			}
+		}
+		buf.WriteOneBit( field.m_Vec.z <= -NORMAL_RESOLUTION );
+		break;
+
+	case BITBUF_OP_BYTES:
+		for ( i = 0; i < (int)sizeof( field.m_Str ); i++ )
+		{
+			Host_RefWriteBits( buf, (unsigned char)field.m_Str[i], 8 );
+		}
+		break;
+
+	case BITBUF_OP_STRING:
+		for ( i = 0; i == 0 || field.m_Str[i-1]; i++ )
+		{
+			Host_RefWriteBits( buf, (unsigned char)field.m_Str[i], 8 );
+		}
+		break;
+	}
+}
+
+static void Host_WriteField( bf_write &buf, const BitBufBenchField_t &field )
+{
+	switch ( field.m_Op )
+	{
+	case BITBUF_OP_UBITLONG:	buf.WriteUBitLong( field.m_Value, field.m_nBits );	break;
+	case BITBUF_OP_SBITLONG:	buf.WriteSBitLong( (int)field.m_Value, field.m_nBits );	break;
+	case BITBUF_OP_COORD:		buf.WriteBitCoord( field.m_Vec.x );	break;
+	case BITBUF_OP_VEC3COORD:	buf.WriteBitVec3Coord( field.m_Vec );	break;
+	case BITBUF_OP_NORMAL:		buf.WriteBitNormal( field.m_Vec.x );	break;
+	case BITBUF_OP_VEC3NORMAL:	buf.WriteBitVec3Normal( field.m_Vec );	break;
+	case BITBUF_OP_BYTES:		buf.WriteBytes( field.m_Str, sizeof( field.m_Str ) );	break;
+	case BITBUF_OP_STRING:		buf.WriteString( field.m_Str );	break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Reads a field back and checks it against what was written.  Coords and
+// normals are quantized, so those just have to land within a step.
+//-----------------------------------------------------------------------------
+static bool Host_ReadField( bf_read &buf, const BitBufBenchField_t &field )
+{
+	Vector vec;
+	char str[sizeof( field.m_Str )];
+	int i;
+
+	switch ( field.m_Op )
+	{
+	case BITBUF_OP_UBITLONG:
+		return buf.ReadUBitLong( field.m_nBits ) == field.m_Value;
+
+	case BITBUF_OP_SBITLONG:
+		return buf.ReadSBitLong( field.m_nBits ) == (int)field.m_Value;
+
+	case BITBUF_OP_COORD:
+		return fabs( buf.ReadBitCoord() - field.m_Vec.x ) < COORD_RESOLUTION;
+
+	case BITBUF_OP_VEC3COORD:
+		buf.ReadBitVec3Coord( vec );
+		for ( i = 0; i < 3; i++ )
+		{
+			if ( fabs( vec[i] - field.m_Vec[i] ) >= COORD_RESOLUTION )
+				return false;
+		}
+		return true;
+
+	case BITBUF_OP_NORMAL:
+		return fabs( buf.ReadBitNormal() - field.m_Vec.x ) < NORMAL_RESOLUTION;
+
+	case BITBUF_OP_VEC3NORMAL:
+		buf.ReadBitVec3Normal( vec );
+		for ( i = 0; i < 2; i++ )
+		{
+			if ( fabs( vec[i] - field.m_Vec[i] ) >= NORMAL_RESOLUTION )
+				return false;
+		}
+		return ( vec.z < 0 ) == ( field.m_Vec.z <= -NORMAL_RESOLUTION ) || vec.z == 0;
+
+	case BITBUF_OP_BYTES:
+		buf.ReadBytes( str, sizeof( str ) );
+		return memcmp( str, field.m_Str, sizeof( str ) ) == 0;
+
+	case BITBUF_OP_STRING:
+		buf.ReadString( str, sizeof( str ) );
+		return Q_strcmp( str, field.m_Str ) == 0;
+	}
+
+	return false;
+}
+
+static void Host_BitBufBench_f( void )
+{
+	int nRounds = ( Cmd_Argc() >= 2 ) ? atoi( Cmd_Argv( 1 ) ) : 100;
+	if ( nRounds <= 0 )
+	{
+		Con_Printf( "Usage:  bitbuf_bench [rounds]\n" );
+		return;
+	}
+
+	BitBufBenchField_t *pFields = new BitBufBenchField_t[BITBUF_BENCH_FIELDS];
+	unsigned char *pBuf = new unsigned char[BITBUF_BENCH_BYTES];
+	unsigned char *pRefBuf = new unsigned char[BITBUF_BENCH_BYTES];
+
+	// Each round writes the fields at a different bit offset, so every
+	// alignment gets covered
+	int nMismatches = 0;
+	int i, nRound;
+	for ( nRound = 0; nRound < nRounds; nRound++ )
+	{
+		Host_MakeBitBufBenchFields( pFields, BITBUF_BENCH_FIELDS, nRound );
+
+		memset( pBuf, 0, BITBUF_BENCH_BYTES );
+		memset( pRefBuf, 0, BITBUF_BENCH_BYTES );
+		bf_write buf( pBuf, BITBUF_BENCH_BYTES );
+		bf_write refBuf( pRefBuf, BITBUF_BENCH_BYTES );
+		buf.SeekToBit( nRound & 31 );
+		refBuf.SeekToBit( nRound & 31 );
+
+		for ( i = 0; i < BITBUF_BENCH_FIELDS; i++ )
+		{
+			Host_WriteField( buf, pFields[i] );
+			Host_RefWriteField( refBuf, pFields[i] );
+		}
+
+		if ( buf.GetNumBitsWritten() != refBuf.GetNumBitsWritten() || buf.IsOverflowed() ||
+			memcmp( pBuf, pRefBuf, buf.GetNumBytesWritten() ) != 0 )
+		{
+			Con_Printf( "Round %d: written bits don't match the reference\n", nRound );
+			nMismatches++;
+			continue;
+		}
+
+		bf_read readBuf( pBuf, BITBUF_BENCH_BYTES, buf.GetNumBitsWritten() );
+		readBuf.Seek( nRound & 31 );
+		for ( i = 0; i < BITBUF_BENCH_FIELDS; i++ )
+		{
+			if ( !Host_ReadField( readBuf, pFields[i] ) )
+			{
+				Con_Printf( "Round %d: field %d (op %d) didn't read back\n", nRound, i, pFields[i].m_Op );
+				nMismatches++;
+				break;
+			}
+		}
+	}
+
+	Con_Printf( "%d rounds of %d fields checked, %d mismatches\n", nRounds, BITBUF_BENCH_FIELDS, nMismatches );
+
+	// Time the same fields going through each path
+	Host_MakeBitBufBenchFields( pFields, BITBUF_BENCH_FIELDS, 0 );
+
+	double flBits = 0;
+	double t0 = Sys_FloatTime();
+	for ( nRound = 0; nRound < nRounds; nRound++ )
+	{
+		bf_write buf( pBuf, BITBUF_BENCH_BYTES );
+		for ( i = 0; i < BITBUF_BENCH_FIELDS; i++ )
+		{
+			Host_WriteField( buf, pFields[i] );
+		}
+		flBits += buf.GetNumBitsWritten();
+	}
+	double t1 = Sys_FloatTime();
+	for ( nRound = 0; nRound < nRounds; nRound++ )
+	{
+		bf_write refBuf( pRefBuf, BITBUF_BENCH_BYTES );
+		for ( i = 0; i < BITBUF_BENCH_FIELDS; i++ )
+		{
+			Host_RefWriteField( refBuf, pFields[i] );
+		}
+	}
+	double t2 = Sys_FloatTime();
+	for ( nRound = 0; nRound < nRounds; nRound++ )
+	{
+		bf_read readBuf( pBuf, BITBUF_BENCH_BYTES, (int)( flBits / nRounds ) );
+		for ( i = 0; i < BITBUF_BENCH_FIELDS; i++ )
+		{
+			Host_ReadField( readBuf, pFields[i] );
+		}
+	}
+	double t3 = Sys_FloatTime();
+
+	Con_Printf( "  write:           %.1f Mbit/s\n", flBits / ( ( t1 - t0 ) * 1000000.0 ) );
+	Con_Printf( "  write bit by bit: %.1f Mbit/s\n", flBits / ( ( t2 - t1 ) * 1000000.0 ) );
+	Con_Printf( "  read and check:  %.1f Mbit/s\n", flBits / ( ( t3 - t2 ) * 1000000.0 ) );
+
+	delete[] pFields;
+	delete[] pBuf;
+	delete[] pRefBuf;
+}
+
+static ConCommand bitbuf_bench( "bitbuf_bench", Host_BitBufBench_f, "Checks bf_write/bf_read against a bit by bit reference and times them." );
@@ -25,6 +25,7 @@
 #include "vstdlib/ICommandLine.h"
 #include "utlbuffer.h"
 #include "tier0/memalloc.h"
+#include "tier0/memprofile.h"
 
 
 #define	MAX_ALIAS_NAME	32
@@ -383,6 +384,49 @@ void Cmd_MemDump_f(void)
 	g_pMemAlloc->DumpStats();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Controls the heap profiler and prints its reports
+//-----------------------------------------------------------------------------
+void Cmd_MemProfile_f( void )
+{
+	const char *pCommand = ( Cmd_Argc() > 1 ) ? Cmd_Argv( 1 ) : "";
+
+	if ( !stricmp( pCommand, "start" ) )
+	{
+		MemProfile_Start( ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : MEMPROFILE_DEFAULT_SAMPLE_BYTES );
+	}
+	else if ( !stricmp( pCommand, "stop" ) )
+	{
+		MemProfile_Stop();
+	}
+	else if ( !stricmp( pCommand, "reset" ) )
+	{
+		MemProfile_Reset();
+	}
+	else if ( !stricmp( pCommand, "mark" ) )
+	{
+		MemProfile_Mark();
+	}
+	else if ( !stricmp( pCommand, "flat" ) )
+	{
+		MemProfile_DumpFlat( ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : 25 );
+	}
+	else if ( !stricmp( pCommand, "tree" ) )
+	{
+		MemProfile_DumpTree( ( Cmd_Argc() > 2 ) ? atof( Cmd_Argv( 2 ) ) : 1.0f );
+	}
+	else
+	{
+		Con_Printf( "mem_profile start [sample bytes]: sample allocations and charge live bytes to their call sites\n" );
+		Con_Printf( "mem_profile stop: stop sampling, frees are still counted\n" );
+		Con_Printf( "mem_profile reset: forget everything sampled so far\n" );
+		Con_Printf( "mem_profile mark: remember live bytes now, reports show growth since (e.g. across map changes)\n" );
+		Con_Printf( "mem_profile flat [sites]: list the sites with the most live bytes\n" );
+		Con_Printf( "mem_profile tree [min percent]: show live bytes as a call tree\n" );
+		Con_Printf( "Heap profiler is %s\n", MemProfile_IsActive() ? "on" : "off" );
+	}
+}
+
 /*
 ===============
 Cmd_Exec_f
@@ -568,11 +612,17 @@ static ConCommand cmd("cmd", Cmd_ForwardToServerProxy);
 static ConCommand wait("wait", Cmd_Wait_f);
 static ConCommand BindToggle( "BindToggle", Cmd_BindToggle_f );
 static ConCommand mem_dump( "mem_dump", Cmd_MemDump_f );
+static ConCommand mem_profile( "mem_profile", Cmd_MemProfile_f, "Sampling heap profiler, run with no arguments for help. -memprofile [sample bytes] starts it at launch." );
 
 
 void Cmd_Init( void )
 {
 	Sys_CreateFileAssociations( ARRAYSIZE( g_FileAssociations ), g_FileAssociations );
+
+	if ( CommandLine()->FindParm( "-memprofile" ) )
+	{
+		MemProfile_Start( CommandLine()->ParmValue( "-memprofile", MEMPROFILE_DEFAULT_SAMPLE_BYTES ) );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -16,6 +16,7 @@ extern IMaterialSystem *materialSystemInterface;
 
 #include "vphysics_interface.h"
 #include "sys_dll.h"
+#include "mapdatashare.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -70,7 +71,7 @@ void CollisionBSPData_Destroy( CCollisionBSPData *pBSPData )
 {
 	for ( int i = 0; i < pBSPData->numcmodels; i++ )
 	{
-		physcollision->VCollideUnload( &pBSPData->map_cmodels[i].vcollisionData );
+		MapDataShare_UnloadVCollide( &pBSPData->map_cmodels[i].vcollisionData );
 	}
 
 	// free displacement data
@@ -159,7 +160,7 @@ void CollisionBSPData_Destroy( CCollisionBSPData *pBSPData )
 
 	if ( pBSPData->map_vis )
 	{
-		free( pBSPData->map_vis );
+		MapDataShare_Free( pBSPData->map_vis );
 		pBSPData->map_vis = NULL;
 	}
 
@@ -820,6 +821,14 @@ void CollisionBSPData_LoadVisibility( CCollisionBSPData *pBSPData )
 			pBSPData->map_vis->bitofs[i][0] = LittleLong (pBSPData->map_vis->bitofs[i][0]);
 			pBSPData->map_vis->bitofs[i][1] = LittleLong (pBSPData->map_vis->bitofs[i][1]);
 		}
+
+		// dedicated servers running the same map all use one copy
+		void *pShared = MapDataShare_Attach( "vis", pBSPData->map_vis, visDataSize );
+		if ( pShared )
+		{
+			free( pBSPData->map_vis );
+			pBSPData->map_vis = (dvis_t *)pShared;
+		}
 	}
 }
 
@@ -852,6 +861,8 @@ void CollisionBSPData_LoadPhysics( CCollisionBSPData *pBSPData )
 	byte *basePtr = ptr;
 
 	dphysmodel_t physModel;
+	CUtlVector<dphysmodel_t> physModels;
+	CUtlVector<byte *> physData;
 
 	// physics data is variable length.  The last physmodel is a NULL pointer
 	// with modelIndex -1, dataSize -1
@@ -862,8 +873,8 @@ void CollisionBSPData_LoadPhysics( CCollisionBSPData *pBSPData )
 
 		if ( physModel.dataSize > 0 )
 		{
-			cmodel_t *pModel = &pBSPData->map_cmodels[ physModel.modelIndex ];
-			physcollision->VCollideLoad( &pModel->vcollisionData, physModel.solidCount, (const char *)ptr, physModel.dataSize + physModel.keydataSize );
+			physModels.AddToTail( physModel );
+			physData.AddToTail( ptr );
 			ptr += physModel.dataSize;
 			ptr += physModel.keydataSize;
 		}
@@ -873,6 +884,40 @@ void CollisionBSPData_LoadPhysics( CCollisionBSPData *pBSPData )
 			break;
 
 	} while ( physModel.dataSize > 0 );
+
+	// dedicated servers running the same map share the world and brush model solids
+	CUtlVector<unsigned char> image;
+	CUtlVector<int> imageOffsets;
+	byte *pShared = NULL;
+	int i;
+	if ( MapDataShare_IsEnabled() )
+	{
+		for ( i = 0; i < physModels.Count(); i++ )
+		{
+			int size = physModels[i].dataSize + physModels[i].keydataSize;
+			imageOffsets.AddToTail( MapDataShare_AppendVCollide( image, physModels[i].solidCount, (const char *)physData[i], size ) );
+		}
+		imageOffsets.AddToTail( image.Count() );
+		pShared = (byte *)MapDataShare_Attach( "physcollide", image.Base(), image.Count() );
+	}
+
+	for ( i = 0; i < physModels.Count(); i++ )
+	{
+		cmodel_t *pModel = &pBSPData->map_cmodels[ physModels[i].modelIndex ];
+		if ( pShared )
+		{
+			MapDataShare_LoadVCollide( &pModel->vcollisionData, physModels[i].solidCount, pShared + imageOffsets[i], imageOffsets[i+1] - imageOffsets[i] );
+		}
+		else
+		{
+			physcollision->VCollideLoad( &pModel->vcollisionData, physModels[i].solidCount, (const char *)physData[i], physModels[i].dataSize + physModels[i].keydataSize );
+		}
+	}
+
+	if ( pShared )
+	{
+		MapDataShare_Release( pShared );
+	}
 }
 
 
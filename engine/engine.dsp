@@ -314,6 +314,10 @@ SOURCE=..\Public\bitbuf.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\bitbuf_bench.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\bitbuf_errorhandler.cpp
 # End Source File
 # Begin Source File
@@ -1563,6 +1567,10 @@ SOURCE=.\Host.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\host_bench.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Host_cmd.cpp
 # ADD CPP /Yu"glquake.h"
 # End Source File
@@ -1683,6 +1691,10 @@ SOURCE=.\LocalNetworkBackdoor.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\mapdatashare.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\MaterialProxyFactory.cpp
 # ADD CPP /Yu"glquake.h"
 # End Source File
@@ -2078,6 +2090,10 @@ SOURCE=.\sv_redirect.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\sv_ticktimes.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Sv_user.cpp
 # End Source File
 # Begin Source File
@@ -2896,6 +2912,10 @@ SOURCE=.\lowpassstream.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\mapdatashare.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\master.h
 # End Source File
 # Begin Source File
@@ -3112,6 +3132,10 @@ SOURCE=.\sv_precache.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\sv_ticktimes.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\SYS.H
 # End Source File
 # Begin Source File
@@ -3680,6 +3704,10 @@ SOURCE=..\Public\utldict.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\Public\utlhashmap.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\Public\utllinkedlist.h
 # End Source File
 # Begin Source File
@@ -664,7 +664,7 @@ void CEngineTrace::ClipRayToEntity( const Ray_t &ray, unsigned int fMask, IHandl
 class CEntitiesAlongRay : public IPartitionEnumerator
 {
 public:
-	CEntitiesAlongRay( ) : m_EntityHandles(0, 32) {}
+	CEntitiesAlongRay( ) {}
 
 	void Reset()
 	{
@@ -677,7 +677,7 @@ public:
 		return ITERATION_CONTINUE;
 	}
 
-	CUtlVector< IHandleEntity * >	m_EntityHandles;
+	CUtlVectorFixedGrowable< IHandleEntity *, 32 >	m_EntityHandles;
 };
 
 
@@ -854,9 +854,8 @@ void CEngineTrace::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter
  	pTrace->fraction = 1.0;
 
 	// Collide with entities along the ray
-	// FIXME: Hitbox code causes this to be re-entrant for the IK stuff.
-	// If we could eliminate that, this could be static and therefore
-	// not have to reallocate memory all the time
+	// NOTE: Hitbox code causes this to be re-entrant for the IK stuff, so
+	// it can't be static; the list lives on the stack until it's unusually long
 	CEntitiesAlongRay enumerator;
 	enumerator.Reset();
 	SpatialPartition()->EnumerateElementsAlongRay( SpatialPartitionMask(), entityRay, false, &enumerator );
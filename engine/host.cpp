@@ -26,6 +26,7 @@
 #include "sv_main.h"
 #include "master.h"
 #include "sv_log.h"
+#include "sv_ticktimes.h"
 #include "zone.h"
 #include "game_interface.h"
 #include "sv_filter.h"
@@ -73,6 +74,9 @@
 #include "cl_ents.h"
 #include "tier0/vprof.h"
 #include "vstdlib/ICommandLine.h"
+#include "vstdlib/IKeyValuesSystem.h"
+#include <KeyValues.h>
+#include "mempool.h"
 #include "materialsystem/imaterialsystemhardwareconfig.h"
 #include "glquake.h"
 #include "staticpropmgr.h"
@@ -183,6 +187,7 @@ static ConVar	next( "next", "0", 0, "Set to 1 to advance to next frame ( when si
 // Print a debug message when the client or server cache is missed
 ConVar host_showcachemiss( "host_showcachemiss", "0", 0, "Print a debug message when the client or server cache is missed." );
 static ConVar mem_dumpstats( "mem_dumpstats", "0", 0, "Dump current and max heap usage info to console at end of frame ( set to 2 for continuous output )\n" );
+static ConVar host_showmapchangetime( "host_showmapchangetime", "0", 0, "Print how long each map change takes. Dedicated servers always print it." );
 
 extern qboolean gfBackground;
 
@@ -214,7 +219,6 @@ double		realtime;				// without any filtering or bounding
 static double	oldrealtime;			// last frame run
 
 int			host_framecount;
-static int	host_hunklevel;
 
 client_t	*host_client;			// current client
 
@@ -342,6 +346,9 @@ void Host_Error (char *error, ...)
 	SCR_EndLoadingPlaque ();		
 #endif
 	Con_Printf( "\nHost_Error: %s\n\n", string );
+
+	// The map may have been loading when it failed
+	Mod_WaitForLumpJobs();
 	
 	Host_Disconnect();
 	
@@ -1105,7 +1112,7 @@ void Host_DumpMemoryStats( void )
 	Msg( "\tCurrent mem %s\n", Q_pretifymem( size,4 ) );
 	Msg("------------------------------------\n");
 	int hunk = MEM_Summary_Console();
-	Msg("\tAllocated outside hunk:  %s\n", Q_pretifymem( size - hunk ) );
+	Msg("\tAllocated outside scopes and cache:  %s\n", Q_pretifymem( size - hunk ) );
 #endif
 }
 
@@ -1199,6 +1206,9 @@ void _Host_RunFrame_Server( bool finaltick )
 
 	VPROF_BUDGET( "_Host_RunFrame_Server", VPROF_BUDGETGROUP_GAME );
 
+	CFastTimer tickTimer;
+	tickTimer.Start();
+
 	// Run the Server frame ( read, run phsyiscs, respond )
 	g_HostTimes.StartFrameSegment( FRAME_SEGMENT_SERVER );
 	SV_Frame ( send_client_updates );
@@ -1208,7 +1218,13 @@ void _Host_RunFrame_Server( bool finaltick )
 	SV_CheckRcom();
 
 	SV_CheckTimeouts();
-	
+
+	if ( sv.active )
+	{
+		tickTimer.End();
+		SV_RecordTickStage( TICKSTAGE_SERVER_FRAME, tickTimer.GetDuration() );
+		SV_UpdateTickTimes();
+	}
 }
 
 void _Host_RunFrame_Client( bool framefinished )
@@ -1541,6 +1557,9 @@ void _Host_RunFrame (float time)
 
 	Host_PostFrameRate( host_frametime );
 
+	// Scratch memory only lasts the frame
+	Mem_FreeScope( MEMSCOPE_FRAME );
+
 	if ( host_checkheap )
 	{
 #ifdef _WIN32
@@ -1810,10 +1829,25 @@ void Host_InitProcessor( void )
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: 
+// Purpose: Reports how much KeyValues file loading happened since start, and how
+//  much of it came out of the binary cache (-nokvcache to compare against text)
 //-----------------------------------------------------------------------------
+static void Host_PrintKeyValuesLoadTime( const KeyValuesLoadStats_t &start )
+{
+	KeyValuesLoadStats_t stats;
+	KeyValuesSystem()->GetLoadStats( stats );
+
+	Con_Printf( "  KeyValues: %d text files parsed in %.2f seconds, %d loaded from the binary cache in %.2f seconds\n",
+		stats.m_nTextLoads - start.m_nTextLoads, stats.m_flTextTime - start.m_flTextTime,
+		stats.m_nCacheLoads - start.m_nCacheLoads, stats.m_flCacheTime - start.m_flCacheTime );
+}
+
 void Host_Init( void )
 {
+	double flStart = Sys_FloatTime();
+	KeyValuesLoadStats_t kvStart;
+	KeyValuesSystem()->GetLoadStats( kvStart );
+
 	realtime = 0;
 	cls.state = ( isDedicated ) ? ca_dedicated : ca_disconnected;
 
@@ -1837,6 +1871,13 @@ void Host_Init( void )
 
 	TRACEINIT( COM_Init(), COM_Shutdown() );
 
+	// Parsed resource and script files are cached in binary; -nokvcache always parses the text
+	if ( !CommandLine()->FindParm( "-nokvcache" ) )
+	{
+		g_pFileSystem->CreateDirHierarchy( "kvcache/", NULL );
+		KeyValuesSystem()->SetBinaryCacheEnabled( true );
+	}
+
 #ifndef SWDS
 	TRACEINIT( saverestore->Init(), saverestore->Shutdown() );
 #endif
@@ -1861,7 +1902,7 @@ void Host_Init( void )
 
 	TRACEINIT( g_Log.Init(), g_Log.Shutdown() );
 	
-	Con_DPrintf( "Heap:  %5.2f Mb\n", host_parms.memsize/ (1024*1024.0) );
+	Con_DPrintf( "Cache: %5.2f Mb\n", host_parms.memsize/ (1024*1024.0) );
 	
 #if defined _WIN32 && !defined SWDS
 	if ( cls.state != ca_dedicated )
@@ -1938,9 +1979,8 @@ void Host_Init( void )
 	// Initialize processor subsystem, and print relevant information:
 	Host_InitProcessor();
 
-	// Mark hunklevel at end of startup
-	Hunk_AllocName( 0, "-HOST_HUNKLEVEL-" );
-	host_hunklevel = Hunk_LowMark ();
+	// Everything on the hunk so far lives until shutdown, from here on it's level data
+	Hunk_BeginLevelScope();
 
 	// Finished initializing
 	host_initialized = true;
@@ -1972,6 +2012,28 @@ void Host_Init( void )
 		DTI_Init( "dti_client.txt" );
 		ServerDTI_Init( "dti_server.txt" );
 	}
+
+	if ( isDedicated || developer.GetInt() )
+	{
+		Con_Printf( "Engine startup took %.2f seconds\n", Sys_FloatTime() - flStart );
+		Host_PrintKeyValuesLoadTime( kvStart );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reports how long a map change took, split into spawning the server
+//  (which loads the map), the game dll's LevelInit and activating the server.
+//  Players are disconnected for all of it on a dedicated server.
+//-----------------------------------------------------------------------------
+static void Host_PrintMapChangeTime( const char *pMapName, double flStart, double flSpawned, double flLevelInit, const KeyValuesLoadStats_t &kvStart )
+{
+	if ( !isDedicated && !host_showmapchangetime.GetInt() )
+		return;
+
+	double flEnd = Sys_FloatTime();
+	Con_Printf( "Map change to %s took %.2f seconds (spawn server %.2f, level init %.2f, activate %.2f)\n",
+		pMapName, flEnd - flStart, flSpawned - flStart, flLevelInit - flSpawned, flEnd - flLevelInit );
+	Host_PrintKeyValuesLoadTime( kvStart );
 }
 
 void Host_Changelevel( bool loadfromsavedgame, const char *mapname, const char *start )
@@ -2022,13 +2084,22 @@ void Host_Changelevel( bool loadfromsavedgame, const char *mapname, const char *
 		pSaveData = saverestore->SaveGameState();
 	}
 #endif
+	double flStart = Sys_FloatTime();
+	KeyValuesLoadStats_t kvStart;
+	KeyValuesSystem()->GetLoadStats( kvStart );
+
 	serverGameDLL->LevelShutdown();
 
+	g_pFileSystem->LogLevelLoadStarted( level );
+
 	SV_InactivateClients();
 	if ( !SV_SpawnServer( level, startspot ) )
 	{
+		g_pFileSystem->LogLevelLoadFinished( level );
 		return;
 	}
+
+	double flSpawned = Sys_FloatTime();
 	
 #ifndef SWDS
 	if ( loadfromsavedgame )
@@ -2048,7 +2119,13 @@ void Host_Changelevel( bool loadfromsavedgame, const char *mapname, const char *
 		serverGameDLL->LevelInit( level, CM_EntityString(), NULL, NULL, false );
 	}
 
+	double flLevelInit = Sys_FloatTime();
+
 	SV_ActivateServer();
+
+	g_pFileSystem->LogLevelLoadFinished( level );
+
+	Host_PrintMapChangeTime( level, flStart, flSpawned, flLevelInit, kvStart );
 }
 
 static void    StripExtension (char *path)
@@ -2116,14 +2193,27 @@ bool Host_NewGame( char *mapName, bool loadGame )
 		HostState_RunGameInit();
 	}
 
+	double flStart = Sys_FloatTime();
+	KeyValuesLoadStats_t kvStart;
+	KeyValuesSystem()->GetLoadStats( kvStart );
+
+	g_pFileSystem->LogLevelLoadStarted( mapName );
+
 	if ( !SV_SpawnServer ( mapName, NULL ) )
+	{
+		g_pFileSystem->LogLevelLoadFinished( mapName );
 		return false;
+	}
+
+	double flSpawned = Sys_FloatTime();
 
 	// make sure the time is set
 	g_ServerGlobalVariables.curtime = sv.gettime();
 
 	serverGameDLL->LevelInit( mapName, CM_EntityString(), NULL, NULL, loadGame );
 
+	double flLevelInit = Sys_FloatTime();
+
 	if ( loadGame )
 	{
 		sv.paused = true;		// pause until all clients connect
@@ -2133,6 +2223,10 @@ bool Host_NewGame( char *mapName, bool loadGame )
 
 	SV_ActivateServer();
 
+	g_pFileSystem->LogLevelLoadFinished( mapName );
+
+	Host_PrintMapChangeTime( mapName, flStart, flSpawned, flLevelInit, kvStart );
+
 	if ( !sv.active )
 	{
 		return false;
@@ -2160,7 +2254,6 @@ bool Host_NewGame( char *mapName, bool loadGame )
 void Host_FreeToLowMark( bool server )
 {
 	assert( host_initialized );
-	assert( host_hunklevel );
 
 	// If called by the client and we are running a listen server, just ignore
 	if ( !server && sv.active )
@@ -2182,10 +2275,18 @@ void Host_FreeToLowMark( bool server )
 
 	modelloader->UnloadUnreferencedModels();
 
-	if ( host_hunklevel )
+	// Release the old map's data in one go
+	if ( Mem_ScopeUsed( MEMSCOPE_LEVEL ) )
+	{
+		Mem_ReportScope( MEMSCOPE_LEVEL, Con_DPrintf );
+		Con_DPrintf( "Released %d bytes of level memory\n", Mem_FreeScope( MEMSCOPE_LEVEL ) );
+	}
+
+	// The old map's KeyValues are gone, so hand back the pool blobs they emptied
+	int nPoolBytes = KeyValuesSystem()->ReleaseFreeMemory() + CMemoryPoolMT::ReleaseAllFreeBlobs();
+	if ( nPoolBytes )
 	{
-		// See if we are going to obliterate any malloc'd pointers
-		Hunk_FreeToLowMark(host_hunklevel);
+		Con_DPrintf( "Released %d bytes of memory pool blobs\n", nPoolBytes );
 	}
 }
 //-----------------------------------------------------------------------------
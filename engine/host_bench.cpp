@@ -0,0 +1,569 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Console commands that time, check and report on engine support
+//			code: memory pools, KeyValues, symbol tables and hash maps.  They're
+//			for comparing implementations on real game data, and don't
+//			change anything the engine does.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "winquake.h"
+#include "quakedef.h"
+#include "sys.h"
+#include "convar.h"
+#include "filesystem_engine.h"
+#include "vstdlib/strtools.h"
+#include "vstdlib/IKeyValuesSystem.h"
+#include <KeyValues.h>
+#include "mempool.h"
+#include "utlsymbol.h"
+#include "utldict.h"
+#include "utlhashmap.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reports the thread safe memory pools, the shared KeyValues one and
+//  any the engine has
+//-----------------------------------------------------------------------------
+static void Host_MemPoolStats_f( void )
+{
+	KeyValuesSystem()->ReportMemoryStats( Con_Printf );
+	CMemoryPoolMT::ReportAllStats( Con_Printf );
+}
+
+static ConCommand mempool_stats( "mempool_stats", Host_MemPoolStats_f, "Reports the blocks in use and memory held by the thread safe memory pools." );
+
+#define HASHMAP_TEST_KEYS		1000
+
+//-----------------------------------------------------------------------------
+// A hash that puts every key in one of eight chains, so the probes have to
+// walk past other keys and deleted slots
+//-----------------------------------------------------------------------------
+static unsigned int Host_HashMapTestCollidingHash( const int &key )
+{
+	return (unsigned int)key & 7;
+}
+
+static unsigned int Host_HashMapTestHash( const int &key )
+{
+	return (unsigned int)key * 2654435761U;
+}
+
+static bool Host_HashMapTestEqual( const int &key1, const int &key2 )
+{
+	return key1 == key2;
+}
+
+//-----------------------------------------------------------------------------
+// Checks that every key in [0, nKeys) is found exactly when bPresent says so,
+// and that Count and the iteration agree
+//-----------------------------------------------------------------------------
+static bool Host_CheckHashMapTest( CUtlHashMap<int, int> &map, const bool *bPresent, int nKeys, const char *pStep )
+{
+	int nPresent = 0;
+	for ( int key = 0; key < nKeys; key++ )
+	{
+		int i = map.Find( key );
+		if ( bPresent[key] )
+		{
+			++nPresent;
+			if ( !map.IsValidIndex( i ) || map.Key( i ) != key || map.Element( i ) != key * 3 )
+			{
+				Con_Printf( "  %s: key %d is missing\n", pStep, key );
+				return false;
+			}
+		}
+		else if ( i != map.InvalidIndex() )
+		{
+			Con_Printf( "  %s: removed key %d was found at index %d\n", pStep, key, i );
+			return false;
+		}
+	}
+
+	int nIterated = 0;
+	for ( int i = map.First(); i != map.InvalidIndex(); i = map.Next( i ) )
+	{
+		++nIterated;
+	}
+
+	if ( map.Count() != nPresent || nIterated != nPresent )
+	{
+		Con_Printf( "  %s: %d keys, Count() is %d, iteration found %d\n", pStep, nPresent, map.Count(), nIterated );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Inserts, removes and reinserts keys, growing the slot table several times
+// along the way, and checks every key after each step
+//-----------------------------------------------------------------------------
+static bool Host_RunHashMapTest( CUtlHashMap<int, int>::HashFunc_t hashFunc )
+{
+	CUtlHashMap<int, int> map( hashFunc, Host_HashMapTestEqual );
+	bool bPresent[HASHMAP_TEST_KEYS];
+	memset( bPresent, 0, sizeof( bPresent ) );
+
+	int key;
+
+	// The very first insert builds the slot table
+	map.Insert( 0, 0 );
+	bPresent[0] = true;
+	map.Remove( 0 );
+	bPresent[0] = false;
+	if ( !Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "first insert" ) )
+		return false;
+
+	for ( key = 0; key < HASHMAP_TEST_KEYS / 2; key++ )
+	{
+		map.Insert( key, key * 3 );
+		bPresent[key] = true;
+	}
+	if ( !Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "insert" ) )
+		return false;
+
+	// Every other key, half by key and half by index
+	for ( key = 0; key < HASHMAP_TEST_KEYS / 2; key += 2 )
+	{
+		if ( key & 2 )
+		{
+			map.RemoveAt( map.Find( key ) );
+		}
+		else
+		{
+			map.Remove( key );
+		}
+		bPresent[key] = false;
+	}
+	if ( !Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "remove" ) )
+		return false;
+
+	// Moves the keys left in the first quarter up into the unused half
+	for ( key = 1; key < HASHMAP_TEST_KEYS / 4; key += 2 )
+	{
+		int i = map.Find( key );
+		map.SetKey( i, key + HASHMAP_TEST_KEYS / 2 );
+		map.Element( i ) = ( key + HASHMAP_TEST_KEYS / 2 ) * 3;
+		bPresent[key] = false;
+		bPresent[key + HASHMAP_TEST_KEYS / 2] = true;
+	}
+	if ( !Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "set key" ) )
+		return false;
+
+	// Reuses the freed elements and grows past them
+	for ( key = 0; key < HASHMAP_TEST_KEYS; key++ )
+	{
+		if ( !bPresent[key] )
+		{
+			map.InsertOrReplace( key, key * 3 );
+			bPresent[key] = true;
+		}
+	}
+	if ( !Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "reinsert" ) )
+		return false;
+
+	for ( key = 0; key < HASHMAP_TEST_KEYS; key++ )
+	{
+		map.Remove( key );
+		bPresent[key] = false;
+	}
+	return Host_CheckHashMapTest( map, bPresent, HASHMAP_TEST_KEYS, "remove all" );
+}
+
+//-----------------------------------------------------------------------------
+// The same with names, the way the engine's lookups use it
+//-----------------------------------------------------------------------------
+static bool Host_RunStringHashMapTest( void )
+{
+	CUtlStringHashMap<int> map;
+	char name[32];
+	int key;
+
+	for ( key = 0; key < HASHMAP_TEST_KEYS; key++ )
+	{
+		Q_snprintf( name, sizeof( name ), "Materials/Test%d.vmt", key );
+		map.Insert( name, key );
+	}
+
+	for ( key = 0; key < HASHMAP_TEST_KEYS; key += 2 )
+	{
+		Q_snprintf( name, sizeof( name ), "materials/test%d.vmt", key );
+		map.Remove( name );
+	}
+
+	for ( key = 0; key < HASHMAP_TEST_KEYS; key++ )
+	{
+		Q_snprintf( name, sizeof( name ), "MATERIALS/TEST%d.VMT", key );
+		int i = map.Find( name );
+		bool bFound = map.IsValidIndex( i ) && map[i] == key;
+		if ( bFound != ( ( key & 1 ) != 0 ) || ( !bFound && i != map.InvalidIndex() ) )
+		{
+			Con_Printf( "  names: %s %s\n", name, bFound ? "found after it was removed" : "is missing" );
+			return false;
+		}
+	}
+
+	if ( map.Count() != HASHMAP_TEST_KEYS / 2 )
+	{
+		Con_Printf( "  names: Count() is %d, expected %d\n", map.Count(), HASHMAP_TEST_KEYS / 2 );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Checks CUtlHashMap inserts, removes and lookups across rehashes
+//-----------------------------------------------------------------------------
+static void Host_HashMapTest_f( void )
+{
+	bool bOk = Host_RunHashMapTest( Host_HashMapTestHash );
+	bOk = Host_RunHashMapTest( Host_HashMapTestCollidingHash ) && bOk;
+	bOk = Host_RunStringHashMapTest() && bOk;
+	Con_Printf( "hashmap_test: %s\n", bOk ? "passed" : "FAILED" );
+}
+
+static ConCommand hashmap_test( "hashmap_test", Host_HashMapTest_f, "Checks CUtlHashMap inserts, removes and lookups across rehashes." );
+
+// KeyValues itself is only built into the Win32 engine
+#ifdef _WIN32
+//-----------------------------------------------------------------------------
+// Purpose: Counts the heap allocations a parsed tree made: one per key, plus
+//  one per value string
+//-----------------------------------------------------------------------------
+static int Host_CountKeyValuesAllocations( KeyValues *pKeys )
+{
+	int count = 0;
+	for ( ; pKeys; pKeys = pKeys->GetNextKey() )
+	{
+		++count;
+		if ( pKeys->GetDataType() != KeyValues::TYPE_NONE )
+		{
+			++count;
+		}
+		count += Host_CountKeyValuesAllocations( pKeys->GetFirstSubKey() );
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Parses a set of KeyValues files on the heap and in an arena and
+//  compares allocation counts and load/free times
+//-----------------------------------------------------------------------------
+static void Host_KeyValuesArenaBench_f( void )
+{
+	if ( Cmd_Argc() != 2 )
+	{
+		Con_Printf( "Usage:  kv_arenabench <wildcard>, e.g. kv_arenabench materials/models/*.vmt\n" );
+		return;
+	}
+
+	char dir[MAX_OSPATH];
+	Q_strncpy( dir, Cmd_Argv( 1 ), sizeof( dir ) );
+	char *pSlash = Q_strrchr( dir, '/' );
+	if ( pSlash )
+	{
+		pSlash[1] = 0;
+	}
+	else
+	{
+		dir[0] = 0;
+	}
+
+	int nFiles = 0, nBytes = 0;
+	int nHeapAllocs = 0, nArenaAllocs = 0, nArenaBlocks = 0;
+	double flHeapLoad = 0, flHeapFree = 0, flArenaLoad = 0, flArenaFree = 0;
+
+	CKeyValuesArena arena;
+	char const *findfn = Sys_FindFirst( Cmd_Argv( 1 ), NULL );
+	while ( findfn )
+	{
+		char filename[MAX_OSPATH];
+		Q_snprintf( filename, sizeof( filename ), "%s%s", dir, findfn );
+
+		int nLength;
+		char *pBuffer = (char *)COM_LoadFileForMe( filename, &nLength );
+		if ( pBuffer )
+		{
+			double t0 = Sys_FloatTime();
+			KeyValues *pHeapKeys = new KeyValues( filename );
+			pHeapKeys->LoadFromBuffer( filename, pBuffer );
+			double t1 = Sys_FloatTime();
+			nHeapAllocs += Host_CountKeyValuesAllocations( pHeapKeys );
+			double t2 = Sys_FloatTime();
+			pHeapKeys->deleteThis();
+			double t3 = Sys_FloatTime();
+
+			KeyValues *pArenaKeys = KeyValues::CreateInArena( filename, &arena );
+			pArenaKeys->LoadFromBuffer( filename, pBuffer );
+			double t4 = Sys_FloatTime();
+			nArenaAllocs += arena.GetAllocationCount();
+			nArenaBlocks += arena.GetBlockCount();
+			arena.Clear();
+			double t5 = Sys_FloatTime();
+
+			flHeapLoad += t1 - t0;
+			flHeapFree += t3 - t2;
+			flArenaLoad += t4 - t3;
+			flArenaFree += t5 - t4;
+
+			++nFiles;
+			nBytes += nLength;
+			COM_FreeFile( (byte *)pBuffer );
+		}
+
+		findfn = Sys_FindNext( NULL );
+	}
+	Sys_FindClose();
+
+	Con_Printf( "%d files, %d bytes\n", nFiles, nBytes );
+	Con_Printf( "  heap:  %7d allocations, load %.2f ms, free %.2f ms\n",
+		nHeapAllocs, flHeapLoad * 1000.0, flHeapFree * 1000.0 );
+	Con_Printf( "  arena: %7d allocations in %d blocks, load %.2f ms, free %.2f ms\n",
+		nArenaAllocs, nArenaBlocks, flArenaLoad * 1000.0, flArenaFree * 1000.0 );
+}
+
+static ConCommand kv_arenabench( "kv_arenabench", Host_KeyValuesArenaBench_f, "Compares loading and freeing KeyValues files on the heap and in an arena." );
+
+#define SYMBOL_BENCH_THREADS	4
+
+//-----------------------------------------------------------------------------
+// A list of strings to feed to the symbol tables, in the order they were seen
+//-----------------------------------------------------------------------------
+struct SymbolBenchStrings_t
+{
+	CUtlVector<char> m_Data;
+	CUtlVector<int> m_Offsets;
+
+	void Add( const char *pString )
+	{
+		int len = Q_strlen( pString ) + 1;
+		m_Offsets.AddToTail( m_Data.AddMultipleToTail( len, pString ) );
+	}
+	int Count() const					{ return m_Offsets.Count(); }
+	const char *operator[]( int i ) const	{ return &m_Data[m_Offsets[i]]; }
+};
+
+static void Host_AddSymbolBenchKeyNames( SymbolBenchStrings_t &strings, KeyValues *pKeys )
+{
+	for ( ; pKeys; pKeys = pKeys->GetNextKey() )
+	{
+		strings.Add( pKeys->GetName() );
+		Host_AddSymbolBenchKeyNames( strings, pKeys->GetFirstSubKey() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Adds every string and then finds every string again, returning the times
+//-----------------------------------------------------------------------------
+template< class T >
+static void Host_RunSymbolBench( T &table, const SymbolBenchStrings_t &strings, double &flAdd, double &flFind )
+{
+	int i;
+	double t0 = Sys_FloatTime();
+	for ( i = 0; i < strings.Count(); i++ )
+	{
+		table.AddString( strings[i] );
+	}
+	double t1 = Sys_FloatTime();
+	for ( i = 0; i < strings.Count(); i++ )
+	{
+		table.Find( strings[i] );
+	}
+	double t2 = Sys_FloatTime();
+
+	flAdd = t1 - t0;
+	flFind = t2 - t1;
+}
+
+struct SymbolBenchThread_t
+{
+	CUtlSymbolTableMT *m_pTable;
+	const SymbolBenchStrings_t *m_pStrings;
+};
+
+static DWORD WINAPI Host_SymbolBenchThread( LPVOID pParameter )
+{
+	SymbolBenchThread_t *pThread = (SymbolBenchThread_t *)pParameter;
+	for ( int i = 0; i < pThread->m_pStrings->Count(); i++ )
+	{
+		pThread->m_pTable->AddString( (*pThread->m_pStrings)[i] );
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Runs one workload through CUtlSymbolTable and CUtlSymbolTableMT, then has
+// several threads add the same strings to one CUtlSymbolTableMT at once
+//-----------------------------------------------------------------------------
+static void Host_SymbolBench( const char *pName, const SymbolBenchStrings_t &strings )
+{
+	double flAdd, flFind;
+
+	CUtlSymbolTable rbTable( 0, 32, true );
+	Host_RunSymbolBench( rbTable, strings, flAdd, flFind );
+	Con_Printf( "%s: %d strings\n", pName, strings.Count() );
+	Con_Printf( "  CUtlSymbolTable:   add %.2f ms, find %.2f ms\n", flAdd * 1000.0, flFind * 1000.0 );
+
+	CUtlSymbolTableMT hashTable( 0, 32, true );
+	Host_RunSymbolBench( hashTable, strings, flAdd, flFind );
+	Con_Printf( "  CUtlSymbolTableMT: add %.2f ms, find %.2f ms, %d symbols\n", flAdd * 1000.0, flFind * 1000.0, hashTable.GetNumStrings() );
+
+	CUtlSymbolTableMT sharedTable( 0, 32, true );
+	SymbolBenchThread_t thread;
+	thread.m_pTable = &sharedTable;
+	thread.m_pStrings = &strings;
+
+	HANDLE hThreads[SYMBOL_BENCH_THREADS];
+	double t0 = Sys_FloatTime();
+	int i;
+	for ( i = 0; i < SYMBOL_BENCH_THREADS; i++ )
+	{
+		DWORD dwThreadID;
+		hThreads[i] = CreateThread( NULL, 0, Host_SymbolBenchThread, &thread, 0, &dwThreadID );
+	}
+	WaitForMultipleObjects( SYMBOL_BENCH_THREADS, hThreads, TRUE, INFINITE );
+	double t1 = Sys_FloatTime();
+	for ( i = 0; i < SYMBOL_BENCH_THREADS; i++ )
+	{
+		CloseHandle( hThreads[i] );
+	}
+
+	Con_Printf( "  CUtlSymbolTableMT, %d threads: add %.2f ms, %d symbols\n", SYMBOL_BENCH_THREADS, ( t1 - t0 ) * 1000.0, sharedTable.GetNumStrings() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compares the symbol tables on the strings the filesystem's path ID
+//  table (file names) and the KeyValues key name table see for a set of files
+//-----------------------------------------------------------------------------
+static void Host_SymbolTableBench_f( void )
+{
+	if ( Cmd_Argc() != 2 )
+	{
+		Con_Printf( "Usage:  symboltable_bench <wildcard>, e.g. symboltable_bench materials/models/*.vmt\n" );
+		return;
+	}
+
+	char dir[MAX_OSPATH];
+	Q_strncpy( dir, Cmd_Argv( 1 ), sizeof( dir ) );
+	char *pSlash = Q_strrchr( dir, '/' );
+	if ( pSlash )
+	{
+		pSlash[1] = 0;
+	}
+	else
+	{
+		dir[0] = 0;
+	}
+
+	SymbolBenchStrings_t paths;
+	SymbolBenchStrings_t keyNames;
+
+	CKeyValuesArena arena;
+	char const *findfn = Sys_FindFirst( Cmd_Argv( 1 ), NULL );
+	while ( findfn )
+	{
+		char filename[MAX_OSPATH];
+		Q_snprintf( filename, sizeof( filename ), "%s%s", dir, findfn );
+		paths.Add( filename );
+
+		KeyValues *pKeys = KeyValues::CreateInArena( filename, &arena );
+		if ( pKeys->LoadFromFile( g_pFileSystem, filename ) )
+		{
+			Host_AddSymbolBenchKeyNames( keyNames, pKeys );
+		}
+		arena.Clear();
+
+		findfn = Sys_FindNext( NULL );
+	}
+	Sys_FindClose();
+
+	Host_SymbolBench( "Path IDs", paths );
+	Host_SymbolBench( "KeyValues key names", keyNames );
+}
+
+static ConCommand symboltable_bench( "symboltable_bench", Host_SymbolTableBench_f, "Compares CUtlSymbolTable and CUtlSymbolTableMT on file names and KeyValues key names." );
+
+#define HASHMAP_BENCH_FIND_PASSES	8
+
+//-----------------------------------------------------------------------------
+// Adds each string that isn't there yet, the way the string tables do, then
+// looks every string up a few times
+//-----------------------------------------------------------------------------
+template< class T >
+static void Host_RunHashMapBench( T &dict, const SymbolBenchStrings_t &strings, double &flInsert, double &flFind )
+{
+	int i;
+	double t0 = Sys_FloatTime();
+	for ( i = 0; i < strings.Count(); i++ )
+	{
+		if ( !dict.IsValidIndex( dict.Find( strings[i] ) ) )
+		{
+			dict.Insert( strings[i], i );
+		}
+	}
+	double t1 = Sys_FloatTime();
+	for ( int nPass = 0; nPass < HASHMAP_BENCH_FIND_PASSES; nPass++ )
+	{
+		for ( i = 0; i < strings.Count(); i++ )
+		{
+			dict.Find( strings[i] );
+		}
+	}
+	double t2 = Sys_FloatTime();
+
+	flInsert = t1 - t0;
+	flFind = t2 - t1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compares CUtlDict and CUtlStringHashMap on a set of file names
+//-----------------------------------------------------------------------------
+static void Host_HashMapBench_f( void )
+{
+	if ( Cmd_Argc() != 2 )
+	{
+		Con_Printf( "Usage:  hashmap_bench <wildcard>, e.g. hashmap_bench materials/models/*.vmt\n" );
+		return;
+	}
+
+	char dir[MAX_OSPATH];
+	Q_strncpy( dir, Cmd_Argv( 1 ), sizeof( dir ) );
+	char *pSlash = Q_strrchr( dir, '/' );
+	if ( pSlash )
+	{
+		pSlash[1] = 0;
+	}
+	else
+	{
+		dir[0] = 0;
+	}
+
+	SymbolBenchStrings_t paths;
+	char const *findfn = Sys_FindFirst( Cmd_Argv( 1 ), NULL );
+	while ( findfn )
+	{
+		char filename[MAX_OSPATH];
+		Q_snprintf( filename, sizeof( filename ), "%s%s", dir, findfn );
+		paths.Add( filename );
+		findfn = Sys_FindNext( NULL );
+	}
+	Sys_FindClose();
+
+	double flInsert, flFind;
+	Con_Printf( "%d file names, each found %d times\n", paths.Count(), HASHMAP_BENCH_FIND_PASSES );
+
+	CUtlDict< int, int > dict;
+	Host_RunHashMapBench( dict, paths, flInsert, flFind );
+	Con_Printf( "  CUtlDict:          insert %.2f ms, find %.2f ms\n", flInsert * 1000.0, flFind * 1000.0 );
+
+	CUtlStringHashMap< int > hashMap;
+	Host_RunHashMapBench( hashMap, paths, flInsert, flFind );
+	Con_Printf( "  CUtlStringHashMap: insert %.2f ms, find %.2f ms\n", flInsert * 1000.0, flFind * 1000.0 );
+}
+
+static ConCommand hashmap_bench( "hashmap_bench", Host_HashMapBench_f, "Compares CUtlDict and CUtlStringHashMap lookups on file names." );
+#endif // _WIN32
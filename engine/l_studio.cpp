@@ -24,6 +24,7 @@
 #include "gl_cvars.h"
 #include "gl_matsysiface.h"
 #include "phyfile.h"
+#include "mapdatashare.h"
 #include "cdll_int.h"
 #include "istudiorender.h"
 #include "client_class.h"
@@ -206,7 +207,7 @@ static void Mod_FreeVCollide( model_t *pModel )
 
 	pModel->studio.vcollisionLoaded = false;
 	vcollide_t *pCollide = &pModel->studio.vcollisionData;
-	physcollision->VCollideUnload( pCollide );
+	MapDataShare_UnloadVCollide( pCollide );
 }
 
 // Call destructors on certain things in the map.
@@ -267,7 +268,11 @@ vcollide_t *Mod_VCollide( model_t *pModel )
 		return NULL;
 
 	vcollide_t *pCollide = &pModel->studio.vcollisionData;
-	physcollision->VCollideLoad( pCollide, header.solidCount, (const char *)buf, fileSize );
+	// static props and the like are shared between dedicated servers on the same machine
+	if ( !MapDataShare_VCollideLoad( "phy", pCollide, header.solidCount, (const char *)buf, fileSize ) )
+	{
+		physcollision->VCollideLoad( pCollide, header.solidCount, (const char *)buf, fileSize );
+	}
 	
 	return pCollide;
 }
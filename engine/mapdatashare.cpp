@@ -0,0 +1,394 @@
+//========= Copyright © 1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Read-only map data that dedicated servers on the same machine share.
+//
+// Each block of data is written once to a cache file named after its contents
+// (tag, CRC and size), then every server that loads the same bytes maps that file
+// read-only, so the OS keeps one copy in memory no matter how many instances are
+// running the map.  Files are written under a temporary name and renamed into place,
+// so a server never maps a partially written file.  Point -sharedmapdir at a tmpfs
+// (e.g. /dev/shm) to keep the files out of the disk cache entirely.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifdef _WIN32
+#include <windows.h>
+#elif _LINUX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "quakedef.h"
+#include "mapdatashare.h"
+#include "vphysics_interface.h"
+#include "vcollide.h"
+#include "checksum_crc.h"
+#include "filesystem_engine.h"
+#include "vstdlib/ICommandLine.h"
+#include "convar.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+extern IPhysicsCollision *physcollision;
+
+// Smaller blocks aren't worth a file and a mapping of their own
+#define MAPDATASHARE_MIN_SIZE	4096
+
+struct SharedBlock_t
+{
+	char	m_Tag[32];
+	void	*m_pBase;
+	int		m_nSize;
+	CRC32_t	m_CRC;
+	int		m_nRefCount;
+#ifdef _WIN32
+	HANDLE	m_hMapping;
+#endif
+};
+
+static CUtlVector<SharedBlock_t> s_SharedBlocks;
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool MapDataShare_IsEnabled( void )
+{
+	static int s_nEnabled = -1;
+	if ( s_nEnabled < 0 )
+	{
+		s_nEnabled = ( isDedicated && !CommandLine()->FindParm( "-nosharedmapdata" ) ) ? 1 : 0;
+	}
+	return s_nEnabled != 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Directory the cache files live in; -sharedmapdir must already exist
+//-----------------------------------------------------------------------------
+static const char *GetSharedDataDir( void )
+{
+	static char s_Dir[MAX_OSPATH] = { 0 };
+	if ( !s_Dir[0] )
+	{
+		const char *pDir = CommandLine()->ParmValue( "-sharedmapdir" );
+		if ( pDir )
+		{
+			Q_strncpy( s_Dir, pDir, sizeof( s_Dir ) );
+		}
+		else
+		{
+			g_pFileSystem->CreateDirHierarchy( "cache/shared", "GAME" );
+			Q_snprintf( s_Dir, sizeof( s_Dir ), "%s/cache/shared", com_gamedir );
+		}
+	}
+	return s_Dir;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Maps a cache file read-only; returns NULL if it's missing or the wrong size
+//-----------------------------------------------------------------------------
+static void *MapCacheFile( const char *pPath, SharedBlock_t &block )
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFile( pPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if ( GetFileSize( hFile, NULL ) != (DWORD)block.m_nSize )
+	{
+		CloseHandle( hFile );
+		return NULL;
+	}
+
+	// The mapping keeps the file open, so the file handle can go
+	block.m_hMapping = CreateFileMapping( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( hFile );
+	if ( !block.m_hMapping )
+		return NULL;
+
+	void *pBase = MapViewOfFile( block.m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( !pBase )
+	{
+		CloseHandle( block.m_hMapping );
+		block.m_hMapping = NULL;
+	}
+	return pBase;
+#elif _LINUX
+	int fd = open( pPath, O_RDONLY );
+	if ( fd < 0 )
+		return NULL;
+
+	struct stat buf;
+	if ( fstat( fd, &buf ) != 0 || buf.st_size != block.m_nSize )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	void *pBase = mmap( NULL, block.m_nSize, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	return ( pBase != MAP_FAILED ) ? pBase : NULL;
+#else
+	return NULL;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void UnmapCacheFile( SharedBlock_t &block )
+{
+#ifdef _WIN32
+	UnmapViewOfFile( block.m_pBase );
+	CloseHandle( block.m_hMapping );
+#elif _LINUX
+	munmap( block.m_pBase, block.m_nSize );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Publishes a cache file.  If another server beats us to it, theirs is used.
+//-----------------------------------------------------------------------------
+static void WriteCacheFile( const char *pPath, const void *pData, int nSize )
+{
+	char tempPath[MAX_OSPATH];
+#ifdef _WIN32
+	Q_snprintf( tempPath, sizeof( tempPath ), "%s.%d.tmp", pPath, (int)GetCurrentProcessId() );
+#else
+	Q_snprintf( tempPath, sizeof( tempPath ), "%s.%d.tmp", pPath, (int)getpid() );
+#endif
+
+	FILE *fp = fopen( tempPath, "wb" );
+	if ( !fp )
+		return;
+
+	bool bWritten = ( fwrite( pData, nSize, 1, fp ) == 1 );
+	if ( fclose( fp ) != 0 )
+	{
+		bWritten = false;
+	}
+
+	if ( !bWritten || rename( tempPath, pPath ) != 0 )
+	{
+		remove( tempPath );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static SharedBlock_t *FindBlock( const void *p )
+{
+	for ( int i = 0; i < s_SharedBlocks.Count(); i++ )
+	{
+		SharedBlock_t &block = s_SharedBlocks[i];
+		if ( p >= block.m_pBase && p < (byte *)block.m_pBase + block.m_nSize )
+			return &block;
+	}
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void *MapDataShare_Attach( const char *pTag, const void *pData, int nSize )
+{
+	if ( !MapDataShare_IsEnabled() || nSize < MAPDATASHARE_MIN_SIZE )
+		return NULL;
+
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, (void *)pData, nSize );
+	CRC32_Final( &crc );
+
+	// Already mapped by this process?
+	int i;
+	for ( i = 0; i < s_SharedBlocks.Count(); i++ )
+	{
+		SharedBlock_t &block = s_SharedBlocks[i];
+		if ( block.m_CRC == crc && block.m_nSize == nSize && !memcmp( block.m_pBase, pData, nSize ) )
+		{
+			++block.m_nRefCount;
+			return block.m_pBase;
+		}
+	}
+
+	char path[MAX_OSPATH];
+	Q_snprintf( path, sizeof( path ), "%s/%s_%08lx_%d.dat", GetSharedDataDir(), pTag, (unsigned long)crc, nSize );
+
+	SharedBlock_t block;
+	memset( &block, 0, sizeof( block ) );
+	Q_strncpy( block.m_Tag, pTag, sizeof( block.m_Tag ) );
+	block.m_nSize = nSize;
+	block.m_CRC = crc;
+	block.m_nRefCount = 1;
+
+	block.m_pBase = MapCacheFile( path, block );
+	if ( !block.m_pBase )
+	{
+		WriteCacheFile( path, pData, nSize );
+		block.m_pBase = MapCacheFile( path, block );
+		if ( !block.m_pBase )
+		{
+			Warning( "Can't share map data: unable to map %s\n", path );
+			return NULL;
+		}
+	}
+
+	// The name is only a hash, so make sure the contents really are the same
+	if ( memcmp( block.m_pBase, pData, nSize ) )
+	{
+		Warning( "Can't share map data: %s doesn't match what was loaded\n", path );
+		UnmapCacheFile( block );
+		return NULL;
+	}
+
+	s_SharedBlocks.AddToTail( block );
+	return block.m_pBase;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void MapDataShare_AddRef( const void *pShared )
+{
+	SharedBlock_t *pBlock = FindBlock( pShared );
+	Assert( pBlock );
+	if ( pBlock )
+	{
+		++pBlock->m_nRefCount;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool MapDataShare_Release( const void *pShared )
+{
+	SharedBlock_t *pBlock = FindBlock( pShared );
+	if ( !pBlock )
+		return false;
+
+	Assert( pBlock->m_nRefCount > 0 );
+	if ( --pBlock->m_nRefCount == 0 )
+	{
+		UnmapCacheFile( *pBlock );
+		s_SharedBlocks.Remove( pBlock - s_SharedBlocks.Base() );
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void MapDataShare_Free( void *pData )
+{
+	if ( pData && !MapDataShare_Release( pData ) )
+	{
+		free( pData );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Copies a VCollideLoad buffer, padding each solid out to the alignment
+//			VCollideLoadInPlace expects.  The image is mapped on a page boundary, so
+//			offsets in the image line up with addresses in the mapping.
+//-----------------------------------------------------------------------------
+int MapDataShare_AppendVCollide( CUtlVector<unsigned char> &image, int solidCount, const char *pBuffer, int nSize )
+{
+	int offset = image.Count();
+	int position = 0;
+
+	for ( int i = 0; i < solidCount; i++ )
+	{
+		int misalign = ( image.Count() + sizeof(int) ) & (VCOLLIDE_INPLACE_ALIGN-1);
+		if ( misalign )
+		{
+			int pad = image.AddMultipleToTail( VCOLLIDE_INPLACE_ALIGN - misalign );
+			memset( &image[pad], 0, VCOLLIDE_INPLACE_ALIGN - misalign );
+		}
+
+		int size;
+		memcpy( &size, pBuffer + position, sizeof(int) );
+		image.AddMultipleToTail( sizeof(int) + size, (const unsigned char *)pBuffer + position );
+		position += sizeof(int) + size;
+	}
+
+	// key values
+	if ( nSize > position )
+	{
+		image.AddMultipleToTail( nSize - position, (const unsigned char *)pBuffer + position );
+	}
+
+	return offset;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void MapDataShare_LoadVCollide( vcollide_t *pOutput, int solidCount, const void *pShared, int nSize )
+{
+	MapDataShare_AddRef( pShared );
+	physcollision->VCollideLoadInPlace( pOutput, solidCount, (const char *)pShared, nSize );
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool MapDataShare_VCollideLoad( const char *pTag, vcollide_t *pOutput, int solidCount, const char *pBuffer, int nSize )
+{
+	if ( !MapDataShare_IsEnabled() || nSize < MAPDATASHARE_MIN_SIZE )
+		return false;
+
+	CUtlVector<unsigned char> image;
+	MapDataShare_AppendVCollide( image, solidCount, pBuffer, nSize );
+
+	void *pShared = MapDataShare_Attach( pTag, image.Base(), image.Count() );
+	if ( !pShared )
+		return false;
+
+	MapDataShare_LoadVCollide( pOutput, solidCount, pShared, image.Count() );
+	MapDataShare_Release( pShared );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void MapDataShare_UnloadVCollide( vcollide_t *pCollide )
+{
+	if ( pCollide->solidCount > 0 && FindBlock( pCollide->solids[0] ) )
+	{
+		const void *pShared = pCollide->solids[0];
+		physcollision->VCollideUnloadInPlace( pCollide );
+		MapDataShare_Release( pShared );
+	}
+	else
+	{
+		physcollision->VCollideUnload( pCollide );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void MapDataShare_Info_f( void )
+{
+	int nTotal = 0;
+	for ( int i = 0; i < s_SharedBlocks.Count(); i++ )
+	{
+		const SharedBlock_t &block = s_SharedBlocks[i];
+		Con_Printf( "%-16s %08lx %9d bytes %3d refs\n", block.m_Tag, (unsigned long)block.m_CRC, block.m_nSize, block.m_nRefCount );
+		nTotal += block.m_nSize;
+	}
+	Con_Printf( "%d blocks, %d KB of map data shared\n", s_SharedBlocks.Count(), nTotal / 1024 );
+}
+
+static ConCommand mapdata_shareinfo( "mapdata_shareinfo", MapDataShare_Info_f, "Lists the map data this server shares with other servers on the machine." );
@@ -0,0 +1,46 @@
+//========= Copyright © 1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Read-only map data that dedicated servers on the same machine share
+//			through content-hashed, memory-mapped cache files.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef MAPDATASHARE_H
+#define MAPDATASHARE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlvector.h"
+
+struct vcollide_t;
+
+
+// Returns true if this process shares its map data (dedicated servers, unless -nosharedmapdata)
+bool MapDataShare_IsEnabled( void );
+
+// Returns a read-only copy of pData that every process asking for the same bytes maps from the
+// same cache file, with one reference held by the caller.  Returns NULL if sharing is off or the
+// cache can't be used, in which case the caller just keeps its private copy.
+void *MapDataShare_Attach( const char *pTag, const void *pData, int nSize );
+void MapDataShare_AddRef( const void *pShared );
+// Returns false if pShared doesn't point into shared data
+bool MapDataShare_Release( const void *pShared );
+
+// Releases pData if it's shared data, otherwise free()s it
+void MapDataShare_Free( void *pData );
+
+// Appends a VCollideLoad buffer to an image that will be passed to MapDataShare_Attach,
+// padded so VCollideLoadInPlace can use the solids straight out of the mapping.
+// Returns the offset of the copy in the image.
+int MapDataShare_AppendVCollide( CUtlVector<unsigned char> &image, int solidCount, const char *pBuffer, int nSize );
+// Loads a vcollide from a copy made by MapDataShare_AppendVCollide in an attached image
+void MapDataShare_LoadVCollide( vcollide_t *pOutput, int solidCount, const void *pShared, int nSize );
+// Shares and loads a single VCollideLoad buffer.  Returns false if it wasn't shared.
+bool MapDataShare_VCollideLoad( const char *pTag, vcollide_t *pOutput, int solidCount, const char *pBuffer, int nSize );
+// Unloads a vcollide loaded by either MapDataShare_LoadVCollide or VCollideLoad
+void MapDataShare_UnloadVCollide( vcollide_t *pCollide );
+
+
+#endif // MAPDATASHARE_H
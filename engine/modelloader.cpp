@@ -26,8 +26,16 @@
 #include "gl_rsurf.h"
 #include "materialsystem/itexture.h"
 #include "Overlay.h"
-#include "utldict.h"
+#include "utlhashmap.h"
 #include "mempool.h"
+#include "checksum_crc.h"
+#include "tier0/platform.h"
+#include "vstdlib/ICommandLine.h"
+#include "sys.h"
+
+#ifdef _WIN32
+#include "winquake.h"
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -147,7 +155,8 @@ private:
 		model_t *modelpointer;
 	};
 
-	CUtlDict< ModelEntry, int >	m_Models;
+	// Models are never removed one at a time, so the indices run 0..Count()-1
+	CUtlStringHashMap< ModelEntry >	m_Models;
 
 	CMemoryPool			m_ModelPool;
 
@@ -176,6 +185,371 @@ static char			s_MapName[ 64 ];
 static model_t		*s_pMap = NULL;
 static int			s_nMapLoadRecursion = 0;
 
+// Lumps being read in the background (see CMapLoadHelper::PrefetchLumps)
+#define MAX_LUMP_PREFETCH_BYTES		(32*1024*1024)
+
+static ConVar		mod_prefetchlumps( "mod_prefetchlumps", "1", 0, "Read map lumps in the background while the earlier ones are being parsed." );
+static FSAsyncControl_t	s_LumpPrefetch[ HEADER_LUMPS ];
+static byte			*s_pLumpPrefetchData[ HEADER_LUMPS ];
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Waits for a prefetched lump and takes its buffer. Returns NULL if the
+//  lump wasn't prefetched or the read failed, and the caller reads it itself.
+//-----------------------------------------------------------------------------
+static byte *TakePrefetchedLump( int nLump, int nSize )
+{
+	FSAsyncControl_t control = s_LumpPrefetch[ nLump ];
+	if ( !control )
+		return NULL;
+
+	byte *pData = s_pLumpPrefetchData[ nLump ];
+	s_LumpPrefetch[ nLump ] = NULL;
+	s_pLumpPrefetchData[ nLump ] = NULL;
+
+	int nBytesRead = 0;
+	FSAsyncStatus_t status = g_pFileSystem->AsyncFinish( control, true, NULL, &nBytesRead );
+	g_pFileSystem->AsyncRelease( control );
+
+	if ( status != FSASYNC_OK || nBytesRead != nSize )
+	{
+		delete[] pData;
+		return NULL;
+	}
+
+	return pData;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Throws away prefetched lumps that never got used.
+//-----------------------------------------------------------------------------
+static void CancelPrefetchedLumps( void )
+{
+	for ( int i = 0; i < HEADER_LUMPS; i++ )
+	{
+		if ( !s_LumpPrefetch[ i ] )
+			continue;
+
+		g_pFileSystem->AsyncAbort( s_LumpPrefetch[ i ] );
+		g_pFileSystem->AsyncRelease( s_LumpPrefetch[ i ] );
+		delete[] s_pLumpPrefetchData[ i ];
+
+		s_LumpPrefetch[ i ] = NULL;
+		s_pLumpPrefetchData[ i ] = NULL;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Lump decoding jobs. The main thread checks a lump and allocates its hunk memory,
+// then hands the conversion loop to a worker thread and moves on to the next lump.
+// Jobs only touch their lump buffer and the memory they were given, so the hunk,
+// the material system and Host_Error all stay on the main thread. Anything that
+// reads a decoded lump has to call WaitForLumpJob on it first.
+//-----------------------------------------------------------------------------
+#define MAX_LUMP_JOB_THREADS		4
+
+struct LumpJob_t;
+typedef void (*LumpJobFn_t)( LumpJob_t *pJob );
+
+struct LumpJob_t
+{
+	LumpJobFn_t		m_pfnDecode;
+	byte			*m_pLumpData[2];	// Raw lumps. Freed when the job is waited on.
+	void			*m_pOut;
+	int				m_nCount;
+	int				m_nExtraCount;
+	medge_t			*m_pEdges;			// Scratch space for the surfedges job
+	volatile long	m_bDone;
+};
+
+static ConVar		mod_threadedload( "mod_threadedload", "1", 0, "Decode map lumps on worker threads while the main thread loads the rest of the map." );
+static ConVar		mod_loadtimes( "mod_loadtimes", "0", 0, "Print how long each stage of loading the world takes." );
+static LumpJob_t	*s_pLumpJobs[ HEADER_LUMPS ];
+static int			s_nLumpJobThreads = 0;
+
+#ifdef _WIN32
+static CRITICAL_SECTION	s_LumpJobCS;
+static HANDLE		s_hLumpJobSemaphore;	// Released once for each queued job
+static HANDLE		s_hLumpJobDoneEvent;	// Set whenever a job finishes
+static HANDLE		s_hLumpJobThreads[ MAX_LUMP_JOB_THREADS ];
+static volatile bool s_bLumpJobThreadsExit = false;
+static CUtlVector< LumpJob_t* > s_LumpJobQueue;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes the oldest queued job and runs it. Returns false if the queue
+//  was empty.
+//-----------------------------------------------------------------------------
+static bool RunNextLumpJob( void )
+{
+	EnterCriticalSection( &s_LumpJobCS );
+	if ( s_LumpJobQueue.Count() == 0 )
+	{
+		LeaveCriticalSection( &s_LumpJobCS );
+		return false;
+	}
+
+	LumpJob_t *pJob = s_LumpJobQueue[ 0 ];
+	s_LumpJobQueue.Remove( 0 );
+	LeaveCriticalSection( &s_LumpJobCS );
+
+	pJob->m_pfnDecode( pJob );
+
+	InterlockedExchange( &pJob->m_bDone, 1 );
+	SetEvent( s_hLumpJobDoneEvent );
+	return true;
+}
+
+static DWORD WINAPI LumpJobThreadFn( LPVOID pParameter )
+{
+	while ( 1 )
+	{
+		WaitForSingleObject( s_hLumpJobSemaphore, INFINITE );
+		if ( s_bLumpJobThreadsExit )
+			break;
+
+		RunNextLumpJob();
+	}
+
+	return 0;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts the worker threads the first time a map loads. They sleep
+//  between loads. One CPU is left for the main thread.
+//-----------------------------------------------------------------------------
+static void StartLumpJobThreads( void )
+{
+#ifdef _WIN32
+	if ( s_nLumpJobThreads || !mod_threadedload.GetInt() )
+		return;
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo( &sysInfo );
+
+	int nThreads = (int)sysInfo.dwNumberOfProcessors - 1;
+	if ( nThreads < 1 )
+	{
+		nThreads = 1;
+	}
+	else if ( nThreads > MAX_LUMP_JOB_THREADS )
+	{
+		nThreads = MAX_LUMP_JOB_THREADS;
+	}
+
+	InitializeCriticalSection( &s_LumpJobCS );
+	s_hLumpJobSemaphore = CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+	s_hLumpJobDoneEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+	s_LumpJobQueue.EnsureCapacity( HEADER_LUMPS );
+	s_bLumpJobThreadsExit = false;
+
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		DWORD dwThreadID;
+		s_hLumpJobThreads[ s_nLumpJobThreads ] = CreateThread( NULL, 0, LumpJobThreadFn, NULL, 0, &dwThreadID );
+		if ( s_hLumpJobThreads[ s_nLumpJobThreads ] )
+		{
+			++s_nLumpJobThreads;
+		}
+	}
+
+	if ( !s_nLumpJobThreads )
+	{
+		// Run everything on the main thread like before
+		CloseHandle( s_hLumpJobSemaphore );
+		CloseHandle( s_hLumpJobDoneEvent );
+		DeleteCriticalSection( &s_LumpJobCS );
+	}
+#endif
+}
+
+static void StopLumpJobThreads( void )
+{
+#ifdef _WIN32
+	if ( !s_nLumpJobThreads )
+		return;
+
+	Mod_WaitForLumpJobs();
+
+	s_bLumpJobThreadsExit = true;
+	ReleaseSemaphore( s_hLumpJobSemaphore, s_nLumpJobThreads, NULL );
+	WaitForMultipleObjects( s_nLumpJobThreads, s_hLumpJobThreads, TRUE, INFINITE );
+
+	for ( int i = 0; i < s_nLumpJobThreads; i++ )
+	{
+		CloseHandle( s_hLumpJobThreads[ i ] );
+	}
+	s_nLumpJobThreads = 0;
+
+	CloseHandle( s_hLumpJobSemaphore );
+	CloseHandle( s_hLumpJobDoneEvent );
+	DeleteCriticalSection( &s_LumpJobCS );
+	s_LumpJobQueue.Purge();
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Hands a job to the worker threads, or runs it right away if there
+//  aren't any.
+//-----------------------------------------------------------------------------
+static void StartLumpJob( LumpJob_t *pJob )
+{
+#ifdef _WIN32
+	if ( s_nLumpJobThreads )
+	{
+		EnterCriticalSection( &s_LumpJobCS );
+		s_LumpJobQueue.AddToTail( pJob );
+		LeaveCriticalSection( &s_LumpJobCS );
+
+		ReleaseSemaphore( s_hLumpJobSemaphore, 1, NULL );
+		return;
+	}
+#endif
+
+	pJob->m_pfnDecode( pJob );
+	pJob->m_bDone = 1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes ownership of the lump buffer and starts decoding it. Pass
+//  bStart = false to fill in more of the job before calling StartLumpJob.
+//-----------------------------------------------------------------------------
+static LumpJob_t *QueueLumpJob( int nLump, LumpJobFn_t pfnDecode, CMapLoadHelper &lh, void *pOut, int nCount, bool bStart = true )
+{
+	Assert( !s_pLumpJobs[ nLump ] );
+
+	LumpJob_t *pJob = new LumpJob_t;
+	memset( pJob, 0, sizeof( *pJob ) );
+	pJob->m_pfnDecode = pfnDecode;
+	pJob->m_pLumpData[0] = lh.TakeLumpData();
+	pJob->m_pOut = pOut;
+	pJob->m_nCount = nCount;
+	s_pLumpJobs[ nLump ] = pJob;
+
+	if ( bStart )
+	{
+		StartLumpJob( pJob );
+	}
+	return pJob;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Waits for a lump's job, if it has one, and frees the raw lump. The
+//  main thread runs queued jobs itself while it waits.
+//-----------------------------------------------------------------------------
+static void WaitForLumpJob( int nLump )
+{
+	LumpJob_t *pJob = s_pLumpJobs[ nLump ];
+	if ( !pJob )
+		return;
+
+#ifdef _WIN32
+	while ( !pJob->m_bDone )
+	{
+		if ( !RunNextLumpJob() )
+		{
+			WaitForSingleObject( s_hLumpJobDoneEvent, INFINITE );
+		}
+	}
+#endif
+
+	s_pLumpJobs[ nLump ] = NULL;
+	delete[] pJob->m_pLumpData[0];
+	delete[] pJob->m_pLumpData[1];
+	delete[] pJob->m_pEdges;
+	delete pJob;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Waits for every outstanding lump job.
+//-----------------------------------------------------------------------------
+void Mod_WaitForLumpJobs( void )
+{
+	for ( int i = 0; i < HEADER_LUMPS; i++ )
+	{
+		WaitForLumpJob( i );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// What Map_LoadModel loads. A dedicated server never draws the world, so it uses
+// the server profile: the collision model (brushes, vis, areaportals, entities,
+// displacement and static prop collision) plus the parts of the world model the
+// server reads, which are the brush models and their surfaces and materials.
+// The lumps only the renderer reads are skipped and their model fields are left
+// empty, the same as a map that doesn't have them. -fullmapload turns it off.
+//-----------------------------------------------------------------------------
+enum MapLoadProfile_t
+{
+	MAPLOAD_FULL = 0,
+	MAPLOAD_SERVER,
+};
+
+static MapLoadProfile_t GetMapLoadProfile( void )
+{
+	if ( isDedicated && !CommandLine()->FindParm( "-fullmapload" ) )
+		return MAPLOAD_SERVER;
+
+	return MAPLOAD_FULL;
+}
+
+static bool IsRenderOnlyLump( int nLump )
+{
+	switch ( nLump )
+	{
+	case LUMP_LIGHTING:
+	case LUMP_WORLDLIGHTS:
+	case LUMP_PRIMITIVES:
+	case LUMP_PRIMVERTS:
+	case LUMP_PRIMINDICES:
+	case LUMP_VERTNORMALS:
+	case LUMP_VERTNORMALINDICES:
+	case LUMP_CUBEMAPS:
+	case LUMP_LEAFMINDISTTOWATER:
+	case LUMP_LEAFWATERDATA:
+	case LUMP_OCCLUSION:
+	case LUMP_OVERLAYS:
+		return true;
+	}
+
+	return false;
+}
+
+static void ClearRenderOnlyLumps( model_t *mod )
+{
+	brushdata_t *b = &mod->brush;
+	b->lightdata = NULL;
+	b->numworldlights = 0;
+	b->worldlights = NULL;
+	b->numprimitives = 0;
+	b->primitives = NULL;
+	b->numprimverts = 0;
+	b->primverts = NULL;
+	b->numprimindices = 0;
+	b->primindices = NULL;
+	b->numvertnormals = 0;
+	b->vertnormals = NULL;
+	b->numvertnormalindices = 0;
+	b->vertnormalindices = NULL;
+	b->m_nCubemapSamples = 0;
+	b->m_pCubemapSamples = NULL;
+	b->m_LeafMinDistToWater = NULL;
+	b->numleafwaterdata = 0;
+	b->leafwaterdata = NULL;
+	b->numoccluders = 0;
+	b->occluders = NULL;
+	b->numoccluderpolys = 0;
+	b->occluderpolys = NULL;
+	b->numoccludervertindices = 0;
+	b->occludervertindices = NULL;
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -187,6 +561,10 @@ void CMapLoadHelper::Init( model_t *map, const char *loadname )
 	if ( ++s_nMapLoadRecursion > 1 )
 		return;
 
+	// In case the last load was cut short by a Host_Error
+	CancelPrefetchedLumps();
+	Mod_WaitForLumpJobs();
+
 	s_pMap = NULL;
 	s_szLoadName[ 0 ] = 0;
 	s_MapFile = (FileHandle_t)0;
@@ -243,6 +621,8 @@ void CMapLoadHelper::Shutdown( void )
 	if ( --s_nMapLoadRecursion > 0 )
 		return;
 
+	CancelPrefetchedLumps();
+
 	if ( s_MapFile )
 	{
 		g_pFileSystem->Close( s_MapFile );
@@ -294,6 +674,51 @@ void CMapLoadHelper::LoadLumpData( int nLumpId, int offset, int size, void *pDat
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Queues async reads for lumps that are about to be loaded. Earlier
+//  lumps get higher priority. Lumps that don't fit in the budget are read when
+//  they're needed, like before.
+//-----------------------------------------------------------------------------
+void CMapLoadHelper::PrefetchLumps( const int *pLumps, int nLumps )
+{
+	if ( !mod_prefetchlumps.GetInt() || s_nMapLoadRecursion != 1 || !s_MapFile )
+		return;
+
+	int nQueuedBytes = 0;
+	for ( int i = 0; i < nLumps; i++ )
+	{
+		int nLump = pLumps[ i ];
+		lump_t *pLump = &s_MapHeader.lumps[ nLump ];
+		if ( s_LumpPrefetch[ nLump ] || pLump->filelen <= 0 )
+			continue;
+
+		if ( GetMapLoadProfile() == MAPLOAD_SERVER && IsRenderOnlyLump( nLump ) )
+			continue;
+
+		if ( nQueuedBytes + pLump->filelen > MAX_LUMP_PREFETCH_BYTES )
+			continue;
+
+		FileAsyncRequest_t request;
+		request.pszFilename = s_MapName;
+		request.nOffset = pLump->fileofs;
+		request.nBytes = pLump->filelen;
+		request.pData = new byte[ pLump->filelen + 1 ];
+		request.priority = nLumps - i;
+
+		if ( g_pFileSystem->AsyncRead( request, &s_LumpPrefetch[ nLump ] ) != FSASYNC_OK )
+		{
+			// Every lump is in the same file, so the rest would fail too.
+			delete[] (byte *)request.pData;
+			s_LumpPrefetch[ nLump ] = NULL;
+			return;
+		}
+
+		s_pLumpPrefetchData[ nLump ] = (byte *)request.pData;
+		nQueuedBytes += pLump->filelen;
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : mapfile - 
@@ -327,6 +752,10 @@ CMapLoadHelper::CMapLoadHelper( int lumpToLoad )
 	m_nLumpSize = lump->filelen;
 	m_nLumpVersion = lump->version;
 
+	m_pData = TakePrefetchedLump( lumpToLoad, m_nLumpSize );
+	if ( m_pData )
+		return;
+
 	// At least one byte
 
 	m_pData = (byte *)new byte[ m_nLumpSize + 1 ];
@@ -400,6 +829,17 @@ int	CMapLoadHelper::LumpVersion() const
 	return m_nLumpVersion;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: 
+// Output : byte
+//-----------------------------------------------------------------------------
+byte *CMapLoadHelper::TakeLumpData( void )
+{
+	byte *pData = m_pData;
+	m_pData = NULL;
+	return pData;
+}
+
 
 //-----------------------------------------------------------------------------
 // Allocates, frees lighting data
@@ -446,6 +886,15 @@ static int ComputeLightmapSize( dface_t *pFace, mtexinfo_t *pTexInfo )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Lump job that copies the lump as-is. m_nCount is the size in bytes.
+//-----------------------------------------------------------------------------
+static void Mod_CopyLump( LumpJob_t *pJob )
+{
+	memcpy( pJob->m_pOut, pJob->m_pLumpData[0], pJob->m_nCount );
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -498,51 +947,42 @@ void Mod_LoadLighting()
 	// BSP_VERSION_CHANGE: End removing here! when the BSP version is upgraded to 19
 	{
 		AllocateLightingData( lh.GetMap(), lh.LumpSize() );
-		memcpy( lh.GetMap()->brush.lightdata, lh.LumpBase(), lh.LumpSize());
+		QueueLumpJob( LUMP_LIGHTING, Mod_CopyLump, lh, lh.GetMap()->brush.lightdata, lh.LumpSize() );
 	}
 }
 
 
 //-----------------------------------------------------------------------------
-// Purpose: 
+// Purpose: Lump job that copies the world lights and fixes up old ones.
 //-----------------------------------------------------------------------------
-void Mod_LoadWorldlights( void )
+static void Mod_DecodeWorldlights( LumpJob_t *pJob )
 {
-	CMapLoadHelper lh( LUMP_WORLDLIGHTS );
-
-	if (!lh.LumpSize())
-	{
-		lh.GetMap()->brush.numworldlights = 0;
-		lh.GetMap()->brush.worldlights = NULL;
-		return;
-	}
-	lh.GetMap()->brush.numworldlights = lh.LumpSize() / sizeof( dworldlight_t );
-	lh.GetMap()->brush.worldlights = (dworldlight_t *)Hunk_AllocName( lh.LumpSize(), lh.GetLoadName() );
-	memcpy (lh.GetMap()->brush.worldlights, lh.LumpBase(), lh.LumpSize());
+	dworldlight_t *pLights = (dworldlight_t *)pJob->m_pOut;
+	memcpy( pLights, pJob->m_pLumpData[0], pJob->m_nCount * sizeof( dworldlight_t ) );
 
 	// Fixup for backward compatability
-	for ( int i = 0; i < lh.GetMap()->brush.numworldlights; i++ )
+	for ( int i = 0; i < pJob->m_nCount; i++ )
 	{
-		if( lh.GetMap()->brush.worldlights[i].type == emit_spotlight)
+		if( pLights[i].type == emit_spotlight)
 		{
-			if ((lh.GetMap()->brush.worldlights[i].constant_attn == 0.0) && 
-				(lh.GetMap()->brush.worldlights[i].linear_attn == 0.0) && 
-				(lh.GetMap()->brush.worldlights[i].quadratic_attn == 0.0))
+			if ((pLights[i].constant_attn == 0.0) && 
+				(pLights[i].linear_attn == 0.0) && 
+				(pLights[i].quadratic_attn == 0.0))
 			{
-				lh.GetMap()->brush.worldlights[i].quadratic_attn = 1.0;
+				pLights[i].quadratic_attn = 1.0;
 			}
 
-			if (lh.GetMap()->brush.worldlights[i].exponent == 0.0)
-				lh.GetMap()->brush.worldlights[i].exponent = 1.0;
+			if (pLights[i].exponent == 0.0)
+				pLights[i].exponent = 1.0;
 		}
-		else if( lh.GetMap()->brush.worldlights[i].type == emit_point)
+		else if( pLights[i].type == emit_point)
 		{
 			// To match earlier lighting, use quadratic...
-			if ((lh.GetMap()->brush.worldlights[i].constant_attn == 0.0) && 
-				(lh.GetMap()->brush.worldlights[i].linear_attn == 0.0) && 
-				(lh.GetMap()->brush.worldlights[i].quadratic_attn == 0.0))
+			if ((pLights[i].constant_attn == 0.0) && 
+				(pLights[i].linear_attn == 0.0) && 
+				(pLights[i].quadratic_attn == 0.0))
 			{
-				lh.GetMap()->brush.worldlights[i].quadratic_attn = 1.0;
+				pLights[i].quadratic_attn = 1.0;
 			}
 		}
 
@@ -550,8 +990,41 @@ void Mod_LoadWorldlights( void )
 		// with a max light radius. Radius of less than 1 will never happen,
 		// so I can get away with this. When I set radius to 0, it'll 
 		// run the old code which computed a radius
-		if (lh.GetMap()->brush.worldlights[i].radius < 1)
-			lh.GetMap()->brush.worldlights[i].radius = 0;
+		if (pLights[i].radius < 1)
+			pLights[i].radius = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void Mod_LoadWorldlights( void )
+{
+	CMapLoadHelper lh( LUMP_WORLDLIGHTS );
+
+	if (!lh.LumpSize())
+	{
+		lh.GetMap()->brush.numworldlights = 0;
+		lh.GetMap()->brush.worldlights = NULL;
+		return;
+	}
+	lh.GetMap()->brush.numworldlights = lh.LumpSize() / sizeof( dworldlight_t );
+	lh.GetMap()->brush.worldlights = (dworldlight_t *)Hunk_AllocName( lh.LumpSize(), lh.GetLoadName() );
+	QueueLumpJob( LUMP_WORLDLIGHTS, Mod_DecodeWorldlights, lh, lh.GetMap()->brush.worldlights, lh.GetMap()->brush.numworldlights );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Lump job
+//-----------------------------------------------------------------------------
+static void Mod_DecodeVertices( LumpJob_t *pJob )
+{
+	dvertex_t *in = (dvertex_t *)pJob->m_pLumpData[0];
+	mvertex_t *out = (mvertex_t *)pJob->m_pOut;
+	for ( int i=0 ; i<pJob->m_nCount ; i++, in++, out++)
+	{
+		out->position[0] = LittleFloat (in->point[0]);
+		out->position[1] = LittleFloat (in->point[1]);
+		out->position[2] = LittleFloat (in->point[2]);
 	}
 }
 
@@ -562,7 +1035,7 @@ void Mod_LoadVertices( void )
 {
 	dvertex_t	*in;
 	mvertex_t	*out;
-	int			i, count;
+	int			count;
 
 	CMapLoadHelper lh( LUMP_VERTEXES );
 
@@ -577,12 +1050,7 @@ void Mod_LoadVertices( void )
 	lh.GetMap()->brush.vertexes = out;
 	lh.GetMap()->brush.numvertexes = count;
 
-	for ( i=0 ; i<count ; i++, in++, out++)
-	{
-		out->position[0] = LittleFloat (in->point[0]);
-		out->position[1] = LittleFloat (in->point[1]);
-		out->position[2] = LittleFloat (in->point[2]);
-	}
+	QueueLumpJob( LUMP_VERTEXES, Mod_DecodeVertices, lh, out, count );
 }
 
 //-----------------------------------------------------------------------------
@@ -640,37 +1108,6 @@ void Mod_LoadSubmodels( void )
 }
 
 
-//-----------------------------------------------------------------------------
-// Purpose: 
-// Output : medge_t *Mod_LoadEdges
-//-----------------------------------------------------------------------------
-medge_t *Mod_LoadEdges ( void )
-{
-	dedge_t *in;
-	medge_t *out;
-	int 	i, count;
-
-	CMapLoadHelper lh( LUMP_EDGES );
-
-	in = (dedge_t *)lh.LumpBase();
-	if (lh.LumpSize() % sizeof(*in))
-		Host_Error ("Mod_LoadEdges: funny lump size in %s",lh.GetMapName());
-	count = lh.LumpSize() / sizeof(*in);
-	medge_t *pedges = new medge_t[count];
-
-	out = pedges;
-
-	for ( i=0 ; i<count ; i++, in++, out++)
-	{
-		out->v[0] = (unsigned short)LittleShort(in->v[0]);
-		out->v[1] = (unsigned short)LittleShort(in->v[1]);
-	}
-
-	// delete this in the loader
-	return pedges;
-}
-
-
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -1019,7 +1456,7 @@ void Mod_LoadVertNormals( void )
 	int count = lh.LumpSize() / sizeof(*pVertNormals);
 	
 	Vector *out = (Vector *)Hunk_AllocName( lh.LumpSize(), lh.GetLoadName() );
-	memcpy( out, pVertNormals, lh.LumpSize() );
+	QueueLumpJob( LUMP_VERTNORMALS, Mod_CopyLump, lh, out, lh.LumpSize() );
 	
 	lh.GetMap()->brush.vertnormals = out;
 	lh.GetMap()->brush.numvertnormals = count;
@@ -1039,7 +1476,7 @@ void Mod_LoadVertNormalIndices( void )
 	int count = lh.LumpSize() / sizeof(*pIndices);
 	
 	unsigned short *out = (unsigned short *)Hunk_AllocName( lh.LumpSize(), lh.GetLoadName() );
-	memcpy( out, pIndices, lh.LumpSize() );
+	QueueLumpJob( LUMP_VERTNORMALINDICES, Mod_CopyLump, lh, out, lh.LumpSize() );
 	
 	lh.GetMap()->brush.vertnormalindices = out;
 	lh.GetMap()->brush.numvertnormalindices = count;
@@ -1054,6 +1491,33 @@ void Mod_LoadVertNormalIndices( void )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Lump jobs
+//-----------------------------------------------------------------------------
+static void Mod_DecodePrimitives( LumpJob_t *pJob )
+{
+	dprimitive_t *in = (dprimitive_t *)pJob->m_pLumpData[0];
+	mprimitive_t *out = (mprimitive_t *)pJob->m_pOut;
+	for ( int i=0 ; i<pJob->m_nCount ; i++, in++, out++)
+	{
+		out->firstIndex		= in->firstIndex;
+		out->firstVert		= in->firstVert;
+		out->indexCount		= in->indexCount;
+		out->type			= in->type;
+		out->vertCount		= in->vertCount;
+	}
+}
+
+static void Mod_DecodePrimVerts( LumpJob_t *pJob )
+{
+	dprimvert_t *in = (dprimvert_t *)pJob->m_pLumpData[0];
+	mprimvert_t *out = (mprimvert_t *)pJob->m_pOut;
+	for ( int i=0 ; i<pJob->m_nCount ; i++, in++, out++)
+	{
+		out->pos				= in->pos;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : *loadmodel - 
@@ -1064,7 +1528,7 @@ void Mod_LoadPrimitives( void )
 {
 	dprimitive_t	*in;
 	mprimitive_t	*out;
-	int				i, count;
+	int				count;
 
 	CMapLoadHelper lh( LUMP_PRIMITIVES );
 
@@ -1077,14 +1541,7 @@ void Mod_LoadPrimitives( void )
 
 	lh.GetMap()->brush.primitives = out;
 	lh.GetMap()->brush.numprimitives = count;
-	for ( i=0 ; i<count ; i++, in++, out++)
-	{
-		out->firstIndex		= in->firstIndex;
-		out->firstVert		= in->firstVert;
-		out->indexCount		= in->indexCount;
-		out->type			= in->type;
-		out->vertCount		= in->vertCount;
-	}
+	QueueLumpJob( LUMP_PRIMITIVES, Mod_DecodePrimitives, lh, out, count );
 }
 
 //-----------------------------------------------------------------------------
@@ -1097,7 +1554,7 @@ void Mod_LoadPrimVerts( void )
 {
 	dprimvert_t		*in;
 	mprimvert_t		*out;
-	int				i, count;
+	int				count;
 
 	CMapLoadHelper lh( LUMP_PRIMVERTS );
 
@@ -1110,10 +1567,7 @@ void Mod_LoadPrimVerts( void )
 
 	lh.GetMap()->brush.primverts = out;
 	lh.GetMap()->brush.numprimverts = count;
-	for ( i=0 ; i<count ; i++, in++, out++)
-	{
-		out->pos				= in->pos;
-	}
+	QueueLumpJob( LUMP_PRIMVERTS, Mod_DecodePrimVerts, lh, out, count );
 }
 
 //-----------------------------------------------------------------------------
@@ -1126,7 +1580,7 @@ void Mod_LoadPrimIndices( void )
 {
 	unsigned short	*in;
 	unsigned short	*out;
-	int				i, count;
+	int				count;
 
 	CMapLoadHelper lh( LUMP_PRIMINDICES );
 
@@ -1139,10 +1593,7 @@ void Mod_LoadPrimIndices( void )
 
 	lh.GetMap()->brush.primindices = out;
 	lh.GetMap()->brush.numprimindices = count;
-	for ( i=0 ; i<count ; i++, in++, out++)
-	{
-		*out = *in;
-	}
+	QueueLumpJob( LUMP_PRIMINDICES, Mod_CopyLump, lh, out, count * sizeof( *out ) );
 }
 
 
@@ -1165,7 +1616,7 @@ void Mod_LoadLump(
 
 	// Make room for the data and copy the data in.
 	*ppData = Hunk_AllocName( lh.LumpSize(), loadname );
-	memcpy( *ppData, lh.LumpBase(), lh.LumpSize() );
+	QueueLumpJob( iLump, Mod_CopyLump, lh, *ppData, lh.LumpSize() );
 }
 
 
@@ -1755,25 +2206,53 @@ void Mod_LoadMarksurfaces( void )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Lump job that decodes the edges and then looks up the vertex index
+//  for each surfedge. The edges are only needed for this.
+//-----------------------------------------------------------------------------
+static void Mod_DecodeSurfedges( LumpJob_t *pJob )
+{
+	dedge_t *pInEdges = (dedge_t *)pJob->m_pLumpData[1];
+	medge_t *pedges = pJob->m_pEdges;
+	int i;
+	for ( i=0 ; i<pJob->m_nExtraCount ; i++ )
+	{
+		pedges[i].v[0] = (unsigned short)LittleShort(pInEdges[i].v[0]);
+		pedges[i].v[1] = (unsigned short)LittleShort(pInEdges[i].v[1]);
+	}
+
+	int *in = (int *)pJob->m_pLumpData[0];
+	unsigned short *out = (unsigned short *)pJob->m_pOut;
+	for ( i=0 ; i<pJob->m_nCount ; i++)
+	{
+		int edge = LittleLong (in[i]);
+		int index = 0;
+		if ( edge < 0 )
+		{
+			edge = -edge;
+			index = 1;
+		}
+		out[i] = pedges[edge].v[index];
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
-// Input  : *pedges - 
-//			*loadmodel - 
-//			*l - 
-//			*loadname - 
 //-----------------------------------------------------------------------------
-void Mod_LoadSurfedges( medge_t *pedges )
+void Mod_LoadSurfedges( void )
 {	
-	int		i, count;
-	int		*in;
+	int		count, edgecount;
 	unsigned short *out;
 	
-	CMapLoadHelper lh( LUMP_SURFEDGES );
+	CMapLoadHelper lhe( LUMP_EDGES );
+	if (lhe.LumpSize() % sizeof(dedge_t))
+		Host_Error ("Mod_LoadEdges: funny lump size in %s",lhe.GetMapName());
+	edgecount = lhe.LumpSize() / sizeof(dedge_t);
 
-	in = (int *)lh.LumpBase();
-	if (lh.LumpSize() % sizeof(*in))
+	CMapLoadHelper lh( LUMP_SURFEDGES );
+	if (lh.LumpSize() % sizeof(int))
 		Host_Error ("Mod_LoadSurfedges: funny lump size in %s",lh.GetMapName());
-	count = lh.LumpSize() / sizeof(*in);
+	count = lh.LumpSize() / sizeof(int);
 	if (count < 1 || count >= MAX_MAP_SURFEDGES)
 		Host_Error ("Mod_LoadSurfedges: bad surfedges count in %s: %i",
 		lh.GetMapName(), count);
@@ -1782,19 +2261,11 @@ void Mod_LoadSurfedges( medge_t *pedges )
 	lh.GetMap()->brush.vertindices = out;
 	lh.GetMap()->brush.numvertindices = count;
 
-	for ( i=0 ; i<count ; i++)
-	{
-		int edge = LittleLong (in[i]);
-		int index = 0;
-		if ( edge < 0 )
-		{
-			edge = -edge;
-			index = 1;
-		}
-		out[i] = pedges[edge].v[index];
-	}
-
-	delete[] pedges;
+	LumpJob_t *pJob = QueueLumpJob( LUMP_SURFEDGES, Mod_DecodeSurfedges, lh, out, count, false );
+	pJob->m_pLumpData[1] = lhe.TakeLumpData();
+	pJob->m_pEdges = new medge_t[edgecount];
+	pJob->m_nExtraCount = edgecount;
+	StartLumpJob( pJob );
 }
 
 //-----------------------------------------------------------------------------
@@ -2048,6 +2519,8 @@ void CModelLoader::Shutdown( void )
 {
 	m_pWorldModel = NULL;
 
+	StopLumpJobThreads();
+
 	UnloadAllModels( false );
 
 	m_ModelPool.Clear();
@@ -2712,6 +3185,90 @@ static void MarkBrushModelWaterSurfaces( model_t* world,
 	host_state.worldmodel = pTemp;
 }
 
+//-----------------------------------------------------------------------------
+// How long each part of Map_LoadModel took, for mod_loadtimes
+//-----------------------------------------------------------------------------
+#define MAX_LOAD_STAGES		16
+
+struct LoadStageTime_t
+{
+	const char	*m_pName;
+	double		m_flTime;
+};
+
+static LoadStageTime_t	s_LoadStageTimes[ MAX_LOAD_STAGES ];
+static int				s_nLoadStages = 0;
+static double			s_flLoadStageStart = 0;
+
+static void BeginLoadStageTimes( void )
+{
+	s_nLoadStages = 0;
+	s_flLoadStageStart = Plat_FloatTime();
+}
+
+static void EndLoadStage( const char *pName )
+{
+	double flNow = Plat_FloatTime();
+	if ( s_nLoadStages < MAX_LOAD_STAGES )
+	{
+		s_LoadStageTimes[ s_nLoadStages ].m_pName = pName;
+		s_LoadStageTimes[ s_nLoadStages ].m_flTime = flNow - s_flLoadStageStart;
+		++s_nLoadStages;
+	}
+	s_flLoadStageStart = flNow;
+}
+
+static void PrintLoadStageTimes( const char *pMapName )
+{
+	double flTotal = 0;
+	int i;
+	for ( i = 0; i < s_nLoadStages; i++ )
+	{
+		flTotal += s_LoadStageTimes[ i ].m_flTime;
+	}
+
+	Msg( "Loaded %s in %.1f ms (%s)\n", pMapName, flTotal * 1000.0, 
+		s_nLumpJobThreads ? "threaded" : "single threaded" );
+	for ( i = 0; i < s_nLoadStages; i++ )
+	{
+		Msg( "  %-32s %7.1f ms\n", s_LoadStageTimes[ i ].m_pName, s_LoadStageTimes[ i ].m_flTime * 1000.0 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The world lumps in the order Map_LoadModel reads them, for prefetching.
+//-----------------------------------------------------------------------------
+static const int s_MapLoadLumps[] =
+{
+	LUMP_VERTEXES,
+	LUMP_EDGES,
+	LUMP_SURFEDGES,
+	LUMP_OCCLUSION,
+	LUMP_TEXINFO,
+	LUMP_LIGHTING,
+	LUMP_PRIMITIVES,
+	LUMP_PRIMVERTS,
+	LUMP_PRIMINDICES,
+	LUMP_FACES,
+	LUMP_VERTNORMALS,
+	LUMP_VERTNORMALINDICES,
+	LUMP_LEAFFACES,
+	LUMP_LEAFS,
+	LUMP_NODES,
+	LUMP_LEAFWATERDATA,
+	LUMP_CUBEMAPS,
+#ifndef SWDS
+	LUMP_OVERLAYS,
+#endif
+	LUMP_LEAFMINDISTTOWATER,
+	LUMP_CLIPPORTALVERTS,
+	LUMP_AREAPORTALS,
+	LUMP_AREAS,
+	LUMP_WORLDLIGHTS,
+	LUMP_GAME_LUMP,
+	LUMP_MODELS,
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : *mod - 
@@ -2726,46 +3283,83 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 
 	SetWorldModel( mod );
 
+	MapLoadProfile_t profile = GetMapLoadProfile();
+	int nResidentKBBefore = Sys_GetResidentMemoryKB();
+
+	BeginLoadStageTimes();
+
 	// Need this first because the render model may reference data it sets up
 	CM_LoadMap( mod->name, true, (unsigned int*)&checksum );
+	EndLoadStage( "collision model" );
 
 	mod->type = mod_brush;
 	mod->needload |= FMODELLOADER_LOADED;
 
 	CMapLoadHelper::Init( mod, s_szLoadName );
+	CMapLoadHelper::PrefetchLumps( s_MapLoadLumps, ARRAYSIZE( s_MapLoadLumps ) );
+	StartLumpJobThreads();
+
+	bool bRenderLumps = ( profile == MAPLOAD_FULL );
+	if ( !bRenderLumps )
+	{
+		ClearRenderOnlyLumps( mod );
+	}
 
 	// Load into hunk
 	Mod_LoadVertices();
-	medge_t *pedges = Mod_LoadEdges();
-	Mod_LoadSurfedges( pedges );
+	Mod_LoadSurfedges();
 	Mod_LoadPlanes();
-	Mod_LoadOcclusion();
+	if ( bRenderLumps )
+	{
+		Mod_LoadOcclusion();
+	}
 	// texdata needs to load before texinfo
 	Mod_LoadTexdata();
 	Mod_LoadTexinfo();
+	EndLoadStage( "vertices, edges, texinfo" );
 
 	// Until BSP version 19, this must occur after loading texinfo
-	Mod_LoadLighting();
+	if ( bRenderLumps )
+	{
+		Mod_LoadLighting();
+
+//		Mod_LoadOrigFaces();
+		Mod_LoadPrimitives();
+		Mod_LoadPrimVerts();
+		Mod_LoadPrimIndices();
+	}
 
-//	Mod_LoadOrigFaces();
-	Mod_LoadPrimitives();
-	Mod_LoadPrimVerts();
-	Mod_LoadPrimIndices();
+	// Faces read the vertices, the surfedges and the lighting
+	WaitForLumpJob( LUMP_VERTEXES );
+	WaitForLumpJob( LUMP_SURFEDGES );
+	WaitForLumpJob( LUMP_LIGHTING );
+	EndLoadStage( "lighting, primitives" );
 
 	// faces need to be loaded before vertnormals
 	Mod_LoadFaces();
-	Mod_LoadVertNormals();
-	Mod_LoadVertNormalIndices();
+	EndLoadStage( "faces" );
+
+	if ( bRenderLumps )
+	{
+		Mod_LoadVertNormals();
+		Mod_LoadVertNormalIndices();
+	}
     Mod_LoadMarksurfaces();
 	Mod_LoadLeafs();
 	Mod_LoadNodes();
-	Mod_LoadLeafWaterData();
-	Mod_LoadCubemapSamples();
-	// UNDONE: Does the cmodel need worldlights?
+	EndLoadStage( "leafs, nodes" );
+
+	if ( bRenderLumps )
+	{
+		Mod_LoadLeafWaterData();
+		Mod_LoadCubemapSamples();
+		// UNDONE: Does the cmodel need worldlights?
 #ifndef SWDS
-	OverlayMgr()->LoadOverlays( );	
+		OverlayMgr()->LoadOverlays( );	
 #endif
-	Mod_LoadLeafMinDistToWater();
+		Mod_LoadLeafMinDistToWater();
+	}
+	EndLoadStage( "cubemaps, overlays" );
 
 	Mod_LoadLump( mod, 
 		LUMP_CLIPPORTALVERTS, 
@@ -2788,7 +3382,10 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 		(void**)&mod->brush.m_pAreas,
 		&mod->brush.m_nAreas );
 
-	Mod_LoadWorldlights();
+	if ( bRenderLumps )
+	{
+		Mod_LoadWorldlights();
+	}
 	Mod_LoadGameLumpDict();
 	// load the portal information
 	// JAY: Disabled until we need this information.
@@ -2800,6 +3397,7 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 #endif
 
 	Mod_LoadSubmodels();
+	EndLoadStage( "areas, game lumps, submodels" );
 
 	//
 	// check for a valid number of sub models to load
@@ -2865,9 +3463,109 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 	host_state.worldmodel = mod;
 	MarkWaterSurfaces_r( mod->brush.nodes );
 	host_state.worldmodel = NULL;
+	EndLoadStage( "brush models" );
+
+	// Everything the workers are still decoding gets used after this
+	Mod_WaitForLumpJobs();
+	EndLoadStage( "waiting for lump jobs" );
 
 	// Close map file, etc.
 	CMapLoadHelper::Shutdown();
+
+	if ( mod_loadtimes.GetInt() )
+	{
+		PrintLoadStageTimes( mod->name );
+	}
+
+	// Per-instance memory is what limits how many servers fit on a box
+	int nResidentKBAfter = Sys_GetResidentMemoryKB();
+	if ( ( isDedicated || mod_loadtimes.GetInt() ) && nResidentKBAfter )
+	{
+		Msg( "Loaded %s (%s profile): resident memory %.1f MB -> %.1f MB (%+.1f MB)\n", mod->name,
+			( profile == MAPLOAD_SERVER ) ? "server" : "full",
+			nResidentKBBefore / 1024.0f, nResidentKBAfter / 1024.0f, ( nResidentKBAfter - nResidentKBBefore ) / 1024.0f );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Times reading a map's world lumps with and without prefetching. Each
+//  lump gets CRC'd as a stand-in for parsing it, so this doesn't need a renderer
+//  and works on a dedicated server. The modes alternate so neither one always
+//  gets the warmer file cache.
+//-----------------------------------------------------------------------------
+CON_COMMAND( map_loadbenchmark, "Times reading a map's lumps with and without background prefetching: map_loadbenchmark <map> [passes]" )
+{
+	if ( Cmd_Argc() < 2 )
+	{
+		Msg( "Usage:  map_loadbenchmark <map> [passes]\n" );
+		return;
+	}
+
+	if ( s_nMapLoadRecursion )
+	{
+		Msg( "map_loadbenchmark:  can't run while a map is loading\n" );
+		return;
+	}
+
+	char szMapName[ 64 ];
+	Q_snprintf( szMapName, sizeof( szMapName ), "maps/%s.bsp", Cmd_Argv( 1 ) );
+	if ( !modelloader->Map_IsValid( szMapName ) )
+		return;
+
+	int nPasses = ( Cmd_Argc() > 2 ) ? atoi( Cmd_Argv( 2 ) ) : 3;
+	if ( nPasses < 1 )
+	{
+		nPasses = 1;
+	}
+
+	int nSavedMapVersion = g_ServerGlobalVariables.mapversion;
+	int nSavedPrefetch = mod_prefetchlumps.GetInt();
+
+	double flTime[2] = { 0, 0 };
+	CRC32_t crc[2];
+	int nBytes = 0;
+	for ( int iPass = 0; iPass < nPasses; iPass++ )
+	{
+		for ( int i = 0; i < 2; i++ )
+		{
+			int iMode = ( iPass & 1 ) ? !i : i;
+			mod_prefetchlumps.SetValue( iMode );
+
+			double flStart = Plat_FloatTime();
+
+			CMapLoadHelper::Init( NULL, szMapName );
+			CMapLoadHelper::PrefetchLumps( s_MapLoadLumps, ARRAYSIZE( s_MapLoadLumps ) );
+
+			CRC32_Init( &crc[ iMode ] );
+			nBytes = 0;
+			for ( int iLump = 0; iLump < ARRAYSIZE( s_MapLoadLumps ); iLump++ )
+			{
+				CMapLoadHelper lh( s_MapLoadLumps[ iLump ] );
+				CRC32_ProcessBuffer( &crc[ iMode ], lh.LumpBase(), lh.LumpSize() );
+				nBytes += lh.LumpSize();
+			}
+
+			CMapLoadHelper::Shutdown();
+
+			flTime[ iMode ] += Plat_FloatTime() - flStart;
+		}
+	}
+
+	mod_prefetchlumps.SetValue( nSavedPrefetch );
+	g_ServerGlobalVariables.mapversion = nSavedMapVersion;
+
+	CRC32_Final( &crc[0] );
+	CRC32_Final( &crc[1] );
+	if ( crc[0] != crc[1] )
+	{
+		Warning( "map_loadbenchmark:  prefetched lumps don't match the ones read directly!\n" );
+	}
+
+	double flSync = flTime[0] * 1000.0 / nPasses;
+	double flAsync = flTime[1] * 1000.0 / nPasses;
+	Msg( "%s: %d lumps, %.1f MB, %d passes\n", szMapName, ARRAYSIZE( s_MapLoadLumps ), nBytes / ( 1024.0f * 1024.0f ), nPasses );
+	Msg( "  direct reads:  %.1f ms\n", flSync );
+	Msg( "  prefetched:    %.1f ms (%.2fx)\n", flAsync, ( flAsync > 0 ) ? flSync / flAsync : 0 );
 }
 
 void CModelLoader::Map_UnloadCubemapSamples( model_t *mod )
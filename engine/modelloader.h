@@ -121,6 +121,14 @@ public:
 	static void			LoadLumpElement( int nLumpId, int nElemIndex, int nElemSize, void *pData );
 	static void			LoadLumpData( int nLumpId, int offset, int size, void *pData );
 
+	// Starts reading lumps in the background, in the order given, so the disk is busy
+	// while the earlier lumps are being parsed. Constructing a CMapLoadHelper for a
+	// prefetched lump waits for its read instead of starting a new one.
+	static void			PrefetchLumps( const int *pLumps, int nLumps );
+
+	// Hands the lump buffer over to the caller, who has to delete[] it.
+	byte				*TakeLumpData( void );
+
 private:
 
 	byte				*m_pData;
@@ -151,4 +159,8 @@ void Mod_GetModelMaterials( model_t* mod, int count, IMaterial** ppMaterial );
 
 bool Mod_LoadStudioModelVtxFileIntoTempBuffer( model_t *mod, CUtlMemory<unsigned char>& tmpVtxMem );
 
+// Waits for any world lumps still being decoded on worker threads. Host_Error
+// calls this before it throws the map away.
+void Mod_WaitForLumpJobs( void );
+
 #endif // MOD_LOADER_H
\ No newline at end of file
@@ -118,7 +118,7 @@ int CNetworkStringTable::AddString( const char *value, int length /*= 0*/, const
 		return i;
 	}
 
-	if ( m_Items.Count() >= (unsigned int)GetMaxEntries() )
+	if ( m_Items.Count() >= GetMaxEntries() )
 	{
 		// Too many strings, FIXME: Print warning message
 		Con_Printf( "Warning:  Table %s is full, can't add %s\n", GetTableName(), value );
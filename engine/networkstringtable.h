@@ -13,7 +13,7 @@
 #include "networkstringtabledefs.h"
 #include "networkstringtableitem.h"
 
-#include "utldict.h"
+#include "utlhashmap.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: Client/Server shared string table definition
@@ -58,7 +58,8 @@ private:
 	int						m_nMaxEntries;
 	int						m_nEntryBits;
 
-	CUtlDict< CNetworkStringTableItem, int > m_Items;
+	// Strings are only removed all at once, so the string numbers stay 0..Count()-1
+	CUtlStringHashMap< CNetworkStringTableItem > m_Items;
 };
 
 #endif // NETWORKSTRINGTABLE_H
@@ -15,6 +15,7 @@
 #include "host_cmd.h"
 #include "cmodel_engine.h"
 #include "sv_log.h"
+#include "sv_ticktimes.h"
 #include "zone.h"
 #include "sound.h"
 #include "vox.h"
@@ -707,9 +708,9 @@ void SV_Init (void)
 
 	SV_SetMaxClients();
 
-	// This is the only place we ever allocate client slots, and they are on the hunk so they
-	// are never freed
-	svs.clients = ( client_t * )Hunk_AllocName( svs.maxclientslimit * sizeof( client_t ), "svs.clients" );
+	// This is the only place we ever allocate client slots, and they are in the permanent
+	// scope so they are never freed
+	svs.clients = ( client_t * )Mem_ScopeAlloc( MEMSCOPE_PERMANENT, svs.maxclientslimit * sizeof( client_t ), "svs.clients" );
 }
 
 //-----------------------------------------------------------------------------
@@ -3438,7 +3439,10 @@ static void SV_SendClientDatagrams ( int clientCount, client_t** clients, CFrame
 	msg.SetDebugName( "SV_SendClientDatagrams->msg" );
 
 	// Compute the client packs
-	SV_ComputeClientPacks( clientCount, clients, pSnapshot, pPack );
+	{
+		CTickStageScope clientPacksTime( TICKSTAGE_CLIENT_PACKS );
+		SV_ComputeClientPacks( clientCount, clients, pSnapshot, pPack );
+	}
 
 	for (i = 0; i < clientCount; ++i)
 	{
@@ -4692,6 +4696,8 @@ void SV_Frame( bool send_client_updates )
 	{
 		// This causes network messages to be sent
 		SV_GameRenderDebugOverlays();
+
+		CTickStageScope sendMessagesTime( TICKSTAGE_SEND_MESSAGES );
 		SV_SendClientMessages();
 	}
 
@@ -15,6 +15,7 @@
 #include "eiface.h"
 #include "server.h"
 #include "sv_main.h"
+#include "sv_ticktimes.h"
 #include "tier0/vprof.h"
 #include "host.h"
 
@@ -65,7 +66,10 @@ void SV_Physics( bool simulating )
 	g_ServerGlobalVariables.curtime		= sv.gettime();
 	g_ServerGlobalVariables.frametime	= simulating ? TICK_RATE : 0;
 
-	serverGameDLL->GameFrame( simulating );
+	{
+		CTickStageScope gameFrameTime( TICKSTAGE_GAME_FRAME );
+		serverGameDLL->GameFrame( simulating );
+	}
 
 	// Update gpGlobals->time to SendProxy stuff can reference timestamp
 	g_ServerGlobalVariables.tickcount = sv.tickcount;
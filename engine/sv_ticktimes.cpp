@@ -0,0 +1,239 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Histograms of how long each stage of a server tick takes.
+//
+// Times are kept in microseconds in log-linear buckets: exact below 64us, and
+// 32 buckets for each power of two above that, so every bucket is within about
+// 3% of the times in it no matter how long the tick was.  Percentiles are read
+// straight off the counts, so recording a tick is a handful of instructions and
+// nothing is ever sorted.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "quakedef.h"
+#include "sv_ticktimes.h"
+#include "sv_log.h"
+#include "convar.h"
+#include "cmd.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+static ConVar sv_ticktimes_log( "sv_ticktimes_log", "0", 0, "Write server tick time percentiles to the server log this often, in seconds. 0 = never." );
+
+#define TICKHISTOGRAM_LINEAR_BUCKETS	64		// Times below this many us get a bucket each
+#define TICKHISTOGRAM_SUB_BITS			5		// 32 buckets per power of two above that
+#define TICKHISTOGRAM_BUCKETS			( TICKHISTOGRAM_LINEAR_BUCKETS + ( 32 - 6 ) * ( 1 << TICKHISTOGRAM_SUB_BITS ) )
+
+static const char *s_pTickStageNames[NUM_TICKSTAGES] =
+{
+	"server frame",
+	"game frame",
+	"client packs",
+	"send messages",
+};
+
+
+//-----------------------------------------------------------------------------
+// A histogram of times in microseconds
+//-----------------------------------------------------------------------------
+class CTickHistogram
+{
+public:
+	CTickHistogram()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		memset( m_Counts, 0, sizeof( m_Counts ) );
+		m_nCount = 0;
+		m_flTotal = 0.0;
+		m_nMax = 0;
+	}
+
+	void Record( unsigned long us )
+	{
+		m_Counts[BucketForTime( us )]++;
+		m_nCount++;
+		m_flTotal += us;
+		if ( us > m_nMax )
+		{
+			m_nMax = us;
+		}
+	}
+
+	int Count() const				{ return m_nCount; }
+	double Mean() const				{ return ( m_nCount ) ? m_flTotal / m_nCount : 0.0; }
+	unsigned long Max() const		{ return m_nMax; }
+
+	// Returns the time that flFraction of the samples are at or below
+	unsigned long Percentile( double flFraction ) const
+	{
+		if ( !m_nCount )
+			return 0;
+
+		// The rank of the sample we want, counting from 1
+		unsigned int nRank = (unsigned int)ceil( flFraction * m_nCount );
+		if ( nRank < 1 )
+		{
+			nRank = 1;
+		}
+
+		unsigned int nSeen = 0;
+		for ( int i = 0; i < TICKHISTOGRAM_BUCKETS; i++ )
+		{
+			nSeen += m_Counts[i];
+			if ( nSeen >= nRank )
+			{
+				// Report the top of the bucket, but never more than the real max
+				unsigned long us = BucketTop( i );
+				return ( us < m_nMax ) ? us : m_nMax;
+			}
+		}
+		return m_nMax;
+	}
+
+private:
+	static int BucketForTime( unsigned long us )
+	{
+		if ( us < TICKHISTOGRAM_LINEAR_BUCKETS )
+			return us;
+
+		int nExponent = 31;
+		while ( !( us & ( 1UL << nExponent ) ) )
+		{
+			nExponent--;
+		}
+
+		// The top bit is always set, the next TICKHISTOGRAM_SUB_BITS pick the bucket
+		int nSub = ( us >> ( nExponent - TICKHISTOGRAM_SUB_BITS ) ) & ( ( 1 << TICKHISTOGRAM_SUB_BITS ) - 1 );
+		return TICKHISTOGRAM_LINEAR_BUCKETS + ( nExponent - 6 ) * ( 1 << TICKHISTOGRAM_SUB_BITS ) + nSub;
+	}
+
+	// The largest time that goes in bucket i
+	static unsigned long BucketTop( int i )
+	{
+		if ( i < TICKHISTOGRAM_LINEAR_BUCKETS )
+			return i;
+
+		i -= TICKHISTOGRAM_LINEAR_BUCKETS;
+		int nExponent = 6 + ( i >> TICKHISTOGRAM_SUB_BITS );
+		int nSub = i & ( ( 1 << TICKHISTOGRAM_SUB_BITS ) - 1 );
+		int nShift = nExponent - TICKHISTOGRAM_SUB_BITS;
+		unsigned long nBase = ( ( 1UL << TICKHISTOGRAM_SUB_BITS ) + nSub ) << nShift;
+		return nBase + ( ( 1UL << nShift ) - 1 );
+	}
+
+	unsigned int	m_Counts[TICKHISTOGRAM_BUCKETS];
+	unsigned int	m_nCount;
+	double			m_flTotal;
+	unsigned long	m_nMax;
+};
+
+
+// Since the last sv_ticktimes reset, and since the last time they were logged
+static CTickHistogram s_TickTimes[NUM_TICKSTAGES];
+static CTickHistogram s_LogTickTimes[NUM_TICKSTAGES];
+static double s_flNextTickTimesLog = 0;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void SV_RecordTickStage( int stage, const CCycleCount &duration )
+{
+	Assert( stage >= 0 && stage < NUM_TICKSTAGES );
+
+	unsigned long us = duration.GetMicroseconds();
+	s_TickTimes[stage].Record( us );
+	s_LogTickTimes[stage].Record( us );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void SV_UpdateTickTimes( void )
+{
+	float flInterval = sv_ticktimes_log.GetFloat();
+	if ( flInterval <= 0 )
+	{
+		s_flNextTickTimesLog = 0;
+		return;
+	}
+
+	if ( s_flNextTickTimesLog == 0 )
+	{
+		// Start the first interval now, so the log covers exactly flInterval seconds
+		for ( int i = 0; i < NUM_TICKSTAGES; i++ )
+		{
+			s_LogTickTimes[i].Reset();
+		}
+		s_flNextTickTimesLog = realtime + flInterval;
+		return;
+	}
+
+	if ( realtime < s_flNextTickTimesLog )
+		return;
+
+	s_flNextTickTimesLog = realtime + flInterval;
+
+	if ( !g_Log.IsActive() )
+		return;
+
+	for ( int i = 0; i < NUM_TICKSTAGES; i++ )
+	{
+		CTickHistogram &histogram = s_LogTickTimes[i];
+		if ( histogram.Count() )
+		{
+			g_Log.Printf( "Tick times \"%s\" (count \"%d\") (mean \"%.3f\") (p50 \"%.3f\") (p99 \"%.3f\") (p99.9 \"%.3f\") (max \"%.3f\")\n",
+				s_pTickStageNames[i],
+				histogram.Count(),
+				histogram.Mean() / 1000.0,
+				histogram.Percentile( 0.5 ) / 1000.0,
+				histogram.Percentile( 0.99 ) / 1000.0,
+				histogram.Percentile( 0.999 ) / 1000.0,
+				histogram.Max() / 1000.0 );
+		}
+		histogram.Reset();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Prints the tick time percentiles, or resets them
+//-----------------------------------------------------------------------------
+void SV_TickTimes_f( void )
+{
+	int i;
+
+	if ( Cmd_Argc() > 1 && !stricmp( Cmd_Argv( 1 ), "reset" ) )
+	{
+		for ( i = 0; i < NUM_TICKSTAGES; i++ )
+		{
+			s_TickTimes[i].Reset();
+		}
+		Con_Printf( "Tick times reset.\n" );
+		return;
+	}
+
+	Con_Printf( "Tick times in ms:\n" );
+	Con_Printf( "  %-14s %9s %8s %8s %8s %8s %8s %8s\n", "stage", "count", "mean", "p50", "p90", "p99", "p99.9", "max" );
+	for ( i = 0; i < NUM_TICKSTAGES; i++ )
+	{
+		const CTickHistogram &histogram = s_TickTimes[i];
+		Con_Printf( "  %-14s %9d %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+			s_pTickStageNames[i],
+			histogram.Count(),
+			histogram.Mean() / 1000.0,
+			histogram.Percentile( 0.5 ) / 1000.0,
+			histogram.Percentile( 0.9 ) / 1000.0,
+			histogram.Percentile( 0.99 ) / 1000.0,
+			histogram.Percentile( 0.999 ) / 1000.0,
+			histogram.Max() / 1000.0 );
+	}
+}
+
+static ConCommand sv_ticktimes( "sv_ticktimes", SV_TickTimes_f, "Show server tick time percentiles for each stage of the tick. sv_ticktimes reset clears them." );
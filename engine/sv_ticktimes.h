@@ -0,0 +1,59 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Histograms of how long each stage of a server tick takes, so the
+//			slow tail can be seen and not just the average.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef SV_TICKTIMES_H
+#define SV_TICKTIMES_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/fasttimer.h"
+
+
+enum TickStage_t
+{
+	TICKSTAGE_SERVER_FRAME = 0,		// _Host_RunFrame_Server
+	TICKSTAGE_GAME_FRAME,			// IServerGameDLL::GameFrame
+	TICKSTAGE_CLIENT_PACKS,			// SV_ComputeClientPacks
+	TICKSTAGE_SEND_MESSAGES,		// SV_SendClientMessages
+
+	NUM_TICKSTAGES,
+};
+
+
+void SV_RecordTickStage( int stage, const CCycleCount &duration );
+
+// Called once a server frame, writes the histograms to the server log every sv_ticktimes_log seconds
+void SV_UpdateTickTimes( void );
+
+
+//-----------------------------------------------------------------------------
+// Records the time until the end of the enclosing block
+//-----------------------------------------------------------------------------
+class CTickStageScope
+{
+public:
+	CTickStageScope( int stage )
+	{
+		m_Stage = stage;
+		m_Timer.Start();
+	}
+
+	~CTickStageScope()
+	{
+		m_Timer.End();
+		SV_RecordTickStage( m_Stage, m_Timer.GetDuration() );
+	}
+
+private:
+	int			m_Stage;
+	CFastTimer	m_Timer;
+};
+
+
+#endif // SV_TICKTIMES_H
@@ -23,6 +23,9 @@ void Sys_ShutdownMemory( void );
 void Sys_InitMemory( void );
 
 void Sys_Sleep ( int msec );
+
+// How much of the process is in physical memory, in KB. 0 if we can't tell.
+int Sys_GetResidentMemoryKB( void );
 void Sys_GetRegKeyValue( char *pszSubKey, char *pszElement, char *pszReturnString, int nReturnLength, char *pszDefaultValue);
 
 extern "C" void Sys_SetFPCW (void);
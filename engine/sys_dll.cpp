@@ -14,6 +14,9 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <dsound.h>
+#include <psapi.h>
+#elif _LINUX
+#include <unistd.h>
 #endif
 
 #include "quakedef.h"
@@ -377,6 +380,47 @@ void Sys_Sleep ( int msec )
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the process's resident set size (the working set on Win32)
+//  in KB, or 0 if we can't get it. psapi.dll is loaded by hand so the engine
+//  doesn't need to link against it.
+//-----------------------------------------------------------------------------
+int Sys_GetResidentMemoryKB( void )
+{
+#ifdef _WIN32
+	typedef BOOL (WINAPI *GetProcessMemoryInfoFn)( HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD );
+	static GetProcessMemoryInfoFn s_pfnGetProcessMemoryInfo = NULL;
+	static bool s_bLoadedPsapi = false;
+
+	if ( !s_bLoadedPsapi )
+	{
+		s_bLoadedPsapi = true;
+		HMODULE hPsapi = LoadLibrary( "psapi.dll" );
+		if ( hPsapi )
+		{
+			s_pfnGetProcessMemoryInfo = (GetProcessMemoryInfoFn)GetProcAddress( hPsapi, "GetProcessMemoryInfo" );
+		}
+	}
+
+	PROCESS_MEMORY_COUNTERS counters;
+	if ( s_pfnGetProcessMemoryInfo && s_pfnGetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+		return (int)( counters.WorkingSetSize / 1024 );
+#elif _LINUX
+	// The second field of statm is the resident size in pages
+	FILE *fp = fopen( "/proc/self/statm", "r" );
+	if ( fp )
+	{
+		long nSize = 0, nResident = 0;
+		int nFields = fscanf( fp, "%ld %ld", &nSize, &nResident );
+		fclose( fp );
+
+		if ( nFields == 2 )
+			return (int)( nResident * ( getpagesize() / 1024 ) );
+	}
+#endif
+	return 0;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : hInst - 
@@ -409,7 +453,7 @@ void GameSetState(int iState )
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Allocate memory for engine hunk
+// Purpose: Size the engine data cache
 // Input  : *parms - 
 //-----------------------------------------------------------------------------
 void Sys_InitMemory( void )
@@ -467,12 +511,9 @@ void Sys_InitMemory( void )
 	{
 		host_parms.memsize = MINIMUM_WIN_MEMORY;
 	}
-	
-	host_parms.membase = (unsigned char *)new unsigned char[ host_parms.memsize ];
-	if ( !host_parms.membase )
-	{
-		Sys_Error( "Unable to allocate %.2f MB\n", (float)(host_parms.memsize)/( 1024.0 * 1024.0 ) );
-	}
+
+	// The memory scopes grow as they need to, memsize only bounds the cache now
+	host_parms.membase = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -509,7 +550,6 @@ void Sys_UnloadPhysicsDLL( void )
 //-----------------------------------------------------------------------------
 void Sys_ShutdownMemory( void )
 {
-	delete[] host_parms.membase;
 	host_parms.membase = 0;
 	host_parms.memsize = 0;
 }
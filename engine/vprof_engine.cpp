@@ -19,6 +19,7 @@
 
 #include "convar.h"
 #include "cmd.h"
+#include "common.h"
 
 #include "tier0/vprof.h"
 
@@ -43,10 +44,99 @@ static void ExecuteDeferredOp()
 const double MAX_SPIKE_REPORT = 1.5;
 static double LastSpikeTime = 0;
 
+//-----------------------------------------------------------------------------
+// Trace recording, see CVProfTrace
+//-----------------------------------------------------------------------------
+
+#define VPROF_TRACE_DEFAULT_EVENTS		( 256 * 1024 )
+#define VPROF_TRACE_DEFAULT_SECONDS		10.0f
+#define VPROF_TRACE_SPIKE_SECONDS		2.0f
+
+static ConVar vprof_trace_spike_ms( "vprof_trace_spike_ms", "0", 0, "While tracing, write the trace to vproftrace_spikeNNNN.vpt when a frame takes longer than this many milliseconds. 0 = disabled." );
+
+static double LastTraceSpikeTime = 0;
+static int nTraceSpikes = 0;
+
+static void WriteVProfTrace( const char *pFilename, float flSeconds )
+{
+	char szPath[MAX_OSPATH];
+	Q_snprintf( szPath, sizeof( szPath ), "%s/%s", com_gamedir, pFilename );
+	if ( g_VProfTrace.WriteFile( szPath, flSeconds ) )
+	{
+		Msg( "Wrote the last %.1f seconds of VProf trace to %s\n", flSeconds, szPath );
+	}
+	else
+	{
+		Warning( "Couldn't write VProf trace to %s\n", szPath );
+	}
+}
+
+static void CheckVProfTraceSpike()
+{
+	if ( !vprof_trace_spike_ms.GetFloat() || eng->GetFrameTime() * 1000.0f <= vprof_trace_spike_ms.GetFloat() )
+		return;
+
+	if ( Sys_FloatTime() - LastTraceSpikeTime > MAX_SPIKE_REPORT )
+	{
+		char szFilename[MAX_OSPATH];
+		Q_snprintf( szFilename, sizeof( szFilename ), "vproftrace_spike%04d.vpt", nTraceSpikes++ );
+		WriteVProfTrace( szFilename, VPROF_TRACE_SPIKE_SECONDS );
+
+		LastTraceSpikeTime = Sys_FloatTime();
+	}
+}
+
+CON_COMMAND( vprof_trace_start, "Start recording VProf scopes for vprof_trace_dump. Optional: number of events to keep." )
+{
+	// Other threads may be writing to the buffer, so it can't be swapped out under them
+	if ( g_VProfTrace.IsRecording() )
+	{
+		Msg( "VProf trace is already recording. Use vprof_trace_stop first.\n" );
+		return;
+	}
+
+	int nEvents = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : VPROF_TRACE_DEFAULT_EVENTS;
+	if ( nEvents <= 0 )
+	{
+		nEvents = VPROF_TRACE_DEFAULT_EVENTS;
+	}
+
+	g_VProfTrace.Start( nEvents );
+	if ( g_VProfTrace.IsRecording() )
+	{
+		Msg( "VProf trace recording.\n" );
+	}
+}
+
+CON_COMMAND( vprof_trace_stop, "Stop recording VProf scopes. What was recorded can still be dumped." )
+{
+	g_VProfTrace.Stop();
+	Msg( "VProf trace stopped.\n" );
+}
+
+CON_COMMAND( vprof_trace_dump, "Write the recorded VProf scopes to a file in the game directory. Use: vprof_trace_dump <filename> [seconds]" )
+{
+	if ( Cmd_Argc() < 2 )
+	{
+		Msg( "Usage: vprof_trace_dump <filename> [seconds]\n" );
+		return;
+	}
+
+	float flSeconds = ( Cmd_Argc() > 2 ) ? atof( Cmd_Argv( 2 ) ) : VPROF_TRACE_DEFAULT_SECONDS;
+	WriteVProfTrace( Cmd_Argv( 1 ), flSeconds );
+}
+
+//-----------------------------------------------------------------------------
+
 void PreUpdateProfile()
 {
 	ExecuteDeferredOp();
 
+	if ( g_VProfTrace.IsRecording() )
+	{
+		CheckVProfTraceSpike();
+	}
+
 	if( vprof_dump_spikes.GetFloat() && ( eng->GetFrameTime() > ( 1.f / vprof_dump_spikes.GetFloat() ) ) )
 	{
 		if( Sys_FloatTime() - LastSpikeTime > MAX_SPIKE_REPORT )
@@ -62,6 +152,11 @@ void PreUpdateProfile()
 
 void PostUpdateProfile()
 {
+	if ( g_VProfTrace.IsRecording() )
+	{
+		g_VProfTrace.MarkFrame();
+	}
+
 	if ( g_VProfCurrentProfile.IsEnabled() )
 	{
 		g_VProfCurrentProfile.MarkFrame();
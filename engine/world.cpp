@@ -228,7 +228,7 @@ void SV_FastRelink( edict_t *ent, int tempHandle )
 class CTouchLinks : public IPartitionEnumerator
 {
 public:
-	CTouchLinks( edict_t* pEnt, const Vector* pPrevAbsOrigin ) : m_TouchedEntities( 8, 8 )
+	CTouchLinks( edict_t* pEnt, const Vector* pPrevAbsOrigin )
 	{
 		m_pEnt = pEnt;
 		IServerEntity *serverEntity = pEnt->GetIServerEntity();
@@ -319,7 +319,7 @@ private:
 	edict_t *m_pEnt;
 	Vector m_mins;
 	Vector m_maxs;
-	CUtlVector< edict_t* > m_TouchedEntities;
+	CUtlVectorFixedGrowable< edict_t*, 16 > m_TouchedEntities;
 };
 
 
@@ -328,7 +328,7 @@ private:
 class CTriggerMoved : public IPartitionEnumerator
 {
 public:
-	CTriggerMoved( edict_t *pTriggerEntity ) : m_TouchedEntities( 8, 8 )
+	CTriggerMoved( edict_t *pTriggerEntity )
 	{
 		m_headnode = -1;
 		m_pTriggerEntity = pTriggerEntity;
@@ -398,7 +398,7 @@ private:
 	QAngle	m_angles;
 	edict_t	*m_pTriggerEntity;
 	int		m_headnode;
-	CUtlVector< edict_t* > m_TouchedEntities;
+	CUtlVectorFixedGrowable< edict_t*, 16 > m_TouchedEntities;
 };
 
 
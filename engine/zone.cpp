@@ -10,13 +10,12 @@
 //
 //						ZONE MEMORY ALLOCATION
 //
-// There is never any space between memblocks, and there will never be two
-// contiguous free memblocks.
-//
-// The rover can be left pointing at a non-empty block
+// Each memory scope is a chain of chunks that allocations are carved off
+// the end of.  A new chunk is only grabbed when the current one is full,
+// and a scope is freed by dropping back to a mark or releasing all of it.
 //
 // The zone calls are pretty much only used for small strings and structures,
-// all big things are allocated on the hunk.
+// all big things are allocated from the scopes.
 //=============================================================================	   
 
 #include "zone.h"
@@ -28,296 +27,492 @@
 #include "sound.h" // just to get at MAX_SFX
 #include "vstdlib/strtools.h"
 #include "vstdlib/ICommandLine.h"
+#include "utlhashmap.h"
+#include "utlvector.h"
 
 
-void Cache_FreeLow (int new_low_hunk);
-void Cache_FreeHigh (int new_high_hunk);
-
 ConVar mem_dbgfile( "mem_dbgfile",".\\mem.txt" );
 
+char* Q_pretifymem(int num, char* pout);
+
 //============================================================================
 
 #define	HUNK_SENTINAL	0x1df001ed
 
-#define HUNK_NAME_LEN 64
-#ifdef _WIN32
-typedef __declspec(align(16)) struct
-#elif _LINUX
-typedef __attribute__((aligned(16))) struct
-#else
-#error
-#endif
+// Default chunk sizes, bigger allocations get a chunk to themselves
+#define MEMSCOPE_PERMANENT_CHUNK	( 1024 * 1024 )
+#define MEMSCOPE_LEVEL_CHUNK		( 4 * 1024 * 1024 )
+#define MEMSCOPE_FRAME_CHUNK		( 256 * 1024 )
+
+typedef struct
 {
 	int		sentinal;
-	int		size;		// including sizeof(hunk_t), -1 = not allocated
-	char	name[HUNK_NAME_LEN];
+	int		size;		// including sizeof(hunk_t)
+	int		tag;		// index into the scope's tag table
+	int		pad;		// keeps the data 16 byte aligned
 } hunk_t;
 
-byte	*hunk_base;
-int		hunk_size;
+typedef struct memchunk_s
+{
+	struct memchunk_s	*prev;
+	byte		*data;		// 16 byte aligned start of the chunk's memory
+	int			base;		// offset of data[0] within the scope, marks count from the scope start
+	int			size;
+	int			used;
+} memchunk_t;
+
+typedef struct
+{
+	int		bytes;
+	int		count;
+} memtag_t;
 
-int		hunk_low_used;
-int		hunk_high_used;
 
-qboolean	hunk_tempactive;
-int		hunk_tempmark;
+//-----------------------------------------------------------------------------
+// A growable linear allocator for one memory scope
+//-----------------------------------------------------------------------------
+class CScopeAllocator
+{
+public:
+	CScopeAllocator();
 
-void R_FreeTextures (void);
+	void	Init( const char *pName, int nChunkSize );
+	void	Shutdown();
 
-/*
-==============
-Hunk_Check
+	void	*Alloc( int size, const char *pTag, bool bClear = true );
 
-Run consistancy and sentinal trahing checks
-==============
-*/
-void Hunk_Check (void)
+	// Marks are the number of bytes allocated from the scope so far
+	int		Mark() const	{ return m_pChunk ? m_pChunk->base + m_pChunk->used : 0; }
+	void	FreeToMark( int mark );
+
+	// Returns the number of bytes that were in use
+	int		FreeAll();
+
+	void	Check();
+	void	Report( MemPrintFunc_t pfnPrint, bool bAllocations = false );
+
+	const char	*GetName() const	{ return m_pName; }
+	int		Reserved() const		{ return m_nReserved; }
+	int		Peak() const			{ return m_nPeak; }
+
+private:
+	memchunk_t	*NewChunk( int size );
+	void	FreeChunk( memchunk_t *pChunk );
+	int		Tag( const char *pTag, int size );
+	void	Untag( byte *pStart, byte *pEnd );
+
+	const char	*m_pName;
+	int			m_nChunkSize;
+
+	// The chunk being allocated from, older chunks hang off its prev
+	memchunk_t	*m_pChunk;
+	int			m_nChunks;
+	int			m_nReserved;
+	int			m_nPeak;
+
+	CUtlStringHashMap<memtag_t>	m_Tags;
+};
+
+static CScopeAllocator s_Scopes[MEMSCOPE_COUNT];
+
+static MemScope_t	hunk_scope = MEMSCOPE_PERMANENT;
+
+static qboolean	hunk_tempactive;
+static int		hunk_tempmark;
+static int		hunk_tempend;
+
+
+CScopeAllocator::CScopeAllocator() : m_Tags( true, 64 )
 {
-	hunk_t	*h;
-	
-	for (h = (hunk_t *)hunk_base ; (byte *)h != hunk_base + hunk_low_used ; )
+	m_pName = "";
+	m_nChunkSize = 0;
+	m_pChunk = NULL;
+	m_nChunks = 0;
+	m_nReserved = 0;
+	m_nPeak = 0;
+}
+
+void CScopeAllocator::Init( const char *pName, int nChunkSize )
+{
+	m_pName = pName;
+	m_nChunkSize = nChunkSize;
+}
+
+void CScopeAllocator::Shutdown()
+{
+	while ( m_pChunk )
 	{
-		if (h->sentinal != HUNK_SENTINAL)
-			Sys_Error ("Hunk_Check: trashed sentinal");
-		if (h->size < 16 || h->size + (byte *)h - hunk_base > hunk_size)
-			Sys_Error ("Hunk_Check: bad size");
-		h = (hunk_t *)((byte *)h+h->size);
+		memchunk_t *pPrev = m_pChunk->prev;
+		FreeChunk( m_pChunk );
+		m_pChunk = pPrev;
 	}
+	m_Tags.Purge();
 }
 
-/*
-==============
-Hunk_Print
-
-If "all" is specified, every single allocation is printed.
-Otherwise, allocations with the same name will be totaled up before printing.
-==============
-*/
-void Hunk_Print (qboolean all)
+memchunk_t *CScopeAllocator::NewChunk( int size )
 {
-	hunk_t	*h, *next, *endlow, *starthigh, *endhigh;
-	int		count, sum;
-	int		totalblocks;
-	char	name[HUNK_NAME_LEN+1];
-
-	name[HUNK_NAME_LEN] = 0;
-	count = 0;
-	sum = 0;
-	totalblocks = 0;
-	
-	FileHandle_t file = g_pFileSystem->Open(mem_dbgfile.GetString(), "a");
-	if (!file)
-		return;
+	if ( size < m_nChunkSize )
+	{
+		size = m_nChunkSize;
+	}
 
-	h = (hunk_t *)hunk_base;
-	endlow = (hunk_t *)(hunk_base + hunk_low_used);
-	starthigh = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
-	endhigh = (hunk_t *)(hunk_base + hunk_size);
+	memchunk_t *pChunk = (memchunk_t *)malloc( sizeof( memchunk_t ) + size + 15 );
+	if ( !pChunk )
+	{
+		Sys_Error( "Mem_ScopeAlloc: %s scope failed on %i bytes", m_pName, size );
+	}
 
-	//Con_Printf ("          :%8i total hunk size\n", hunk_size);
-	//Con_Printf ("-------------------------\n");
-	g_pFileSystem->FPrintf(file, "          :%16.16s total hunk size\n", Q_pretifymem(hunk_size));
-	g_pFileSystem->FPrintf(file, "-------------------------\n");
+	pChunk->prev = m_pChunk;
+	pChunk->data = (byte *)( ( (unsigned long)( pChunk + 1 ) + 15 ) & ~15 );
+	pChunk->base = Mark();
+	pChunk->size = size;
+	pChunk->used = 0;
 
-	while (1)
-	{
-	//
-	// skip to the high hunk if done with low hunk
-	//
-		if ( h == endlow )
-		{
-			g_pFileSystem->FPrintf(file, "-------------------------\n");
-			g_pFileSystem->FPrintf(file, "          :%16.16s REMAINING\n", Q_pretifymem(hunk_size - hunk_low_used - hunk_high_used));
-			g_pFileSystem->FPrintf(file, "-------------------------\n");
-			h = starthigh;
-		}
-		
-	//
-	// if totally done, break
-	//
-		if ( h == endhigh )
-			break;
+	++m_nChunks;
+	m_nReserved += size;
+	return pChunk;
+}
 
-	//
-	// run consistancy checks
-	//
-		if (h->sentinal != HUNK_SENTINAL)
-			Sys_Error ("Hunk_Check: trahsed sentinal");
-		if (h->size < 16 || h->size + (byte *)h - hunk_base > hunk_size)
-			Sys_Error ("Hunk_Check: bad size");
-			
-		next = (hunk_t *)((byte *)h+h->size);
-		count++;
-		totalblocks++;
-		sum += h->size;
-
-	//
-	// print the single block
-	//
-		memcpy (name, h->name, HUNK_NAME_LEN);
-		if (all)
-			g_pFileSystem->FPrintf(file, "%8p :%16.16s %16s\n",h, Q_pretifymem(h->size), name);
-			
-	//
-	// print the total
-	//
-		if (next == endlow || next == endhigh || 
-		strncmp (h->name, next->name, HUNK_NAME_LEN) )
-		{
-			if (!all)
-				g_pFileSystem->FPrintf(file, "          :%16.16s %16s (TOTAL)\n",Q_pretifymem(sum), name);
-			count = 0;
-			sum = 0;
-		}
+void CScopeAllocator::FreeChunk( memchunk_t *pChunk )
+{
+	--m_nChunks;
+	m_nReserved -= pChunk->size;
+	free( pChunk );
+}
+
+//-----------------------------------------------------------------------------
+// Tags are never removed until the scope is released, so the index can be
+// kept in the allocation header
+//-----------------------------------------------------------------------------
+int CScopeAllocator::Tag( const char *pTag, int size )
+{
+	if ( !pTag || !pTag[0] )
+	{
+		pTag = "unknown";
+	}
 
-		h = next;
+	int i = m_Tags.Find( pTag );
+	if ( i == m_Tags.InvalidIndex() )
+	{
+		memtag_t tag;
+		tag.bytes = 0;
+		tag.count = 0;
+		i = m_Tags.Insert( pTag, tag );
 	}
 
-	g_pFileSystem->FPrintf(file, "-------------------------\n");
-	g_pFileSystem->FPrintf(file, "%8i total blocks\n", totalblocks);
-	g_pFileSystem->Close(file);
+	m_Tags[i].bytes += size;
+	m_Tags[i].count++;
+	return i;
 }
 
+void CScopeAllocator::Untag( byte *pStart, byte *pEnd )
+{
+	while ( pStart < pEnd )
+	{
+		hunk_t *h = (hunk_t *)pStart;
+		if ( h->sentinal != HUNK_SENTINAL )
+			Sys_Error( "Mem_FreeScopeToMark: trashed sentinal in %s scope", m_pName );
 
-/*
-===================
-Hunk_AllocName
-===================
-*/
-void *Hunk_AllocName (int size, const char *name)
+		m_Tags[h->tag].bytes -= h->size;
+		m_Tags[h->tag].count--;
+		pStart += h->size;
+	}
+}
+
+void *CScopeAllocator::Alloc( int size, const char *pTag, bool bClear )
 {
-	hunk_t	*h;
-	
 #ifdef PARANOID
-	Hunk_Check ();
+	Check();
 #endif
 
-	if (size < 0)
-		Sys_Error ("Hunk_Alloc: bad size: %i", size);
-		
+	if ( size < 0 )
+		Sys_Error( "Mem_ScopeAlloc: bad size: %i", size );
+
 	size = sizeof(hunk_t) + ((size+15)&~15);
-	
-	if (hunk_size - hunk_low_used - hunk_high_used < size)
-		Sys_Error ("Hunk_Alloc: failed on %i bytes",size);
-	
-	h = (hunk_t *)(hunk_base + hunk_low_used);
-	hunk_low_used += size;
 
-	Cache_FreeLow (hunk_low_used);
+	if ( !m_pChunk || m_pChunk->size - m_pChunk->used < size )
+	{
+		m_pChunk = NewChunk( size );
+	}
+
+	hunk_t *h = (hunk_t *)( m_pChunk->data + m_pChunk->used );
+	m_pChunk->used += size;
+
+	if ( bClear )
+	{
+		memset( h, 0, size );
+	}
 
-	memset (h, 0, size);
-	
-	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
-	Q_strncpy(h->name, name, HUNK_NAME_LEN);
-	
+	h->size = size;
+	h->tag = Tag( pTag, size );
+	h->pad = 0;
+
+	if ( Mark() > m_nPeak )
+	{
+		m_nPeak = Mark();
+	}
+
 	return (void *)(h+1);
 }
 
-/*
-===================
-Hunk_Alloc
-===================
-*/
-void *Hunk_Alloc (int size)
+void CScopeAllocator::FreeToMark( int mark )
 {
-	return Hunk_AllocName (size, "unknown");
-}
+	if ( mark < 0 || mark > Mark() )
+		Sys_Error( "Mem_FreeScopeToMark: bad mark %i in %s scope", mark, m_pName );
 
-int	Hunk_LowMark (void)
-{
-	return hunk_low_used;
+	// Chunks that start above the mark go completely, except the first
+	while ( m_pChunk && m_pChunk->prev && m_pChunk->base >= mark )
+	{
+		memchunk_t *pPrev = m_pChunk->prev;
+		Untag( m_pChunk->data, m_pChunk->data + m_pChunk->used );
+		FreeChunk( m_pChunk );
+		m_pChunk = pPrev;
+	}
+
+	if ( !m_pChunk )
+		return;
+
+	// Skip past any space left at the end of the chunk when the next one started
+	int used = mark - m_pChunk->base;
+	if ( used > m_pChunk->used )
+	{
+		used = m_pChunk->used;
+	}
+
+	Untag( m_pChunk->data + used, m_pChunk->data + m_pChunk->used );
+
+	// Fill the memory with junk (debug only) or don't bother in non-debug
+#if _DEBUG
+	memset( m_pChunk->data + used, 0xDD, m_pChunk->used - used );
+#endif
+	m_pChunk->used = used;
 }
 
-void Hunk_FreeToLowMark (int mark)
+int CScopeAllocator::FreeAll()
 {
-	if (mark < 0 || mark > hunk_low_used)
-		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
-#if 0
-	memset (hunk_base + mark, 0, hunk_low_used - mark);
-#else
-	// Fill the memory with junk (debug only) or don't bother in non-debug
-	#if _DEBUG
-	memset (hunk_base + mark, 0xDD, hunk_low_used - mark);
-	#endif
+	int nUsed = Mark();
+	if ( !nUsed && !m_Tags.Count() )
+		return 0;
+
+	// Keep the first chunk around if it's the usual size, most scopes
+	// will just fill it up again
+	while ( m_pChunk && ( m_pChunk->prev || m_pChunk->size != m_nChunkSize ) )
+	{
+		memchunk_t *pPrev = m_pChunk->prev;
+		FreeChunk( m_pChunk );
+		m_pChunk = pPrev;
+	}
+
+	if ( m_pChunk )
+	{
+#if _DEBUG
+		memset( m_pChunk->data, 0xDD, m_pChunk->used );
 #endif
-	hunk_low_used = mark;
+		m_pChunk->used = 0;
+	}
+
+	m_Tags.RemoveAll();
+	return nUsed;
 }
 
-int	Hunk_HighMark (void)
+//-----------------------------------------------------------------------------
+// Run consistancy and sentinal trashing checks
+//-----------------------------------------------------------------------------
+void CScopeAllocator::Check()
 {
-	if (hunk_tempactive)
+	for ( memchunk_t *pChunk = m_pChunk; pChunk; pChunk = pChunk->prev )
 	{
-		hunk_tempactive = false;
-		Hunk_FreeToHighMark (hunk_tempmark);
+		byte *p = pChunk->data;
+		byte *pEnd = pChunk->data + pChunk->used;
+		while ( p != pEnd )
+		{
+			hunk_t *h = (hunk_t *)p;
+			if ( h->sentinal != HUNK_SENTINAL )
+				Sys_Error( "Hunk_Check: trashed sentinal in %s scope", m_pName );
+			if ( h->size < (int)sizeof(hunk_t) || p + h->size > pEnd )
+				Sys_Error( "Hunk_Check: bad size in %s scope", m_pName );
+			p += h->size;
+		}
 	}
+}
+
+typedef struct
+{
+	const char	*name;
+	int			bytes;
+	int			count;
+} memtagreport_t;
 
-	return hunk_high_used;
+static int MemTagCompare( const void *p1, const void *p2 )
+{
+	return ((const memtagreport_t *)p2)->bytes - ((const memtagreport_t *)p1)->bytes;
 }
 
-void Hunk_FreeToHighMark (int mark)
+//-----------------------------------------------------------------------------
+// Prints the scope's usage by tag, biggest first.  If bAllocations is set
+// every single allocation is printed as well, in allocation order.
+//-----------------------------------------------------------------------------
+void CScopeAllocator::Report( MemPrintFunc_t pfnPrint, bool bAllocations )
 {
-	if (hunk_tempactive)
+	char used[50], reserved[50], peak[50];
+	pfnPrint( "%s scope: %s used, %s reserved in %d chunk(s), %s peak\n", m_pName,
+		Q_pretifymem( Mark(), used ), Q_pretifymem( m_nReserved, reserved ), m_nChunks, Q_pretifymem( m_nPeak, peak ) );
+
+	CUtlVector<memtagreport_t> sorted( 0, m_Tags.Count() );
+	for ( int i = m_Tags.First(); i != m_Tags.InvalidIndex(); i = m_Tags.Next( i ) )
 	{
-		hunk_tempactive = false;
-		Hunk_FreeToHighMark (hunk_tempmark);
+		if ( m_Tags[i].count )
+		{
+			int j = sorted.AddToTail();
+			sorted[j].name = m_Tags.GetElementName( i );
+			sorted[j].bytes = m_Tags[i].bytes;
+			sorted[j].count = m_Tags[i].count;
+		}
 	}
-	if (mark < 0 || mark > hunk_high_used)
-		Sys_Error ("Hunk_FreeToHighMark: bad mark %i", mark);
 
-#if 0
-	memset (hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
-#else
-	// Fill the memory with junk (debug only) or don't bother in non-debug
-	#if _DEBUG
-	memset (hunk_base + hunk_size - hunk_high_used, 0xDD, hunk_high_used - mark);
-	#endif
-#endif
-	hunk_high_used = mark;
+	if ( sorted.Count() )
+	{
+		qsort( sorted.Base(), sorted.Count(), sizeof( memtagreport_t ), MemTagCompare );
+	}
+
+	for ( int j = 0; j < sorted.Count(); ++j )
+	{
+		pfnPrint( "  %16.16s : %6d : %s\n", Q_pretifymem( sorted[j].bytes, used ), sorted[j].count, sorted[j].name );
+	}
+
+	if ( !bAllocations )
+		return;
+
+	// Chunks are linked newest first, walk them oldest first
+	CUtlVector<memchunk_t *> chunks( 0, m_nChunks );
+	for ( memchunk_t *pChunk = m_pChunk; pChunk; pChunk = pChunk->prev )
+	{
+		chunks.AddToHead( pChunk );
+	}
+
+	for ( int k = 0; k < chunks.Count(); ++k )
+	{
+		byte *p = chunks[k]->data;
+		byte *pEnd = chunks[k]->data + chunks[k]->used;
+		while ( p != pEnd )
+		{
+			hunk_t *h = (hunk_t *)p;
+			pfnPrint( "  %8p : %16.16s : %s\n", h, Q_pretifymem( h->size, used ), m_Tags.GetElementName( h->tag ) );
+			p += h->size;
+		}
+	}
 }
 
 
-/*
-===================
-Hunk_HighAllocName
-===================
-*/
-void *Hunk_HighAllocName (int size, char *name)
+//-----------------------------------------------------------------------------
+// Memory scopes
+//-----------------------------------------------------------------------------
+void *Mem_ScopeAlloc( MemScope_t scope, int size, const char *tag )
+{
+	return s_Scopes[scope].Alloc( size, tag );
+}
+
+int Mem_ScopeMark( MemScope_t scope )
 {
-	hunk_t	*h;
+	return s_Scopes[scope].Mark();
+}
 
-	if (size < 0)
-		Sys_Error ("Hunk_HighAllocName: bad size: %i", size);
+void Mem_FreeScopeToMark( MemScope_t scope, int mark )
+{
+	s_Scopes[scope].FreeToMark( mark );
+}
 
-	if (hunk_tempactive)
+int Mem_FreeScope( MemScope_t scope )
+{
+	if ( scope == MEMSCOPE_FRAME )
 	{
-		Hunk_FreeToHighMark (hunk_tempmark);
 		hunk_tempactive = false;
 	}
 
-#ifdef PARANOID
-	Hunk_Check ();
-#endif
+	return s_Scopes[scope].FreeAll();
+}
 
-	size = sizeof(hunk_t) + ((size+15)&~15);
+int Mem_ScopeUsed( MemScope_t scope )
+{
+	return s_Scopes[scope].Mark();
+}
 
-	if (hunk_size - hunk_low_used - hunk_high_used < size)
+void Mem_ReportScope( MemScope_t scope, MemPrintFunc_t pfnPrint )
+{
+	s_Scopes[scope].Report( pfnPrint );
+}
+
+static void Mem_Scopes_f( void )
+{
+	for ( int i = 0; i < MEMSCOPE_COUNT; ++i )
 	{
-		Con_Printf ("Hunk_HighAlloc: failed on %i bytes\n",size);
-		return NULL;
+		s_Scopes[i].Report( Con_Printf );
 	}
+}
 
-	hunk_high_used += size;
-	Cache_FreeHigh (hunk_high_used);
+static ConCommand mem_scopes( "mem_scopes", Mem_Scopes_f, "Print engine memory scope usage by tag." );
 
-	h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
 
-	memset (h, 0, size);
-	h->size = size;
-	h->sentinal = HUNK_SENTINAL;
-	Q_strncpy(h->name, name, HUNK_NAME_LEN);
+/*
+==============
+Hunk_Check
 
-	return (void *)(h+1);
+Run consistancy and sentinal trahing checks
+==============
+*/
+void Hunk_Check (void)
+{
+	for ( int i = 0; i < MEMSCOPE_COUNT; ++i )
+	{
+		s_Scopes[i].Check();
+	}
+}
+
+/*
+===================
+Hunk_BeginLevelScope
+
+Everything allocated on the hunk so far lives until shutdown, from here on
+the hunk is level data.
+===================
+*/
+void Hunk_BeginLevelScope( void )
+{
+	hunk_scope = MEMSCOPE_LEVEL;
+}
+
+/*
+===================
+Hunk_AllocName
+===================
+*/
+void *Hunk_AllocName (int size, const char *name)
+{
+	return s_Scopes[hunk_scope].Alloc( size, name );
+}
+
+/*
+===================
+Hunk_Alloc
+===================
+*/
+void *Hunk_Alloc (int size)
+{
+	return Hunk_AllocName (size, "unknown");
+}
+
+int	Hunk_LowMark (void)
+{
+	return s_Scopes[hunk_scope].Mark();
+}
+
+void Hunk_FreeToLowMark (int mark)
+{
+	if (mark < 0 || mark > s_Scopes[hunk_scope].Mark())
+		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
+
+	s_Scopes[hunk_scope].FreeToMark( mark );
 }
 
 
@@ -325,25 +520,24 @@ void *Hunk_HighAllocName (int size, char *name)
 =================
 Hunk_TempAlloc
 
-Return space from the top of the hunk
+Return space from the frame scope.  Only the last temp block is valid, the
+previous one is handed back unless something else was allocated after it.
 =================
 */
 void *Hunk_TempAlloc (int size)
 {
-	void	*buf;
+	CScopeAllocator &frame = s_Scopes[MEMSCOPE_FRAME];
 
-	size = (size+15)&~15;
-	
-	if (hunk_tempactive)
+	if ( hunk_tempactive && frame.Mark() == hunk_tempend )
 	{
-		Hunk_FreeToHighMark (hunk_tempmark);
-		hunk_tempactive = false;
+		frame.FreeToMark( hunk_tempmark );
 	}
-	
-	hunk_tempmark = Hunk_HighMark ();
 
-	buf = Hunk_HighAllocName (size, "temp");
+	hunk_tempmark = frame.Mark();
+
+	void *buf = frame.Alloc( size, "temp", false );
 
+	hunk_tempend = frame.Mark();
 	hunk_tempactive = true;
 
 	return buf;
@@ -368,91 +562,13 @@ typedef struct cache_system_s
 	int						locked;
 } cache_system_t;
 
-cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
-
 cache_system_t	cache_head;
 
 int	cache_critical_section;
 
-/*
-===========
-Cache_Move
-===========
-*/
-void Cache_Move ( cache_system_t *c)
-{
-	cache_system_t		*newmem;
-
-// we are clearing up space at the bottom, so only allocate it late
-	newmem = Cache_TryAlloc (c->size, true);
-	if (newmem)
-	{
-//		Con_Printf ("cache_move ok\n");
-
-		Q_memcpy ( newmem+1, c+1, c->size - sizeof(cache_system_t) );
-		newmem->user = c->user;
-		Q_memcpy (newmem->name, c->name, sizeof(newmem->name));
-		Cache_Free (c->user);
-		newmem->user->data = (void *)(newmem+1);
-	}
-	else
-	{
-//		Con_Printf ("cache_move failed\n");
-
-		Cache_Free (c->user);		// tough luck...
-	}
-}
-
-/*
-============
-Cache_FreeLow
-
-Throw things out until the hunk can be expanded to the given point
-============
-*/
-void Cache_FreeLow (int new_low_hunk)
-{
-	cache_system_t	*c;
-	
-	while (1)
-	{
-		c = cache_head.next;
-		if (c == &cache_head)
-			return;		// nothing in cache at all
-		if ((byte *)c >= hunk_base + new_low_hunk)
-			return;		// there is space to grow the hunk
-		Cache_Move ( c );	// reclaim the space
-	}
-}
-
-/*
-============
-Cache_FreeHigh
-
-Throw things out until the hunk can be expanded to the given point
-============
-*/
-void Cache_FreeHigh (int new_high_hunk)
-{
-	cache_system_t	*c, *prev;
-	
-	prev = NULL;
-	while (1)
-	{
-		c = cache_head.prev;
-		if (c == &cache_head)
-			return;		// nothing in cache at all
-		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
-			return;		// there is space to grow the hunk
-		if (c == prev)
-			Cache_Free (c->user);	// didn't move out of the way
-		else
-		{
-			Cache_Move (c);	// try to move it
-			prev = c;
-		}
-	}
-}
+// The cache throws out old entries to stay under this
+int	cache_budget;
+int	cache_used;
 
 void Cache_UnlinkLRU (cache_system_t *cs)
 {
@@ -482,86 +598,6 @@ void Cache_MakeLRU (cache_system_t *cs)
 	cs->locked = cache_critical_section;
 }
 
-/*
-============
-Cache_TryAlloc
-
-Looks for a free block of memory between the high and low hunk marks
-Size should already include the header and padding
-============
-*/
-cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
-{
-	cache_system_t	*cs, *newmem;
-	
-// is the cache completely empty?
-
-	if (!nobottom && cache_head.prev == &cache_head)
-	{
-		if (hunk_size - hunk_high_used - hunk_low_used < size)
-			Sys_Error ("Cache_TryAlloc: %i is greater then free hunk", size);
-
-		newmem = (cache_system_t *) (hunk_base + hunk_low_used);
-		memset (newmem, 0, sizeof(*newmem));
-		newmem->size = size;
-
-		cache_head.prev = cache_head.next = newmem;
-		newmem->prev = newmem->next = &cache_head;
-		
-		Cache_MakeLRU (newmem);
-		return newmem;
-	}
-	
-// search from the bottom up for space
-
-	newmem = (cache_system_t *) (hunk_base + hunk_low_used);
-	cs = cache_head.next;
-	
-	do
-	{
-		if (!nobottom || cs != cache_head.next)
-		{
-			if ( (byte *)cs - (byte *)newmem >= size)
-			{	// found space
-				memset (newmem, 0, sizeof(*newmem));
-				newmem->size = size;
-				
-				newmem->next = cs;
-				newmem->prev = cs->prev;
-				cs->prev->next = newmem;
-				cs->prev = newmem;
-				
-				Cache_MakeLRU (newmem);
-	
-				return newmem;
-			}
-		}
-
-	// continue looking		
-		newmem = (cache_system_t *)((byte *)cs + cs->size);
-		cs = cs->next;
-
-	} while (cs != &cache_head);
-	
-// try to allocate one at the very end
-	if ( hunk_base + hunk_size - hunk_high_used - (byte *)newmem >= size)
-	{
-		memset (newmem, 0, sizeof(*newmem));
-		newmem->size = size;
-		
-		newmem->next = &cache_head;
-		newmem->prev = cache_head.prev;
-		cache_head.prev->next = newmem;
-		cache_head.prev = newmem;
-		
-		Cache_MakeLRU (newmem);
-
-		return newmem;
-	}
-	
-	return NULL;		// couldn't allocate
-}
-
 /*
 ============
 Cache_Flush
@@ -711,7 +747,7 @@ Cache_Report
 */
 void Cache_Report (void)
 {
-	Con_DPrintf ("%4.1f megabyte data cache\n", (hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024) );
+	Con_DPrintf ("%4.1f megabyte data cache, %4.1f in use\n", cache_budget / (float)(1024*1024), cache_used / (float)(1024*1024) );
 }
 
 /*
@@ -736,6 +772,9 @@ void Cache_Init (void)
 {
 	cache_head.next = cache_head.prev = &cache_head;
 	cache_head.lru_next = cache_head.lru_prev = &cache_head;
+
+	cache_budget = host_parms.memsize;
+	cache_used = 0;
 }
 
 /*
@@ -761,16 +800,14 @@ void Cache_Free (cache_user_t *c)
 	c->data = NULL;
 
 	Cache_UnlinkLRU (cs);
+
+	cache_used -= cs->size;
+	free (cs);
 }
 
 int Cache_TotalUsed(void)
 {
-	cache_system_t	*cd;
-	int Total=0;
-	for (cd = cache_head.next ; cd != &cache_head ; cd = cd->next)
-			Total+=cd->size;
-
-	return Total;
+	return cache_used;
 }
 	
 
@@ -815,26 +852,36 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 
 	size = (size + sizeof(cache_system_t) + 15) & ~15;
 
-// find memory for it	
-	while (1)
+// free the least recently used entries until it fits the budget
+	while (cache_used + size > cache_budget)
 	{
-		cs = Cache_TryAlloc (size, false);
-		if (cs)
-		{
-			Q_strncpy(cs->name, name, sizeof(cs->name));
-			c->data = (void *)(cs+1);
-			cs->user = c;
+		// locked entries are still wanted, if that's all that's left
+		// go over the budget rather than fail
+		if (cache_head.lru_prev == &cache_head || cache_head.lru_prev->locked)
 			break;
-		}
 
-	// free the least recently used entry
-		// assume if it's a locked entry that we've run out.
-		if (cache_head.lru_prev == &cache_head || cache_head.lru_prev->locked)
-			Sys_Error ("Cache_Alloc: out of memory");
-		
 		Cache_Free ( cache_head.lru_prev->user );
 	}
-	
+
+	cs = (cache_system_t *)malloc (size);
+	if (!cs)
+		Sys_Error ("Cache_Alloc: out of memory");
+
+	memset (cs, 0, sizeof(*cs));
+	cs->size = size;
+	Q_strncpy(cs->name, name, sizeof(cs->name));
+	cs->user = c;
+
+	cs->next = &cache_head;
+	cs->prev = cache_head.prev;
+	cache_head.prev->next = cs;
+	cache_head.prev = cs;
+
+	Cache_MakeLRU (cs);
+
+	cache_used += size;
+	c->data = (void *)(cs+1);
+
 	return Cache_Check (c);
 }
 
@@ -861,6 +908,7 @@ void Cache_ExitCriticalSection( void )
 
 //============================================================================
 
+
 #ifdef _DEBUG
 /*
 =========================
@@ -870,88 +918,56 @@ MEM_Print
 =========================
 */
 
-typedef struct SMemoryBin
-{
-	char binName[ HUNK_NAME_LEN+1 ];
-	long size;
-
-	struct SMemoryBin *pNext;
-} SMemoryBin;
+static FileHandle_t mem_dbghandle;
 
+static void MEM_FilePrintf( const char *pMsg, ... )
+{
+	va_list		argptr;
+	char		text[1024];
 
-void MEM_PrintHunk( void ) 
-{ 
-	SMemoryBin *pHunkBins = NULL, *pCur = NULL;
-	FileHandle_t file = g_pFileSystem->Open(mem_dbgfile.GetString(), "a");
+	va_start( argptr, pMsg );
+	Q_vsnprintf( text, sizeof( text ), pMsg, argptr );
+	va_end( argptr );
 
-	hunk_t *h = (hunk_t *)hunk_base;
+	g_pFileSystem->FPrintf( mem_dbghandle, "%s", text );
+}
 
-	hunk_t *endlow = (hunk_t *)(hunk_base + hunk_low_used);
-	hunk_t *starthigh = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
-	hunk_t *endhigh = (hunk_t *)(hunk_base + hunk_size);
+/*
+==============
+Hunk_Print
 
-	if (!file)
+If "all" is specified, every single allocation is printed.
+Otherwise, allocations with the same tag are totaled up before printing.
+==============
+*/
+void Hunk_Print (qboolean all)
+{
+	mem_dbghandle = g_pFileSystem->Open(mem_dbgfile.GetString(), "a");
+	if (!mem_dbghandle)
 		return;
 
-	g_pFileSystem->FPrintf(file, "\n\nHunk:\n\n" ); 
-
-	while (1)
+	for ( int i = 0; i < MEMSCOPE_COUNT; ++i )
 	{
-		//
-		// skip to the high hunk if done with low hunk
-		//
-		if ( h == endlow )
-			h = starthigh;
-		
-		//
-		// if totally done, break
-		//
-		if ( h == endhigh )
-			break;
-
-		// total up info
-		pCur = pHunkBins;
-		while( pCur )
-		{
-			if( !strncmp( pCur->binName, h->name, sizeof( h->name ) ) )
-			{
-				pCur->size += h->size;
-				break;
-			}
-
-			pCur = pCur->pNext;
-		}
-
-		// If we ran out of bins, make a newmem one.
-		if( !pCur )
-		{
-			pCur = (SMemoryBin *) malloc( sizeof( SMemoryBin ) );
-			Q_strncpy( pCur->binName, h->name, sizeof(pCur->binName) );
-
-			pCur->size = h->size;
-
-			pCur->pNext = pHunkBins;
-			pHunkBins = pCur;
-		}
-
-		// next block
-		h = (hunk_t *)((byte *)h + h->size);
+		s_Scopes[i].Check();
+		s_Scopes[i].Report( MEM_FilePrintf, all ? true : false );
+		g_pFileSystem->FPrintf(mem_dbghandle, "-------------------------\n");
 	}
 
-	pCur = pHunkBins;
-	while( pCur )
-	{
-		SMemoryBin *pLast = pCur;
+	g_pFileSystem->Close(mem_dbghandle);
+	mem_dbghandle = NULL;
+}
 
-		g_pFileSystem->FPrintf(file, "%16.16s : %16s \n", Q_pretifymem(pCur->size), pCur->binName);
 
-		pCur = pCur->pNext;
-		free( pLast );
-	}
+void MEM_PrintHunk( void ) 
+{ 
+	FileHandle_t file = g_pFileSystem->Open(mem_dbgfile.GetString(), "a");
+	if (!file)
+		return;
 
-	pHunkBins = NULL;
+	g_pFileSystem->FPrintf(file, "\n\nHunk:\n\n" ); 
 	g_pFileSystem->Close(file);
-//	Hunk_Print( 1 ); 
+
+	Hunk_Print( 0 ); 
 }
 
 
@@ -972,19 +988,19 @@ void MEM_PrintCache( void )
 void MEM_Summary(void)
 {
 	FileHandle_t file = g_pFileSystem->Open(mem_dbgfile.GetString(), "a");
-	int CacheUsed=Cache_TotalUsed();
 	char buf[50];
 	if (!file)
 		return;
 
 
 	g_pFileSystem->FPrintf(file, "MEMORY SUMMARY:\n------------------------------------\n");
-	g_pFileSystem->FPrintf(file, "\tTotal memory available:    %s\n",Q_pretifymem(hunk_size,buf));
-	g_pFileSystem->FPrintf(file, "\tTotal used in low hunk:    %s\n",Q_pretifymem(hunk_low_used,buf));
-	g_pFileSystem->FPrintf(file, "\tTotal used in high hunk:   %s\n",Q_pretifymem(hunk_high_used,buf));
-	g_pFileSystem->FPrintf(file, "\tTotal cache space:         %s\n",Q_pretifymem(hunk_size - hunk_low_used - hunk_high_used,buf));
-	g_pFileSystem->FPrintf(file, "\tTotal cache used:          %s\n",Q_pretifymem(CacheUsed,buf));
-	g_pFileSystem->FPrintf(file, "\tTotal memory available:    %s\n",Q_pretifymem(hunk_size - hunk_low_used - hunk_high_used-CacheUsed,buf));
+	for ( int i = 0; i < MEMSCOPE_COUNT; ++i )
+	{
+		g_pFileSystem->FPrintf(file, "\tUsed in %-9s scope:     %s\n",s_Scopes[i].GetName(),Q_pretifymem(s_Scopes[i].Mark(),buf));
+		g_pFileSystem->FPrintf(file, "\tReserved by %-9s scope: %s\n",s_Scopes[i].GetName(),Q_pretifymem(s_Scopes[i].Reserved(),buf));
+	}
+	g_pFileSystem->FPrintf(file, "\tTotal cache budget:        %s\n",Q_pretifymem(cache_budget,buf));
+	g_pFileSystem->FPrintf(file, "\tTotal cache used:          %s\n",Q_pretifymem(cache_used,buf));
 	g_pFileSystem->FPrintf(file, "------------------------------------\n\n");
 
 	g_pFileSystem->Close(file);
@@ -1013,7 +1029,6 @@ void MEM_All(void)
 
 	Hunk_Print(0);
 //	Hunk_Print(1);		//too verbose to be used generally.
-	MEM_PrintHunk();
 	MEM_PrintCache();
 }
 
@@ -1046,10 +1061,12 @@ static ConCommand memmodels( "memmodels", MEM_PrintCacheModels, "Print model cac
 //-----------------------------------------------------------------------------
 void Memory_Init ( void )
 {
-	hunk_base = (byte *)host_parms.membase;
-	hunk_size = host_parms.memsize;
-	hunk_low_used = 0;
-	hunk_high_used = 0;
+	s_Scopes[MEMSCOPE_PERMANENT].Init( "permanent", MEMSCOPE_PERMANENT_CHUNK );
+	s_Scopes[MEMSCOPE_LEVEL].Init( "level", MEMSCOPE_LEVEL_CHUNK );
+	s_Scopes[MEMSCOPE_FRAME].Init( "frame", MEMSCOPE_FRAME_CHUNK );
+
+	hunk_scope = MEMSCOPE_PERMANENT;
+	hunk_tempactive = false;
 	
 	Cache_Init ();
 }
@@ -1060,7 +1077,12 @@ void Memory_Init ( void )
 //-----------------------------------------------------------------------------
 void Memory_Shutdown( void )
 {
-	// TODO: Clear out the hunk?
+	// Cache entries belong to their users, who have already freed them
+	for ( int i = MEMSCOPE_COUNT; --i >= 0; )
+	{
+		s_Scopes[i].Shutdown();
+	}
+	hunk_tempactive = false;
 }
 
 void Cache_Print_Models_And_Totals (void)
@@ -1190,15 +1212,18 @@ void Cache_Print_Sounds_And_Totals (void)
 
 int MEM_Summary_Console( void )
 {
-	Msg("MEMORY:  Engine hunk, cache, and zone:\n------------------------------------\n");
-	Msg("\tTotal memory available:    %s\n",Q_pretifymem(hunk_size));
-	Msg("\tTotal used in low hunk:    %s\n",Q_pretifymem(hunk_low_used));
-	Msg("\tTotal used in high hunk:   %s\n",Q_pretifymem(hunk_high_used));
-	Msg("\tTotal cache space:         %s\n",Q_pretifymem(hunk_size - hunk_low_used - hunk_high_used));
-	Msg("\tTotal cache used:          %s\n",Q_pretifymem(Cache_TotalUsed()));
-	Msg("\tTotal memory available:    %s\n",Q_pretifymem(hunk_size - hunk_low_used - hunk_high_used-Cache_TotalUsed()));
+	int nReserved = 0;
+
+	Msg("MEMORY:  Engine scopes and cache:\n------------------------------------\n");
+	for ( int i = 0; i < MEMSCOPE_COUNT; ++i )
+	{
+		Msg("\t%-9s scope:  %s used, %s reserved\n",s_Scopes[i].GetName(),Q_pretifymem(s_Scopes[i].Mark()),Q_pretifymem(s_Scopes[i].Reserved()));
+		nReserved += s_Scopes[i].Reserved();
+	}
+	Msg("\tTotal cache budget:        %s\n",Q_pretifymem(cache_budget));
+	Msg("\tTotal cache used:          %s\n",Q_pretifymem(cache_used));
 
 	Msg("------------------------------------\n");
 
-	return hunk_size;
+	return nReserved + cache_used;
 }
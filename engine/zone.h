@@ -6,77 +6,62 @@
  memory allocation
 
 
-H_??? The hunk manages the entire memory block given to quake.  It must be
-contiguous.  Memory can be allocated from either the low or high end in a
-stack fashion.  The only way memory is released is by resetting one of the
-pointers.
+Mem_Scope??? Engine data that lives and dies together is allocated from a
+growable linear allocator for its scope.  Each scope is a chain of chunks
+grabbed from the heap as it's needed, so there is no fixed block to size up
+front.  Memory is only released by going back to a mark, or by releasing the
+whole scope at once:
 
-Hunk allocations should be given a name, so the Hunk_Print () function
-can display usage.
+	MEMSCOPE_PERMANENT	startup allocations, kept until shutdown
+	MEMSCOPE_LEVEL		map data, released in one go at map change
+	MEMSCOPE_FRAME		scratch memory, released at the end of every frame
 
-Hunk allocations are guaranteed to be 16 byte aligned.
+Allocations should be given a tag.  Each scope totals its allocations by tag,
+which is what the level report at map change and mem_scopes print.
 
-The video buffers are allocated high to avoid leaving a hole underneath
-server allocations when changing to a higher video mode.
+Scope allocations are zero filled and guaranteed to be 16 byte aligned.
 
-Cache_??? Cache memory is for objects that can be dynamically loaded and
-can usefully stay persistant between levels.  The size of the cache
-fluctuates from level to level.
-
-To allocate a cachable object
-
-
-Temp_??? Temp memory is used for file loading and surface caching.  The size
-of the cache memory is adjusted so that there is a minimum of 512k remaining
-for temp memory.
-
-
------- Top of Memory -------
-
-high hunk allocations
-
-<--- high hunk reset point held by vid
-
-video buffer
-
-z buffer
-
-surface cache
-
-<--- high hunk used
-
-cachable memory
+Hunk_??? The old hunk calls are kept on top of the scopes.  They allocate
+from the permanent scope until Hunk_BeginLevelScope is called at the end of
+startup, and from the level scope after that.  Hunk_TempAlloc comes from the
+frame scope, only the last temp block is valid, as before.
 
-<--- low hunk used
-
-client and server low hunk allocations
-
-<-- low hunk reset point held by host
-
-startup hunk allocations
-
-Zone block
+Cache_??? Cache memory is for objects that can be dynamically loaded and
+can usefully stay persistant between levels.  Cache entries come from the
+heap, and the least recently used ones are thrown out to keep the cache
+under its budget (-heapsize).
 
------ Bottom of Memory -----
+*/
 
+enum MemScope_t
+{
+	MEMSCOPE_PERMANENT = 0,
+	MEMSCOPE_LEVEL,
+	MEMSCOPE_FRAME,
 
+	MEMSCOPE_COUNT
+};
 
-*/
+typedef void (*MemPrintFunc_t)( const char *pMsg, ... );
 
 void Memory_Init (void);
 void Memory_Shutdown( void );
 
+void *Mem_ScopeAlloc( MemScope_t scope, int size, const char *tag );	// returns 0 filled memory
+int	Mem_ScopeMark( MemScope_t scope );
+void Mem_FreeScopeToMark( MemScope_t scope, int mark );
+int	Mem_FreeScope( MemScope_t scope );		// returns the number of bytes released
+int	Mem_ScopeUsed( MemScope_t scope );
+void Mem_ReportScope( MemScope_t scope, MemPrintFunc_t pfnPrint );
+
+void Hunk_BeginLevelScope( void );
+
 void *Hunk_Alloc (int size);		// returns 0 filled memory
 void *Hunk_AllocName (int size, const char *name);
 
-void *Hunk_HighAllocName (int size, char *name);
-
 int	Hunk_LowMark (void);
 void Hunk_FreeToLowMark (int mark);
 
-int	Hunk_HighMark (void);
-void Hunk_FreeToHighMark (int mark);
-
 void *Hunk_TempAlloc (int size);
 
 void Hunk_Check (void);
@@ -84,5 +69,3 @@ void Hunk_Check (void);
 int MEM_Summary_Console( void );
 
 #endif // ZONE_H
-
-
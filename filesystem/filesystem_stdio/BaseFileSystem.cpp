@@ -26,7 +26,7 @@ static char s_pScratchFileName[ MAX_PATH ];
 
 
 // Case-insensitive symbol table for path IDs.
-CUtlSymbolTable g_PathIDTable( 0, 32, true );
+CUtlSymbolTableMT g_PathIDTable( 0, 32, true );
 
 
 //-----------------------------------------------------------------------------
@@ -45,6 +45,15 @@ CBaseFileSystem::CBaseFileSystem()
 	m_pfnWarning	= NULL;
 	m_pLogFile			= NULL;
 	m_bOutputDebugString = false;
+	m_bMapPackFiles = true;
+	m_bPathIndexEnabled = true;
+	m_bPathIndexDirty = true;
+	m_bLevelLoading = false;
+	m_nPathProbes = 0;
+	m_bRecordingLookups = false;
+	m_flLooseDirIndexTime = 0;
+	m_nLooseDirIndexFiles = 0;
+	m_pAsyncReader = NULL;
 	CUtlSymbol::DisableStaticSymbolTable();
 }
 
@@ -88,6 +97,16 @@ InitReturnVal_t CBaseFileSystem::Init()
 			return INIT_FAILED;
 	}
 
+	if ( CommandLine()->FindParm( "-fs_noindex" ) )
+	{
+		m_bPathIndexEnabled = false;
+	}
+
+	if ( CommandLine()->FindParm( "-fs_nomap" ) )
+	{
+		m_bMapPackFiles = false;
+	}
+
 	// Add the executable directory as a default search path for the executable.
 	if ( CommandLine()->ParmCount() != 0 )
 	{
@@ -123,6 +142,7 @@ void CBaseFileSystem::Shutdown()
 		fclose( m_pLogFile ); // STEAM OK
 	}
 
+	ShutdownAsyncReader();
 	RemoveAllSearchPaths();
 	Trace_DumpUnclosedFiles();
 }
@@ -395,6 +415,30 @@ bool CBaseFileSystem::PreparePackFile( CSearchPath& packfile, int offsetofpackin
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Memory-maps a pack file (or the .bsp it's embedded in) so reads from it
+//  don't have to share the pack's FILE* and can be handed out without copying.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::MapPackFile( CSearchPath& packfile, const char *pFullPath )
+{
+	if ( !m_bMapPackFiles )
+		return;
+
+	struct	_stat buf;
+	if ( FS_stat( pFullPath, &buf ) == -1 || buf.st_size > MAX_MAPPED_PACK_SIZE )
+		return;
+
+	unsigned int size = 0;
+	void *hMapping = NULL;
+	const unsigned char *pData = FS_MapFile( pFullPath, size, hMapping );
+	if ( !pData )
+		return;
+
+	packfile.m_pPackMapping = pData;
+	packfile.m_nPackMappingSize = size;
+	packfile.m_hPackMapping = hMapping;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Search pPath for pak?.pak files and add to search path if found
 // Input  : *pPath - 
@@ -459,6 +503,7 @@ void CBaseFileSystem::AddPackFiles( const char *pPath, SearchPathAdd_t addType )
 		sp->m_lPackFileTime = GetFileTime( pakfile );
 		sp->m_hPackFile		= new CFileHandle;
 		sp->m_hPackFile->m_pFile = Trace_FOpen( fullpath, "rb" );
+		sp->m_PackFullPath	= g_PathIDTable.AddString( fullpath );
 
 		Seek( ( FILE * )sp->m_hPackFile->m_pFile, 0, FILESYSTEM_SEEK_TAIL );
 		int len = FS_ftell( ( FILE * )sp->m_hPackFile->m_pFile );
@@ -467,6 +512,7 @@ void CBaseFileSystem::AddPackFiles( const char *pPath, SearchPathAdd_t addType )
 		if ( PreparePackFile( *sp, 0, len ) )
 		{
 			m_PackFileHandles.AddToTail( sp->m_hPackFile->m_pFile );
+			MapPackFile( *sp, fullpath );
 		}
 		else
 		{
@@ -489,6 +535,8 @@ void CBaseFileSystem::RemoveAllMapSearchPaths( void )
 		
 		m_SearchPaths.Remove( i );
 	}
+
+	InvalidatePathIndex();
 }
 
 //-----------------------------------------------------------------------------
@@ -574,16 +622,20 @@ void CBaseFileSystem::AddMapPackFile( const char *pPath, SearchPathAdd_t addType
 	sp->m_lPackFileTime = GetFileTime( newPath );
 	sp->m_hPackFile		= new CFileHandle;
 	sp->m_hPackFile->m_pFile = fp;
+	sp->m_PackFullPath	= g_PathIDTable.AddString( fullpath );
 
 	if ( PreparePackFile( *sp, packfile->fileofs, packfile->filelen ) )
 	{
 		m_PackFileHandles.AddToTail( sp->m_hPackFile->m_pFile );
+		MapPackFile( *sp, fullpath );
 	}
 	else
 	{
 		// Failed for some reason, ignore it . .m_SearchPaths.Remove will close the file for us.
 		m_SearchPaths.Remove( nIndex );
 	}
+
+	InvalidatePathIndex();
 }
 
 void CBaseFileSystem::PrintSearchPaths( void )
@@ -668,6 +720,10 @@ void CBaseFileSystem::AddSearchPath( const char *pPath, const char *pathID, Sear
 	sp->m_Path = pathSym;
 	sp->m_PathID = pathIDSym;
 
+	// If this directory was in the search path before, files could have shown up since then.
+	RescanLooseDir( pathSym );
+	InvalidatePathIndex();
+
 #ifdef _DEBUG
 	PrintSearchPaths();
 #endif
@@ -710,6 +766,8 @@ bool CBaseFileSystem::RemoveSearchPath( const char *pPath, const char *pathID )
 		m_SearchPaths.Remove( i );
 		bret = true;
 	}
+
+	InvalidatePathIndex();
 	return bret;
 }
 
@@ -775,6 +833,7 @@ void CBaseFileSystem::RemoveAllSearchPaths( void )
 {
 	m_SearchPaths.Purge();
 	m_PackFileHandles.Purge();
+	PurgePathIndex();
 }
 
 
@@ -791,6 +850,8 @@ FileHandle_t CBaseFileSystem::FindFile( const CSearchPath *path, const char *pFi
 {
 	CFileHandle *fh;
 
+	m_nPathProbes++;
+
 	if ( path->m_bIsPackFile )
 	{
 		// Search the tree for the filename
@@ -807,8 +868,6 @@ FileHandle_t CBaseFileSystem::FindFile( const CSearchPath *path, const char *pFi
 		{
 			CPackFileEntry result = path->m_PackFiles[ searchresult ];
 
-			Seek( (FileHandle_t)path->m_hPackFile, result.m_nPosition, FILESYSTEM_SEEK_HEAD );
-
 			fh = new CFileHandle;
 
 			fh->m_pFile = ((CFileHandle *)path->m_hPackFile)->m_pFile;
@@ -817,6 +876,16 @@ FileHandle_t CBaseFileSystem::FindFile( const CSearchPath *path, const char *pFi
 			fh->m_nFileTime = path->m_lPackFileTime;
 			fh->m_bPack = true;
 
+			// Mapped pack files don't touch the shared FILE* at all.
+			if ( path->m_pPackMapping && (unsigned int)( result.m_nPosition + result.m_nLength ) <= path->m_nPackMappingSize )
+			{
+				fh->m_pMappedData = path->m_pPackMapping + result.m_nPosition;
+			}
+			else
+			{
+				Seek( (FileHandle_t)path->m_hPackFile, result.m_nPosition, FILESYSTEM_SEEK_HEAD );
+			}
+
 			return (FileHandle_t)fh;
 		}
 	}
@@ -901,10 +970,14 @@ FileHandle_t CBaseFileSystem::OpenForRead( const char *pFileName, const char *pO
 		lookup = g_PathIDTable.AddString( pathID );
 	}
 
-	// Opening for READ needs to search search paths
-	int i;
-	for( i = 0; i < m_SearchPaths.Count(); i++ )
+	// Opening for READ needs to search search paths. The path index
+	// narrows it down to the ones that can have the file.
+	int *pCandidates = ( int * )_alloca( ( m_SearchPaths.Count() + 1 ) * sizeof( int ) );
+	int nCandidates = GetSearchPathCandidates( pFileName, pCandidates );
+	int iCandidate;
+	for( iCandidate = 0; iCandidate < nCandidates; iCandidate++ )
 	{
+		int i = pCandidates[iCandidate];
 		if (pathID && m_SearchPaths[i].m_PathID != lookup)
 			continue;
 
@@ -957,6 +1030,8 @@ FileHandle_t CBaseFileSystem::OpenForWrite( const char *pFileName, const char *p
 	fh->m_bPack = false;
 	fh->m_pFile = fp;
 
+	NotePathIndexFileChanged( pTmpFileName, true );
+
 	return ( FileHandle_t )fh;
 }
 
@@ -1024,6 +1099,11 @@ FileHandle_t CBaseFileSystem::Open( const char *pFileName, const char *pOptions,
 	// FIXME: call createdirhierarchy upon opening for write.
 	if( strstr( pOptions, "r" ) && !strstr( pOptions, "+" ) )
 	{
+		if ( m_bRecordingLookups )
+		{
+			RecordLookup( LOOKUP_OPEN, pFileName, pathID );
+		}
+
 		return OpenForRead( pFileName, pOptions, pathID );
 	}
 
@@ -1089,7 +1169,21 @@ void CBaseFileSystem::Seek( FileHandle_t file, int pos, FileSystemSeek_t whence
 		seekType = SEEK_END;
 
 	// Pack files get special handling
-	if ( fh->m_bPack )
+	if ( fh->m_pMappedData )
+	{
+		if ( whence == FILESYSTEM_SEEK_CURRENT )
+			pos += fh->m_nMappedPos;
+		else if ( whence == FILESYSTEM_SEEK_TAIL )
+			pos += fh->m_nLength;
+
+		if ( pos < 0 )
+			pos = 0;
+		else if ( pos > fh->m_nLength )
+			pos = fh->m_nLength;
+
+		fh->m_nMappedPos = pos;
+	}
+	else if ( fh->m_bPack )
 	{
 		if ( whence == FILESYSTEM_SEEK_CURRENT )
 		{
@@ -1134,6 +1228,9 @@ unsigned int CBaseFileSystem::Tell( FileHandle_t file )
 		return 0;
 	}
 
+	if ( fh->m_pMappedData )
+		return fh->m_nMappedPos;
+
 	// Pack files are relative
 	return FS_ftell( fh->m_pFile ) - fh->m_nStartOffset;
 }
@@ -1183,12 +1280,20 @@ unsigned int CBaseFileSystem::Size( const char* pFileName, const char *pPathID )
 	char tempPathID[MAX_PATH];
 	ParsePathID( pFileName, pPathID, tempPathID );
 
+	if ( m_bRecordingLookups )
+	{
+		RecordLookup( LOOKUP_SIZE, pFileName, pPathID );
+	}
+
 	// Handle adding in searth paths
-	int i;
 	int iSize = 0;
 	CUtlSymbol id = g_PathIDTable.AddString( pPathID );
-	for( i = 0; i < m_SearchPaths.Count(); i++ )
+	int *pCandidates = ( int * )_alloca( ( m_SearchPaths.Count() + 1 ) * sizeof( int ) );
+	int nCandidates = GetSearchPathCandidates( pFileName, pCandidates );
+	int iCandidate;
+	for( iCandidate = 0; iCandidate < nCandidates; iCandidate++ )
 	{
+		int i = pCandidates[iCandidate];
 		if ( pPathID && m_SearchPaths[i].m_PathID != id )
 			continue;
 
@@ -1205,6 +1310,8 @@ int CBaseFileSystem::FastFindFile( const CSearchPath *path, const char *pFileNam
 {
 	struct	_stat buf;
 
+	m_nPathProbes++;
+
 	if ( path->m_bIsPackFile )
 	{
 		// Search the tree for the filename
@@ -1268,6 +1375,11 @@ bool CBaseFileSystem::EndOfFile( FileHandle_t file )
 		return true;
 	}
 
+	if ( fh->m_pMappedData )
+	{
+		return fh->m_nMappedPos >= fh->m_nLength;
+	}
+
 	if ( fh->m_bPack )
 	{
 		if ( FS_ftell( fh->m_pFile ) >=
@@ -1299,6 +1411,20 @@ int CBaseFileSystem::Read( void *pOutput, int size, FileHandle_t file )
 		return 0;
 	}
 
+	if ( fh->m_pMappedData )
+	{
+		int nBytesLeft = fh->m_nLength - fh->m_nMappedPos;
+		if ( size > nBytesLeft )
+			size = nBytesLeft;
+
+		memcpy( pOutput, fh->m_pMappedData + fh->m_nMappedPos, size );
+		fh->m_nMappedPos += size;
+
+		m_Stats.nBytesRead += size;
+		m_Stats.nReads++;
+		return size;
+	}
+
 	size_t nBytesRead = FS_fread( pOutput, 1, size, fh->m_pFile  );
 	m_Stats.nBytesRead += nBytesRead;
 	m_Stats.nReads++;
@@ -1414,9 +1540,21 @@ bool CBaseFileSystem::Precache( const char *pFileName, const char *pPathID)
 		return false;
 
 
-	char buffer[16384];
-	while( sizeof(buffer) == Read(buffer,sizeof(buffer),f) )
-		;
+	unsigned int nSize;
+	const unsigned char *pData = (const unsigned char *)GetReadOnlyFileData( f, &nSize );
+	if ( pData )
+	{
+		// It's memory-mapped, so just touch every page to bring it in. The reads
+		// are volatile so they can't be optimized away.
+		for ( unsigned int i=0; i < nSize; i += 4096 )
+			(void)*(volatile const unsigned char *)&pData[i];
+	}
+	else
+	{
+		char buffer[16384];
+		while( sizeof(buffer) == Read(buffer,sizeof(buffer),f) )
+			;
+	}
 
 	Close(f);
 
@@ -1444,6 +1582,26 @@ char *CBaseFileSystem::ReadLine( char *pOutput, int maxChars, FileHandle_t file
 
 	m_Stats.nReads++;
 
+	if ( fh->m_pMappedData )
+	{
+		// Same as fgets: stop after a newline or when the buffer is full.
+		if ( fh->m_nMappedPos >= fh->m_nLength || maxChars <= 0 )
+			return NULL;
+
+		int nChars = 0;
+		while ( nChars < maxChars - 1 && fh->m_nMappedPos < fh->m_nLength )
+		{
+			char c = fh->m_pMappedData[ fh->m_nMappedPos++ ];
+			pOutput[nChars++] = c;
+			if ( c == '\n' )
+				break;
+		}
+
+		pOutput[nChars] = 0;
+		m_Stats.nBytesRead += nChars;
+		return pOutput;
+	}
+
 	char* s = FS_fgets( pOutput, maxChars, fh->m_pFile  ); // STEAM ???
 
 	if( s )
@@ -1468,9 +1626,17 @@ long CBaseFileSystem::GetFileTime( const char *pFileName, const char *pPathID )
 	CUtlSymbol id = g_PathIDTable.AddString( pPathID );
 
 	VPROF_BUDGET( "CBaseFileSystem::GetFileTime", VPROF_BUDGETGROUP_OTHER_FILESYSTEM );
-	int i;
-	for( i = 0; i < m_SearchPaths.Count(); i++ )
+	if ( m_bRecordingLookups )
+	{
+		RecordLookup( LOOKUP_FILETIME, pFileName, pPathID );
+	}
+
+	int *pCandidates = ( int * )_alloca( ( m_SearchPaths.Count() + 1 ) * sizeof( int ) );
+	int nCandidates = GetSearchPathCandidates( pFileName, pCandidates );
+	int iCandidate;
+	for( iCandidate = 0; iCandidate < nCandidates; iCandidate++ )
 	{
+		int i = pCandidates[iCandidate];
 		if ( pPathID && m_SearchPaths[i].m_PathID != id )
 			continue;
 
@@ -1528,9 +1694,17 @@ bool CBaseFileSystem::FileExists( const char *pFileName, const char *pPathID )
 		lookup = g_PathIDTable.AddString( pPathID );
 	}
 
-	int i;
-	for( i = 0; i < m_SearchPaths.Count(); i++ )
+	if ( m_bRecordingLookups )
+	{
+		RecordLookup( LOOKUP_FILEEXISTS, pFileName, pPathID );
+	}
+
+	int *pCandidates = ( int * )_alloca( ( m_SearchPaths.Count() + 1 ) * sizeof( int ) );
+	int nCandidates = GetSearchPathCandidates( pFileName, pCandidates );
+	int iCandidate;
+	for( iCandidate = 0; iCandidate < nCandidates; iCandidate++ )
 	{
+		int i = pCandidates[iCandidate];
 		if (pPathID && m_SearchPaths[i].m_PathID != lookup)
 			continue;
 
@@ -2023,6 +2197,10 @@ void CBaseFileSystem::RemoveFile( char const* pRelativePath, const char *pathID
 	{
 		Warning( FILESYSTEM_WARNING, "Unable to remove %s!\n", s_pScratchFileName );
 	}
+	else
+	{
+		NotePathIndexFileChanged( s_pScratchFileName, false );
+	}
 }
 
 
@@ -2043,6 +2221,11 @@ void CBaseFileSystem::RenameFile( char const *pOldPath, char const *pNewPath, co
 	{
 		Warning( FILESYSTEM_WARNING, "Unable to rename %s to %s!\n", s_pScratchFileName, pNewFileName );
 	}
+	else
+	{
+		NotePathIndexFileChanged( s_pScratchFileName, false );
+		NotePathIndexFileChanged( pNewFileName, true );
+	}
 }
 
 
@@ -2228,6 +2411,11 @@ CBaseFileSystem::CSearchPath::CSearchPath( void )
 	m_bIsMapPath		= false;
 	m_lPackFileTime		= 0L;
 	m_nNumPackFiles		= 0;
+	m_hPackFile			= NULL;
+	m_pPackMapping		= NULL;
+	m_nPackMappingSize	= 0;
+	m_hPackMapping		= NULL;
+	m_PackFullPath		= g_PathIDTable.AddString( "" );
 }
 
 //-----------------------------------------------------------------------------
@@ -2242,6 +2430,11 @@ CBaseFileSystem::CSearchPath::~CSearchPath( void )
 
 		m_fs->Close( (FileHandle_t)m_hPackFile );
 	}
+
+	if ( m_pPackMapping )
+	{
+		m_fs->FS_UnmapFile( m_pPackMapping, m_nPackMappingSize, m_hPackMapping );
+	}
 }
 
 
@@ -2260,6 +2453,25 @@ void CBaseFileSystem::UnloadModule( CSysModule *pModule )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Zero-copy access to files in memory-mapped pack files. Returns NULL
+//  for everything else, and the caller falls back to Read().
+//-----------------------------------------------------------------------------
+const void *CBaseFileSystem::GetReadOnlyFileData( FileHandle_t file, unsigned int *pSize )
+{
+	CFileHandle *fh = ( CFileHandle *)file;
+	if ( !fh || !fh->m_pMappedData )
+		return NULL;
+
+	if ( pSize )
+	{
+		*pSize = fh->m_nLength;
+	}
+
+	return fh->m_pMappedData;
+}
+
+
 //-----------------------------------------------------------------------------
 // Fixes slashes in the directory name
 //-----------------------------------------------------------------------------
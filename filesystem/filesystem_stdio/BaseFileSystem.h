@@ -66,6 +66,7 @@
 #endif	//_WIN32
 
 
+class CAsyncReader;
 
 class CBaseFileSystem : public IFileSystem
 {
@@ -149,6 +150,15 @@ public:
 	virtual CSysModule 			*LoadModule( const char *path );
 	virtual void				UnloadModule( CSysModule *pModule );
 
+	virtual const void			*GetReadOnlyFileData( FileHandle_t file, unsigned int *pSize );
+
+	// Asynchronous reads (see FileSystemAsync.cpp)
+	virtual FSAsyncStatus_t		AsyncRead( const FileAsyncRequest_t &request, FSAsyncControl_t *pControl );
+	virtual FSAsyncStatus_t		AsyncFinish( FSAsyncControl_t control, bool bWait, void **ppData, int *pnBytesRead );
+	virtual FSAsyncStatus_t		AsyncAbort( FSAsyncControl_t control );
+	virtual void				AsyncSetPriority( FSAsyncControl_t control, int newPriority );
+	virtual void				AsyncRelease( FSAsyncControl_t control );
+
 protected:
 	// IMPLEMENTATION DETAILS FOR CBaseFileSystem 
 	struct FindData_t
@@ -169,6 +179,8 @@ protected:
 			m_nLength = 0;
 			m_nFileTime = 0;
 			m_bPack = false;
+			m_pMappedData = NULL;
+			m_nMappedPos = 0;
 		}
 
 		FILE			*m_pFile;
@@ -176,11 +188,17 @@ protected:
 		int				m_nStartOffset;
 		int				m_nLength;
 		long			m_nFileTime;
+
+		// If the file is in a memory-mapped pack file, this points at its data and
+		// reads come straight from memory instead of going through m_pFile.
+		const unsigned char	*m_pMappedData;
+		int				m_nMappedPos;
 	};
 
 	enum
 	{
 		MAX_FILES_IN_PACK = 32768,
+		MAX_MAPPED_PACK_SIZE = 256 * 1024 * 1024,	// Bigger pack files are read through their FILE*.
 	};
 
 	class CPackFileEntry
@@ -211,6 +229,14 @@ protected:
 		CFileHandle			*m_hPackFile;
 		int					m_nNumPackFiles;
 
+		// The whole pack file (or .bsp) if it could be memory-mapped.
+		const unsigned char	*m_pPackMapping;
+		unsigned int		m_nPackMappingSize;
+		void				*m_hPackMapping;
+
+		// The pack file (or .bsp) on disk. The async I/O threads open their own handles to it.
+		CUtlSymbol			m_PackFullPath;
+
 		CUtlRBTree< CPackFileEntry, int > m_PackFiles;
 
 		static CBaseFileSystem*	m_fs;
@@ -224,6 +250,7 @@ protected:
 	CUtlVector< CSearchPath > m_SearchPaths;
 	FILE *m_pLogFile;
 	bool m_bOutputDebugString;
+	bool m_bMapPackFiles;
 
 	// Statistics:
 	FileSystemStatistics m_Stats;
@@ -248,6 +275,15 @@ protected:
 	virtual bool FS_FindNextFile(HANDLE handle, WIN32_FIND_DATA *dat) = 0;
 	virtual bool FS_FindClose(HANDLE handle) = 0;
 
+	// Maps a whole file into memory read-only. Implementations that can't return NULL
+	// and pack files are read through their FILE* instead.
+	virtual const unsigned char *FS_MapFile( const char *path, unsigned int &size, void *&hMapping ) { return NULL; }
+	virtual void FS_UnmapFile( const unsigned char *pData, unsigned int size, void *hMapping ) {}
+
+	// Returns true if FS_fopen, FS_fseek, FS_fread, and FS_fclose can be called from the async
+	// I/O threads. If not, async reads are done as soon as they're queued.
+	virtual bool FS_CanReadInBackground() { return false; }
+
 protected:
 	//-----------------------------------------------------------------------------
 	// Purpose: For tracking unclosed files
@@ -297,6 +333,7 @@ protected:
 	void						AddMapPackFile( const char *pPath, SearchPathAdd_t addType );
 	void						AddPackFiles( const char *pPath, SearchPathAdd_t addType );
 	bool						PreparePackFile( CSearchPath& packfile, int offsetofpackinmetafile, int filelen );
+	void						MapPackFile( CSearchPath& packfile, const char *pFullPath );
 	void						PrintSearchPaths( void );
 
 	FileHandle_t				FindFile( const CSearchPath *path, const char *pFileName, const char *pOptions );
@@ -312,6 +349,115 @@ protected:
 	FileHandle_t OpenForWrite( const char *pFileName, const char *pOptions, const char *pathID );
 	CSearchPath *FindWritePath( const char *pathID );
 
+protected:
+	//----------------------------------------------------------------------------
+	// Purpose: Path index (see PathIndex.cpp). Maps a normalized relative filename
+	//  to the search paths that have it so lookups only probe those paths instead
+	//  of trying every search path in turn.
+	//----------------------------------------------------------------------------
+	enum
+	{
+		MAX_INDEXED_LOOSE_DIRS = 32,		// One bit per directory in PathIndexEntry_t::m_LooseDirs.
+		MAX_INDEXED_LOOSE_FILES = 131072,	// Bigger directory trees are searched the old way.
+	};
+
+	struct PathIndexEntry_t
+	{
+		unsigned int	m_nHash;
+		int				m_iName;			// Offset into m_PathIndexNames.
+		int				m_iNext;			// Next entry in the same bucket.
+		int				m_iFirstPackHit;	// Into m_PathIndexPackHits. Rebuilt when the search paths change.
+		unsigned int	m_LooseDirs;		// Bit n is set if m_IndexedLooseDirs[n] has this file.
+	};
+
+	struct PathIndexPackHit_t
+	{
+		int				m_iSearchPath;
+		int				m_iNext;
+	};
+
+	struct IndexedLooseDir_t
+	{
+		CUtlSymbol		m_Path;
+		bool			m_bIndexed;			// False if it had too many files (it's always searched).
+		bool			m_bNeedsScan;		// Scan it again the next time the index is built.
+		double			m_flScanTime;		// Plat_FloatTime of the last scan.
+	};
+
+	void						InvalidatePathIndex( void );
+	void						RescanLooseDir( CUtlSymbol path );
+	void						PathIndexLevelLoadStarted( void );
+	void						PathIndexLevelLoadFinished( void );
+	void						BuildPathIndex( void );
+	void						PurgePathIndex( void );
+	int							GetSearchPathCandidates( const char *pFileName, int *pCandidates );
+	int							FindPathIndexEntry( const char *pName, unsigned int nHash );
+	int							FindOrAddPathIndexEntry( const char *pName );
+	int							FindOrIndexLooseDir( CUtlSymbol path );
+	void						ScanLooseDir( int iLooseDir );
+	bool						IndexLooseDirFiles( int iLooseDir, const char *pRoot, const char *pRelativeDir, int &nFiles );
+	void						NotePathIndexFileChanged( const char *pFullPath, bool bExists );
+
+	bool						m_bPathIndexEnabled;
+	bool						m_bPathIndexDirty;
+	bool						m_bLevelLoading;		// Loose directory misses are trusted while this is set.
+	CUtlVector<int>				m_PathIndexBuckets;
+	CUtlVector<PathIndexEntry_t> m_PathIndexEntries;
+	CUtlVector<char>			m_PathIndexNames;
+	CUtlVector<PathIndexPackHit_t> m_PathIndexPackHits;
+	CUtlVector<IndexedLooseDir_t> m_IndexedLooseDirs;
+	CUtlVector<int>				m_SearchPathLooseDirs;	// m_IndexedLooseDirs index for each search path, -1 for pack files.
+	int							m_nPathProbes;			// FindFile/FastFindFile calls, for the benchmark.
+
+	//----------------------------------------------------------------------------
+	// Purpose: -fs_benchmark. Lookups made between LogLevelLoadStarted and
+	//  LogLevelLoadFinished are recorded, then replayed with and without the
+	//  path index when the level is done loading.
+	//----------------------------------------------------------------------------
+	enum LookupType_t
+	{
+		LOOKUP_OPEN = 0,
+		LOOKUP_FILEEXISTS,
+		LOOKUP_SIZE,
+		LOOKUP_FILETIME,
+	};
+
+	struct RecordedLookup_t
+	{
+		LookupType_t	m_Type;
+		int				m_iName;			// Offsets into m_RecordedLookupStrings.
+		int				m_iPathID;			// -1 if there wasn't one.
+	};
+
+	void						BeginLookupRecording( void );
+	void						FinishLookupRecording( const char *pLevelName );
+	void						RecordLookup( LookupType_t type, const char *pFileName, const char *pPathID );
+	float						ReplayRecordedLookups( int nIterations );
+
+	bool						m_bRecordingLookups;
+	CUtlVector<RecordedLookup_t> m_RecordedLookups;
+	CUtlVector<char>			m_RecordedLookupStrings;
+	float						m_flLooseDirIndexTime;
+	int							m_nLooseDirIndexFiles;
+
+protected:
+	//----------------------------------------------------------------------------
+	// Purpose: Asynchronous reads (see FileSystemAsync.cpp). Requests are looked
+	//  up on the calling thread and read by CAsyncReader's I/O threads.
+	//----------------------------------------------------------------------------
+	struct FileLocation_t
+	{
+		char					m_FullPath[MAX_PATH];	// The loose file, or the pack file it's in.
+		int						m_nStartOffset;
+		int						m_nLength;
+		bool					m_bPackFile;
+	};
+
+	bool						ResolveFileLocation( const char *pFileName, const char *pPathID, FileLocation_t &location );
+	void						ShutdownAsyncReader( void );
+
+	friend class CAsyncReader;
+	CAsyncReader				*m_pAsyncReader;
 };
 
 // singleton accessor
@@ -0,0 +1,830 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Asynchronous reads for CBaseFileSystem. Requests are queued by
+//			priority and read by a small pool of I/O threads. Requests for
+//			bytes that are next to each other in the same file (the lumps of a
+//			.bsp, or files stored together in a pack file) are read with one
+//			seek and one read.
+//
+//			The file is looked up on the calling thread, so AsyncRead has to be
+//			called from the thread that uses the rest of the filesystem. Only
+//			the reads happen in the background. Without I/O threads (Linux,
+//			Steam, or -fs_asyncthreads 0) requests are read inside AsyncRead.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "BaseFileSystem.h"
+#include "tier0/dbg.h"
+#include "vstdlib/ICommandLine.h"
+#include "vstdlib/strtools.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+#define FS_ASYNC_DEFAULT_THREADS		2
+#define FS_ASYNC_MAX_THREADS			8
+#define FS_ASYNC_MAX_COALESCE_BYTES		(1024*1024)	// Biggest single read made out of several requests.
+#define FS_ASYNC_MAX_COALESCE_REQUESTS	32
+#define FS_ASYNC_MAX_IDLE_PACK_FILES	8			// Pack files kept open after their last request is done.
+#define FS_ASYNC_WAIT_PRIORITY			0x7fffffff	// Requests someone is blocked on go to the front of the queue.
+
+
+extern CUtlSymbolTableMT g_PathIDTable;
+
+
+//-----------------------------------------------------------------------------
+// A file the I/O threads read from. All the requests for files in the same
+// pack file share one of these.
+//-----------------------------------------------------------------------------
+struct AsyncFile_t
+{
+	char			m_FullPath[MAX_PATH];
+	FILE			*m_pFile;			// Opened by the first I/O thread that reads from it.
+	bool			m_bPackFile;		// Loose files are closed as soon as they're not in use.
+	bool			m_bOpenFailed;
+	bool			m_bBusy;			// An I/O thread is reading from it.
+	int				m_nRefs;			// Requests that haven't finished yet.
+	unsigned int	m_nLastUsed;
+};
+
+
+//-----------------------------------------------------------------------------
+// A queued read. FSAsyncControl_t handles point at these.
+//-----------------------------------------------------------------------------
+struct AsyncRequest_t
+{
+	FileAsyncRequest_t	m_Request;			// pszFilename and pszPathID point at the copies below.
+	char				m_Filename[MAX_PATH];
+	char				m_PathID[MAX_PATH];
+	AsyncFile_t			*m_pFile;
+	int					m_nFileOffset;		// Where the read starts in m_pFile.
+	int					m_nBytes;
+	bool				m_bAllocatedData;	// The filesystem malloced m_Request.pData.
+	unsigned int		m_nSequence;
+	int					m_nBytesRead;
+	int					m_nRefs;			// One for the queue and one for the control handle.
+	volatile FSAsyncStatus_t m_Status;
+#ifdef _WIN32
+	HANDLE				m_hDoneEvent;
+#endif
+};
+
+
+//-----------------------------------------------------------------------------
+// The queue and the I/O threads.
+//-----------------------------------------------------------------------------
+class CAsyncReader
+{
+public:
+						CAsyncReader( CBaseFileSystem *pFileSystem );
+						~CAsyncReader();
+
+	FSAsyncStatus_t		Read( const FileAsyncRequest_t &request, FSAsyncControl_t *pControl );
+	FSAsyncStatus_t		Finish( AsyncRequest_t *pRequest, bool bWait, void **ppData, int *pnBytesRead );
+	FSAsyncStatus_t		Abort( AsyncRequest_t *pRequest );
+	void				SetPriority( AsyncRequest_t *pRequest, int priority );
+	void				Release( AsyncRequest_t *pRequest );
+
+private:
+	void				Lock();
+	void				Unlock();
+	void				StartThreads();
+	void				StopThreads();
+
+	// These are called with the lock held.
+	AsyncFile_t			*AddFileRef( const char *pFullPath, bool bPackFile );
+	void				ReleaseFileRef( AsyncFile_t *pFile );
+	void				ReleaseRequest( AsyncRequest_t *pRequest );
+	int					TakeRequests( AsyncRequest_t **ppBatch );
+
+	// Reads the most important request (and any that can go along with it). Returns false
+	// if there's nothing that can be read right now.
+	bool				ServiceRequests();
+	void				CompleteRequest( AsyncRequest_t *pRequest, int nBytesRead, FSAsyncStatus_t status );
+	void				WaitForRequest( AsyncRequest_t *pRequest );
+
+#ifdef _WIN32
+	static DWORD WINAPI	StaticThreadFn( LPVOID pParameter );
+	DWORD				ThreadFn();
+#endif
+
+private:
+	CBaseFileSystem		*m_pFileSystem;
+	CUtlVector<AsyncRequest_t*> m_Pending;		// In the order they were queued.
+	CUtlVector<AsyncFile_t*> m_Files;
+	unsigned int		m_nNextSequence;
+	int					m_nThreads;
+
+#ifdef _WIN32
+	CRITICAL_SECTION	m_CS;
+	HANDLE				m_hWorkSemaphore;		// Released once for each request that's queued.
+	HANDLE				m_hThreads[FS_ASYNC_MAX_THREADS];
+	volatile bool		m_bShutdown;
+#endif
+};
+
+
+CAsyncReader::CAsyncReader( CBaseFileSystem *pFileSystem )
+{
+	m_pFileSystem = pFileSystem;
+	m_nNextSequence = 0;
+	m_nThreads = 0;
+
+#ifdef _WIN32
+	InitializeCriticalSection( &m_CS );
+	m_hWorkSemaphore = NULL;
+	m_bShutdown = false;
+
+	if ( m_pFileSystem->FS_CanReadInBackground() )
+	{
+		StartThreads();
+	}
+#endif
+}
+
+
+CAsyncReader::~CAsyncReader()
+{
+	StopThreads();
+
+	// Nothing is going to read what's left.
+	while ( m_Pending.Count() )
+	{
+		AsyncRequest_t *pRequest = m_Pending[0];
+		m_Pending.Remove( 0 );
+		CompleteRequest( pRequest, 0, FSASYNC_STATUS_ABORTED );
+	}
+
+	for ( int i=0; i < m_Files.Count(); i++ )
+	{
+		if ( m_Files[i]->m_pFile )
+		{
+			m_pFileSystem->FS_fclose( m_Files[i]->m_pFile );
+		}
+		delete m_Files[i];
+	}
+	m_Files.Purge();
+
+#ifdef _WIN32
+	DeleteCriticalSection( &m_CS );
+#endif
+}
+
+
+void CAsyncReader::Lock()
+{
+#ifdef _WIN32
+	EnterCriticalSection( &m_CS );
+#endif
+}
+
+
+void CAsyncReader::Unlock()
+{
+#ifdef _WIN32
+	LeaveCriticalSection( &m_CS );
+#endif
+}
+
+
+void CAsyncReader::StartThreads()
+{
+#ifdef _WIN32
+	int nThreads = CommandLine()->ParmValue( "-fs_asyncthreads", FS_ASYNC_DEFAULT_THREADS );
+	if ( nThreads > FS_ASYNC_MAX_THREADS )
+	{
+		nThreads = FS_ASYNC_MAX_THREADS;
+	}
+	if ( nThreads <= 0 )
+		return;
+
+	m_hWorkSemaphore = CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+	if ( !m_hWorkSemaphore )
+		return;
+
+	for ( int i=0; i < nThreads; i++ )
+	{
+		DWORD dwThreadID = 0;
+		HANDLE hThread = CreateThread( NULL, 0, &CAsyncReader::StaticThreadFn, this, 0, &dwThreadID );
+		if ( !hThread )
+			break;
+
+		m_hThreads[m_nThreads++] = hThread;
+	}
+
+	if ( !m_nThreads )
+	{
+		CloseHandle( m_hWorkSemaphore );
+		m_hWorkSemaphore = NULL;
+	}
+#endif
+}
+
+
+void CAsyncReader::StopThreads()
+{
+#ifdef _WIN32
+	if ( !m_nThreads )
+		return;
+
+	m_bShutdown = true;
+	ReleaseSemaphore( m_hWorkSemaphore, m_nThreads, NULL );
+	WaitForMultipleObjects( m_nThreads, m_hThreads, TRUE, INFINITE );
+
+	for ( int i=0; i < m_nThreads; i++ )
+	{
+		CloseHandle( m_hThreads[i] );
+	}
+	m_nThreads = 0;
+
+	CloseHandle( m_hWorkSemaphore );
+	m_hWorkSemaphore = NULL;
+#endif
+}
+
+
+#ifdef _WIN32
+DWORD WINAPI CAsyncReader::StaticThreadFn( LPVOID pParameter )
+{
+	return ((CAsyncReader*)pParameter)->ThreadFn();
+}
+
+
+DWORD CAsyncReader::ThreadFn()
+{
+	while ( 1 )
+	{
+		WaitForSingleObject( m_hWorkSemaphore, INFINITE );
+		if ( m_bShutdown )
+			break;
+
+		// Keep going while there's work. Requests skipped because another thread had
+		// their file busy get picked up by that thread when it comes back around.
+		while ( !m_bShutdown && ServiceRequests() )
+		{
+		}
+	}
+
+	return 0;
+}
+#endif
+
+
+AsyncFile_t *CAsyncReader::AddFileRef( const char *pFullPath, bool bPackFile )
+{
+	for ( int i=0; i < m_Files.Count(); i++ )
+	{
+		if ( !Q_stricmp( m_Files[i]->m_FullPath, pFullPath ) )
+		{
+			m_Files[i]->m_nRefs++;
+			return m_Files[i];
+		}
+	}
+
+	AsyncFile_t *pFile = new AsyncFile_t;
+	Q_strncpy( pFile->m_FullPath, pFullPath, sizeof( pFile->m_FullPath ) );
+	pFile->m_pFile = NULL;
+	pFile->m_bPackFile = bPackFile;
+	pFile->m_bOpenFailed = false;
+	pFile->m_bBusy = false;
+	pFile->m_nRefs = 1;
+	pFile->m_nLastUsed = m_nNextSequence;
+	m_Files.AddToTail( pFile );
+	return pFile;
+}
+
+
+void CAsyncReader::ReleaseFileRef( AsyncFile_t *pFile )
+{
+	pFile->m_nLastUsed = m_nNextSequence;
+	if ( --pFile->m_nRefs > 0 )
+		return;
+
+	// Loose files are closed right away so they can be written, renamed, or deleted. A few
+	// pack files are kept open since most async reads come out of the same couple of packs.
+	int iClose = -1;
+	if ( !pFile->m_bPackFile )
+	{
+		iClose = m_Files.Find( pFile );
+	}
+	else
+	{
+		int nIdle = 0;
+		for ( int i=0; i < m_Files.Count(); i++ )
+		{
+			AsyncFile_t *pIdle = m_Files[i];
+			if ( pIdle->m_nRefs || pIdle->m_bBusy || !pIdle->m_bPackFile )
+				continue;
+
+			nIdle++;
+			if ( iClose == -1 || pIdle->m_nLastUsed < m_Files[iClose]->m_nLastUsed )
+			{
+				iClose = i;
+			}
+		}
+
+		if ( nIdle <= FS_ASYNC_MAX_IDLE_PACK_FILES )
+			return;
+	}
+
+	if ( iClose == -1 )
+		return;
+
+	if ( m_Files[iClose]->m_pFile )
+	{
+		m_pFileSystem->FS_fclose( m_Files[iClose]->m_pFile );
+	}
+	delete m_Files[iClose];
+	m_Files.Remove( iClose );
+}
+
+
+void CAsyncReader::ReleaseRequest( AsyncRequest_t *pRequest )
+{
+	if ( --pRequest->m_nRefs > 0 )
+		return;
+
+#ifdef _WIN32
+	if ( pRequest->m_hDoneEvent )
+	{
+		CloseHandle( pRequest->m_hDoneEvent );
+	}
+#endif
+	delete pRequest;
+}
+
+
+//-----------------------------------------------------------------------------
+// Takes the most important request that isn't in a busy file off the queue,
+// plus any other requests that are right before or after it in the same file.
+// The batch comes back sorted by file offset.
+//-----------------------------------------------------------------------------
+int CAsyncReader::TakeRequests( AsyncRequest_t **ppBatch )
+{
+	// m_Pending is in the order things were queued, so the first one found wins ties.
+	int iBest = -1;
+	int i;
+	for ( i=0; i < m_Pending.Count(); i++ )
+	{
+		if ( m_Pending[i]->m_pFile->m_bBusy )
+			continue;
+
+		if ( iBest == -1 || m_Pending[i]->m_Request.priority > m_Pending[iBest]->m_Request.priority )
+		{
+			iBest = i;
+		}
+	}
+
+	if ( iBest == -1 )
+		return 0;
+
+	AsyncFile_t *pFile = m_Pending[iBest]->m_pFile;
+	int nStart = m_Pending[iBest]->m_nFileOffset;
+	int nEnd = nStart + m_Pending[iBest]->m_nBytes;
+	int nBatch = 1;
+	ppBatch[0] = m_Pending[iBest];
+	m_Pending.Remove( iBest );
+
+	bool bGrew = true;
+	while ( bGrew && nBatch < FS_ASYNC_MAX_COALESCE_REQUESTS )
+	{
+		bGrew = false;
+		for ( i=0; i < m_Pending.Count(); i++ )
+		{
+			AsyncRequest_t *pRequest = m_Pending[i];
+			if ( pRequest->m_pFile != pFile || nEnd - nStart + pRequest->m_nBytes > FS_ASYNC_MAX_COALESCE_BYTES )
+				continue;
+
+			if ( pRequest->m_nFileOffset == nEnd )
+			{
+				ppBatch[nBatch++] = pRequest;
+				nEnd += pRequest->m_nBytes;
+			}
+			else if ( pRequest->m_nFileOffset + pRequest->m_nBytes == nStart )
+			{
+				memmove( &ppBatch[1], &ppBatch[0], nBatch * sizeof( ppBatch[0] ) );
+				ppBatch[0] = pRequest;
+				nBatch++;
+				nStart = pRequest->m_nFileOffset;
+			}
+			else
+			{
+				continue;
+			}
+
+			m_Pending.Remove( i );
+			bGrew = true;
+			break;
+		}
+	}
+
+	pFile->m_bBusy = true;
+	for ( i=0; i < nBatch; i++ )
+	{
+		ppBatch[i]->m_Status = FSASYNC_STATUS_INPROGRESS;
+	}
+
+	return nBatch;
+}
+
+
+bool CAsyncReader::ServiceRequests()
+{
+	AsyncRequest_t *pBatch[FS_ASYNC_MAX_COALESCE_REQUESTS];
+
+	Lock();
+	int nBatch = TakeRequests( pBatch );
+	Unlock();
+
+	if ( !nBatch )
+		return false;
+
+	// Nobody else touches the file while it's marked busy.
+	AsyncFile_t *pFile = pBatch[0]->m_pFile;
+	if ( !pFile->m_pFile && !pFile->m_bOpenFailed )
+	{
+		pFile->m_pFile = m_pFileSystem->FS_fopen( pFile->m_FullPath, "rb" );
+		pFile->m_bOpenFailed = ( pFile->m_pFile == NULL );
+	}
+
+	int nStart = pBatch[0]->m_nFileOffset;
+	int nEnd = pBatch[nBatch-1]->m_nFileOffset + pBatch[nBatch-1]->m_nBytes;
+	int nRead = -1;
+	unsigned char *pBuffer = NULL;
+	if ( pFile->m_pFile )
+	{
+		// A single request goes straight into its own buffer.
+		if ( nBatch == 1 )
+		{
+			pBuffer = (unsigned char*)pBatch[0]->m_Request.pData;
+		}
+		else
+		{
+			pBuffer = (unsigned char*)malloc( nEnd - nStart );
+		}
+
+		m_pFileSystem->FS_fseek( pFile->m_pFile, nStart, SEEK_SET );
+		nRead = (int)m_pFileSystem->FS_fread( pBuffer, 1, nEnd - nStart, pFile->m_pFile );
+	}
+
+	Lock();
+	pFile->m_bBusy = false;
+	Unlock();
+
+	for ( int i=0; i < nBatch; i++ )
+	{
+		AsyncRequest_t *pRequest = pBatch[i];
+		if ( nRead < 0 )
+		{
+			CompleteRequest( pRequest, 0, FSASYNC_ERR_FILEOPEN );
+			continue;
+		}
+
+		int nGot = nRead - ( pRequest->m_nFileOffset - nStart );
+		if ( nGot > pRequest->m_nBytes )
+		{
+			nGot = pRequest->m_nBytes;
+		}
+		if ( nGot < 0 )
+		{
+			nGot = 0;
+		}
+
+		if ( nBatch > 1 && nGot > 0 )
+		{
+			memcpy( pRequest->m_Request.pData, &pBuffer[pRequest->m_nFileOffset - nStart], nGot );
+		}
+
+		CompleteRequest( pRequest, nGot, ( nGot == pRequest->m_nBytes ) ? FSASYNC_OK : FSASYNC_ERR_READING );
+	}
+
+	if ( nBatch > 1 && pBuffer )
+	{
+		free( pBuffer );
+	}
+
+	return true;
+}
+
+
+void CAsyncReader::CompleteRequest( AsyncRequest_t *pRequest, int nBytesRead, FSAsyncStatus_t status )
+{
+	if ( status == FSASYNC_STATUS_ABORTED && pRequest->m_bAllocatedData )
+	{
+		free( pRequest->m_Request.pData );
+		pRequest->m_Request.pData = NULL;
+	}
+
+	pRequest->m_nBytesRead = nBytesRead;
+
+	// The callback runs before the status changes, so anyone who sees the read
+	// finished knows the callback is done too.
+	if ( pRequest->m_Request.pfnCallback )
+	{
+		pRequest->m_Request.pfnCallback( pRequest->m_Request, nBytesRead, status );
+	}
+
+	Lock();
+	pRequest->m_Status = status;
+	ReleaseFileRef( pRequest->m_pFile );
+	pRequest->m_pFile = NULL;
+#ifdef _WIN32
+	if ( pRequest->m_hDoneEvent )
+	{
+		SetEvent( pRequest->m_hDoneEvent );
+	}
+#endif
+	ReleaseRequest( pRequest );
+	Unlock();
+}
+
+
+void CAsyncReader::WaitForRequest( AsyncRequest_t *pRequest )
+{
+	Lock();
+	if ( pRequest->m_Status == FSASYNC_STATUS_PENDING )
+	{
+		pRequest->m_Request.priority = FS_ASYNC_WAIT_PRIORITY;
+	}
+	Unlock();
+
+#ifdef _WIN32
+	if ( m_nThreads )
+	{
+		WaitForSingleObject( pRequest->m_hDoneEvent, INFINITE );
+		return;
+	}
+#endif
+
+	// Without threads, everything was read when it was queued.
+	Assert( pRequest->m_Status != FSASYNC_STATUS_PENDING && pRequest->m_Status != FSASYNC_STATUS_INPROGRESS );
+}
+
+
+FSAsyncStatus_t CAsyncReader::Read( const FileAsyncRequest_t &request, FSAsyncControl_t *pControl )
+{
+	if ( pControl )
+	{
+		*pControl = NULL;
+	}
+
+	CBaseFileSystem::FileLocation_t location;
+	if ( !request.pszFilename || !m_pFileSystem->ResolveFileLocation( request.pszFilename, request.pszPathID, location ) )
+		return FSASYNC_ERR_FILEOPEN;
+
+	if ( request.nOffset < 0 || request.nOffset > location.m_nLength )
+		return FSASYNC_ERR_READING;
+
+	int nBytes = location.m_nLength - request.nOffset;
+	if ( request.nBytes > 0 && request.nBytes < nBytes )
+	{
+		nBytes = request.nBytes;
+	}
+
+	AsyncRequest_t *pRequest = new AsyncRequest_t;
+	pRequest->m_Request = request;
+	Q_strncpy( pRequest->m_Filename, request.pszFilename, sizeof( pRequest->m_Filename ) );
+	pRequest->m_Request.pszFilename = pRequest->m_Filename;
+	if ( request.pszPathID )
+	{
+		Q_strncpy( pRequest->m_PathID, request.pszPathID, sizeof( pRequest->m_PathID ) );
+		pRequest->m_Request.pszPathID = pRequest->m_PathID;
+	}
+
+	pRequest->m_nFileOffset = location.m_nStartOffset + request.nOffset;
+	pRequest->m_nBytes = nBytes;
+	pRequest->m_bAllocatedData = false;
+	if ( !pRequest->m_Request.pData )
+	{
+		pRequest->m_Request.pData = malloc( nBytes ? nBytes : 1 );
+		pRequest->m_bAllocatedData = true;
+	}
+	pRequest->m_nBytesRead = 0;
+	pRequest->m_nRefs = pControl ? 2 : 1;
+	pRequest->m_Status = FSASYNC_STATUS_PENDING;
+#ifdef _WIN32
+	pRequest->m_hDoneEvent = m_nThreads ? CreateEvent( NULL, TRUE, FALSE, NULL ) : NULL;
+#endif
+
+	Lock();
+	pRequest->m_pFile = AddFileRef( location.m_FullPath, location.m_bPackFile );
+	pRequest->m_nSequence = m_nNextSequence++;
+	m_Pending.AddToTail( pRequest );
+	Unlock();
+
+	if ( pControl )
+	{
+		*pControl = (FSAsyncControl_t)pRequest;
+	}
+
+#ifdef _WIN32
+	if ( m_nThreads )
+	{
+		ReleaseSemaphore( m_hWorkSemaphore, 1, NULL );
+		return FSASYNC_OK;
+	}
+#endif
+
+	// No I/O threads, so read it now.
+	while ( ServiceRequests() )
+	{
+	}
+
+	return FSASYNC_OK;
+}
+
+
+FSAsyncStatus_t CAsyncReader::Finish( AsyncRequest_t *pRequest, bool bWait, void **ppData, int *pnBytesRead )
+{
+	if ( bWait )
+	{
+		WaitForRequest( pRequest );
+	}
+
+	FSAsyncStatus_t status = pRequest->m_Status;
+	if ( status == FSASYNC_OK || status == FSASYNC_ERR_READING )
+	{
+		if ( ppData )
+		{
+			*ppData = pRequest->m_Request.pData;
+		}
+		if ( pnBytesRead )
+		{
+			*pnBytesRead = pRequest->m_nBytesRead;
+		}
+	}
+
+	return status;
+}
+
+
+FSAsyncStatus_t CAsyncReader::Abort( AsyncRequest_t *pRequest )
+{
+	Lock();
+	int i = m_Pending.Find( pRequest );
+	if ( i != -1 )
+	{
+		m_Pending.Remove( i );
+		Unlock();
+
+		CompleteRequest( pRequest, 0, FSASYNC_STATUS_ABORTED );
+		return FSASYNC_STATUS_ABORTED;
+	}
+	Unlock();
+
+	// It's already being read (or it's done).
+	WaitForRequest( pRequest );
+	return pRequest->m_Status;
+}
+
+
+void CAsyncReader::SetPriority( AsyncRequest_t *pRequest, int priority )
+{
+	Lock();
+	pRequest->m_Request.priority = priority;
+	Unlock();
+}
+
+
+void CAsyncReader::Release( AsyncRequest_t *pRequest )
+{
+	Lock();
+	ReleaseRequest( pRequest );
+	Unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds where a file's bytes are without opening it: the loose file,
+//  or the pack file it's in and where it starts in there.
+//-----------------------------------------------------------------------------
+bool CBaseFileSystem::ResolveFileLocation( const char *pFileName, const char *pPathID, FileLocation_t &location )
+{
+	// Allow for UNC-type syntax to specify the path ID.
+	char tempPathID[MAX_PATH];
+	ParsePathID( pFileName, pPathID, tempPathID );
+
+	CUtlSymbol id = g_PathIDTable.AddString( pPathID );
+	int *pCandidates = ( int * )_alloca( ( m_SearchPaths.Count() + 1 ) * sizeof( int ) );
+	int nCandidates = GetSearchPathCandidates( pFileName, pCandidates );
+	int iCandidate;
+	for ( iCandidate = 0; iCandidate < nCandidates; iCandidate++ )
+	{
+		const CSearchPath *path = &m_SearchPaths[ pCandidates[iCandidate] ];
+		if ( pPathID && path->m_PathID != id )
+			continue;
+
+		m_nPathProbes++;
+
+		if ( path->m_bIsPackFile )
+		{
+			CPackFileEntry search;
+			char *temp = (char *)_alloca( strlen( pFileName ) + 1 );
+			strcpy( temp, pFileName );
+			strlwr( temp );
+			search.m_Name = g_PathIDTable.AddString( temp );
+
+			int i = path->m_PackFiles.Find( search );
+			if ( i == path->m_PackFiles.InvalidIndex() )
+				continue;
+
+			Q_strncpy( location.m_FullPath, g_PathIDTable.String( path->m_PackFullPath ), sizeof( location.m_FullPath ) );
+			location.m_nStartOffset = path->m_PackFiles[i].m_nPosition;
+			location.m_nLength = path->m_PackFiles[i].m_nLength;
+			location.m_bPackFile = true;
+			return true;
+		}
+
+		// Is it an absolute path?
+		if ( strchr( pFileName, ':' ) )
+		{
+			Q_strncpy( location.m_FullPath, pFileName, sizeof( location.m_FullPath ) );
+		}
+		else
+		{
+			Q_snprintf( location.m_FullPath, sizeof( location.m_FullPath ), "%s%s", path->GetPathString(), pFileName );
+		}
+
+		for ( char *pSlash = location.m_FullPath; *pSlash; pSlash++ )
+		{
+			if ( *pSlash == INCORRECT_PATH_SEPARATOR )
+			{
+				*pSlash = CORRECT_PATH_SEPARATOR;
+			}
+		}
+
+		struct _stat buf;
+		if ( FS_stat( location.m_FullPath, &buf ) != -1 && !( buf.st_mode & _S_IFDIR ) )
+		{
+			location.m_nStartOffset = 0;
+			location.m_nLength = buf.st_size;
+			location.m_bPackFile = false;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Stops the I/O threads and aborts anything still queued. Control
+//  handles have to be released before this.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::ShutdownAsyncReader( void )
+{
+	if ( m_pAsyncReader )
+	{
+		delete m_pAsyncReader;
+		m_pAsyncReader = NULL;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// IFileSystem async methods. The reader (and its threads) are created the
+// first time something is queued.
+//-----------------------------------------------------------------------------
+FSAsyncStatus_t CBaseFileSystem::AsyncRead( const FileAsyncRequest_t &request, FSAsyncControl_t *pControl )
+{
+	if ( !m_pAsyncReader )
+	{
+		m_pAsyncReader = new CAsyncReader( this );
+	}
+
+	return m_pAsyncReader->Read( request, pControl );
+}
+
+FSAsyncStatus_t CBaseFileSystem::AsyncFinish( FSAsyncControl_t control, bool bWait, void **ppData, int *pnBytesRead )
+{
+	if ( !control || !m_pAsyncReader )
+		return FSASYNC_ERR_FILEOPEN;
+
+	return m_pAsyncReader->Finish( (AsyncRequest_t*)control, bWait, ppData, pnBytesRead );
+}
+
+FSAsyncStatus_t CBaseFileSystem::AsyncAbort( FSAsyncControl_t control )
+{
+	if ( !control || !m_pAsyncReader )
+		return FSASYNC_ERR_FILEOPEN;
+
+	return m_pAsyncReader->Abort( (AsyncRequest_t*)control );
+}
+
+void CBaseFileSystem::AsyncSetPriority( FSAsyncControl_t control, int newPriority )
+{
+	if ( control && m_pAsyncReader )
+	{
+		m_pAsyncReader->SetPriority( (AsyncRequest_t*)control, newPriority );
+	}
+}
+
+void CBaseFileSystem::AsyncRelease( FSAsyncControl_t control )
+{
+	if ( control && m_pAsyncReader )
+	{
+		m_pAsyncReader->Release( (AsyncRequest_t*)control );
+	}
+}
@@ -0,0 +1,634 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Path index for CBaseFileSystem. Every name in the pack files and
+//			loose search path directories is hashed once, so a lookup finds the
+//			search paths that have a file with one probe instead of trying an
+//			fopen or stat in every search path.
+//
+//			Loose directories are scanned the first time they're needed and
+//			again at the start of every level load, or when they're added back
+//			to the search path. Files written, removed, or renamed through the
+//			filesystem are updated in place. Other processes can add files at
+//			any time, so a miss in a loose directory is only trusted while a
+//			level is loading or for a few seconds after the scan. After that,
+//			the directory is probed like it would be without the index.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "BaseFileSystem.h"
+#include "tier0/dbg.h"
+#include "tier0/platform.h"
+#include "vstdlib/ICommandLine.h"
+#include "vstdlib/strtools.h"
+#include <ctype.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+#define FS_BENCHMARK_ITERATIONS		4
+#define FS_LOOSE_DIR_TRUST_TIME		5.0		// Seconds a loose directory scan can rule out a file outside of level loads.
+
+
+extern CUtlSymbolTableMT g_PathIDTable;
+
+
+//-----------------------------------------------------------------------------
+// Lowercases the name and makes all the slashes forward slashes. Returns false
+// for names the index can't answer for: absolute paths, "." and ".." components,
+// and anything that ends in a slash.
+//-----------------------------------------------------------------------------
+static bool NormalizeIndexName( const char *pIn, char *pOut, int maxLen )
+{
+	if ( !pIn[0] || PATHSEPARATOR( pIn[0] ) )
+		return false;
+
+	int len = 0;
+	int componentStart = 0;
+	for ( ;; pIn++ )
+	{
+		char c = *pIn;
+		if ( c == 0 || PATHSEPARATOR( c ) )
+		{
+			int componentLen = len - componentStart;
+			if ( componentLen == 0 )
+				return false;
+			if ( pOut[componentStart] == '.' && ( componentLen == 1 || ( componentLen == 2 && pOut[componentStart+1] == '.' ) ) )
+				return false;
+
+			if ( c == 0 )
+				break;
+
+			c = '/';
+			componentStart = len + 1;
+		}
+		else if ( c == ':' )
+		{
+			return false;
+		}
+		else
+		{
+			c = tolower( c );
+		}
+
+		if ( len >= maxLen - 1 )
+			return false;
+
+		pOut[len++] = c;
+	}
+
+	pOut[len] = 0;
+	return true;
+}
+
+
+static unsigned int HashIndexName( const char *pName )
+{
+	unsigned int nHash = 0;
+	while ( *pName )
+	{
+		nHash = nHash * 31 + (unsigned char)*pName++;
+	}
+	return nHash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The next lookup rebuilds the pack file part of the index and picks up
+//  new loose directories. Loose directories that were already scanned are kept.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::InvalidatePathIndex( void )
+{
+	m_bPathIndexDirty = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Makes the next lookup scan the loose directory again, if it was
+//  scanned before.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::RescanLooseDir( CUtlSymbol path )
+{
+	for ( int iLooseDir=0; iLooseDir < m_IndexedLooseDirs.Count(); iLooseDir++ )
+	{
+		if ( m_IndexedLooseDirs[iLooseDir].m_Path == path )
+		{
+			m_IndexedLooseDirs[iLooseDir].m_bNeedsScan = true;
+			m_bPathIndexDirty = true;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Called from LogLevelLoadStarted. The loose directories get scanned
+//  again, so anything added since the last level shows up, and misses are
+//  trusted until the level is done loading.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::PathIndexLevelLoadStarted( void )
+{
+	for ( int iLooseDir=0; iLooseDir < m_IndexedLooseDirs.Count(); iLooseDir++ )
+	{
+		m_IndexedLooseDirs[iLooseDir].m_bNeedsScan = true;
+	}
+
+	m_bPathIndexDirty = true;
+	m_bLevelLoading = true;
+}
+
+
+void CBaseFileSystem::PathIndexLevelLoadFinished( void )
+{
+	m_bLevelLoading = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Throws away everything, including the loose directory scans.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::PurgePathIndex( void )
+{
+	m_PathIndexBuckets.Purge();
+	m_PathIndexEntries.Purge();
+	m_PathIndexNames.Purge();
+	m_PathIndexPackHits.Purge();
+	m_IndexedLooseDirs.Purge();
+	m_SearchPathLooseDirs.Purge();
+	m_bPathIndexDirty = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the index of the entry for pName (already normalized), or -1.
+//-----------------------------------------------------------------------------
+int CBaseFileSystem::FindPathIndexEntry( const char *pName, unsigned int nHash )
+{
+	if ( m_PathIndexBuckets.Count() == 0 )
+		return -1;
+
+	int iEntry = m_PathIndexBuckets[ nHash & ( m_PathIndexBuckets.Count() - 1 ) ];
+	while ( iEntry != -1 )
+	{
+		PathIndexEntry_t *pEntry = &m_PathIndexEntries[iEntry];
+		if ( pEntry->m_nHash == nHash && !strcmp( &m_PathIndexNames[pEntry->m_iName], pName ) )
+			return iEntry;
+
+		iEntry = pEntry->m_iNext;
+	}
+
+	return -1;
+}
+
+
+int CBaseFileSystem::FindOrAddPathIndexEntry( const char *pName )
+{
+	unsigned int nHash = HashIndexName( pName );
+	int iEntry = FindPathIndexEntry( pName, nHash );
+	if ( iEntry != -1 )
+		return iEntry;
+
+	// Keep the chains short. The bucket count is always a power of two.
+	if ( m_PathIndexEntries.Count() >= m_PathIndexBuckets.Count() * 2 )
+	{
+		int nBuckets = m_PathIndexBuckets.Count() ? m_PathIndexBuckets.Count() * 4 : 1024;
+		m_PathIndexBuckets.SetSize( nBuckets );
+
+		int i;
+		for ( i=0; i < nBuckets; i++ )
+			m_PathIndexBuckets[i] = -1;
+
+		for ( i=0; i < m_PathIndexEntries.Count(); i++ )
+		{
+			int iBucket = m_PathIndexEntries[i].m_nHash & ( nBuckets - 1 );
+			m_PathIndexEntries[i].m_iNext = m_PathIndexBuckets[iBucket];
+			m_PathIndexBuckets[iBucket] = i;
+		}
+	}
+
+	int len = strlen( pName ) + 1;
+	int iName = m_PathIndexNames.AddMultipleToTail( len );
+	memcpy( &m_PathIndexNames[iName], pName, len );
+
+	int iBucket = nHash & ( m_PathIndexBuckets.Count() - 1 );
+	iEntry = m_PathIndexEntries.AddToTail();
+
+	PathIndexEntry_t *pEntry = &m_PathIndexEntries[iEntry];
+	pEntry->m_nHash = nHash;
+	pEntry->m_iName = iName;
+	pEntry->m_iNext = m_PathIndexBuckets[iBucket];
+	pEntry->m_iFirstPackHit = -1;
+	pEntry->m_LooseDirs = 0;
+
+	m_PathIndexBuckets[iBucket] = iEntry;
+	return iEntry;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds every file under pRoot + pRelativeDir to the index. Returns false
+//  if the directory tree has too many files to be worth indexing.
+//-----------------------------------------------------------------------------
+bool CBaseFileSystem::IndexLooseDirFiles( int iLooseDir, const char *pRoot, const char *pRelativeDir, int &nFiles )
+{
+	char findName[MAX_PATH];
+	Q_snprintf( findName, sizeof( findName ), "%s%s*.*", pRoot, pRelativeDir );
+
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = FS_FindFirstFile( findName, &findData );
+	if ( hFind == INVALID_HANDLE_VALUE )
+		return true;
+
+	bool bOk = true;
+	do
+	{
+		if ( !strcmp( findData.cFileName, "." ) || !strcmp( findData.cFileName, ".." ) )
+			continue;
+
+		char relativeName[MAX_PATH];
+		Q_snprintf( relativeName, sizeof( relativeName ), "%s%s", pRelativeDir, findData.cFileName );
+
+#ifdef _LINUX
+		// The Linux find data stats the name relative to the working directory,
+		// so its attributes can't be trusted here.
+		char fullName[MAX_PATH];
+		Q_snprintf( fullName, sizeof( fullName ), "%s%s", pRoot, relativeName );
+
+		struct _stat buf;
+		bool bDirectory = ( FS_stat( fullName, &buf ) != -1 ) && ( buf.st_mode & _S_IFDIR );
+#else
+		bool bDirectory = ( findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+#endif
+
+		if ( bDirectory )
+		{
+			int len = strlen( relativeName );
+			if ( len < (int)sizeof( relativeName ) - 1 )
+			{
+				relativeName[len] = CORRECT_PATH_SEPARATOR;
+				relativeName[len+1] = 0;
+				bOk = IndexLooseDirFiles( iLooseDir, pRoot, relativeName, nFiles );
+			}
+		}
+		else if ( ++nFiles > MAX_INDEXED_LOOSE_FILES )
+		{
+			bOk = false;
+		}
+		else
+		{
+			char name[MAX_PATH];
+			if ( NormalizeIndexName( relativeName, name, sizeof( name ) ) )
+			{
+				int iEntry = FindOrAddPathIndexEntry( name );
+				m_PathIndexEntries[iEntry].m_LooseDirs |= ( 1 << iLooseDir );
+			}
+		}
+	} while ( bOk && FS_FindNextFile( hFind, &findData ) );
+
+	FS_FindClose( hFind );
+	return bOk;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Scans a loose directory, replacing whatever an earlier scan found.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::ScanLooseDir( int iLooseDir )
+{
+	IndexedLooseDir_t *pDir = &m_IndexedLooseDirs[iLooseDir];
+	pDir->m_bNeedsScan = false;
+	pDir->m_bIndexed = false;
+	pDir->m_flScanTime = Plat_FloatTime();
+
+	if ( iLooseDir >= MAX_INDEXED_LOOSE_DIRS )
+		return;
+
+	// The names stay in the index. Only this directory's bit goes away.
+	unsigned int nClearMask = ~( 1 << iLooseDir );
+	for ( int i=0; i < m_PathIndexEntries.Count(); i++ )
+	{
+		m_PathIndexEntries[i].m_LooseDirs &= nClearMask;
+	}
+
+	int nFiles = 0;
+	if ( IndexLooseDirFiles( iLooseDir, g_PathIDTable.String( pDir->m_Path ), "", nFiles ) )
+	{
+		pDir->m_bIndexed = true;
+	}
+	else
+	{
+		Warning( FILESYSTEM_WARNING_REPORTUSAGE, "FS:  More than %d files under %s, not indexing it.\n",
+			MAX_INDEXED_LOOSE_FILES, g_PathIDTable.String( pDir->m_Path ) );
+	}
+
+	m_flLooseDirIndexTime += (float)( Plat_FloatTime() - pDir->m_flScanTime );
+	m_nLooseDirIndexFiles += nFiles;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the m_IndexedLooseDirs index for a loose search path,
+//  scanning the directory the first time it shows up or if it's due for
+//  another scan.
+//-----------------------------------------------------------------------------
+int CBaseFileSystem::FindOrIndexLooseDir( CUtlSymbol path )
+{
+	int iLooseDir;
+	for ( iLooseDir=0; iLooseDir < m_IndexedLooseDirs.Count(); iLooseDir++ )
+	{
+		if ( m_IndexedLooseDirs[iLooseDir].m_Path == path )
+			break;
+	}
+
+	if ( iLooseDir == m_IndexedLooseDirs.Count() )
+	{
+		iLooseDir = m_IndexedLooseDirs.AddToTail();
+		m_IndexedLooseDirs[iLooseDir].m_Path = path;
+		m_IndexedLooseDirs[iLooseDir].m_bNeedsScan = true;
+	}
+
+	if ( m_IndexedLooseDirs[iLooseDir].m_bNeedsScan )
+	{
+		ScanLooseDir( iLooseDir );
+	}
+
+	return iLooseDir;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuilds the pack file hits and figures out which loose directory
+//  goes with each search path.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::BuildPathIndex( void )
+{
+	m_bPathIndexDirty = false;
+
+	int i;
+	for ( i=0; i < m_PathIndexEntries.Count(); i++ )
+		m_PathIndexEntries[i].m_iFirstPackHit = -1;
+	m_PathIndexPackHits.RemoveAll();
+
+	m_SearchPathLooseDirs.SetSize( m_SearchPaths.Count() );
+	for ( i=0; i < m_SearchPaths.Count(); i++ )
+	{
+		CSearchPath *sp = &m_SearchPaths[i];
+		if ( !sp->m_bIsPackFile )
+		{
+			m_SearchPathLooseDirs[i] = FindOrIndexLooseDir( sp->m_Path );
+			continue;
+		}
+
+		m_SearchPathLooseDirs[i] = -1;
+		for ( int j = sp->m_PackFiles.FirstInorder(); j != sp->m_PackFiles.InvalidIndex(); j = sp->m_PackFiles.NextInorder( j ) )
+		{
+			char name[MAX_PATH];
+			if ( !NormalizeIndexName( g_PathIDTable.String( sp->m_PackFiles[j].m_Name ), name, sizeof( name ) ) )
+				continue;
+
+			int iEntry = FindOrAddPathIndexEntry( name );
+			int iHit = m_PathIndexPackHits.AddToTail();
+			m_PathIndexPackHits[iHit].m_iSearchPath = i;
+			m_PathIndexPackHits[iHit].m_iNext = m_PathIndexEntries[iEntry].m_iFirstPackHit;
+			m_PathIndexEntries[iEntry].m_iFirstPackHit = iHit;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Fills pCandidates (which has room for every search path) with the
+//  search paths that might have pFileName, in search order. The callers still
+//  apply their path ID filter and open or stat the file in each one, so the
+//  index only ever skips search paths that can't have the file.
+//-----------------------------------------------------------------------------
+int CBaseFileSystem::GetSearchPathCandidates( const char *pFileName, int *pCandidates )
+{
+	int nSearchPaths = m_SearchPaths.Count();
+	int i;
+	double flNow = 0;
+
+	char name[MAX_PATH];
+	if ( !m_bPathIndexEnabled || !NormalizeIndexName( pFileName, name, sizeof( name ) ) )
+	{
+		for ( i=0; i < nSearchPaths; i++ )
+			pCandidates[i] = i;
+		return nSearchPaths;
+	}
+
+	if ( m_bPathIndexDirty )
+	{
+		BuildPathIndex();
+	}
+
+	PathIndexEntry_t *pEntry = NULL;
+	int iEntry = FindPathIndexEntry( name, HashIndexName( name ) );
+	if ( iEntry != -1 )
+	{
+		pEntry = &m_PathIndexEntries[iEntry];
+	}
+
+	int nCandidates = 0;
+	for ( i=0; i < nSearchPaths; i++ )
+	{
+		int iLooseDir = m_SearchPathLooseDirs[i];
+		if ( iLooseDir == -1 )
+		{
+			if ( !pEntry )
+				continue;
+
+			int iHit;
+			for ( iHit = pEntry->m_iFirstPackHit; iHit != -1; iHit = m_PathIndexPackHits[iHit].m_iNext )
+			{
+				if ( m_PathIndexPackHits[iHit].m_iSearchPath == i )
+					break;
+			}
+
+			if ( iHit != -1 )
+				pCandidates[nCandidates++] = i;
+		}
+		else if ( !m_IndexedLooseDirs[iLooseDir].m_bIndexed || ( pEntry && ( pEntry->m_LooseDirs & ( 1 << iLooseDir ) ) ) )
+		{
+			pCandidates[nCandidates++] = i;
+		}
+		else if ( !m_bLevelLoading )
+		{
+			// Another process might have put the file there since the scan.
+			if ( flNow == 0 )
+				flNow = Plat_FloatTime();
+
+			if ( flNow - m_IndexedLooseDirs[iLooseDir].m_flScanTime >= FS_LOOSE_DIR_TRUST_TIME )
+				pCandidates[nCandidates++] = i;
+		}
+	}
+
+	return nCandidates;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Called when the filesystem writes, removes, or renames a file so the
+//  loose directories that contain it stay up to date.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::NotePathIndexFileChanged( const char *pFullPath, bool bExists )
+{
+	for ( int iLooseDir=0; iLooseDir < m_IndexedLooseDirs.Count(); iLooseDir++ )
+	{
+		if ( !m_IndexedLooseDirs[iLooseDir].m_bIndexed )
+			continue;
+
+		// Is the file under this directory?
+		const char *pRoot = g_PathIDTable.String( m_IndexedLooseDirs[iLooseDir].m_Path );
+		const char *pRelative = pFullPath;
+		while ( *pRoot )
+		{
+			if ( PATHSEPARATOR( *pRoot ) ? !PATHSEPARATOR( *pRelative ) : ( tolower( *pRoot ) != tolower( *pRelative ) ) )
+				break;
+
+			++pRoot;
+			++pRelative;
+		}
+
+		char name[MAX_PATH];
+		if ( *pRoot || !NormalizeIndexName( pRelative, name, sizeof( name ) ) )
+			continue;
+
+		if ( bExists )
+		{
+			int iEntry = FindOrAddPathIndexEntry( name );
+			m_PathIndexEntries[iEntry].m_LooseDirs |= ( 1 << iLooseDir );
+		}
+		else
+		{
+			int iEntry = FindPathIndexEntry( name, HashIndexName( name ) );
+			if ( iEntry != -1 )
+			{
+				m_PathIndexEntries[iEntry].m_LooseDirs &= ~( 1 << iLooseDir );
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: -fs_benchmark lookup recording.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::BeginLookupRecording( void )
+{
+	m_RecordedLookups.RemoveAll();
+	m_RecordedLookupStrings.RemoveAll();
+	m_bRecordingLookups = ( CommandLine()->FindParm( "-fs_benchmark" ) != 0 );
+}
+
+
+void CBaseFileSystem::RecordLookup( LookupType_t type, const char *pFileName, const char *pPathID )
+{
+	int i = m_RecordedLookups.AddToTail();
+	m_RecordedLookups[i].m_Type = type;
+
+	int len = strlen( pFileName ) + 1;
+	m_RecordedLookups[i].m_iName = m_RecordedLookupStrings.AddMultipleToTail( len );
+	memcpy( &m_RecordedLookupStrings[ m_RecordedLookups[i].m_iName ], pFileName, len );
+
+	m_RecordedLookups[i].m_iPathID = -1;
+	if ( pPathID )
+	{
+		len = strlen( pPathID ) + 1;
+		m_RecordedLookups[i].m_iPathID = m_RecordedLookupStrings.AddMultipleToTail( len );
+		memcpy( &m_RecordedLookupStrings[ m_RecordedLookups[i].m_iPathID ], pPathID, len );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs the recorded lookups again and returns how long it took in seconds.
+//-----------------------------------------------------------------------------
+float CBaseFileSystem::ReplayRecordedLookups( int nIterations )
+{
+	double flStartTime = Plat_FloatTime();
+
+	for ( int iIteration=0; iIteration < nIterations; iIteration++ )
+	{
+		for ( int i=0; i < m_RecordedLookups.Count(); i++ )
+		{
+			const RecordedLookup_t *pLookup = &m_RecordedLookups[i];
+			const char *pFileName = &m_RecordedLookupStrings[pLookup->m_iName];
+			const char *pPathID = ( pLookup->m_iPathID == -1 ) ? NULL : &m_RecordedLookupStrings[pLookup->m_iPathID];
+
+			switch ( pLookup->m_Type )
+			{
+				case LOOKUP_OPEN:
+				{
+					FileHandle_t hFile = OpenForRead( pFileName, "rb", pPathID );
+					if ( hFile )
+						Close( hFile );
+					break;
+				}
+
+				case LOOKUP_FILEEXISTS:
+					FileExists( pFileName, pPathID );
+					break;
+
+				case LOOKUP_SIZE:
+					Size( pFileName, pPathID );
+					break;
+
+				case LOOKUP_FILETIME:
+					GetFileTime( pFileName, pPathID );
+					break;
+			}
+		}
+	}
+
+	return (float)( Plat_FloatTime() - flStartTime );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replays what the level load looked up with and without the path
+//  index and prints the results.
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::FinishLookupRecording( const char *pLevelName )
+{
+	if ( !m_bRecordingLookups )
+		return;
+
+	m_bRecordingLookups = false;
+
+	int nLookups = m_RecordedLookups.Count();
+	if ( nLookups == 0 )
+		return;
+
+	bool bIndexEnabled = m_bPathIndexEnabled;
+
+	// Time a rebuild the way a level change does it: the loose directories are already scanned.
+	m_bPathIndexEnabled = true;
+
+	double flStartTime = Plat_FloatTime();
+	BuildPathIndex();
+	float flBuildTime = (float)( Plat_FloatTime() - flStartTime );
+
+	Msg( "fs_benchmark: %s: %d lookups, %d search paths, %d indexed names\n",
+		pLevelName, nLookups, m_SearchPaths.Count(), m_PathIndexEntries.Count() );
+	Msg( "    index rebuild: %.2f ms (loose directory scans: %.2f ms for %d files)\n",
+		flBuildTime * 1000.0f, m_flLooseDirIndexTime * 1000.0f, m_nLooseDirIndexFiles );
+
+	for ( int iPass=0; iPass < 2; iPass++ )
+	{
+		m_bPathIndexEnabled = ( iPass == 0 );
+		m_nPathProbes = 0;
+
+		float flTime = ReplayRecordedLookups( FS_BENCHMARK_ITERATIONS );
+		int nTotal = nLookups * FS_BENCHMARK_ITERATIONS;
+
+		Msg( "    %-12s %8.2f ms per load, %6.2f us per lookup, %5.2f search paths probed per lookup\n",
+			m_bPathIndexEnabled ? "path index:" : "no index:",
+			flTime * 1000.0f / FS_BENCHMARK_ITERATIONS,
+			flTime * 1000000.0f / nTotal,
+			(float)m_nPathProbes / nTotal );
+	}
+
+	m_bPathIndexEnabled = bIndexEnabled;
+	m_RecordedLookups.Purge();
+	m_RecordedLookupStrings.Purge();
+}
@@ -7,6 +7,10 @@
 
 #include "BaseFileSystem.h"
 #include "tier0/dbg.h"
+#ifdef _LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -51,6 +55,9 @@ protected:
 	virtual HANDLE FS_FindFirstFile(char *findname, WIN32_FIND_DATA *dat);
 	virtual bool FS_FindNextFile(HANDLE handle, WIN32_FIND_DATA *dat);
 	virtual bool FS_FindClose(HANDLE handle);
+	virtual const unsigned char *FS_MapFile( const char *path, unsigned int &size, void *&hMapping );
+	virtual void FS_UnmapFile( const unsigned char *pData, unsigned int size, void *hMapping );
+	virtual bool FS_CanReadInBackground();
 
 	virtual bool IsFileImmediatelyAvailable(const char *pFileName);
 
@@ -218,6 +225,90 @@ bool CFileSystem_Stdio::FS_FindClose(HANDLE handle)
 	return (::FindClose(handle) != 0);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: low-level filesystem wrapper
+//-----------------------------------------------------------------------------
+const unsigned char *CFileSystem_Stdio::FS_MapFile( const char *path, unsigned int &size, void *&hMapping )
+{
+#ifdef _WIN32
+	HANDLE hFile = ::CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	size = ::GetFileSize( hFile, NULL );
+	HANDLE hFileMapping = ::CreateFileMapping( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+
+	// The mapping keeps the file open.
+	::CloseHandle( hFile );
+	if ( !hFileMapping )
+		return NULL;
+
+	void *pData = ::MapViewOfFile( hFileMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( !pData )
+	{
+		::CloseHandle( hFileMapping );
+		return NULL;
+	}
+
+	hMapping = hFileMapping;
+	return (const unsigned char *)pData;
+#elif _LINUX
+	int fd = open( path, O_RDONLY );
+	if ( fd == -1 )
+	{
+		const char *file = findFileInDirCaseInsensitive( path );
+		if ( !file )
+			return NULL;
+
+		fd = open( file, O_RDONLY );
+		if ( fd == -1 )
+			return NULL;
+	}
+
+	struct stat buf;
+	void *pData = MAP_FAILED;
+	if ( fstat( fd, &buf ) == 0 && buf.st_size > 0 )
+	{
+		pData = mmap( NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	close( fd );
+	if ( pData == MAP_FAILED )
+		return NULL;
+
+	size = buf.st_size;
+	hMapping = NULL;
+	return (const unsigned char *)pData;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: low-level filesystem wrapper
+//-----------------------------------------------------------------------------
+void CFileSystem_Stdio::FS_UnmapFile( const unsigned char *pData, unsigned int size, void *hMapping )
+{
+#ifdef _WIN32
+	::UnmapViewOfFile( pData );
+	::CloseHandle( (HANDLE)hMapping );
+#elif _LINUX
+	munmap( (void *)pData, size );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The stdio wrappers are safe to call from the async I/O threads. The
+//  Linux build has no threads, so it reads async requests right away.
+//-----------------------------------------------------------------------------
+bool CFileSystem_Stdio::FS_CanReadInBackground()
+{
+#ifdef _WIN32
+	return true;
+#else
+	return false;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: files are always immediately available on disk
 //-----------------------------------------------------------------------------
@@ -238,10 +329,14 @@ void CFileSystem_Stdio::GetLocalCopy( const char *pFileName )
 
 void CFileSystem_Stdio::LogLevelLoadStarted( const char *name )
 {
+	PathIndexLevelLoadStarted();
+	BeginLookupRecording();
 }
 
 void CFileSystem_Stdio::LogLevelLoadFinished( const char *name )
 {
+	FinishLookupRecording( name );
+	PathIndexLevelLoadFinished();
 }
 
 int CFileSystem_Stdio::ProgressCounter( void )
@@ -45,7 +45,7 @@ RSC=rc.exe
 # PROP Ignore_Export_Lib 0
 # PROP Target_Dir ""
 # ADD BASE CPP /nologo /MT /W3 /GX /O2 /D "WIN32" /D "NDEBUG" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /YX /FD /c
-# ADD CPP /nologo /W4 /Zi /O2 /I "..\..\public" /I "..\..\common" /D "NDEBUG" /D "_WIN32" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /D "DONT_PROTECT_FILEIO_FUNCTIONS" /D "PROTECTED_THINGS_ENABLE" /FD /c
+# ADD CPP /nologo /MT /W4 /Zi /O2 /I "..\..\public" /I "..\..\common" /D "NDEBUG" /D "_WIN32" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /D "DONT_PROTECT_FILEIO_FUNCTIONS" /D "PROTECTED_THINGS_ENABLE" /FD /c
 # SUBTRACT CPP /Fr /YX
 # ADD BASE MTL /nologo /D "NDEBUG" /mktyplib203 /win32
 # ADD MTL /nologo /D "NDEBUG" /mktyplib203 /win32
@@ -82,7 +82,7 @@ SOURCE="$(InputPath)"
 # PROP Ignore_Export_Lib 0
 # PROP Target_Dir ""
 # ADD BASE CPP /nologo /MTd /W3 /Gm /GX /ZI /Od /D "WIN32" /D "_DEBUG" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /YX /FD /GZ /c
-# ADD CPP /nologo /W4 /Gm /ZI /Od /I "..\..\public" /I "..\..\common" /D "_DEBUG" /D "_WIN32" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /D "DONT_PROTECT_FILEIO_FUNCTIONS" /D "PROTECTED_THINGS_ENABLE" /FR /FD /GZ /c
+# ADD CPP /nologo /MTd /W4 /Gm /ZI /Od /I "..\..\public" /I "..\..\common" /D "_DEBUG" /D "_WIN32" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "FILESYSTEM_STDIO_EXPORTS" /D "DONT_PROTECT_FILEIO_FUNCTIONS" /D "PROTECTED_THINGS_ENABLE" /FR /FD /GZ /c
 # SUBTRACT CPP /YX
 # ADD BASE MTL /nologo /D "_DEBUG" /mktyplib203 /win32
 # ADD MTL /nologo /D "_DEBUG" /mktyplib203 /win32
@@ -204,6 +204,10 @@ SOURCE=..\..\Public\characterset.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\FileSystemAsync.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\FileSystem_Stdio.cpp
 
 !IF  "$(CFG)" == "FileSystem_Stdio - Win32 Release"
@@ -250,6 +254,10 @@ SOURCE=..\..\public\tier0\memoverride.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\PathIndex.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\common\Steam.c
 
 !IF  "$(CFG)" == "FileSystem_Stdio - Win32 Release"
@@ -391,12 +391,16 @@ void CFileSystem_Steam::LogLevelLoadStarted( const char *name )
 {
 	m_bCurrentlyLoading = true;
 	STEAM_LogLevelLoadStarted( name );
+	PathIndexLevelLoadStarted();
+	BeginLookupRecording();
 }
 
 void CFileSystem_Steam::LogLevelLoadFinished( const char *name )
 {
 	m_bCurrentlyLoading = false;
 	STEAM_LogLevelLoadFinished( name );
+	FinishLookupRecording( name );
+	PathIndexLevelLoadFinished();
 }
 
 int CFileSystem_Steam::ProgressCounter( void )
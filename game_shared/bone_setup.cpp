@@ -3292,7 +3292,7 @@ int Studio_FindRandomAttachment( const studiohdr_t *pStudioHdr, const char *pAtt
 	if ( pStudioHdr )
 	{
 		// First move them all matching attachments into a list
-		CUtlVector<int> matchingAttachments;
+		CUtlVectorFixedGrowable<int, 8> matchingAttachments;
 
 		// Extract the bone index from the name
 		for (int i = 0; i < pStudioHdr->numattachments; i++)
@@ -1384,8 +1384,10 @@ bool CMaterial::PrecacheVars()
 	if( IsPrecachedVars() )
 		return true;
 
-	// load data from the vmt file
-	KeyValues * vmtKeyValues = new KeyValues("vmt");
+	// load data from the vmt file.  The keys only live until we return,
+	// so they all go in one arena instead of a heap allocation each.
+	CKeyValuesArena arena;
+	KeyValues * vmtKeyValues = KeyValues::CreateInArena( "vmt", &arena );
 
 	if( !LoadVMTFile( *vmtKeyValues ) )
 	{
@@ -32,6 +32,7 @@
 #include "materialsystem/imesh.h"
 #include "utlsymbol.h"
 #include "utlrbtree.h"
+#include "utlhashmap.h"
 #include <malloc.h>
 #include "filesystem.h"
 #include "pixelwriter.h"
@@ -367,13 +368,6 @@ public:
 						MaterialRect_t *actualRect,	const char *fmt, ... );
 
 private:
-	// Stores a dictionary of materials, searched by name
-	struct MaterialLookup_t
-	{
-		IMaterialInternal* m_pMaterial;
-		CUtlSymbol m_Name;
-	};
-
 	// Stores a dictionary of missing materials to cut down on redundant warning messages
 	// TODO:  1) Could add a counter
 	//        2) Could dump to file/console at exit for exact list of missing materials
@@ -409,9 +403,6 @@ private:
 	// by rendering the desired Z values ahead of time.
 	void ForceDepthFuncEquals( bool bEnable );
 
-	static bool MaterialLessFunc( MaterialLookup_t const& src1, 
-								  MaterialLookup_t const& src2 );
-
 	static bool MissingMaterialLessFunc( MissingMaterial_t const& src1, 
 								  MissingMaterial_t const& src2 );
 
@@ -479,7 +470,8 @@ private:
 	void UpdateHeightClipUserClipPlane( void );
 
 private:
-	CUtlRBTree< MaterialLookup_t, MaterialHandle_t > m_MaterialDict;
+	// Stores a dictionary of materials, searched by name
+	CUtlStringHashMap< IMaterialInternal* > m_MaterialDict;
 	CUtlRBTree< MissingMaterial_t, int > m_MissingList;
 
 	// stuff that is exported to the launcher
@@ -664,21 +656,11 @@ void CMaterialSystem::CleanUpDebugMaterials()
 }
 
 
-//-----------------------------------------------------------------------------
-// sort function
-//-----------------------------------------------------------------------------
-bool CMaterialSystem::MaterialLessFunc( MaterialLookup_t const& src1, 
-							  MaterialLookup_t const& src2 )
-{
-	return src1.m_Name < src2.m_Name;
-}
-
-
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
 CMaterialSystem::CMaterialSystem() : 
-    m_MaterialDict( 0, 256, MaterialLessFunc ),
+    m_MaterialDict( false, 256 ),
 	m_MissingList( 0, 32, MissingMaterialLessFunc )
 {
 	// set default values for members
@@ -1452,19 +1434,25 @@ bool CMaterialSystem::UpdateConfig( MaterialSystem_Config_t *config, bool forceU
 void CMaterialSystem::AddMaterialToMaterialList( IMaterialInternal *pMaterial )
 {
 	// FIXME: Is there a better way of handling procedurally-created materials?
-	MaterialLookup_t lookup;
-	lookup.m_pMaterial = pMaterial;
-	lookup.m_Name = pMaterial->GetName();
-	m_MaterialDict.Insert( lookup );
+	m_MaterialDict.Insert( pMaterial->GetName(), pMaterial );
 }
 
 void CMaterialSystem::RemoveMaterialFromMaterialList( IMaterialInternal *pMaterial )
 {
 	// FIXME: Is there a better way of handling procedurally-created materials?
-	MaterialLookup_t lookup;
-	lookup.m_pMaterial = pMaterial;
-	lookup.m_Name = pMaterial->GetName();
-	m_MaterialDict.Remove( lookup );
+	int i = m_MaterialDict.Find( pMaterial->GetName() );
+	if ( ( i == m_MaterialDict.InvalidIndex() ) || ( m_MaterialDict[i] != pMaterial ) )
+	{
+		// Another material has the same name, look for this one by hand
+		for ( i = m_MaterialDict.First(); i != m_MaterialDict.InvalidIndex(); i = m_MaterialDict.Next( i ) )
+		{
+			if ( m_MaterialDict[i] == pMaterial )
+				break;
+		}
+		if ( i == m_MaterialDict.InvalidIndex() )
+			return;
+	}
+	m_MaterialDict.RemoveAt( i );
 }
 
 
@@ -1489,7 +1477,7 @@ void CMaterialSystem::RemoveAllMaterials()
 {
 	for (MaterialHandle_t i = FirstMaterial(); i != InvalidMaterial(); i = NextMaterial(i) )
 	{
-		IMaterialInternal::Destroy( m_MaterialDict[i].m_pMaterial );
+		IMaterialInternal::Destroy( m_MaterialDict[i] );
 	}
 	m_MaterialDict.RemoveAll();
 }
@@ -1565,12 +1553,12 @@ ITexture *CMaterialSystem::CreateProceduralTexture( const char *pTextureName, in
 //-----------------------------------------------------------------------------
 MaterialHandle_t CMaterialSystem::FirstMaterial() const
 {
-	return m_MaterialDict.FirstInorder();
+	return (MaterialHandle_t)m_MaterialDict.First();
 }
 
 MaterialHandle_t CMaterialSystem::NextMaterial( MaterialHandle_t h ) const
 {
-	return m_MaterialDict.NextInorder(h);
+	return (MaterialHandle_t)m_MaterialDict.Next(h);
 }
 
 int CMaterialSystem::GetNumMaterials( )	const
@@ -1584,7 +1572,7 @@ int CMaterialSystem::GetNumMaterials( )	const
 
 MaterialHandle_t CMaterialSystem::InvalidMaterial() const
 {
-	return m_MaterialDict.InvalidIndex();
+	return (MaterialHandle_t)m_MaterialDict.InvalidIndex();
 }
 
 //-----------------------------------------------------------------------------
@@ -1593,12 +1581,12 @@ MaterialHandle_t CMaterialSystem::InvalidMaterial() const
 
 IMaterial* CMaterialSystem::GetMaterial( MaterialHandle_t idx ) const
 {
-	return m_MaterialDict[idx].m_pMaterial;
+	return m_MaterialDict[idx];
 }
 
 IMaterialInternal* CMaterialSystem::GetMaterialInternal( MaterialHandle_t idx ) const
 {
-	return m_MaterialDict[idx].m_pMaterial;
+	return m_MaterialDict[idx];
 }
 
 
@@ -1638,15 +1626,12 @@ IMaterial* CMaterialSystem::FindMaterial( char const *pMaterialName, bool *pFoun
 	FixSlashes( pTemp );
 	Assert( len == strlen( pTemp ) + 1 );
 
-	MaterialLookup_t lookup;
-	lookup.m_Name = pTemp;
-
 	if( pFound )
 	{
 		*pFound = false;
 	}
 	
-	MaterialHandle_t h = m_MaterialDict.Find( lookup );
+	int h = m_MaterialDict.Find( pTemp );
 	if( h == m_MaterialDict.InvalidIndex() )
 	{
 		// It hasn't been seen yet, so let's check to see if it's in the filesystem.
@@ -1673,7 +1658,7 @@ IMaterial* CMaterialSystem::FindMaterial( char const *pMaterialName, bool *pFoun
 			Warning( "========\n" );
 			for (MaterialHandle_t i = FirstMaterial(); i != InvalidMaterial(); i = NextMaterial(i) )
 			{
-				Warning( "material: \"%s\"\n", m_MaterialDict[i].m_pMaterial->GetName() );
+				Warning( "material: \"%s\"\n", m_MaterialDict[i]->GetName() );
 			}
 #endif
 			char *matNameWithExtension;
@@ -1712,7 +1697,7 @@ IMaterial* CMaterialSystem::FindMaterial( char const *pMaterialName, bool *pFoun
 			*pFound = true;
 		}
 	}
-	return m_MaterialDict[h].m_pMaterial;
+	return m_MaterialDict[h];
 }
 
 ITexture *CMaterialSystem::FindTexture( char const* pTextureName, bool *pFound, bool complain )
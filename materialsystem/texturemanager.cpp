@@ -21,6 +21,7 @@
 
 #include "vstdlib/strtools.h"
 #include "utlvector.h"
+#include "utlhashmap.h"
 #include "itextureinternal.h"
 #include "vtf/vtf.h"
 #include "pixelwriter.h"
@@ -285,7 +286,18 @@ protected:
 	// Restores a single texture
 	void RestoreTexture( ITextureInternal* pTex );
 
+	// Adds a texture to the list and the name lookup
+	void AddTexture( ITextureInternal *pTexture );
+
+	// Rebuilds the name lookup from the texture list
+	void RebuildTextureDict();
+
 	CUtlVector<ITextureInternal *> m_TextureList;
+
+	// Name lookup, indexed by IsNormalMap().  When several textures share a
+	// name the one furthest down m_TextureList wins, as it did when
+	// FindTexture searched the list from the end.
+	CUtlStringHashMap<ITextureInternal *> m_TextureDict[2];
 	int m_iNextTexID;
 
 	ITextureInternal *m_pErrorTexture;
@@ -376,6 +388,8 @@ void CTextureManager::Shutdown()
 		ITextureInternal::Destroy( m_TextureList[i] );
 	}
 	m_TextureList.RemoveAll();
+	m_TextureDict[0].Purge();
+	m_TextureDict[1].Purge();
 }
 
 
@@ -435,6 +449,9 @@ void CTextureManager::RestoreTextures( void )
 		// Restore the texture...
 		RestoreTexture( m_TextureList[i] );
 	}
+
+	// Downloading is what decides whether a file is a normal map
+	RebuildTextureDict();
 }
 
 
@@ -448,6 +465,7 @@ void CTextureManager::ReloadTextures( void )
 		// Put the texture back onto the board
 		m_TextureList[i]->Download( );
 	}
+	RebuildTextureDict();
 }
 
 
@@ -476,7 +494,7 @@ ITextureInternal *CTextureManager::CreateProceduralTexture( const char *pTexture
 		return NULL;
 
 	// Add it to the list of textures so it can be restored, etc.
-	m_TextureList.AddToTail( pNewTexture );
+	AddTexture( pNewTexture );
 
 	// NOTE: This will download the texture only if the shader api is ready
 	pNewTexture->Download();
@@ -519,16 +537,40 @@ ITextureInternal *CTextureManager::FindTexture( const char *pTextureName, bool b
 	if (!pTextureName || pTextureName[0] == 0)
 		return NULL;
 
-	// FIXME: Use a UtlDict here, get log(n)
-	for (int i = m_TextureList.Count(); --i >= 0; )
+	int i = m_TextureDict[bIsBump].Find( pTextureName );
+	if ( i == m_TextureDict[bIsBump].InvalidIndex() )
+		return NULL;
+
+	ITextureInternal *pTexture = m_TextureDict[bIsBump][i];
+	if ( pTexture->IsNormalMap() != bIsBump )
 	{
-		if( Q_strnicmp( m_TextureList[i]->GetName(), pTextureName, 1024 ) == 0 )
-		{
-			if ( m_TextureList[i]->IsNormalMap() == bIsBump )
-				return m_TextureList[i];
-		}
+		// It was downloaded again and came back the other kind, so the
+		// lookup's stale
+		RebuildTextureDict();
+		i = m_TextureDict[bIsBump].Find( pTextureName );
+		return ( i != m_TextureDict[bIsBump].InvalidIndex() ) ? m_TextureDict[bIsBump][i] : NULL;
+	}
+	return pTexture;
+}
+
+//-----------------------------------------------------------------------------
+// Texture list + name lookup
+//-----------------------------------------------------------------------------
+void CTextureManager::AddTexture( ITextureInternal *pTexture )
+{
+	m_TextureList.AddToTail( pTexture );
+	m_TextureDict[pTexture->IsNormalMap()].InsertOrReplace( pTexture->GetName(), pTexture );
+}
+
+void CTextureManager::RebuildTextureDict()
+{
+	m_TextureDict[0].RemoveAll();
+	m_TextureDict[1].RemoveAll();
+	for (int i = 0; i < m_TextureList.Count(); ++i )
+	{
+		ITextureInternal *pTexture = m_TextureList[i];
+		m_TextureDict[pTexture->IsNormalMap()].InsertOrReplace( pTexture->GetName(), pTexture );
 	}
-	return NULL;
 }
 
 ITextureInternal *CTextureManager::FindOrLoadTexture( const char *pTextureName, bool bIsBump )
@@ -543,7 +585,7 @@ ITextureInternal *CTextureManager::FindOrLoadTexture( const char *pTextureName,
 			pTexture = LoadTexture( pTextureName, bIsBump );
 			if( pTexture )
 			{
-				m_TextureList.AddToTail( pTexture );
+				AddTexture( pTexture );
 			}
 		}
 	}
@@ -584,7 +626,7 @@ ITextureInternal *CTextureManager::CreateRenderTargetTexture( int w, int h, Imag
 
 	// Add the render target to the list of textures
 	// that way it'll get cleaned up correctly in case of a task switch
-	m_TextureList.AddToTail( pNewTexture );
+	AddTexture( pNewTexture );
 
 	// NOTE: This will download the texture only if the shader api is ready
 	pNewTexture->Download();
@@ -603,7 +645,7 @@ ITextureInternal *CTextureManager::CreateNamedRenderTargetTexture( const char *p
 
 	// Add the render target to the list of textures
 	// that way it'll get cleaned up correctly in case of a task switch
-	m_TextureList.AddToTail( pNewTexture );
+	AddTexture( pNewTexture );
 
 	// NOTE: This will download the texture only if the shader api is ready
 	pNewTexture->Download();
@@ -630,6 +672,7 @@ void CTextureManager::ResetTextureFilteringState( )
 
 void CTextureManager::RemoveUnusedTextures( void )
 {
+	bool bRemoved = false;
 	for (int i = m_TextureList.Count(); --i >= 0; )
 	{
 
@@ -644,8 +687,14 @@ void CTextureManager::RemoveUnusedTextures( void )
 		{
 			ITextureInternal::Destroy( m_TextureList[i] );
 			m_TextureList.FastRemove(i);
+			bRemoved = true;
 		}
 	}
+
+	if ( bRemoved )
+	{
+		RebuildTextureDict();
+	}
 }
 
 void CTextureManager::DebugPrintUsedTextures( void )
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <direct.h>			// for _mkdir
 #include "tier0/mem.h"
+#include "tier0/platform.h"
 #include "utlvector.h"
 #include "utlbuffer.h"
 
@@ -29,6 +30,85 @@ static char * s_LastFileLoadingFrom = "unknown"; // just needed for error messag
 
 #define KEYVALUES_TOKEN_SIZE	1024
 
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CKeyValuesArena::CKeyValuesArena( int blockSize )
+{
+	m_pBlocks = NULL;
+	m_nBlockSize = blockSize;
+	m_nAllocations = 0;
+	m_nBlocks = 0;
+	m_nBytesUsed = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CKeyValuesArena::~CKeyValuesArena()
+{
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Allocates size bytes, starting a new block if the current one is full
+//-----------------------------------------------------------------------------
+void *CKeyValuesArena::Alloc( int size, int alignment )
+{
+	// the data starts after the header, rounded up so it's 8 byte aligned
+	const int headerSize = ( sizeof( Block_t ) + 7 ) & ~7;
+
+	int offset = 0;
+	if ( m_pBlocks )
+	{
+		offset = ( m_pBlocks->m_nUsed + alignment - 1 ) & ~( alignment - 1 );
+	}
+
+	if ( !m_pBlocks || offset + size > m_pBlocks->m_nSize )
+	{
+		// anything bigger than a block gets a block of its own
+		int blockSize = max( size, m_nBlockSize );
+		Block_t *pBlock = (Block_t *)malloc( headerSize + blockSize );
+		pBlock->m_pNext = m_pBlocks;
+		pBlock->m_nSize = blockSize;
+		pBlock->m_nUsed = 0;
+		m_pBlocks = pBlock;
+		++m_nBlocks;
+		offset = 0;
+	}
+
+	void *pMem = (char *)m_pBlocks + headerSize + offset;
+	m_pBlocks->m_nUsed = offset + size;
+	m_nBytesUsed += size;
+	++m_nAllocations;
+	return pMem;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees everything allocated from the arena
+//-----------------------------------------------------------------------------
+void CKeyValuesArena::Clear()
+{
+	while ( m_pBlocks )
+	{
+		Block_t *pNext = m_pBlocks->m_pNext;
+		free( m_pBlocks );
+		m_pBlocks = pNext;
+	}
+
+	m_nAllocations = 0;
+	m_nBlocks = 0;
+	m_nBytesUsed = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor for ReadAsBinary, which sets the name symbol itself
+//-----------------------------------------------------------------------------
+KeyValues::KeyValues()
+{
+	Init();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
@@ -107,6 +187,7 @@ void KeyValues::Init()
 	m_pValue = NULL;
 	
 	m_bHasEscapeSequences = false;
+	m_pArena = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -122,23 +203,26 @@ KeyValues::~KeyValues()
 //-----------------------------------------------------------------------------
 void KeyValues::RemoveEverything()
 {
+	// deleteThis() leaves keys that live in an arena for the arena to free
 	KeyValues *dat;
 	KeyValues *datNext = NULL;
 	for ( dat = m_pSub; dat != NULL; dat = datNext )
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
 
 	for ( dat = m_pPeer; dat && dat != this; dat = datNext )
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
 
+	CKeyValuesArena *pArena = m_pArena;
 	Init();	// reset all values
+	m_pArena = pArena;
 }
 
 //-----------------------------------------------------------------------------
@@ -369,6 +453,136 @@ void KeyValues::UsesEscapeSequences(bool state)
 	m_bHasEscapeSequences = state;
 }
 
+//-----------------------------------------------------------------------------
+// Binary cache
+//
+// LoadFromFile keeps a binary copy of every text file it parses in kvcache/ (in
+// the write path) when KeyValuesSystem()->IsBinaryCacheEnabled().  A cache file
+// is used as is if the source timestamp and size still match; if only the
+// timestamp changed, the source is hashed and the cache is kept if the hash
+// still matches.  Files with #include aren't cached since the cache couldn't
+// tell when an included file changes.  Flattening the path into one file name
+// can map two sources to the same cache file, so the header keeps the source
+// name and a cache written for another file is ignored.
+//-----------------------------------------------------------------------------
+#define KEYVALUES_CACHE_DIR			"kvcache"
+#define KEYVALUES_CACHE_ID			(('C'<<24)+('B'<<16)+('V'<<8)+'K')
+#define KEYVALUES_CACHE_VERSION		2
+#define KEYVALUES_BINARY_END		0xFF	// ends a list of keys in the binary format
+#define KEYVALUES_BINARY_MAX_DEPTH	64
+
+struct KeyValuesCacheHeader_t
+{
+	int				id;
+	int				version;
+	long			sourceTime;
+	int				sourceSize;
+	unsigned int	sourceHash;
+	int				hasEscapeSequences;
+	int				dataSize;			// size of the binary keys following the header
+	char			sourceName[MAX_PATH];	// path ID and source file name, see GetKeyValuesCacheName
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: FNV-1a hash of a source file
+//-----------------------------------------------------------------------------
+static unsigned int HashKeyValuesSource( const char *pBuffer, int nSize )
+{
+	unsigned int hash = 2166136261U;
+	for ( int i = 0; i < nSize; i++ )
+	{
+		hash = ( hash ^ (unsigned char)pBuffer[i] ) * 16777619U;
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Gets the cache file name for a resource and the source name that goes
+//			in its header, returns false if it can't be cached
+//-----------------------------------------------------------------------------
+static bool GetKeyValuesCacheName( const char *resourceName, const char *pathID, char *pCacheName, char *pSourceName, int maxlen )
+{
+	// absolute paths are outside the game directories
+	if ( strchr( resourceName, ':' ) || resourceName[0] == '/' || resourceName[0] == '\\' )
+		return false;
+
+	Q_snprintf( pSourceName, maxlen, "%s/%s", pathID ? pathID : "ALL", resourceName );
+	Q_strlower( pSourceName );
+	for ( char *pChar = pSourceName; *pChar; pChar++ )
+	{
+		if ( *pChar == '\\' )
+		{
+			*pChar = '/';
+		}
+	}
+
+	// flatten the resource path so the cache is a single directory
+	Q_snprintf( pCacheName, maxlen, KEYVALUES_CACHE_DIR "/%s.kvb", pSourceName );
+	for ( char *pChar = pCacheName + sizeof( KEYVALUES_CACHE_DIR ); *pChar; pChar++ )
+	{
+		if ( *pChar == '/' )
+		{
+			*pChar = '_';
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads a cache file; the caller frees *ppCache
+//-----------------------------------------------------------------------------
+static bool ReadKeyValuesCache( IBaseFileSystem *filesystem, const char *cacheName, const char *sourceName, bool bHasEscapeSequences, KeyValuesCacheHeader_t &header, char **ppCache )
+{
+	*ppCache = NULL;
+
+	FileHandle_t f = filesystem->Open( cacheName, "rb" );
+	if ( !f )
+		return false;
+
+	int fileSize = filesystem->Size( f );
+	bool bValid = ( fileSize >= (int)sizeof( header ) ) && 
+		( filesystem->Read( &header, sizeof( header ), f ) == sizeof( header ) ) &&
+		( header.id == KEYVALUES_CACHE_ID ) &&
+		( header.version == KEYVALUES_CACHE_VERSION ) &&
+		( header.hasEscapeSequences == (int)bHasEscapeSequences ) &&
+		( header.dataSize == fileSize - (int)sizeof( header ) );
+
+	// another source that flattens to the same cache name wrote it
+	if ( bValid )
+	{
+		header.sourceName[ sizeof( header.sourceName ) - 1 ] = 0;
+		bValid = !Q_strcmp( header.sourceName, sourceName );
+	}
+
+	if ( bValid )
+	{
+		*ppCache = (char *)malloc( header.dataSize );
+		bValid = ( filesystem->Read( *ppCache, header.dataSize, f ) == header.dataSize );
+		if ( !bValid )
+		{
+			free( *ppCache );
+			*ppCache = NULL;
+		}
+	}
+
+	filesystem->Close( f );
+	return bValid;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes a cache file
+//-----------------------------------------------------------------------------
+static void WriteKeyValuesCache( IBaseFileSystem *filesystem, const char *cacheName, KeyValuesCacheHeader_t &header, const void *pData )
+{
+	FileHandle_t f = filesystem->Open( cacheName, "wb" );
+	if ( !f )
+		return;
+
+	filesystem->Write( &header, sizeof( header ), f );
+	filesystem->Write( pData, header.dataSize, f );
+	filesystem->Close( f );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Load keyValues from disk
 //-----------------------------------------------------------------------------
@@ -378,9 +592,41 @@ bool KeyValues::LoadFromFile( IBaseFileSystem *filesystem, const char *resourceN
 	assert(filesystem);
 	assert(_heapchk() == _HEAPOK);
 
+	double startTime = Plat_FloatTime();
+
+	// look for an up to date binary copy first
+	char cacheName[MAX_PATH];
+	char sourceName[MAX_PATH];
+	bool bUseCache = KeyValuesSystem()->IsBinaryCacheEnabled() && GetKeyValuesCacheName( resourceName, pathID, cacheName, sourceName, sizeof( cacheName ) );
+
+	KeyValuesCacheHeader_t header;
+	char *pCache = NULL;
+	long sourceTime = 0;
+	if ( bUseCache )
+	{
+		sourceTime = filesystem->GetFileTime( resourceName, pathID );
+		if ( ReadKeyValuesCache( filesystem, cacheName, sourceName, m_bHasEscapeSequences, header, &pCache ) &&
+			 header.sourceTime == sourceTime && 
+			 header.sourceSize == (int)filesystem->Size( resourceName, pathID ) )
+		{
+			if ( LoadFromBinaryCache( pCache, header.dataSize ) )
+			{
+				free( pCache );
+				KeyValuesSystem()->AddLoadTime( true, (float)( Plat_FloatTime() - startTime ) );
+				return true;
+			}
+
+			free( pCache );
+			pCache = NULL;
+		}
+	}
+
 	FileHandle_t f = filesystem->Open(resourceName, "rb", pathID);
 	if (!f)
+	{
+		free( pCache );
 		return false;
+	}
 
 	s_LastFileLoadingFrom = (char*)resourceName;
 
@@ -396,13 +642,309 @@ bool KeyValues::LoadFromFile( IBaseFileSystem *filesystem, const char *resourceN
 
 	filesystem->Close( f );	// close file after reading
 
-	bool retOK = LoadFromBuffer( resourceName, buffer, filesystem );
+	bool retOK;
+	bool bFromCache = false;
+	if ( pCache && header.sourceSize == fileSize && header.sourceHash == HashKeyValuesSource( buffer, fileSize ) &&
+		 LoadFromBinaryCache( pCache, header.dataSize ) )
+	{
+		// only the timestamp changed, keep the cache for next time
+		header.sourceTime = sourceTime;
+		WriteKeyValuesCache( filesystem, cacheName, header, pCache );
+		retOK = true;
+		bFromCache = true;
+	}
+	else
+	{
+		retOK = LoadFromBuffer( resourceName, buffer, filesystem );
+
+		if ( bUseCache && retOK && !Q_stristr( buffer, "#include" ) )
+		{
+			CUtlBuffer data;
+			if ( WriteAsBinary( data ) )
+			{
+				memset( &header, 0, sizeof( header ) );
+				header.id = KEYVALUES_CACHE_ID;
+				header.version = KEYVALUES_CACHE_VERSION;
+				header.sourceTime = sourceTime;
+				header.sourceSize = fileSize;
+				header.sourceHash = HashKeyValuesSource( buffer, fileSize );
+				header.hasEscapeSequences = m_bHasEscapeSequences;
+				header.dataSize = data.TellPut();
+				Q_strncpy( header.sourceName, sourceName, sizeof( header.sourceName ) );
+				WriteKeyValuesCache( filesystem, cacheName, header, data.Base() );
+			}
+		}
+	}
 
 	MemFreeScratch();
+	free( pCache );
+
+	KeyValuesSystem()->AddLoadTime( bFromCache, (float)( Plat_FloatTime() - startTime ) );
 
 	return retOK;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Reads the keys out of a cache file, leaves this key empty if it fails
+//-----------------------------------------------------------------------------
+bool KeyValues::LoadFromBinaryCache( const char *pData, int nSize )
+{
+	CUtlBuffer buf( pData, nSize );
+	if ( ReadAsBinary( buf ) )
+		return true;
+
+	// throw away whatever was read and let the caller parse the text
+	bool bHasEscapeSequences = m_bHasEscapeSequences;
+	RemoveEverything();
+	m_bHasEscapeSequences = bHasEscapeSequences;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes this key and its peers in binary
+//-----------------------------------------------------------------------------
+bool KeyValues::WriteAsBinary( CUtlBuffer &buf )
+{
+	// the key names go in front of the keys, so write the keys first to collect them
+	CUtlVector< int > symbols;
+	CUtlBuffer keys;
+	for ( KeyValues *dat = this; dat; dat = dat->m_pPeer )
+	{
+		dat->RecursiveWriteBinary( keys, symbols );
+		if ( dat->m_pPeer == this )
+			break;
+	}
+	keys.PutUnsignedChar( KEYVALUES_BINARY_END );
+
+	// names are stored as unsigned shorts
+	if ( symbols.Count() >= 0xFFFF )
+		return false;
+
+	buf.PutInt( symbols.Count() );
+	for ( int i = 0; i < symbols.Count(); i++ )
+	{
+		buf.PutString( KeyValuesSystem()->GetStringForSymbol( symbols[i] ) );
+	}
+	buf.Put( keys.Base(), keys.TellPut() );
+
+	return buf.IsValid();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes a key, its value and its subkeys
+//-----------------------------------------------------------------------------
+void KeyValues::RecursiveWriteBinary( CUtlBuffer &buf, CUtlVector< int > &symbols )
+{
+	// pointers mean nothing once they're on disk
+	int type = ( m_iDataType == TYPE_PTR ) ? TYPE_NONE : m_iDataType;
+	buf.PutUnsignedChar( type );
+
+	int index = symbols.Find( m_iKeyName );
+	if ( index == -1 )
+	{
+		index = symbols.AddToTail( m_iKeyName );
+	}
+	buf.PutUnsignedShort( index );
+
+	switch ( type )
+	{
+	case TYPE_STRING:
+		buf.PutString( m_sValue ? m_sValue : "" );
+		break;
+
+	case TYPE_INT:
+	case TYPE_FLOAT:
+		// text files keep the original string too
+		buf.PutString( m_sValue ? m_sValue : "" );
+		buf.PutInt( m_iValue );
+		break;
+
+	case TYPE_WSTRING:
+		{
+			int len = m_wsValue ? wcslen( m_wsValue ) : 0;
+			buf.PutInt( len );
+			for ( int i = 0; i < len; i++ )
+			{
+				buf.PutUnsignedShort( m_wsValue[i] );
+			}
+		}
+		break;
+
+	case TYPE_COLOR:
+		buf.Put( m_Color, sizeof( m_Color ) );
+		break;
+	}
+
+	for ( KeyValues *dat = m_pSub; dat; dat = dat->m_pPeer )
+	{
+		dat->RecursiveWriteBinary( buf, symbols );
+	}
+	buf.PutUnsignedChar( KEYVALUES_BINARY_END );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns a string in a binary buffer and skips it, NULL if it runs off the end
+//-----------------------------------------------------------------------------
+static const char *ReadBinaryString( CUtlBuffer &buf )
+{
+	int remaining = buf.Size() - buf.TellGet();
+	if ( !buf.IsValid() || remaining <= 0 )
+		return NULL;
+
+	const char *pString = (const char *)buf.PeekGet();
+	const char *pEnd = (const char *)memchr( pString, 0, remaining );
+	if ( !pEnd )
+		return NULL;
+
+	buf.SeekGet( CUtlBuffer::SEEK_CURRENT, pEnd - pString + 1 );
+	return pString;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads keys written by WriteAsBinary into this key and new peers
+//-----------------------------------------------------------------------------
+bool KeyValues::ReadAsBinary( CUtlBuffer &buf )
+{
+	// turn each name into a symbol once, the keys refer to them by index
+	int count = buf.GetInt();
+	if ( !buf.IsValid() || count < 0 || count >= 0xFFFF )
+		return false;
+
+	CUtlVector< int > symbols;
+	symbols.EnsureCapacity( count );
+	for ( int i = 0; i < count; i++ )
+	{
+		const char *pName = ReadBinaryString( buf );
+		if ( !pName )
+			return false;
+
+		symbols.AddToTail( KeyValuesSystem()->GetSymbolForString( pName ) );
+	}
+
+	KeyValues *pPrevious = NULL;
+	while ( true )
+	{
+		unsigned char type = buf.GetUnsignedChar();
+		if ( !buf.IsValid() )
+			return false;
+
+		if ( type == KEYVALUES_BINARY_END )
+			break;
+
+		if ( type > TYPE_COLOR )
+			return false;
+
+		KeyValues *dat = this;
+		if ( pPrevious )
+		{
+			dat = AllocKey();
+			dat->UsesEscapeSequences( m_bHasEscapeSequences );
+			pPrevious->SetNextKey( dat );
+		}
+
+		dat->m_iDataType = (types_t)type;
+		if ( !dat->RecursiveReadBinary( buf, symbols, 0 ) )
+			return false;
+
+		pPrevious = dat;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads a key's name, value and subkeys; m_iDataType is already set
+//-----------------------------------------------------------------------------
+bool KeyValues::RecursiveReadBinary( CUtlBuffer &buf, const CUtlVector< int > &symbols, int depth )
+{
+	if ( depth > KEYVALUES_BINARY_MAX_DEPTH )
+		return false;
+
+	int index = buf.GetUnsignedShort();
+	if ( !buf.IsValid() || index >= symbols.Count() )
+		return false;
+
+	m_iKeyName = symbols[index];
+
+	switch ( m_iDataType )
+	{
+	case TYPE_STRING:
+	case TYPE_INT:
+	case TYPE_FLOAT:
+		{
+			const char *pValue = ReadBinaryString( buf );
+			if ( !pValue )
+				return false;
+
+			int len = Q_strlen( pValue );
+			if ( len || m_iDataType == TYPE_STRING )
+			{
+				m_sValue = AllocString( len );
+				Q_memcpy( m_sValue, pValue, len+1 );
+			}
+
+			if ( m_iDataType != TYPE_STRING )
+			{
+				m_iValue = buf.GetInt();
+			}
+		}
+		break;
+
+	case TYPE_WSTRING:
+		{
+			int len = buf.GetInt();
+			if ( !buf.IsValid() || len < 0 || len * (int)sizeof( unsigned short ) > buf.Size() - buf.TellGet() )
+				return false;
+
+			m_wsValue = AllocWString( len );
+			for ( int i = 0; i < len; i++ )
+			{
+				m_wsValue[i] = buf.GetUnsignedShort();
+			}
+			m_wsValue[len] = 0;
+		}
+		break;
+
+	case TYPE_COLOR:
+		buf.Get( m_Color, sizeof( m_Color ) );
+		break;
+	}
+
+	// subkeys, linked as they're made so a failed read still frees them
+	KeyValues *pLastSub = NULL;
+	while ( true )
+	{
+		unsigned char type = buf.GetUnsignedChar();
+		if ( !buf.IsValid() )
+			return false;
+
+		if ( type == KEYVALUES_BINARY_END )
+			break;
+
+		if ( type > TYPE_COLOR )
+			return false;
+
+		KeyValues *dat = AllocKey();
+		dat->UsesEscapeSequences( m_bHasEscapeSequences );
+		dat->m_iDataType = (types_t)type;
+
+		if ( pLastSub )
+		{
+			pLastSub->SetNextKey( dat );
+		}
+		else
+		{
+			m_pSub = dat;
+		}
+		pLastSub = dat;
+
+		if ( !dat->RecursiveReadBinary( buf, symbols, depth + 1 ) )
+			return false;
+	}
+
+	return buf.IsValid();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Save the keyvalues to disk
 //			Creates the path to the file if it doesn't exist 
@@ -679,7 +1221,7 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 		if (bCreate)
 		{
 			// we need to create a new key
-			dat = new KeyValues( searchStr );
+			dat = AllocKey( searchStr );
 //			assert(dat != NULL);
 
 			// insert new key at end of list
@@ -746,7 +1288,7 @@ KeyValues *KeyValues::CreateNewKey()
 KeyValues* KeyValues::CreateKey( const char *keyName )
 {
 	// key wasn't found so just create a new one
-	KeyValues* dat = new KeyValues( keyName );
+	KeyValues* dat = AllocKey( keyName );
 
 	dat->UsesEscapeSequences( m_bHasEscapeSequences ); // use same format as parent does
 	
@@ -824,6 +1366,10 @@ KeyValues *KeyValues::GetNextKey()
 //-----------------------------------------------------------------------------
 void KeyValues::SetNextKey( KeyValues *pDat )
 {
+	// An arena doesn't free heap keys linked into it, and deleting a heap key doesn't
+	// free arena keys linked into it, so both have to come from the same place.
+	// MakeCopy( pArena ) moves keys between them.
+	Assert( !pDat || pDat->m_pArena == m_pArena );
 	m_pPeer = pDat;
 }
 
@@ -1060,9 +1606,9 @@ void KeyValues::SetString( const char *keyName, const char *value )
 	if ( dat )
 	{
 		// delete the old value
-		delete [] dat->m_sValue;
+		dat->FreeString( dat->m_sValue );
 		// make sure we're not storing the WSTRING  - as we're converting over to STRING
-		delete [] dat->m_wsValue;
+		dat->FreeWString( dat->m_wsValue );
 		dat->m_wsValue = NULL;
 
 		if (!value)
@@ -1073,7 +1619,7 @@ void KeyValues::SetString( const char *keyName, const char *value )
 
 		// allocate memory for the new value and copy it in
 		int len = Q_strlen( value );
-		dat->m_sValue = new char[len + 1];
+		dat->m_sValue = dat->AllocString( len );
 		Q_memcpy( dat->m_sValue, value, len+1 );
 
 		dat->m_iDataType = TYPE_STRING;
@@ -1090,9 +1636,9 @@ void KeyValues::SetWString( const char *keyName, const wchar_t *value )
 	if ( dat )
 	{
 		// delete the old value
-		delete[] dat->m_wsValue;
+		dat->FreeWString( dat->m_wsValue );
 		// make sure we're not storing the STRING  - as we're converting over to WSTRING
-		delete [] dat->m_sValue;
+		dat->FreeString( dat->m_sValue );
 		dat->m_sValue = NULL;
 
 		if (!value)
@@ -1103,7 +1649,7 @@ void KeyValues::SetWString( const char *keyName, const wchar_t *value )
 
 		// allocate memory for the new value and copy it in
 		int len = wcslen( value );
-		dat->m_wsValue = new wchar_t[len + 1];
+		dat->m_wsValue = dat->AllocWString( len );
 		Q_memcpy( dat->m_wsValue, value, (len+1) * sizeof(wchar_t) );
 
 		dat->m_iDataType = TYPE_WSTRING;
@@ -1174,20 +1720,20 @@ void KeyValues::RecursiveCopyKeyValues( KeyValues& src )
 		case TYPE_STRING:
 			if( src.m_sValue )
 			{
-				m_sValue = new char[Q_strlen(src.m_sValue) + 1];
+				m_sValue = AllocString( Q_strlen(src.m_sValue) );
 				Q_strcpy( m_sValue, src.m_sValue );
 			}
 			break;
 		case TYPE_INT:
 			m_iValue = src.m_iValue;
 			Q_snprintf( buf,sizeof(buf), "%d", m_iValue );
-			m_sValue = new char[strlen(buf) + 1];
+			m_sValue = AllocString( strlen(buf) );
 			Q_strcpy( m_sValue, buf );
 			break;
 		case TYPE_FLOAT:
 			m_flValue = src.m_flValue;
 			Q_snprintf( buf,sizeof(buf), "%f", m_flValue );
-			m_sValue = new char[strlen(buf) + 1];
+			m_sValue = AllocString( strlen(buf) );
 			Q_strcpy( m_sValue, buf );
 			break;
 		case TYPE_PTR:
@@ -1230,14 +1776,14 @@ void KeyValues::RecursiveCopyKeyValues( KeyValues& src )
 	// Handle the immediate child
 	if( src.m_pSub )
 	{
-		m_pSub = new KeyValues( NULL );
+		m_pSub = AllocKey( NULL );
 		m_pSub->RecursiveCopyKeyValues( *src.m_pSub );
 	}
 
 	// Handle the immediate peer
 	if( src.m_pPeer )
 	{
-		m_pPeer = new KeyValues( NULL );
+		m_pPeer = AllocKey( NULL );
 		m_pPeer->RecursiveCopyKeyValues( *src.m_pPeer );
 	}
 }
@@ -1250,11 +1796,11 @@ KeyValues& KeyValues::operator=( KeyValues& src )
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Makes a copy of the whole key-value pair set
+// Purpose: Makes a copy of the whole key-value pair set, in pArena if it's set
 //-----------------------------------------------------------------------------
-KeyValues *KeyValues::MakeCopy( void )
+KeyValues *KeyValues::MakeCopy( CKeyValuesArena *pArena )
 {
-	KeyValues *newKeyValue = new KeyValues(GetName());
+	KeyValues *newKeyValue = pArena ? CreateInArena( GetName(), pArena ) : new KeyValues(GetName());
 
 	// copy data
 	newKeyValue->m_iDataType = m_iDataType;
@@ -1266,7 +1812,7 @@ KeyValues *KeyValues::MakeCopy( void )
 			{
 				int len = Q_strlen( m_sValue );
 				assert( !newKeyValue->m_sValue );
-				newKeyValue->m_sValue = new char[len + 1];
+				newKeyValue->m_sValue = newKeyValue->AllocString( len );
 				Q_memcpy( newKeyValue->m_sValue, m_sValue, len+1 );
 			}
 		}
@@ -1276,7 +1822,7 @@ KeyValues *KeyValues::MakeCopy( void )
 			if ( m_wsValue )
 			{
 				int len = wcslen( m_wsValue );
-				newKeyValue->m_wsValue = new wchar_t[len+1];
+				newKeyValue->m_wsValue = newKeyValue->AllocWString( len );
 				Q_memcpy( newKeyValue->m_wsValue, m_wsValue, (len+1)*sizeof(wchar_t));
 			}
 		}
@@ -1309,7 +1855,7 @@ KeyValues *KeyValues::MakeCopy( void )
 	for ( KeyValues *sub = m_pSub; sub != NULL; sub = sub->m_pPeer )
 	{
 		// take a copy of the subkey
-		KeyValues *dat = sub->MakeCopy();
+		KeyValues *dat = sub->MakeCopy( pArena );
 		 
 		// add into subkey list
 		if (pPrev)
@@ -1348,7 +1894,10 @@ bool KeyValues::IsEmpty(const char *keyName)
 //-----------------------------------------------------------------------------
 void KeyValues::Clear( void )
 {
-	delete m_pSub;
+	if ( m_pSub )
+	{
+		m_pSub->deleteThis();
+	}
 	m_pSub = NULL;
 	m_iDataType = TYPE_NONE;
 }
@@ -1365,11 +1914,50 @@ KeyValues::types_t KeyValues::GetDataType(const char *keyName)
 	return TYPE_NONE;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: String allocation, from the arena this key is in if it's in one
+//-----------------------------------------------------------------------------
+char *KeyValues::AllocString( int len )
+{
+	if ( m_pArena )
+		return (char *)m_pArena->Alloc( len + 1, 1 );
+
+	return new char[len + 1];
+}
+
+wchar_t *KeyValues::AllocWString( int len )
+{
+	if ( m_pArena )
+		return (wchar_t *)m_pArena->Alloc( ( len + 1 ) * sizeof( wchar_t ), sizeof( wchar_t ) );
+
+	return new wchar_t[len + 1];
+}
+
+void KeyValues::FreeString( char *pString )
+{
+	if ( !m_pArena )
+	{
+		delete [] pString;
+	}
+}
+
+void KeyValues::FreeWString( wchar_t *pString )
+{
+	if ( !m_pArena )
+	{
+		delete [] pString;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Deletion, ensures object gets deleted from correct heap
 //-----------------------------------------------------------------------------
 void KeyValues::deleteThis()
 {
+	// keys in an arena are only freed with the arena
+	if ( m_pArena )
+		return;
+
 	delete this;
 }
 
@@ -1438,7 +2026,7 @@ void KeyValues::ParseIncludedKeys( char const *resourceName, const char *filetoi
 	// Append included file
 	Q_strcat( fullpath, filetoinclude );
 
-	KeyValues *newKV = new KeyValues( fullpath );
+	KeyValues *newKV = AllocKey( fullpath );
 
 	// CUtlSymbol save = s_CurrentFileSymbol;	// did that had any use ???
 
@@ -1496,7 +2084,7 @@ bool KeyValues::LoadFromBuffer( char const *resourceName, const char *pBuffer, I
 
 		if ( !pCurrentKey )
 		{
-			pCurrentKey = new KeyValues( s );
+			pCurrentKey = AllocKey( s );
 
 			pCurrentKey->UsesEscapeSequences( m_bHasEscapeSequences ); // same format has parent use
 
@@ -1593,11 +2181,11 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, char **pfile
 		{
 			if (dat->m_sValue)
 			{
-				delete[] dat->m_sValue;
+				dat->FreeString( dat->m_sValue );
 			}
 
 			int len = Q_strlen( value );
-			dat->m_sValue = new char[len+1];
+			dat->m_sValue = dat->AllocString( len );
 			Q_memcpy( dat->m_sValue, value, len+1 );
 
 			// Here, let's determine if we got a float or an int....
@@ -1653,4 +2241,52 @@ void KeyValues::operator delete( void *pMem )
 	KeyValuesSystem()->FreeKeyValuesMemory(pMem);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: arena allocator.  The delete is only called if a constructor throws.
+//-----------------------------------------------------------------------------
+void *KeyValues::operator new( unsigned int iAllocSize, CKeyValuesArena *pArena )
+{
+	return pArena->Alloc( iAllocSize );
+}
+
+void KeyValues::operator delete( void *pMem, CKeyValuesArena *pArena )
+{
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Creates a key whose whole tree lives in pArena
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::CreateInArena( const char *setName, CKeyValuesArena *pArena )
+{
+	KeyValues *dat = new( pArena ) KeyValues( setName );
+	dat->m_pArena = pArena;
+	return dat;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Allocates a new key in the same place as this one
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::AllocKey( const char *setName )
+{
+	if ( m_pArena )
+		return CreateInArena( setName, m_pArena );
+
+	return new KeyValues( setName );
+}
+
+KeyValues *KeyValues::AllocKey()
+{
+	KeyValues *dat;
+	if ( m_pArena )
+	{
+		dat = new( m_pArena ) KeyValues;
+		dat->m_pArena = m_pArena;
+	}
+	else
+	{
+		dat = new KeyValues;
+	}
+	return dat;
+}
+
 #include "tier0/memdbgon.h"
@@ -34,6 +34,44 @@ class CUtlBuffer;
 class Color;
 typedef void * FileHandle_t;
 
+//-----------------------------------------------------------------------------
+// Purpose: Growable block allocator that a whole KeyValues tree and its strings
+//			can live in (see KeyValues::CreateInArena).  Nothing allocated from it
+//			is freed individually; Clear() or the destructor frees it all at once.
+//-----------------------------------------------------------------------------
+class CKeyValuesArena
+{
+public:
+	CKeyValuesArena( int blockSize = 16384 );
+	~CKeyValuesArena();
+
+	void *Alloc( int size, int alignment = 8 );
+
+	// Frees every block.  Any KeyValues in the arena are gone after this.
+	void Clear();
+
+	// Stats
+	int GetAllocationCount() const	{ return m_nAllocations; }
+	int GetBlockCount() const		{ return m_nBlocks; }
+	int GetBytesUsed() const		{ return m_nBytesUsed; }
+
+private:
+	CKeyValuesArena( const CKeyValuesArena& );	// not copyable
+
+	struct Block_t
+	{
+		Block_t *m_pNext;
+		int		m_nSize;
+		int		m_nUsed;
+	};
+
+	Block_t *m_pBlocks;	// block being allocated from is first
+	int		m_nBlockSize;
+	int		m_nAllocations;
+	int		m_nBlocks;
+	int		m_nBytesUsed;
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Simple recursive data access class
 //			Used in vgui for message parameters and resource files
@@ -67,6 +105,11 @@ public:
 	KeyValues( const char *setName, const char *firstKey, const char *firstValue, const char *secondKey, const char *secondValue );
 	KeyValues( const char *setName, const char *firstKey, int firstValue, const char *secondKey, int secondValue );
 
+	// Creates a key whose sub keys and strings are all allocated in pArena.  deleteThis()
+	// does nothing on keys in an arena; the arena frees them when it's cleared or destroyed.
+	// Keys from an arena and keys from the heap can't be linked together, use MakeCopy.
+	static KeyValues *CreateInArena( const char *setName, CKeyValuesArena *pArena );
+
 	// Section name
 	const char *GetName();
 	void SetName( const char *setName);
@@ -82,6 +125,12 @@ public:
 	// Read from a buffer...  Note that the buffer must be null terminated
 	bool LoadFromBuffer( char const *resourceName, const char *pBuffer, IBaseFileSystem* pFileSystem = NULL, const char *pPathID = NULL );
 
+	// Binary format, used by the LoadFromFile cache. Writes this key and its peers (the
+	// top level keys of a file). Key names are stored once each and turned back into
+	// symbols once each when read, so reading doesn't tokenize or hash every key.
+	bool WriteAsBinary( CUtlBuffer &buf );
+	bool ReadAsBinary( CUtlBuffer &buf );
+
 	// Find a keyValue, create it if it is not found.
 	// Set bCreate to true to create the key if it doesn't already exist (which ensures a valid pointer will be returned)
 	KeyValues *FindKey(const char *keyName, bool bCreate = false);
@@ -92,7 +141,7 @@ public:
 	// Key iteration
 	KeyValues *GetFirstSubKey();	// returns the first subkey in the list
 	KeyValues *GetNextKey();		// returns the next subkey
-	void SetNextKey( KeyValues * pDat);
+	void SetNextKey( KeyValues * pDat);	// pDat must come from the same arena (or the heap) as this key
 
 	// Data access
 	int   GetInt( const char *keyName = NULL, int defaultValue = 0 );
@@ -123,8 +172,8 @@ public:
 	
 	void RecursiveSaveToFile( CUtlBuffer& buf, int indentLevel );
 
-	// Allocate & create a new copy of the keys
-	KeyValues *MakeCopy( void );
+	// Allocate & create a new copy of the keys, in pArena if it's set
+	KeyValues *MakeCopy( CKeyValuesArena *pArena = NULL );
 
 	// Clear out all subkeys, and the current value
 	void Clear( void );
@@ -147,11 +196,24 @@ public:
 
 private:
 	KeyValues( KeyValues& );	// prevent copy constructor being used
+	KeyValues();				// for ReadAsBinary, which sets the key name symbol itself
 
 	// prevent delete being called except through deleteThis()
 	~KeyValues();
 
 	KeyValues* CreateKey( const char *keyName );
+
+	// Arena allocation
+	void *operator new( unsigned int iAllocSize, CKeyValuesArena *pArena );
+	void operator delete( void *pMem, CKeyValuesArena *pArena );
+
+	// These allocate from the same arena as this key, or the heap if it isn't in one
+	KeyValues *AllocKey( const char *setName );
+	KeyValues *AllocKey();
+	char *AllocString( int len );
+	wchar_t *AllocWString( int len );
+	void FreeString( char *pString );
+	void FreeWString( wchar_t *pString );
 	
 	void RecursiveCopyKeyValues( KeyValues& src );
 	void RemoveEverything();
@@ -160,6 +222,10 @@ private:
 	
 	void RecursiveLoadFromBuffer( char const *resourceName, char **pfile );
 
+	void RecursiveWriteBinary( CUtlBuffer &buf, CUtlVector< int > &symbols );
+	bool RecursiveReadBinary( CUtlBuffer &buf, const CUtlVector< int > &symbols, int depth );
+	bool LoadFromBinaryCache( const char *pData, int nSize );
+
 	// For handling #include "filename"
 	void AppendIncludedKeys( CUtlVector< KeyValues * >& includedKeys );
 	void ParseIncludedKeys( char const *resourceName, const char *filetoinclude, 
@@ -191,6 +257,7 @@ private:
 	KeyValues *m_pSub;	// pointer to Start of a new sub key list
 	KeyValues *m_pChain;// Search here if it's not in our list
 	bool	   m_bHasEscapeSequences; // true, if while parsing this KeyValue, Escape Sequences are used (default false)
+	CKeyValuesArena *m_pArena;	// arena this key and its strings live in, if any
 };
 
 #endif // KEYVALUES_H
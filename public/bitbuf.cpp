@@ -71,6 +71,91 @@ public:
 CBitWriteMasksInit g_BitWriteMasksInit;
 
 
+//-----------------------------------------------------------------------------
+// Gathers a run of small fields in a 64 bit accumulator so they go into the
+// buffer a whole dword at a time instead of one WriteUBitLong per field.
+// Fields must already be masked to their size.
+//-----------------------------------------------------------------------------
+class CBitWriteAccumulator
+{
+public:
+	inline CBitWriteAccumulator( bf_write *pBuf ) : m_pBuf( pBuf ), m_Bits( 0 ), m_nBits( 0 ) {}
+
+	inline void Put( unsigned int data, int numbits )
+	{
+		Assert( numbits >= 0 && numbits <= 32 );
+		m_Bits |= (uint64)data << m_nBits;
+		m_nBits += numbits;
+		if ( m_nBits >= 32 )
+		{
+			m_pBuf->WriteUBitLong( (unsigned int)m_Bits, 32, false );
+			m_Bits >>= 32;
+			m_nBits -= 32;
+		}
+	}
+
+	inline void Flush()
+	{
+		if ( m_nBits )
+		{
+			m_pBuf->WriteUBitLong( (unsigned int)m_Bits, m_nBits, false );
+			m_Bits = 0;
+			m_nBits = 0;
+		}
+	}
+
+private:
+	bf_write	*m_pBuf;
+	uint64		m_Bits;
+	int			m_nBits;
+};
+
+
+//-----------------------------------------------------------------------------
+// Packs a coord the way WriteBitCoord always has: integer and fraction flags,
+// then the sign, integer and fraction if there are any.  Returns the bits
+// (at most 22 of them) and sets numbits.
+//-----------------------------------------------------------------------------
+static inline unsigned int EncodeBitCoord( float f, int &numbits )
+{
+	unsigned int signbit = (f <= -COORD_RESOLUTION);
+	unsigned int intval = (int)abs(f);
+	unsigned int fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
+
+	// All ones if the part is there, zero if not
+	unsigned int intmask = 0 - (unsigned int)( intval != 0 );
+	unsigned int fractmask = 0 - (unsigned int)( fractval != 0 );
+	unsigned int anymask = intmask | fractmask;
+
+	unsigned int bits = ( intmask & 1 ) | ( fractmask & 2 ) | ( ( signbit << 2 ) & anymask );
+	int nBits = 2 + ( anymask & 1 );
+
+	// Adjust the integers from [1..MAX_COORD_VALUE] to [0..MAX_COORD_VALUE-1]
+	bits |= ( ( intval - 1 ) & ( (1 << COORD_INTEGER_BITS) - 1 ) & intmask ) << nBits;
+	nBits += COORD_INTEGER_BITS & intmask;
+
+	bits |= ( fractval & fractmask ) << nBits;
+	nBits += COORD_FRACTIONAL_BITS & fractmask;
+
+	numbits = nBits;
+	return bits;
+}
+
+//-----------------------------------------------------------------------------
+// The sign bit, then the fraction clamped to the denominator
+//-----------------------------------------------------------------------------
+static inline unsigned int EncodeBitNormal( float f )
+{
+	unsigned int signbit = (f <= -NORMAL_RESOLUTION);
+
+	// NOTE: Since +/-1 are valid values for a normal, I'm going to encode that as all ones
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+	fractval = ( fractval > NORMAL_DENOMINATOR ) ? NORMAL_DENOMINATOR : fractval;
+
+	return signbit | ( fractval << 1 );
+}
+
+
 // ---------------------------------------------------------------------------------------- //
 // bf_write
 // ---------------------------------------------------------------------------------------- //
@@ -159,10 +244,6 @@ void bf_write::WriteSBitLong( int data, int numbits )
 	// Do we have a valid # of bits to encode with?
 	Assert( numbits >= 1 );
 
-	// Note: it does this wierdness here so it's bit-compatible with regular integer data in the buffer.
-	// (Some old code writes direct integers right into the buffer).
-	if(data < 0)
-	{
 #ifdef _DEBUG
 	if( numbits < 32 )
 	{
@@ -179,14 +260,13 @@ void bf_write::WriteSBitLong( int data, int numbits )
 	}
 #endif
 
-		WriteUBitLong( (unsigned int)(0x80000000 + data), numbits - 1, false );
-		WriteOneBit( 1 );
-	}
-	else
-	{
-		WriteUBitLong((unsigned int)data, numbits - 1);
-		WriteOneBit( 0 );
-	}
+	// Note: it does this wierdness here so it's bit-compatible with regular integer data in the buffer.
+	// (Some old code writes direct integers right into the buffer).
+	// The low numbits-1 bits go first and the sign bit on top, which is one write.
+	unsigned int lowbits = (unsigned int)data & ( ( 1u << ( numbits - 1 ) ) - 1 );
+	unsigned int signbit = (unsigned int)data >> 31;
+
+	WriteUBitLong( lowbits | ( signbit << ( numbits - 1 ) ), numbits, false );
 }
 
 void bf_write::WriteBitLong(unsigned int data, int numbits, bool bSigned)
@@ -206,6 +286,16 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 	unsigned char *pOut = (unsigned char*)pInData;
 	int nBitsLeft = nBits;
 
+	// If we're on a byte boundary the whole bytes can just be copied in.
+	// The buffer is stored little endian, so this is the same as writing them a dword at a time.
+	if ( ( m_iCurBit & 7 ) == 0 && m_iCurBit + nBits <= m_nDataBits )
+	{
+		int nBytes = nBitsLeft >> 3;
+		memcpy( m_pData + ( m_iCurBit >> 3 ), pOut, nBytes );
+		m_iCurBit += nBytes << 3;
+		pOut += nBytes;
+		nBitsLeft -= nBytes << 3;
+	}
 	
 	// Get output dword-aligned.
 	while(((unsigned long)pOut & 3) != 0 && nBitsLeft >= 8)
@@ -275,34 +365,10 @@ void bf_write::WriteBitCoord (const float f)
 #if defined( BB_PROFILING )
 	MEASURECODE( "bf_write::WriteBitCoord" );
 #endif
-	int		signbit = (f <= -COORD_RESOLUTION);
-	int		intval = (int)abs(f);
-	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
-
-
-	// Send the bit flags that indicate whether we have an integer part and/or a fraction part.
-	WriteOneBit( intval );
-	WriteOneBit( fractval );
-
-	if ( intval || fractval )
-	{
-		// Send the sign bit
-		WriteOneBit( signbit );
-
-		// Send the integer if we have one.
-		if ( intval )
-		{
-			// Adjust the integers from [1..MAX_COORD_VALUE] to [0..MAX_COORD_VALUE-1]
-			intval--;
-			WriteUBitLong( (unsigned int)intval, COORD_INTEGER_BITS );
-		}
-		
-		// Send the fraction if we have one
-		if ( fractval )
-		{
-			WriteUBitLong( (unsigned int)fractval, COORD_FRACTIONAL_BITS );
-		}
-	}
+	// The flags, sign, integer and fraction all fit in one write
+	int nBits;
+	unsigned int bits = EncodeBitCoord( f, nBits );
+	WriteUBitLong( bits, nBits, false );
 }
 
 void bf_write::WriteBitFloat(float val)
@@ -318,60 +384,52 @@ void bf_write::WriteBitFloat(float val)
 
 void bf_write::WriteBitVec3Coord( const Vector& fa )
 {
-	int		xflag, yflag, zflag;
+	unsigned int	xflag, yflag, zflag;
 
 	xflag = (fa[0] >= COORD_RESOLUTION) || (fa[0] <= -COORD_RESOLUTION);
 	yflag = (fa[1] >= COORD_RESOLUTION) || (fa[1] <= -COORD_RESOLUTION);
 	zflag = (fa[2] >= COORD_RESOLUTION) || (fa[2] <= -COORD_RESOLUTION);
 
-	WriteOneBit( xflag );
-	WriteOneBit( yflag );
-	WriteOneBit( zflag );
+	CBitWriteAccumulator bits( this );
+	bits.Put( xflag | (yflag << 1) | (zflag << 2), 3 );
 
-	if ( xflag )
-		WriteBitCoord( fa[0] );
-	if ( yflag )
-		WriteBitCoord( fa[1] );
-	if ( zflag )
-		WriteBitCoord( fa[2] );
+	// Components without a flag are dropped by masking them down to nothing
+	int nBits;
+	unsigned int coord = EncodeBitCoord( fa[0], nBits );
+	bits.Put( coord & (0 - xflag), nBits & (0 - xflag) );
+	coord = EncodeBitCoord( fa[1], nBits );
+	bits.Put( coord & (0 - yflag), nBits & (0 - yflag) );
+	coord = EncodeBitCoord( fa[2], nBits );
+	bits.Put( coord & (0 - zflag), nBits & (0 - zflag) );
+
+	bits.Flush();
 }
 
 void bf_write::WriteBitNormal( float f )
 {
-	int	signbit = (f <= -NORMAL_RESOLUTION);
-
-	// NOTE: Since +/-1 are valid values for a normal, I'm going to encode that as all ones
-	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
-
-	// clamp..
-	if (fractval > NORMAL_DENOMINATOR)
-		fractval = NORMAL_DENOMINATOR;
-
-	// Send the sign bit
-	WriteOneBit( signbit );
-
-	// Send the fractional component
-	WriteUBitLong( fractval, NORMAL_FRACTIONAL_BITS );
+	// Send the sign bit and the fractional component
+	WriteUBitLong( EncodeBitNormal( f ), NORMAL_FRACTIONAL_BITS + 1, false );
 }
 
 void bf_write::WriteBitVec3Normal( const Vector& fa )
 {
-	int		xflag, yflag;
+	unsigned int	xflag, yflag;
 
 	xflag = (fa[0] >= NORMAL_RESOLUTION) || (fa[0] <= -NORMAL_RESOLUTION);
 	yflag = (fa[1] >= NORMAL_RESOLUTION) || (fa[1] <= -NORMAL_RESOLUTION);
 
-	WriteOneBit( xflag );
-	WriteOneBit( yflag );
+	CBitWriteAccumulator bits( this );
+	bits.Put( xflag | (yflag << 1), 2 );
 
-	if ( xflag )
-		WriteBitNormal( fa[0] );
-	if ( yflag )
-		WriteBitNormal( fa[1] );
+	unsigned int nNormalBits = NORMAL_FRACTIONAL_BITS + 1;
+	bits.Put( EncodeBitNormal( fa[0] ) & (0 - xflag), nNormalBits & (0 - xflag) );
+	bits.Put( EncodeBitNormal( fa[1] ) & (0 - yflag), nNormalBits & (0 - yflag) );
 	
 	// Write z sign bit
-	int	signbit = (fa[2] <= -NORMAL_RESOLUTION);
-	WriteOneBit( signbit );
+	unsigned int signbit = (fa[2] <= -NORMAL_RESOLUTION);
+	bits.Put( signbit, 1 );
+
+	bits.Flush();
 }
 
 void bf_write::WriteBitAngles( const QAngle& fa )
@@ -420,11 +478,9 @@ bool bf_write::WriteString(const char *pStr)
 {
 	if(pStr)
 	{
-		do
-		{
-			WriteChar( *pStr );
-			++pStr;
-		} while( *(pStr-1) != 0 );
+		// A char is eight bits whether it's written signed or not, so the
+		// string and its terminator can go in as bytes
+		WriteBytes( pStr, (int)strlen( pStr ) + 1 );
 	}
 	else
 	{
@@ -530,6 +586,15 @@ bool bf_read::ReadBits(void *pOutData, int nBits)
 	unsigned char *pOut = (unsigned char*)pOutData;
 	int nBitsLeft = nBits;
 
+	// On a byte boundary the whole bytes can just be copied out
+	if ( ( m_iCurBit & 7 ) == 0 && m_iCurBit + nBits <= m_nDataBits )
+	{
+		int nBytes = nBitsLeft >> 3;
+		memcpy( pOut, m_pData + ( m_iCurBit >> 3 ), nBytes );
+		m_iCurBit += nBytes << 3;
+		pOut += nBytes;
+		nBitsLeft -= nBytes << 3;
+	}
 	
 	// Get output dword-aligned.
 	while(((unsigned long)pOut & 3) != 0 && nBitsLeft >= 8)
@@ -614,17 +679,14 @@ unsigned int bf_read::PeekUBitLong( int numbits )
 // Append numbits least significant bits from data to the current bit stream
 int bf_read::ReadSBitLong( int numbits )
 {
-	int r, sign;
-
-	r = ReadUBitLong(numbits - 1);
-
 	// Note: it does this wierdness here so it's bit-compatible with regular integer data in the buffer.
 	// (Some old code writes direct integers right into the buffer).
-	sign = ReadOneBit();
-	if(sign)
-		r = -((1 << (numbits-1)) - r);
+	// The sign bit is on top of the low numbits-1 bits, so one read and a sign
+	// extension gets the value.
+	int r = (int)ReadUBitLong( numbits );
+	int shift = 32 - numbits;
 
-	return r;
+	return (int)( (unsigned int)r << shift ) >> shift;
 }
 
 
@@ -648,27 +710,27 @@ float bf_read::ReadBitCoord (void)
 
 
 	// Read the required integer and fraction flags
-	intval = ReadOneBit();
-	fractval = ReadOneBit();
+	unsigned int flags = ReadUBitLong( 2 );
 
 	// If we got either parse them, otherwise it's a zero.
-	if ( intval || fractval )
+	if ( flags )
 	{
-		// Read the sign bit
-		signbit = ReadOneBit();
+		// All ones if the part is there, zero if not
+		unsigned int intmask = 0 - ( flags & 1 );
+		unsigned int fractmask = 0 - ( flags >> 1 );
 
-		// If there's an integer, read it in
-		if ( intval )
-		{
-			// Adjust the integers from [0..MAX_COORD_VALUE-1] to [1..MAX_COORD_VALUE]
-			intval = ReadUBitLong( COORD_INTEGER_BITS ) + 1;
-		}
+		// The sign, integer and fraction are next to each other, read them in one go
+		int nBits = 1 + ( COORD_INTEGER_BITS & intmask ) + ( COORD_FRACTIONAL_BITS & fractmask );
+		unsigned int bits = ReadUBitLong( nBits );
 
-		// If there's a fraction, read it in
-		if ( fractval )
-		{
-			fractval = ReadUBitLong( COORD_FRACTIONAL_BITS );
-		}
+		signbit = bits & 1;
+		bits >>= 1;
+
+		// Adjust the integers from [0..MAX_COORD_VALUE-1] to [1..MAX_COORD_VALUE]
+		intval = ( ( bits & ( (1 << COORD_INTEGER_BITS) - 1 ) ) + 1 ) & intmask;
+		bits >>= COORD_INTEGER_BITS & intmask;
+
+		fractval = bits & ( COORD_DENOMINATOR - 1 ) & fractmask;
 
 		// Calculate the correct floating point value
 		value = intval + ((float)fractval * COORD_RESOLUTION);
@@ -689,9 +751,10 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 	// the corresponding component will not be read and will be stack garbage.
 	fa.Init( 0, 0, 0 );
 
-	xflag = ReadOneBit();
-	yflag = ReadOneBit(); 
-	zflag = ReadOneBit();
+	unsigned int flags = ReadUBitLong( 3 );
+	xflag = flags & 1;
+	yflag = (flags >> 1) & 1;
+	zflag = flags >> 2;
 
 	if ( xflag )
 		fa[0] = ReadBitCoord();
@@ -703,11 +766,10 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 
 float bf_read::ReadBitNormal (void)
 {
-	// Read the sign bit
-	int	signbit = ReadOneBit();
-
-	// Read the fractional part
-	unsigned int fractval = ReadUBitLong( NORMAL_FRACTIONAL_BITS );
+	// Read the sign bit and the fractional part
+	unsigned int bits = ReadUBitLong( NORMAL_FRACTIONAL_BITS + 1 );
+	int	signbit = bits & 1;
+	unsigned int fractval = bits >> 1;
 
 	// Calculate the correct floating point value
 	float value = (float)fractval * NORMAL_RESOLUTION;
@@ -721,8 +783,9 @@ float bf_read::ReadBitNormal (void)
 
 void bf_read::ReadBitVec3Normal( Vector& fa )
 {
-	int xflag = ReadOneBit();
-	int yflag = ReadOneBit(); 
+	unsigned int flags = ReadUBitLong( 2 );
+	int xflag = flags & 1;
+	int yflag = flags >> 1;
 
 	if (xflag)
 		fa[0] = ReadBitNormal();
@@ -800,7 +863,8 @@ bool bf_read::ReadString( char *pStr, int maxLen, bool bLine, int *pOutNumChars
 	int iChar = 0;
 	while(1)
 	{
-		char val = ReadChar();
+		// Same bits as ReadChar, without splitting off the sign
+		char val = (char)ReadUBitLong( 8 );
 		if ( val == 0 )
 			break;
 		else if ( bLine && val == '\n' )
@@ -87,6 +87,54 @@ struct FileSystemStatistics
 		   nSeeks;
 };
 
+//-----------------------------------------------------------------------------
+// Asynchronous reads
+//-----------------------------------------------------------------------------
+
+enum FSAsyncStatus_t
+{
+	FSASYNC_ERR_FILEOPEN	= -2,	// The file couldn't be found or opened
+	FSASYNC_ERR_READING		= -1,	// Read failed, or the request was past the end of the file
+	FSASYNC_OK				= 0,	// Done. The data is in the buffer.
+	FSASYNC_STATUS_PENDING,			// Queued and waiting for an I/O thread
+	FSASYNC_STATUS_INPROGRESS,		// Being read right now
+	FSASYNC_STATUS_ABORTED,			// Aborted before it was read
+};
+
+struct FileAsyncRequest_t;
+
+// Called when a read finishes, on whichever thread did the read. request.pData is the buffer
+// the data went into (the filesystem's buffer if the caller passed NULL).
+typedef void (*FSAsyncCallbackFunc_t)( const FileAsyncRequest_t &request, int nBytesRead, FSAsyncStatus_t err );
+
+// Handle to a queued read. Get one back from AsyncRead and give it to AsyncRelease when you're done.
+typedef void *FSAsyncControl_t;
+
+struct FileAsyncRequest_t
+{
+	FileAsyncRequest_t()
+	{
+		pszFilename = 0;
+		pszPathID = 0;
+		nOffset = 0;
+		nBytes = 0;
+		pData = 0;
+		priority = 0;
+		pfnCallback = 0;
+		pContext = 0;
+	}
+
+	const char				*pszFilename;	// The filesystem makes its own copy of this
+	const char				*pszPathID;		// NULL to look in all search paths
+	int						nOffset;		// Where to start reading in the file
+	int						nBytes;			// How much to read. 0 reads to the end of the file.
+	void					*pData;			// Where to put it. If it's NULL, the filesystem mallocs
+											// a buffer that the caller has to free.
+	int						priority;		// Higher numbers get read first
+	FSAsyncCallbackFunc_t	pfnCallback;	// Optional
+	void					*pContext;		// For the caller's use
+};
+
 //-----------------------------------------------------------------------------
 // Main file system interface
 //-----------------------------------------------------------------------------
@@ -121,7 +169,7 @@ public:
 
 
 
-#define FILESYSTEM_INTERFACE_VERSION			"VFileSystem009"
+#define FILESYSTEM_INTERFACE_VERSION			"VFileSystem011"
 
 class IFileSystem : public IBaseFileSystem, public IAppSystem
 {
@@ -210,6 +258,30 @@ public:
 	virtual void			PrintSearchPaths( void ) = 0;
 
 	virtual void			UnloadModule( CSysModule *pModule ) = 0;
+
+	// Returns a read-only pointer to the whole contents of an open file without copying
+	// it, or NULL if the file isn't stored in a memory-mapped pack file (use Read then).
+	// The pointer is good until the file is closed. It doesn't move the file position.
+	virtual const void		*GetReadOnlyFileData( FileHandle_t file, unsigned int *pSize = 0 ) = 0;
+
+	// Asynchronous reads. The file is looked up right away on the calling thread (so call this
+	// from the same thread that does everything else with the filesystem), then the read is queued
+	// for the I/O threads. Reads that are next to each other in the same file get done together.
+	// If pControl is non-NULL, it gets a handle that has to be released with AsyncRelease.
+	// Returns FSASYNC_OK if it was queued, or an error right away (without calling the callback)
+	// if the file can't be found or the offset is past the end of it.
+	virtual FSAsyncStatus_t	AsyncRead( const FileAsyncRequest_t &request, FSAsyncControl_t *pControl = 0 ) = 0;
+
+	// Gets the status of a read. If bWait is true, this blocks until the read is done (and moves
+	// it to the front of the queue if it hasn't started). ppData and pnBytesRead are filled in
+	// once the read is done, even if it came up short (FSASYNC_ERR_READING).
+	virtual FSAsyncStatus_t	AsyncFinish( FSAsyncControl_t control, bool bWait = true, void **ppData = 0, int *pnBytesRead = 0 ) = 0;
+
+	// Takes a read off the queue if it hasn't started yet (the filesystem frees its buffer if it
+	// made one). If it's already being read, this waits for it to finish.
+	virtual FSAsyncStatus_t	AsyncAbort( FSAsyncControl_t control ) = 0;
+	virtual void			AsyncSetPriority( FSAsyncControl_t control, int newPriority ) = 0;
+	virtual void			AsyncRelease( FSAsyncControl_t control ) = 0;
 };
 
 
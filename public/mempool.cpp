@@ -8,6 +8,9 @@
 // Purpose: 
 //=============================================================================
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
 #include "mempool.h"
 
 #include <stdio.h>
@@ -276,4 +279,602 @@ void CMemoryPool::Free( void *memBlock )
 }
 
 
+//-----------------------------------------------------------------------------
+//
+// CMemoryPoolMT
+//
+//-----------------------------------------------------------------------------
+
+// Most blocks a thread keeps on its own free list, it swaps half of them with
+// the blobs at a time
+#define MEMPOOL_MT_MAX_CACHE		64
+
+CMemoryPoolMT *CMemoryPoolMT::s_pPools = 0;
+
+struct CMemoryPoolMT::Lock_t
+{
+#ifdef _WIN32
+	Lock_t()		{ InitializeCriticalSection( &m_CS ); }
+	~Lock_t()		{ DeleteCriticalSection( &m_CS ); }
+	void Lock()		{ EnterCriticalSection( &m_CS ); }
+	void Unlock()	{ LeaveCriticalSection( &m_CS ); }
+
+	CRITICAL_SECTION m_CS;
+#else
+	void Lock()		{}
+	void Unlock()	{}
+#endif
+};
+
+struct CMemoryPoolMT::Blob_t
+{
+	Blob_t		*m_pNextPartial, *m_pPrevPartial;
+	void		*m_pFreeList;
+	int			m_NumFree;
+	int			m_NumBlocks;
+	int			m_NumBytes;
+	char		*m_pData;
+};
+
+// Blocks a thread has freed or taken from the blobs but not handed out yet
+struct CMemoryPoolMT::ThreadCache_t
+{
+	void			*m_pFreeList;
+	int				m_Count;
+	int				m_FlushCount;	// the pool's m_FlushCount when this was last emptied
+	ThreadCache_t	*m_pNext;
+#ifdef _WIN32
+	HANDLE			m_hThread;		// signaled once the thread has exited
+#endif
+};
+
+// The blob data starts this far in so blocks are as aligned as malloc's
+#define MEMPOOL_MT_BLOB_HEADER		( ( sizeof( CMemoryPoolMT::Blob_t ) + 15 ) & ~15 )
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMemoryPoolMT::CMemoryPoolMT( int blockSize, int numElements, int growMode, const char *pName )
+{
+	m_pName = pName ? pName : "unnamed";
+	m_BlockSize = blockSize < sizeof(void*) ? sizeof(void*) : blockSize;
+	m_BlocksPerBlob = numElements;
+	m_GrowMode = growMode;
+
+	// Don't let the threads sit on more than half a blob
+	m_CacheSize = numElements / 2;
+	if ( m_CacheSize > MEMPOOL_MT_MAX_CACHE )
+	{
+		m_CacheSize = MEMPOOL_MT_MAX_CACHE;
+	}
+	else if ( m_CacheSize < 2 )
+	{
+		m_CacheSize = 2;
+	}
+
+	m_pLock = new Lock_t;
+#ifdef _WIN32
+	m_TlsIndex = TlsAlloc();
+	Assert( m_TlsIndex != TLS_OUT_OF_INDEXES );
+#endif
+
+	m_NumBlobs = 0;
+	m_pPartialBlobs = 0;
+	m_pThreadCaches = 0;
+	m_FlushCount = 0;
+	m_BlocksOut = 0;
+	m_PeakOut = 0;
+
+	m_pNextPool = s_pPools;
+	s_pPools = this;
+}
+
+CMemoryPoolMT::~CMemoryPoolMT()
+{
+	if ( m_BlocksOut > CountCachedBlocks() )
+	{
+		ReportLeaks();
+	}
+	Clear();
+
+	ThreadCache_t *pNext;
+	for ( ThreadCache_t *pCache = m_pThreadCaches; pCache; pCache = pNext )
+	{
+		pNext = pCache->m_pNext;
+#ifdef _WIN32
+		if ( pCache->m_hThread )
+		{
+			CloseHandle( pCache->m_hThread );
+		}
+#endif
+		free( pCache );
+	}
+
+#ifdef _WIN32
+	TlsFree( m_TlsIndex );
+#endif
+	delete m_pLock;
+
+	for ( CMemoryPoolMT **ppPool = &s_pPools; *ppPool; ppPool = &(*ppPool)->m_pNextPool )
+	{
+		if ( *ppPool == this )
+		{
+			*ppPool = m_pNextPool;
+			break;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Frees everything
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::Clear()
+{
+	m_pLock->Lock();
+
+	for ( int i = 0; i < m_NumBlobs; ++i )
+	{
+		free( m_Blobs[i] );
+	}
+	m_Blobs.Purge();
+	m_NumBlobs = 0;
+	m_pPartialBlobs = 0;
+
+	// The caches point into the blobs
+	for ( ThreadCache_t *pCache = m_pThreadCaches; pCache; pCache = pCache->m_pNext )
+	{
+		pCache->m_pFreeList = 0;
+		pCache->m_Count = 0;
+	}
+	m_BlocksOut = 0;
+
+	m_pLock->Unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+// Gets the calling thread's cache, making it the first time through
+//-----------------------------------------------------------------------------
+CMemoryPoolMT::ThreadCache_t *CMemoryPoolMT::GetThreadCache()
+{
+#ifdef _WIN32
+	ThreadCache_t *pCache = (ThreadCache_t *)TlsGetValue( m_TlsIndex );
+	if ( pCache )
+		return pCache;
+#else
+	// Everything's on one thread
+	if ( m_pThreadCaches )
+		return m_pThreadCaches;
+	ThreadCache_t *pCache;
+#endif
+
+	pCache = (ThreadCache_t *)malloc( sizeof( ThreadCache_t ) );
+	pCache->m_pFreeList = 0;
+	pCache->m_Count = 0;
+	pCache->m_FlushCount = m_FlushCount;
+#ifdef _WIN32
+	// GetCurrentThread is only a pseudo handle, this gets one that can be
+	// waited on from other threads
+	if ( !DuplicateHandle( GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), 
+		&pCache->m_hThread, SYNCHRONIZE, FALSE, 0 ) )
+	{
+		pCache->m_hThread = 0;
+	}
+#endif
+
+	m_pLock->Lock();
+	pCache->m_pNext = m_pThreadCaches;
+	m_pThreadCaches = pCache;
+	m_pLock->Unlock();
+
+#ifdef _WIN32
+	TlsSetValue( m_TlsIndex, pCache );
+#endif
+	return pCache;
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds the blob a block came from.  The lock must be held.
+//-----------------------------------------------------------------------------
+CMemoryPoolMT::Blob_t *CMemoryPoolMT::FindBlob( void *pMem )
+{
+	int nLow = 0;
+	int nHigh = m_NumBlobs - 1;
+	while ( nLow <= nHigh )
+	{
+		int nMid = ( nLow + nHigh ) >> 1;
+		Blob_t *pBlob = m_Blobs[nMid];
+		if ( (char *)pMem < pBlob->m_pData )
+		{
+			nHigh = nMid - 1;
+		}
+		else if ( (char *)pMem >= pBlob->m_pData + pBlob->m_NumBytes )
+		{
+			nLow = nMid + 1;
+		}
+		else
+		{
+			return pBlob;
+		}
+	}
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Makes a new blob and puts it at the front of the partial list.  The lock
+// must be held.
+//-----------------------------------------------------------------------------
+CMemoryPoolMT::Blob_t *CMemoryPoolMT::AddNewBlob()
+{
+	int sizeMultiplier;
+	if ( m_GrowMode == CMemoryPool::GROW_SLOW )
+	{
+		sizeMultiplier = 1;
+	}
+	else if ( m_GrowMode == CMemoryPool::GROW_NONE )
+	{
+		// Can only have one allocation when we're in this mode
+		if ( m_NumBlobs != 0 )
+			return 0;
+		sizeMultiplier = 1;
+	}
+	else
+	{
+		sizeMultiplier = m_NumBlobs + 1;
+	}
+
+	int nElements = m_BlocksPerBlob * sizeMultiplier;
+	int blobSize = m_BlockSize * nElements;
+	Blob_t *pBlob = (Blob_t *)malloc( MEMPOOL_MT_BLOB_HEADER + blobSize );
+	Assert( pBlob );
+	if ( !pBlob )
+		return 0;
+
+	pBlob->m_pData = (char *)pBlob + MEMPOOL_MT_BLOB_HEADER;
+	pBlob->m_NumBytes = blobSize;
+	pBlob->m_NumBlocks = nElements;
+	pBlob->m_NumFree = nElements;
+
+	// setup the free list
+	pBlob->m_pFreeList = pBlob->m_pData;
+	void **newBlob = (void **)pBlob->m_pFreeList;
+	for ( int j = 0; j < nElements-1; j++ )
+	{
+		newBlob[0] = (char *)newBlob + m_BlockSize;
+		newBlob = (void **)newBlob[0];
+	}
+	newBlob[0] = NULL;
+
+	// keep the blobs sorted by address
+	if ( m_NumBlobs >= m_Blobs.NumAllocated() )
+	{
+		m_Blobs.Grow();
+	}
+	int i;
+	for ( i = m_NumBlobs; i > 0 && m_Blobs[i-1] > pBlob; --i )
+	{
+		m_Blobs[i] = m_Blobs[i-1];
+	}
+	m_Blobs[i] = pBlob;
+	m_NumBlobs++;
+
+	pBlob->m_pPrevPartial = 0;
+	pBlob->m_pNextPartial = m_pPartialBlobs;
+	if ( m_pPartialBlobs )
+	{
+		m_pPartialBlobs->m_pPrevPartial = pBlob;
+	}
+	m_pPartialBlobs = pBlob;
+
+	return pBlob;
+}
+
+
+//-----------------------------------------------------------------------------
+// Moves half a cache's worth of blocks from the blobs to a thread's cache
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::RefillThreadCache( ThreadCache_t *pCache )
+{
+	int nWanted = m_CacheSize / 2;
+
+	m_pLock->Lock();
+
+	while ( pCache->m_Count < nWanted )
+	{
+		Blob_t *pBlob = m_pPartialBlobs;
+		if ( !pBlob )
+		{
+			pBlob = AddNewBlob();
+			if ( !pBlob )
+				break;
+		}
+
+		void *pBlock = pBlob->m_pFreeList;
+		pBlob->m_pFreeList = *((void**)pBlock);
+		if ( --pBlob->m_NumFree == 0 )
+		{
+			m_pPartialBlobs = pBlob->m_pNextPartial;
+			if ( m_pPartialBlobs )
+			{
+				m_pPartialBlobs->m_pPrevPartial = 0;
+			}
+		}
+
+		*((void**)pBlock) = pCache->m_pFreeList;
+		pCache->m_pFreeList = pBlock;
+		pCache->m_Count++;
+		m_BlocksOut++;
+	}
+	m_PeakOut = max( m_PeakOut, m_BlocksOut );
+
+	m_pLock->Unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+// Gives a thread's cached blocks back to their blobs, down to nKeep
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::FlushThreadCache( ThreadCache_t *pCache, int nKeep )
+{
+	m_pLock->Lock();
+
+	while ( pCache->m_Count > nKeep )
+	{
+		void *pBlock = pCache->m_pFreeList;
+		pCache->m_pFreeList = *((void**)pBlock);
+		pCache->m_Count--;
+
+		Blob_t *pBlob = FindBlob( pBlock );
+		Assert( pBlob );
+
+		*((void**)pBlock) = pBlob->m_pFreeList;
+		pBlob->m_pFreeList = pBlock;
+		if ( pBlob->m_NumFree++ == 0 )
+		{
+			pBlob->m_pPrevPartial = 0;
+			pBlob->m_pNextPartial = m_pPartialBlobs;
+			if ( m_pPartialBlobs )
+			{
+				m_pPartialBlobs->m_pPrevPartial = pBlob;
+			}
+			m_pPartialBlobs = pBlob;
+		}
+		m_BlocksOut--;
+	}
+	pCache->m_FlushCount = m_FlushCount;
+
+	m_pLock->Unlock();
+}
+
+
+//-----------------------------------------------------------------------------
+// Gives back the blocks cached by threads that have exited, and frees their
+// caches.  Nothing else would ever empty them.  Call with the lock held.
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::FlushExitedThreadCaches()
+{
+#ifdef _WIN32
+	ThreadCache_t **ppCache = &m_pThreadCaches;
+	while ( *ppCache )
+	{
+		ThreadCache_t *pCache = *ppCache;
+		if ( !pCache->m_hThread || WaitForSingleObject( pCache->m_hThread, 0 ) != WAIT_OBJECT_0 )
+		{
+			ppCache = &pCache->m_pNext;
+			continue;
+		}
+
+		FlushThreadCache( pCache, 0 );
+		CloseHandle( pCache->m_hThread );
+		*ppCache = pCache->m_pNext;
+		free( pCache );
+	}
+#endif
+}
+
+
+void *CMemoryPoolMT::Alloc()
+{
+	return Alloc( m_BlockSize );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Allocs a single block of memory from the pool.  
+//-----------------------------------------------------------------------------
+void *CMemoryPoolMT::Alloc( unsigned int amount )
+{
+	if ( amount > (unsigned int)m_BlockSize )
+		return NULL;
+
+	ThreadCache_t *pCache = GetThreadCache();
+	if ( pCache->m_FlushCount != m_FlushCount )
+	{
+		// Someone's releasing blobs, let them have these
+		FlushThreadCache( pCache, 0 );
+	}
+
+	if ( !pCache->m_pFreeList )
+	{
+		RefillThreadCache( pCache );
+
+		// returning NULL is fine in GROW_NONE
+		if ( !pCache->m_pFreeList )
+		{
+			Assert( m_GrowMode == CMemoryPool::GROW_NONE );
+			return NULL;
+		}
+	}
+
+	void *returnBlock = pCache->m_pFreeList;
+	pCache->m_pFreeList = *((void**)returnBlock);
+	pCache->m_Count--;
+	return returnBlock;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees a block of memory, which any thread may have allocated
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::Free( void *memBlock )
+{
+	if ( !memBlock )
+		return;  // trying to delete NULL pointer, ignore
+
+#ifdef _DEBUG
+	// check to see if the memory is from the allocated range
+	m_pLock->Lock();
+	Assert( FindBlob( memBlock ) );
+	m_pLock->Unlock();
+
+	// invalidate the memory
+	memset( memBlock, 0xDD, m_BlockSize );
+#endif
+
+	ThreadCache_t *pCache = GetThreadCache();
+	*((void**)memBlock) = pCache->m_pFreeList;
+	pCache->m_pFreeList = memBlock;
+	pCache->m_Count++;
+
+	if ( pCache->m_FlushCount != m_FlushCount )
+	{
+		FlushThreadCache( pCache, 0 );
+	}
+	else if ( pCache->m_Count > m_CacheSize )
+	{
+		FlushThreadCache( pCache, m_CacheSize / 2 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Frees the blobs with nothing allocated from them
+//-----------------------------------------------------------------------------
+int CMemoryPoolMT::ReleaseFreeBlobs()
+{
+	// The one blob a GROW_NONE pool gets can't be made again
+	if ( m_GrowMode == CMemoryPool::GROW_NONE )
+		return 0;
 
+	FlushThreadCache( GetThreadCache(), 0 );
+
+	m_pLock->Lock();
+
+	// Have the other threads give their blocks back as they get to it, the
+	// ones that have exited won't
+	m_FlushCount++;
+	FlushExitedThreadCaches();
+
+	int nBytes = 0;
+	int nKept = 0;
+	for ( int i = 0; i < m_NumBlobs; ++i )
+	{
+		Blob_t *pBlob = m_Blobs[i];
+		if ( pBlob->m_NumFree != pBlob->m_NumBlocks )
+		{
+			m_Blobs[nKept++] = pBlob;
+			continue;
+		}
+
+		if ( pBlob->m_pPrevPartial )
+		{
+			pBlob->m_pPrevPartial->m_pNextPartial = pBlob->m_pNextPartial;
+		}
+		else
+		{
+			m_pPartialBlobs = pBlob->m_pNextPartial;
+		}
+		if ( pBlob->m_pNextPartial )
+		{
+			pBlob->m_pNextPartial->m_pPrevPartial = pBlob->m_pPrevPartial;
+		}
+
+		nBytes += pBlob->m_NumBytes;
+		free( pBlob );
+	}
+	m_NumBlobs = nKept;
+
+	m_pLock->Unlock();
+	return nBytes;
+}
+
+int CMemoryPoolMT::ReleaseAllFreeBlobs()
+{
+	int nBytes = 0;
+	for ( CMemoryPoolMT *pPool = s_pPools; pPool; pPool = pPool->m_pNextPool )
+	{
+		nBytes += pPool->ReleaseFreeBlobs();
+	}
+	return nBytes;
+}
+
+
+//-----------------------------------------------------------------------------
+// Blocks sitting in the threads' caches.  The counts aren't locked, so this
+// is only a snapshot if other threads are using the pool.
+//-----------------------------------------------------------------------------
+int CMemoryPoolMT::CountCachedBlocks()
+{
+	int nCached = 0;
+	m_pLock->Lock();
+	for ( ThreadCache_t *pCache = m_pThreadCaches; pCache; pCache = pCache->m_pNext )
+	{
+		nCached += pCache->m_Count;
+	}
+	m_pLock->Unlock();
+	return nCached;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reports what the pool is using
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::ReportStats( MemoryPoolReportFunc_t func )
+{
+	if ( !func )
+	{
+		func = CMemoryPool::g_ReportFunc;
+		if ( !func )
+			return;
+	}
+
+	int nCached = CountCachedBlocks();
+
+	m_pLock->Lock();
+	int nBytes = 0;
+	for ( int i = 0; i < m_NumBlobs; ++i )
+	{
+		nBytes += m_Blobs[i]->m_NumBytes;
+	}
+	int nBlobs = m_NumBlobs;
+	int nOut = m_BlocksOut;
+	int nPeak = m_PeakOut;
+	m_pLock->Unlock();
+
+	func( "%s: %d byte blocks, %d in use, %d cached, peak %d, %d blobs, %d bytes\n",
+		m_pName, m_BlockSize, nOut - nCached, nCached, nPeak, nBlobs, nBytes );
+}
+
+void CMemoryPoolMT::ReportAllStats( MemoryPoolReportFunc_t func )
+{
+	for ( CMemoryPoolMT *pPool = s_pPools; pPool; pPool = pPool->m_pNextPool )
+	{
+		pPool->ReportStats( func );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reports memory leaks 
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::ReportLeaks()
+{
+	if ( !CMemoryPool::g_ReportFunc )
+		return;
+
+	CMemoryPool::g_ReportFunc( "Memory leak: mempool %s blocks left in memory: %d\n", m_pName, m_BlocksOut - CountCachedBlocks() );
+}
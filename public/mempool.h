@@ -90,6 +90,84 @@ private:
 	unsigned short	m_NumBlobs;
 
 	static MemoryPoolReportFunc_t g_ReportFunc;
+
+	friend class CMemoryPoolMT;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Thread safe pool allocator.  Each thread keeps a short free list of
+//			its own, so most allocs and frees don't lock, and a block can be
+//			freed by a different thread than the one that allocated it.  Blobs
+//			whose blocks are all free can be given back to the system.
+//-----------------------------------------------------------------------------
+class CMemoryPoolMT
+{
+public:
+	// growMode is one of the CMemoryPool::GROW_ values
+				CMemoryPoolMT( int blockSize, int numElements, int growMode = CMemoryPool::GROW_FAST, const char *pName = 0 );
+				~CMemoryPoolMT();
+
+	void*		Alloc();	// Allocate the element size you specified in the constructor.
+	void*		Alloc( unsigned int amount );
+	void		Free( void *pMem );
+
+	// Frees everything.  No other thread may be using the pool.
+	void		Clear();
+
+	// Frees every blob with no blocks in use and returns the number of bytes
+	// freed.  The calling thread's free list is emptied first, and those of
+	// threads that have exited.  Other threads empty theirs the next time they
+	// use the pool, so blocks they're holding come back on a later call.
+	// Meant for after a map change.
+	int			ReleaseFreeBlobs();
+
+	// Reports the blocks in use, the peak and the memory held, through func
+	// or the CMemoryPool error report function
+	void		ReportStats( MemoryPoolReportFunc_t func = 0 );
+
+	// The same for every CMemoryPoolMT in this module.  Pools are expected to
+	// be created and destroyed on the main thread.
+	static int	ReleaseAllFreeBlobs();
+	static void	ReportAllStats( MemoryPoolReportFunc_t func = 0 );
+
+private:
+	struct Blob_t;
+	struct ThreadCache_t;
+	struct Lock_t;
+
+	ThreadCache_t	*GetThreadCache();
+	void			RefillThreadCache( ThreadCache_t *pCache );
+	void			FlushThreadCache( ThreadCache_t *pCache, int nKeep );
+	void			FlushExitedThreadCaches();
+	Blob_t			*AddNewBlob();
+	Blob_t			*FindBlob( void *pMem );
+	int				CountCachedBlocks();
+	void			ReportLeaks();
+
+	const char		*m_pName;
+	int				m_BlockSize;
+	int				m_BlocksPerBlob;
+	int				m_GrowMode;		// CMemoryPool::GROW_ enum.
+	int				m_CacheSize;	// most blocks a thread keeps
+
+	Lock_t			*m_pLock;		// held while blobs and the lists of them change
+	unsigned long	m_TlsIndex;		// each thread's ThreadCache_t (Win32)
+
+	CUtlMemory<Blob_t*>	m_Blobs;		// sorted by address, for FindBlob
+	int				m_NumBlobs;
+	Blob_t			*m_pPartialBlobs;	// blobs with free blocks
+	ThreadCache_t	*m_pThreadCaches;	// every thread's cache, freed with the pool
+	volatile int	m_FlushCount;		// bumped to have the threads empty their caches
+
+	int				m_BlocksOut;		// blocks out of the blobs, in use or cached
+	int				m_PeakOut;
+
+	CMemoryPoolMT	*m_pNextPool;
+	static CMemoryPoolMT *s_pPools;
+
+	// Not implemented
+	CMemoryPoolMT( const CMemoryPoolMT & );
 };
 
 
@@ -151,6 +229,22 @@ void CClassMemoryPool<T>::Free(T *pMem)
    CMemoryPool   _class::s_Allocator(sizeof(_class), _initsize, _grow)
 
 
+//-----------------------------------------------------------------------------
+// The same for classes that are allocated and freed on more than one thread
+//-----------------------------------------------------------------------------
+#define DECLARE_FIXEDSIZE_ALLOCATOR_MT( _class )									\
+   public:																		\
+      inline void* operator new( size_t size ) { return s_Allocator.Alloc(size); }   \
+      inline void* operator new( size_t size, int nBlockUse, const char *pFileName, int nLine ) { return s_Allocator.Alloc(size); }   \
+      inline void  operator delete( void* p ) { s_Allocator.Free(p); }		\
+      inline void  operator delete( void* p, int nBlockUse, const char *pFileName, int nLine ) { s_Allocator.Free(p); }   \
+  private:																		\
+      static   CMemoryPoolMT   s_Allocator
+    
+#define DEFINE_FIXEDSIZE_ALLOCATOR_MT( _class, _initsize, _grow )				\
+   CMemoryPoolMT   _class::s_Allocator(sizeof(_class), _initsize, _grow, #_class)
+
+
 //-----------------------------------------------------------------------------
 // Macros that make it simple to make a class use a fixed-size allocator
 // This version allows us to use a memory pool which is externally defined...
@@ -16,64 +16,151 @@
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+#define STRINGPOOL_INIT_SIZE	512		// hash table slots, must be a power of two
+#define STRINGPOOL_BLOCK_SIZE	16384
+
 //-----------------------------------------------------------------------------
-// Purpose: Comparison function for string sorted associative data structures
 //-----------------------------------------------------------------------------
 
-bool StrLess( const char * const &pszLeft, const char * const &pszRight )
+CStringPool::CStringPool()
 {
-	return ( strcmpi( pszLeft, pszRight) < 0 );
+	m_nCount = 0;
+	m_nBlockUsed = 0;
+	m_nBlockSize = 0;
 }
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
-CStringPool::CStringPool()
-  : m_Strings( 32, 256, StrLess )
+CStringPool::~CStringPool()
 {
+	FreeAll();
 }
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
-CStringPool::~CStringPool()
+unsigned int CStringPool::Count() const
 {
-	FreeAll();
+	return m_nCount;
 }
 
 //-----------------------------------------------------------------------------
+// Purpose: FNV-1a of the lower case string
 //-----------------------------------------------------------------------------
 
-unsigned int CStringPool::Count() const
+unsigned int CStringPool::HashString( const char *pszValue )
 {
-	return m_Strings.Count();
+	unsigned int hash = 2166136261U;
+	for ( ; *pszValue; ++pszValue )
+	{
+		unsigned char c = (unsigned char)*pszValue;
+		if ( c >= 'A' && c <= 'Z' )
+		{
+			c += 'a' - 'A';
+		}
+		hash = ( hash ^ c ) * 16777619U;
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the slot holding pszValue, or the empty slot it would go in
+//-----------------------------------------------------------------------------
+
+int CStringPool::FindSlot( const char *pszValue, unsigned int hash ) const
+{
+	int mask = m_Table.Count() - 1;
+	int i = hash & mask;
+	while ( m_Table[i] )
+	{
+		if ( GetHash( m_Table[i] ) == hash && strcmpi( m_Table[i], pszValue ) == 0 )
+			break;
+		i = ( i + 1 ) & mask;
+	}
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Doubles the size of the hash table, using the stored hashes
+//-----------------------------------------------------------------------------
+
+void CStringPool::GrowTable()
+{
+	CUtlVector<const char *> oldTable;
+	oldTable.AddMultipleToTail( m_Table.Count(), m_Table.Base() );
+
+	int size = m_Table.Count() ? m_Table.Count() * 2 : STRINGPOOL_INIT_SIZE;
+	m_Table.RemoveAll();
+	m_Table.AddMultipleToTail( size );
+	memset( m_Table.Base(), 0, size * sizeof( const char * ) );
+
+	int mask = size - 1;
+	for ( int i = 0; i < oldTable.Count(); i++ )
+	{
+		if ( !oldTable[i] )
+			continue;
+
+		int j = GetHash( oldTable[i] ) & mask;
+		while ( m_Table[j] )
+		{
+			j = ( j + 1 ) & mask;
+		}
+		m_Table[j] = oldTable[i];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Stores len bytes, preceded by room for the hash
+//-----------------------------------------------------------------------------
+
+char *CStringPool::AllocString( int len )
+{
+	// Keep the hashes aligned
+	int size = ( sizeof( unsigned int ) + len + 3 ) & ~3;
+	if ( m_nBlockUsed + size > m_nBlockSize )
+	{
+		m_nBlockSize = max( size, STRINGPOOL_BLOCK_SIZE );
+		m_Blocks.AddToTail( (char *)malloc( m_nBlockSize ) );
+		m_nBlockUsed = 0;
+	}
+
+	char *pMem = m_Blocks[m_Blocks.Count() - 1] + m_nBlockUsed;
+	m_nBlockUsed += size;
+	return pMem + sizeof( unsigned int );
 }
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 const char * CStringPool::Find( const char *pszValue )
 {
-	unsigned short i = m_Strings.Find(pszValue);
-	if ( m_Strings.IsValidIndex(i) )
-		return m_Strings[i];
+	if ( !m_nCount )
+		return NULL;
 
-	return NULL;
+	return m_Table[FindSlot( pszValue, HashString( pszValue ) )];
 }
 
 const char * CStringPool::Allocate( const char *pszValue )
 {
-	char	*pszNew;
+	unsigned int hash = HashString( pszValue );
 
-	unsigned short i 	= m_Strings.Find(pszValue);
-	bool		   bNew = (i == m_Strings.InvalidIndex());
+	// Keep the table at most half full
+	if ( ( m_nCount + 1 ) * 2 > (unsigned int)m_Table.Count() )
+	{
+		GrowTable();
+	}
 
-	if ( !bNew )
-		return m_Strings[i];
+	int i = FindSlot( pszValue, hash );
+	if ( m_Table[i] )
+		return m_Table[i];
 
-	pszNew = strdup( pszValue );
+	int len = strlen( pszValue ) + 1;
+	char *pszNew = AllocString( len );
+	((unsigned int *)pszNew)[-1] = hash;
+	memcpy( pszNew, pszValue, len );
 
-	if ( bNew )
-		m_Strings.Insert( pszNew );
+	m_Table[i] = pszNew;
+	m_nCount++;
 
 	return pszNew;
 }
@@ -83,13 +170,16 @@ const char * CStringPool::Allocate( const char *pszValue )
 
 void CStringPool::FreeAll()
 {
-	unsigned short i = m_Strings.FirstInorder();
-	while ( i != m_Strings.InvalidIndex() )
+	for ( int i = 0; i < m_Blocks.Count(); i++ )
 	{
-		free( (void *)m_Strings[i] );
-		i = m_Strings.NextInorder(i);
+		free( m_Blocks[i] );
 	}
-	m_Strings.RemoveAll();
+	m_Blocks.Purge();
+	m_nBlockUsed = 0;
+	m_nBlockSize = 0;
+
+	m_Table.Purge();
+	m_nCount = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -116,6 +206,8 @@ CON_COMMAND( test_stringpool, "Tests the class CStringPool" )
 	Assert( pool.Find("TEST") != NULL );
 	Assert( pool.Find("Test2") != NULL );
 	Assert( pool.Find("test") != NULL );
+	Assert( pool.Find("test3") == NULL );
+	Assert( CStringPool::GetHash( pool.Find("TEST2") ) == CStringPool::HashString( "test2" ) );
 
 	pool.FreeAll();
 	Assert(pool.Count() == 0);
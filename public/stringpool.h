@@ -8,7 +8,7 @@
 #ifndef STRINGPOOL_H
 #define STRINGPOOL_H
 
-#include "utlrbtree.h"
+#include "utlvector.h"
 
 #if defined( _WIN32 )
 #pragma once
@@ -16,7 +16,9 @@
 
 //-----------------------------------------------------------------------------
 // Purpose: Allocates memory for strings, checking for duplicates first,
-//			reusing exising strings if duplicate found.
+//			reusing exising strings if duplicate found. Comparisons are case
+//			insensitive. Strings are found through a hash table, and each
+//			string's hash is stored in the pool just in front of it.
 //-----------------------------------------------------------------------------
 
 class CStringPool
@@ -31,12 +33,27 @@ public:
 	void FreeAll();
 
 	// searches for a string already in the pool
-	const char * CStringPool::Find( const char *pszValue );
+	const char * Find( const char *pszValue );
 
-private:
-	typedef CUtlRBTree<const char *, unsigned short> CStrSet;
+	// The case insensitive hash the pool uses
+	static unsigned int HashString( const char *pszValue );
+
+	// Gets the hash of a string returned by Allocate or Find without rehashing it
+	static unsigned int GetHash( const char *pszPooled )	{ return ((const unsigned int *)pszPooled)[-1]; }
 
-	CStrSet m_Strings;
+private:
+	int FindSlot( const char *pszValue, unsigned int hash ) const;
+	void GrowTable();
+	char *AllocString( int len );
+
+	// open addressing hash table of the strings, NULL for an empty slot
+	CUtlVector<const char *> m_Table;
+	unsigned int m_nCount;
+
+	// string storage, in blocks that are freed all at once
+	CUtlVector<char *> m_Blocks;
+	int m_nBlockUsed;
+	int m_nBlockSize;
 };
 
 #endif // STRINGPOOL_H
@@ -0,0 +1,50 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Sampling heap profiler for the release allocator.  Every so many
+//			bytes an allocation is picked, and the live bytes it stands for are
+//			charged to its call site (the stack plus whatever PushAllocDbgInfo
+//			scope it was made in) until it's freed.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef TIER0_MEMPROFILE_H
+#define TIER0_MEMPROFILE_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/mem.h"
+
+#define MEMPROFILE_DEFAULT_SAMPLE_BYTES		( 512 * 1024 )
+
+
+//-----------------------------------------------------------------------------
+// These only do anything in release builds on Win32, elsewhere they say so
+//-----------------------------------------------------------------------------
+
+// Starts sampling roughly one allocation for every nSampleBytes bytes allocated.
+// Sites recorded earlier are kept, so this can also change the rate.
+MEM_INTERFACE void MemProfile_Start( int nSampleBytes = MEMPROFILE_DEFAULT_SAMPLE_BYTES );
+
+// Stops sampling new allocations.  Frees of sampled allocations are still
+// counted, so live bytes stay right for the reports.
+MEM_INTERFACE void MemProfile_Stop();
+MEM_INTERFACE bool MemProfile_IsActive();
+
+// Forgets every site and sampled allocation
+MEM_INTERFACE void MemProfile_Reset();
+
+// Remembers each site's live bytes, the reports show the growth since then
+MEM_INTERFACE void MemProfile_Mark();
+
+// Lists the nMaxSites sites with the most live bytes
+MEM_INTERFACE void MemProfile_DumpFlat( int nMaxSites );
+
+// Shows live bytes as a call tree from the outermost caller in, leaving out
+// anything under flMinPercent of the total
+MEM_INTERFACE void MemProfile_DumpTree( float flMinPercent );
+
+
+#endif // TIER0_MEMPROFILE_H
@@ -10,6 +10,7 @@
 
 #include "tier0/dbg.h"
 #include "tier0/fasttimer.h"
+#include "tier0/vproftrace.h"
 
 
 #define VPROF_ENABLED
@@ -60,6 +61,9 @@
 	
 #define VPROF_HISTORY_COUNT 1024
 
+// Budget groups tracked per thread; higher IDs are counted as unaccounted
+#define VPROF_MAX_THREAD_BUDGET_GROUPS 64
+
 //-------------------------------------
 
 #ifndef VPROF_LEVEL
@@ -212,6 +216,8 @@ enum VProfReportType_t
 	VPRT_LIST_BY_PEAK_OVER_AVERAGE,
 };
 
+class CVProfThread;
+
 class DBG_CLASS CVProfile 
 {
 public:
@@ -260,7 +266,20 @@ public:
 	int BudgetGroupNameToBudgetGroupID( const char *pBudgetGroupName );
 	void RegisterNumBudgetGroupsChangedCallBack( void (*pCallBack)(void) );
 
+	// Threads other than the primary thread that have profiled anything
+	CVProfThread *GetFirstThread()	{ return m_pThreads; }
+
 private:
+	friend class CVProfThread;
+
+#ifdef _WIN32
+	void EnterThreadScope( const char *pszName, int detailLevel, const char *pBudgetGroupName );
+	void ExitThreadScope();
+#endif
+	void MergeThreads();
+	void ResetThreads();
+	void OutputThreadReport();
+
 	void SumTimes( const char *pszStartNode, int budgetGroupID );
 	void SumTimes( CVProfNode *pNode, int budgetGroupID );
 	void DumpNodes( CVProfNode *pNode, int indent );
@@ -278,12 +297,118 @@ private:
 	int			m_nBudgetGroupNamesAllocated;
 	int			m_nBudgetGroupNames;
 	void		(*m_pNumBudgetGroupsChangedCallBack)(void);
+	bool		m_bNumBudgetGroupsChanged;	// by another thread, the callback is made at the next frame
+
+	CVProfThread * volatile m_pThreads;
+	volatile int m_nFrameSerial;	// counts MarkFrame() calls, other threads roll their frames over when it changes
+	volatile int m_nResetSerial;
 };
 
 //-------------------------------------
 
 DBG_INTERFACE CVProfile g_VProfCurrentProfile;
 
+//-----------------------------------------------------------------------------
+//
+// The profile of a thread other than the primary thread.  Only the thread
+// itself touches its node tree.  When it sees that the primary thread has
+// marked a frame it rolls its tree over and publishes its budget group times
+// for the frame, which the primary thread adds up in its next MarkFrame(),
+// so neither side ever waits on the other.
+//
+
+class DBG_CLASS CVProfThread
+{
+public:
+	CVProfThread( unsigned long threadID );
+
+	unsigned long GetThreadID() const	{ return m_ThreadID; }
+	CVProfThread *GetNext()				{ return m_pNext; }
+	CVProfNode *GetRoot()				{ return &m_Root; }
+
+	// Frames merged and budget group time in ms since the last reset
+	int NumFramesSampled()				{ return m_nFramesMerged; }
+	double GetBudgetGroupTime( int budgetGroupID );
+
+private:
+	friend class CVProfile;
+
+	void EnterScope( const char *pszName, int detailLevel, const char *pBudgetGroupName );
+	void ExitScope();
+	bool AtRoot() const					{ return ( m_pCurNode == &m_Root ); }
+	void CatchUp();
+	void Merge();
+	void ResetTotals();
+
+	// Written by the thread itself
+	CVProfNode	m_Root;
+	CVProfNode *m_pCurNode;
+	int			m_nFrameSerial;
+	int			m_nResetSerial;
+	double		m_FrameTimes[2][VPROF_MAX_THREAD_BUDGET_GROUPS];	// m_FrameTimes[m_nPublished & 1] is complete
+	volatile int m_nPublished;
+
+	// Written by the primary thread
+	int			m_nMerged;
+	int			m_nFramesMerged;
+	double		m_TotalTimes[VPROF_MAX_THREAD_BUDGET_GROUPS];
+
+	unsigned long m_ThreadID;
+	CVProfThread *m_pNext;
+};
+
+//-----------------------------------------------------------------------------
+//
+// Records every scope entry and exit, on every thread, into a ring buffer so
+// the last few seconds can be written out and looked at on a timeline (see
+// utils/vproftrace2json).  Runs whether or not the profile is enabled, and
+// costs one test per scope while it's off.
+//
+
+class DBG_CLASS CVProfTrace
+{
+public:
+	CVProfTrace();
+	~CVProfTrace();
+
+	// nEvents is rounded up to a power of two.  Does nothing while recording,
+	// since other threads may still be writing to the buffer it would free;
+	// Stop first.
+	void Start( int nEvents );
+	void Stop();
+	bool IsRecording() const		{ return m_bRecording; }
+
+	void EnterScope( const char *pszName, const char *pBudgetGroupName );
+	void ExitScope();
+	void MarkFrame();
+
+	// Writes the events from the last flSeconds in the vproftrace.h format.
+	// Recording is held off while the events are copied.
+	bool WriteFile( const char *pFilename, float flSeconds );
+
+private:
+	struct Event_t
+	{
+		__int64			m_Time;
+		const char		*m_pszName;
+		const char		*m_pszBudgetGroupName;
+		unsigned long	m_ThreadID;
+		int				m_Type;
+	};
+
+	void Record( int type, const char *pszName, const char *pBudgetGroupName );
+
+	volatile bool	m_bRecording;
+	bool			m_bWrapped;
+	Event_t			*m_pEvents;
+	unsigned long	m_nEventsMask;
+	volatile unsigned long m_nNext;		// Events ever recorded, m_pEvents[m_nNext & m_nEventsMask] is the next
+};
+
+//-------------------------------------
+
+DBG_INTERFACE CVProfTrace g_VProfTrace;
+
 //-----------------------------------------------------------------------------
 
 class CVProfScope
@@ -538,11 +663,18 @@ inline void CVProfile::Stop()
 
 inline void CVProfile::EnterScope( const char *pszName, int detailLevel, const char *pBudgetGroupName, bool bAssertAccounted )
 {
-	if ( m_enabled != 0 || !m_fAtRoot ) // if became disabled, need to unwind back to root before stopping
+	if ( m_enabled != 0 || !m_fAtRoot || m_pThreads ) // if became disabled, need to unwind back to root before stopping
 	{
-		// Only account for vprof stuff on the primary thread.
-		//if( !Plat_IsPrimaryThread() )
-		//	return;
+#ifdef _WIN32
+		// Other threads profile into trees of their own
+		if ( !Plat_IsPrimaryThread() )
+		{
+			EnterThreadScope( pszName, detailLevel, pBudgetGroupName );
+			return;
+		}
+#endif
+		if ( m_enabled == 0 && m_fAtRoot )
+			return;
 
 		if ( pszName != m_pCurNode->GetName() ) 
 		{
@@ -564,11 +696,17 @@ inline void CVProfile::EnterScope( const char *pszName, int detailLevel, const c
 
 inline void CVProfile::ExitScope()
 {
-	if ( !m_fAtRoot || m_enabled != 0 )
+	if ( !m_fAtRoot || m_enabled != 0 || m_pThreads )
 	{
-		// Only account for vprof stuff on the primary thread.
-		//if( !Plat_IsPrimaryThread() )
-		//	return;
+#ifdef _WIN32
+		if ( !Plat_IsPrimaryThread() )
+		{
+			ExitThreadScope();
+			return;
+		}
+#endif
+		if ( m_fAtRoot && m_enabled == 0 )
+			return;
 
 		// ExitScope will indicate whether we should back up to our parent (we may
 		// be profiling a recursive function)
@@ -605,6 +743,8 @@ inline void CVProfile::Reset()
 {
 	m_Root.Reset(); 
 	m_nFrames = 0;
+	if ( m_pThreads )
+		ResetThreads();
 }
 
 //-------------------------------------
@@ -624,6 +764,11 @@ inline void CVProfile::MarkFrame()
 		m_Root.ExitScope();
 		m_Root.MarkFrame(); 
 		m_Root.EnterScope();
+
+		// Merge before moving on, so each thread publishes at most once between merges
+		if ( m_pThreads )
+			MergeThreads();
+		++m_nFrameSerial;
 	}
 }
 
@@ -655,11 +800,37 @@ inline CVProfNode *CVProfile::GetRoot()
 	return &m_Root;
 }
 
+//-----------------------------------------------------------------------------
+//
+// CVProfTrace, inline methods
+//
+
+inline void CVProfTrace::EnterScope( const char *pszName, const char *pBudgetGroupName )
+{
+	Record( VPROF_TRACE_ENTER, pszName, pBudgetGroupName );
+}
+
+//-------------------------------------
+
+inline void CVProfTrace::ExitScope()
+{
+	Record( VPROF_TRACE_EXIT, NULL, NULL );
+}
+
+//-------------------------------------
+
+inline void CVProfTrace::MarkFrame()
+{
+	Record( VPROF_TRACE_FRAME, NULL, NULL );
+}
+
 //-----------------------------------------------------------------------------
 
 inline CVProfScope::CVProfScope( const char * pszName, int detailLevel, const char *pBudgetGroupName, bool bAssertAccounted )
 { 
 	g_VProfCurrentProfile.EnterScope( pszName, detailLevel, pBudgetGroupName, bAssertAccounted ); 
+	if ( g_VProfTrace.IsRecording() )
+		g_VProfTrace.EnterScope( pszName, pBudgetGroupName );
 }
 
 //-------------------------------------
@@ -667,6 +838,8 @@ inline CVProfScope::CVProfScope( const char * pszName, int detailLevel, const ch
 inline CVProfScope::~CVProfScope()					
 { 
 	g_VProfCurrentProfile.ExitScope(); 
+	if ( g_VProfTrace.IsRecording() )
+		g_VProfTrace.ExitScope();
 }
 
 #endif
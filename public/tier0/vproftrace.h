@@ -0,0 +1,57 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: File format written by CVProfTrace::WriteFile, read by vproftrace2json
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef VPROFTRACE_H
+#define VPROFTRACE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+#define VPROF_TRACE_ID				(('R'<<24)+('T'<<16)+('P'<<8)+'V')
+#define VPROF_TRACE_VERSION			1
+
+// VProfTraceHeader_t
+// m_nNames VProfTraceName_t, each followed by its scope and budget group strings
+// m_nEvents VProfTraceEvent_t, oldest first
+
+enum VProfTraceEventType_t
+{
+	VPROF_TRACE_ENTER = 0,		// A scope was entered
+	VPROF_TRACE_EXIT,			// The innermost scope on the thread was exited
+	VPROF_TRACE_FRAME,			// CVProfTrace::MarkFrame
+};
+
+#pragma pack(1)
+
+struct VProfTraceHeader_t
+{
+	int			m_nID;					// VPROF_TRACE_ID
+	int			m_nVersion;				// VPROF_TRACE_VERSION
+	__int64		m_ClockSpeed;			// Event times are in cycles of this many a second
+	int			m_nNames;
+	int			m_nEvents;
+};
+
+struct VProfTraceName_t
+{
+	unsigned short	m_nScopeLength;		// Both lengths include the terminator
+	unsigned short	m_nBudgetGroupLength;
+};
+
+struct VProfTraceEvent_t
+{
+	__int64			m_Time;
+	unsigned long	m_ThreadID;
+	unsigned short	m_iName;			// Index of the scope's name, 0xFFFF for exit and frame events
+	unsigned short	m_Type;				// VProfTraceEventType_t
+};
+
+#pragma pack()
+
+
+#endif // VPROFTRACE_H
@@ -0,0 +1,776 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: An open addressing hash map.  The elements live in one array and
+//			are found through a power of two table of (hash, index) slots
+//			probed linearly, so a lookup touches a couple of cache lines
+//			instead of walking a tree.  Indices stay put until the element is
+//			removed, like CUtlLinkedList and CUtlRBTree.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef UTLHASHMAP_H
+#define UTLHASHMAP_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/dbg.h"
+#include "utlmemory.h"
+#include "vstdlib/strtools.h"
+#include <ctype.h>
+#include <string.h>
+
+
+//-----------------------------------------------------------------------------
+// The CUtlHashMap class:
+// A hash map keyed by K.  The hash and equality functions are passed in, the
+// same way CUtlRBTree takes its less function.
+//-----------------------------------------------------------------------------
+template< class K, class V >
+class CUtlHashMap
+{
+public:
+	typedef unsigned int (*HashFunc_t)( const K &key );
+	typedef bool (*EqualFunc_t)( const K &key1, const K &key2 );
+
+	// constructor, destructor
+	CUtlHashMap( HashFunc_t hashFunc, EqualFunc_t equalFunc, int initSize = 0 );
+	~CUtlHashMap();
+
+	// gets particular elements
+	V&			Element( int i );
+	const V&	Element( int i ) const;
+	V&			operator[]( int i );
+	const V&	operator[]( int i ) const;
+
+	// gets the key of an element
+	const K&	Key( int i ) const;
+
+	// Number of elements
+	int			Count() const;
+
+	// One past the highest index in use, for loops over every index
+	int			MaxElement() const;
+
+	// Checks if an index refers to an element in the map
+	bool		IsValidIndex( int i ) const;
+
+	// Invalid index
+	static int	InvalidIndex();
+
+	// Find method
+	int			Find( const K &key ) const;
+
+	// Insert methods.  These don't look for the key first, if it's already
+	// there Find will return one of the two.
+	int			Insert( const K &key );
+	int			Insert( const K &key, const V &value );
+
+	// Replaces the value if the key is there, otherwise inserts it
+	int			InsertOrReplace( const K &key, const V &value );
+
+	// Changes the key of an element
+	void		SetKey( int i, const K &key );
+
+	// Remove methods
+	void		RemoveAt( int i );
+	bool		Remove( const K &key );
+	void		RemoveAll();
+
+	// Purge memory
+	void		Purge();
+
+	// Iteration methods, in index order
+	int			First() const;
+	int			Next( int i ) const;
+
+	// Makes room for this many elements without rehashing
+	void		EnsureCapacity( int num );
+
+protected:
+	enum
+	{
+		ELEMENT_IN_USE = -2,
+
+		SLOT_EMPTY = -1,
+		SLOT_DELETED = -2,
+
+		MIN_SLOT_COUNT = 16,
+	};
+
+	struct Element_t
+	{
+		K				m_Key;
+		V				m_Value;
+		unsigned int	m_nHash;
+		int				m_iNextFree;	// ELEMENT_IN_USE while the element's alive
+	};
+
+	struct Slot_t
+	{
+		unsigned int	m_nHash;
+		int				m_iElement;		// or SLOT_EMPTY, SLOT_DELETED
+	};
+
+	// Gets a free element with the key and hash filled in
+	int			AllocElement( const K &key, unsigned int nHash );
+	void		FreeElement( int i );
+
+	// Slot table
+	int			FindSlot( const K &key, unsigned int nHash ) const;
+	int			FindSlotForElement( int i ) const;
+	void		AddSlot( int i, unsigned int nHash );
+	void		Rehash( int nMinSlots );
+
+	HashFunc_t				m_HashFunc;
+	EqualFunc_t				m_EqualFunc;
+
+	CUtlMemory<Element_t>	m_Elements;
+	int						m_nCount;
+	int						m_nMaxElement;
+	int						m_iFirstFree;
+
+	CUtlMemory<Slot_t>		m_Slots;
+	int						m_nSlotsUsed;	// live plus deleted
+
+private:
+	// Not implemented, copying would have to rebuild the slots
+	CUtlHashMap( const CUtlHashMap<K, V> &src );
+	CUtlHashMap<K, V> &operator=( const CUtlHashMap<K, V> &src );
+};
+
+
+//-----------------------------------------------------------------------------
+// constructor, destructor
+//-----------------------------------------------------------------------------
+template< class K, class V >
+CUtlHashMap<K, V>::CUtlHashMap( HashFunc_t hashFunc, EqualFunc_t equalFunc, int initSize ) :
+	m_HashFunc( hashFunc ), m_EqualFunc( equalFunc ), m_nCount( 0 ), m_nMaxElement( 0 ),
+	m_iFirstFree( InvalidIndex() ), m_nSlotsUsed( 0 )
+{
+	Assert( m_HashFunc && m_EqualFunc );
+	if ( initSize > 0 )
+	{
+		EnsureCapacity( initSize );
+	}
+}
+
+template< class K, class V >
+CUtlHashMap<K, V>::~CUtlHashMap()
+{
+	Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// gets particular elements
+//-----------------------------------------------------------------------------
+template< class K, class V >
+inline V& CUtlHashMap<K, V>::Element( int i )
+{
+	Assert( IsValidIndex( i ) );
+	return m_Elements[i].m_Value;
+}
+
+template< class K, class V >
+inline const V& CUtlHashMap<K, V>::Element( int i ) const
+{
+	Assert( IsValidIndex( i ) );
+	return m_Elements[i].m_Value;
+}
+
+template< class K, class V >
+inline V& CUtlHashMap<K, V>::operator[]( int i )
+{
+	return Element( i );
+}
+
+template< class K, class V >
+inline const V& CUtlHashMap<K, V>::operator[]( int i ) const
+{
+	return Element( i );
+}
+
+template< class K, class V >
+inline const K& CUtlHashMap<K, V>::Key( int i ) const
+{
+	Assert( IsValidIndex( i ) );
+	return m_Elements[i].m_Key;
+}
+
+
+//-----------------------------------------------------------------------------
+// Num elements
+//-----------------------------------------------------------------------------
+template< class K, class V >
+inline int CUtlHashMap<K, V>::Count() const
+{
+	return m_nCount;
+}
+
+template< class K, class V >
+inline int CUtlHashMap<K, V>::MaxElement() const
+{
+	return m_nMaxElement;
+}
+
+
+//-----------------------------------------------------------------------------
+// Checks if an index refers to an element in the map
+//-----------------------------------------------------------------------------
+template< class K, class V >
+inline bool CUtlHashMap<K, V>::IsValidIndex( int i ) const
+{
+	return ( i >= 0 ) && ( i < m_nMaxElement ) && ( m_Elements[i].m_iNextFree == ELEMENT_IN_USE );
+}
+
+template< class K, class V >
+inline int CUtlHashMap<K, V>::InvalidIndex()
+{
+	return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Slot table.  The table's size is a power of two, so the hash is masked down
+// to the first slot and the probe walks forward one slot at a time.  The full
+// hash is kept in the slot so most mismatches never touch the element.
+//-----------------------------------------------------------------------------
+template< class K, class V >
+int CUtlHashMap<K, V>::FindSlot( const K &key, unsigned int nHash ) const
+{
+	int nMask = m_Slots.NumAllocated() - 1;
+	if ( nMask < 0 )
+		return -1;
+
+	for ( int iSlot = nHash & nMask; ; iSlot = ( iSlot + 1 ) & nMask )
+	{
+		const Slot_t &slot = m_Slots[iSlot];
+		if ( slot.m_iElement == SLOT_EMPTY )
+			return -1;
+
+		if ( ( slot.m_iElement >= 0 ) && ( slot.m_nHash == nHash ) &&
+			m_EqualFunc( m_Elements[slot.m_iElement].m_Key, key ) )
+		{
+			return iSlot;
+		}
+	}
+}
+
+template< class K, class V >
+int CUtlHashMap<K, V>::FindSlotForElement( int i ) const
+{
+	int nMask = m_Slots.NumAllocated() - 1;
+	for ( int iSlot = m_Elements[i].m_nHash & nMask; ; iSlot = ( iSlot + 1 ) & nMask )
+	{
+		if ( m_Slots[iSlot].m_iElement == i )
+			return iSlot;
+
+		// The element has to be in the table
+		Assert( m_Slots[iSlot].m_iElement != SLOT_EMPTY );
+	}
+}
+
+template< class K, class V >
+void CUtlHashMap<K, V>::AddSlot( int i, unsigned int nHash )
+{
+	// Keep the table under 3/4 full, counting the deleted slots since they
+	// lengthen the probes just the same
+	if ( ( m_nSlotsUsed + 1 ) * 4 > m_Slots.NumAllocated() * 3 )
+	{
+		// Element i is already in use with its new hash, so the rehash puts it
+		// in the table along with everything else
+		Assert( m_Elements[i].m_iNextFree == ELEMENT_IN_USE && m_Elements[i].m_nHash == nHash );
+		Rehash( ( m_nCount + 1 ) * 2 );
+		return;
+	}
+
+	int nMask = m_Slots.NumAllocated() - 1;
+	int iSlot;
+	for ( iSlot = nHash & nMask; m_Slots[iSlot].m_iElement >= 0; iSlot = ( iSlot + 1 ) & nMask )
+		;
+
+	if ( m_Slots[iSlot].m_iElement == SLOT_EMPTY )
+	{
+		++m_nSlotsUsed;
+	}
+	m_Slots[iSlot].m_nHash = nHash;
+	m_Slots[iSlot].m_iElement = i;
+}
+
+template< class K, class V >
+void CUtlHashMap<K, V>::Rehash( int nMinSlots )
+{
+	int nSlots = MIN_SLOT_COUNT;
+	while ( nSlots < nMinSlots )
+	{
+		nSlots <<= 1;
+	}
+
+	// The elements remember their hashes, so the old table can just go
+	m_Slots.Purge();
+	m_Slots.EnsureCapacity( nSlots );
+	int iSlot;
+	for ( iSlot = 0; iSlot < nSlots; ++iSlot )
+	{
+		m_Slots[iSlot].m_iElement = SLOT_EMPTY;
+	}
+
+	int nMask = nSlots - 1;
+	for ( int i = 0; i < m_nMaxElement; ++i )
+	{
+		if ( m_Elements[i].m_iNextFree != ELEMENT_IN_USE )
+			continue;
+
+		unsigned int nHash = m_Elements[i].m_nHash;
+		for ( iSlot = nHash & nMask; m_Slots[iSlot].m_iElement != SLOT_EMPTY; iSlot = ( iSlot + 1 ) & nMask )
+			;
+		m_Slots[iSlot].m_nHash = nHash;
+		m_Slots[iSlot].m_iElement = i;
+	}
+	m_nSlotsUsed = m_nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Element allocation
+//-----------------------------------------------------------------------------
+template< class K, class V >
+int CUtlHashMap<K, V>::AllocElement( const K &key, unsigned int nHash )
+{
+	int i;
+	if ( m_iFirstFree != InvalidIndex() )
+	{
+		i = m_iFirstFree;
+		m_iFirstFree = m_Elements[i].m_iNextFree;
+	}
+	else
+	{
+		if ( m_nMaxElement >= m_Elements.NumAllocated() )
+		{
+			m_Elements.Grow();
+		}
+		i = m_nMaxElement++;
+	}
+
+	Element_t &elem = m_Elements[i];
+	CopyConstruct( &elem.m_Key, key );
+	elem.m_nHash = nHash;
+	elem.m_iNextFree = ELEMENT_IN_USE;
+	++m_nCount;
+	return i;
+}
+
+template< class K, class V >
+void CUtlHashMap<K, V>::FreeElement( int i )
+{
+	Element_t &elem = m_Elements[i];
+	Destruct( &elem.m_Key );
+	Destruct( &elem.m_Value );
+	elem.m_iNextFree = m_iFirstFree;
+	m_iFirstFree = i;
+	--m_nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Find method
+//-----------------------------------------------------------------------------
+template< class K, class V >
+int CUtlHashMap<K, V>::Find( const K &key ) const
+{
+	int iSlot = FindSlot( key, m_HashFunc( key ) );
+	return ( iSlot >= 0 ) ? m_Slots[iSlot].m_iElement : InvalidIndex();
+}
+
+
+//-----------------------------------------------------------------------------
+// Insert methods
+//-----------------------------------------------------------------------------
+template< class K, class V >
+int CUtlHashMap<K, V>::Insert( const K &key )
+{
+	unsigned int nHash = m_HashFunc( key );
+	int i = AllocElement( key, nHash );
+	Construct( &m_Elements[i].m_Value );
+	AddSlot( i, nHash );
+	return i;
+}
+
+template< class K, class V >
+int CUtlHashMap<K, V>::Insert( const K &key, const V &value )
+{
+	unsigned int nHash = m_HashFunc( key );
+	int i = AllocElement( key, nHash );
+	CopyConstruct( &m_Elements[i].m_Value, value );
+	AddSlot( i, nHash );
+	return i;
+}
+
+template< class K, class V >
+int CUtlHashMap<K, V>::InsertOrReplace( const K &key, const V &value )
+{
+	unsigned int nHash = m_HashFunc( key );
+	int iSlot = FindSlot( key, nHash );
+	if ( iSlot >= 0 )
+	{
+		int i = m_Slots[iSlot].m_iElement;
+		m_Elements[i].m_Value = value;
+		return i;
+	}
+
+	int i = AllocElement( key, nHash );
+	CopyConstruct( &m_Elements[i].m_Value, value );
+	AddSlot( i, nHash );
+	return i;
+}
+
+
+//-----------------------------------------------------------------------------
+// Changes the key of an element, keeping its index
+//-----------------------------------------------------------------------------
+template< class K, class V >
+void CUtlHashMap<K, V>::SetKey( int i, const K &key )
+{
+	Assert( IsValidIndex( i ) );
+
+	unsigned int nHash = m_HashFunc( key );
+	m_Slots[FindSlotForElement( i )].m_iElement = SLOT_DELETED;
+	m_Elements[i].m_Key = key;
+	m_Elements[i].m_nHash = nHash;
+	AddSlot( i, nHash );
+}
+
+
+//-----------------------------------------------------------------------------
+// Remove methods
+//-----------------------------------------------------------------------------
+template< class K, class V >
+void CUtlHashMap<K, V>::RemoveAt( int i )
+{
+	Assert( IsValidIndex( i ) );
+	m_Slots[FindSlotForElement( i )].m_iElement = SLOT_DELETED;
+	FreeElement( i );
+}
+
+template< class K, class V >
+bool CUtlHashMap<K, V>::Remove( const K &key )
+{
+	int iSlot = FindSlot( key, m_HashFunc( key ) );
+	if ( iSlot < 0 )
+		return false;
+
+	int i = m_Slots[iSlot].m_iElement;
+	m_Slots[iSlot].m_iElement = SLOT_DELETED;
+	FreeElement( i );
+	return true;
+}
+
+template< class K, class V >
+void CUtlHashMap<K, V>::RemoveAll()
+{
+	for ( int i = 0; i < m_nMaxElement; ++i )
+	{
+		if ( m_Elements[i].m_iNextFree == ELEMENT_IN_USE )
+		{
+			Destruct( &m_Elements[i].m_Key );
+			Destruct( &m_Elements[i].m_Value );
+		}
+	}
+
+	// Keep the memory, but start handing indices out from zero again
+	m_nCount = 0;
+	m_nMaxElement = 0;
+	m_iFirstFree = InvalidIndex();
+	m_nSlotsUsed = 0;
+	for ( int iSlot = m_Slots.NumAllocated(); --iSlot >= 0; )
+	{
+		m_Slots[iSlot].m_iElement = SLOT_EMPTY;
+	}
+}
+
+template< class K, class V >
+void CUtlHashMap<K, V>::Purge()
+{
+	RemoveAll();
+	m_Elements.Purge();
+	m_Slots.Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Iteration methods
+//-----------------------------------------------------------------------------
+template< class K, class V >
+int CUtlHashMap<K, V>::First() const
+{
+	return Next( -1 );
+}
+
+template< class K, class V >
+int CUtlHashMap<K, V>::Next( int i ) const
+{
+	while ( ++i < m_nMaxElement )
+	{
+		if ( m_Elements[i].m_iNextFree == ELEMENT_IN_USE )
+			return i;
+	}
+	return InvalidIndex();
+}
+
+
+//-----------------------------------------------------------------------------
+// Makes room for this many elements without rehashing
+//-----------------------------------------------------------------------------
+template< class K, class V >
+void CUtlHashMap<K, V>::EnsureCapacity( int num )
+{
+	m_Elements.EnsureCapacity( num );
+	if ( ( num + 1 ) * 4 > m_Slots.NumAllocated() * 3 )
+	{
+		Rehash( ( num + 1 ) * 2 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// String hashing, FNV-1a like the symbol tables
+//-----------------------------------------------------------------------------
+inline unsigned int UtlHashString( const char *pString )
+{
+	unsigned int nHash = 2166136261U;
+	for ( const unsigned char *p = (const unsigned char *)pString; *p; ++p )
+	{
+		nHash = ( nHash ^ *p ) * 16777619U;
+	}
+	return nHash;
+}
+
+inline unsigned int UtlHashStringCaseless( const char *pString )
+{
+	unsigned int nHash = 2166136261U;
+	for ( const unsigned char *p = (const unsigned char *)pString; *p; ++p )
+	{
+		nHash = ( nHash ^ (unsigned char)tolower( *p ) ) * 16777619U;
+	}
+	return nHash;
+}
+
+
+//-----------------------------------------------------------------------------
+// The CUtlStringHashMap class:
+// A hash map from names to T, a drop in for CUtlDict where the order of the
+// names doesn't matter.  The map keeps its own copy of each name.
+//-----------------------------------------------------------------------------
+template< class T >
+class CUtlStringHashMap
+{
+public:
+	// constructor, destructor
+	CUtlStringHashMap( bool caseInsensitive = true, int initSize = 0 );
+	~CUtlStringHashMap();
+
+	// gets particular elements
+	T&			Element( int i )				{ return m_Map.Element( i ); }
+	const T&	Element( int i ) const			{ return m_Map.Element( i ); }
+	T&			operator[]( int i )				{ return m_Map.Element( i ); }
+	const T&	operator[]( int i ) const		{ return m_Map.Element( i ); }
+
+	// gets element names
+	char const	*GetElementName( int i ) const	{ return m_Map.Key( i ); }
+	void		SetElementName( int i, char const *pName );
+
+	// Number of elements
+	int			Count() const					{ return m_Map.Count(); }
+	int			MaxElement() const				{ return m_Map.MaxElement(); }
+
+	// Checks if an index refers to an element in the map
+	bool		IsValidIndex( int i ) const		{ return m_Map.IsValidIndex( i ); }
+
+	// Invalid index
+	static int	InvalidIndex()					{ return CUtlHashMap<const char *, T>::InvalidIndex(); }
+
+	// Insert methods, these don't look for the name first
+	int			Insert( const char *pName );
+	int			Insert( const char *pName, const T &element );
+
+	// Replaces the element if the name is there, otherwise inserts it
+	int			InsertOrReplace( const char *pName, const T &element );
+
+	// Find method
+	int			Find( const char *pName ) const	{ return m_Map.Find( pName ); }
+
+	// Remove methods
+	void		RemoveAt( int i );
+	bool		Remove( const char *pName );
+	void		RemoveAll();
+
+	// Purge memory
+	void		Purge();
+
+	// Iteration methods, in index order
+	int			First() const					{ return m_Map.First(); }
+	int			Next( int i ) const				{ return m_Map.Next( i ); }
+
+	// Makes room for this many elements without rehashing
+	void		EnsureCapacity( int num )		{ m_Map.EnsureCapacity( num ); }
+
+private:
+	static unsigned int HashFunc( const char * const &pName );
+	static unsigned int HashFuncCaseless( const char * const &pName );
+	static bool EqualFunc( const char * const &pName1, const char * const &pName2 );
+	static bool EqualFuncCaseless( const char * const &pName1, const char * const &pName2 );
+
+	static char *CopyName( const char *pName );
+	void FreeNames();
+
+	CUtlHashMap<const char *, T>	m_Map;
+
+	// Not implemented
+	CUtlStringHashMap( const CUtlStringHashMap<T> &src );
+	CUtlStringHashMap<T> &operator=( const CUtlStringHashMap<T> &src );
+};
+
+
+//-----------------------------------------------------------------------------
+// hash and equality functions
+//-----------------------------------------------------------------------------
+template< class T >
+unsigned int CUtlStringHashMap<T>::HashFunc( const char * const &pName )
+{
+	return UtlHashString( pName );
+}
+
+template< class T >
+unsigned int CUtlStringHashMap<T>::HashFuncCaseless( const char * const &pName )
+{
+	return UtlHashStringCaseless( pName );
+}
+
+template< class T >
+bool CUtlStringHashMap<T>::EqualFunc( const char * const &pName1, const char * const &pName2 )
+{
+	return strcmp( pName1, pName2 ) == 0;
+}
+
+template< class T >
+bool CUtlStringHashMap<T>::EqualFuncCaseless( const char * const &pName1, const char * const &pName2 )
+{
+	return Q_stricmp( pName1, pName2 ) == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// constructor, destructor
+//-----------------------------------------------------------------------------
+template< class T >
+CUtlStringHashMap<T>::CUtlStringHashMap( bool caseInsensitive, int initSize ) :
+	m_Map( caseInsensitive ? HashFuncCaseless : HashFunc, caseInsensitive ? EqualFuncCaseless : EqualFunc, initSize )
+{
+}
+
+template< class T >
+CUtlStringHashMap<T>::~CUtlStringHashMap()
+{
+	FreeNames();
+}
+
+
+//-----------------------------------------------------------------------------
+// Names are copied in and freed when their element goes
+//-----------------------------------------------------------------------------
+template< class T >
+char *CUtlStringHashMap<T>::CopyName( const char *pName )
+{
+	int len = strlen( pName ) + 1;
+	char *pCopy = new char[len];
+	memcpy( pCopy, pName, len );
+	return pCopy;
+}
+
+template< class T >
+void CUtlStringHashMap<T>::FreeNames()
+{
+	for ( int i = m_Map.First(); i != m_Map.InvalidIndex(); i = m_Map.Next( i ) )
+	{
+		delete [] (char *)m_Map.Key( i );
+	}
+}
+
+template< class T >
+void CUtlStringHashMap<T>::SetElementName( int i, char const *pName )
+{
+	char *pOldName = (char *)m_Map.Key( i );
+	m_Map.SetKey( i, CopyName( pName ) );
+	delete [] pOldName;
+}
+
+
+//-----------------------------------------------------------------------------
+// Insert methods
+//-----------------------------------------------------------------------------
+template< class T >
+int CUtlStringHashMap<T>::Insert( const char *pName )
+{
+	return m_Map.Insert( CopyName( pName ) );
+}
+
+template< class T >
+int CUtlStringHashMap<T>::Insert( const char *pName, const T &element )
+{
+	return m_Map.Insert( CopyName( pName ), element );
+}
+
+template< class T >
+int CUtlStringHashMap<T>::InsertOrReplace( const char *pName, const T &element )
+{
+	int i = m_Map.Find( pName );
+	if ( i != m_Map.InvalidIndex() )
+	{
+		m_Map.Element( i ) = element;
+		return i;
+	}
+	return m_Map.Insert( CopyName( pName ), element );
+}
+
+
+//-----------------------------------------------------------------------------
+// Remove methods
+//-----------------------------------------------------------------------------
+template< class T >
+void CUtlStringHashMap<T>::RemoveAt( int i )
+{
+	char *pName = (char *)m_Map.Key( i );
+	m_Map.RemoveAt( i );
+	delete [] pName;
+}
+
+template< class T >
+bool CUtlStringHashMap<T>::Remove( const char *pName )
+{
+	int i = m_Map.Find( pName );
+	if ( i == m_Map.InvalidIndex() )
+		return false;
+
+	RemoveAt( i );
+	return true;
+}
+
+template< class T >
+void CUtlStringHashMap<T>::RemoveAll()
+{
+	FreeNames();
+	m_Map.RemoveAll();
+}
+
+template< class T >
+void CUtlStringHashMap<T>::Purge()
+{
+	FreeNames();
+	m_Map.Purge();
+}
+
+
+#endif // UTLHASHMAP_H
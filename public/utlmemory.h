@@ -55,6 +55,9 @@ public:
 	// Attaches the buffer to external memory....
 	void SetExternalBuffer( T* pMemory, int numElements );
 
+	// Attaches the buffer to external memory that's copied to the heap if it has to grow
+	void SetGrowableExternalBuffer( T* pMemory, int numElements );
+
 	// Size
 	int NumAllocated() const;
 	int Count() const;
@@ -78,8 +81,12 @@ private:
 	enum
 	{
 		EXTERNAL_BUFFER_MARKER = -1,
+		GROWABLE_EXTERNAL_BUFFER_MARKER = -2,
 	};
 
+	// Moves a growable external buffer to the heap, returns the old buffer
+	T* DetachGrowableExternalBuffer();
+
 	T* m_pMemory;
 	int m_nAllocationCount;
 	int m_nGrowSize;
@@ -131,6 +138,29 @@ void CUtlMemory<T>::SetExternalBuffer( T* pMemory, int numElements )
 	m_nGrowSize = EXTERNAL_BUFFER_MARKER;
 }
 
+template< class T >
+void CUtlMemory<T>::SetGrowableExternalBuffer( T* pMemory, int numElements )
+{
+	Purge();
+
+	m_pMemory = pMemory;
+	m_nAllocationCount = numElements;
+
+	// We don't own it, but we can leave it for the heap
+	m_nGrowSize = GROWABLE_EXTERNAL_BUFFER_MARKER;
+}
+
+template< class T >
+T* CUtlMemory<T>::DetachGrowableExternalBuffer()
+{
+	Assert( m_nGrowSize == GROWABLE_EXTERNAL_BUFFER_MARKER );
+
+	T* pExternalMemory = m_pMemory;
+	m_pMemory = 0;
+	m_nGrowSize = 0;
+	return pExternalMemory;
+}
+
 
 //-----------------------------------------------------------------------------
 // element access
@@ -170,7 +200,7 @@ inline T const& CUtlMemory<T>::Element( int i ) const
 template< class T >
 bool CUtlMemory<T>::IsExternallyAllocated() const
 {
-	return m_nGrowSize == EXTERNAL_BUFFER_MARKER;
+	return (m_nGrowSize == EXTERNAL_BUFFER_MARKER) || (m_nGrowSize == GROWABLE_EXTERNAL_BUFFER_MARKER);
 }
 
 
@@ -178,6 +208,11 @@ template< class T >
 void CUtlMemory<T>::SetGrowSize( int nSize )
 {
 	Assert( (nSize >= 0) && (nSize != EXTERNAL_BUFFER_MARKER) );
+
+	// Losing the marker would make us free memory we don't own
+	if (m_nGrowSize == GROWABLE_EXTERNAL_BUFFER_MARKER)
+		return;
+
 	m_nGrowSize = nSize;
 }
 
@@ -232,13 +267,20 @@ void CUtlMemory<T>::Grow( int num )
 {
 	Assert( num > 0 );
 
-	if (IsExternallyAllocated())
+	if (m_nGrowSize == EXTERNAL_BUFFER_MARKER)
 	{
 		// Can't grow a buffer whose memory was externally allocated 
 		Assert(0);
 		return;
 	}
 
+	T* pExternalMemory = 0;
+	int nExternalCount = m_nAllocationCount;
+	if (m_nGrowSize == GROWABLE_EXTERNAL_BUFFER_MARKER)
+	{
+		pExternalMemory = DetachGrowableExternalBuffer();
+	}
+
 	// Make sure we have at least numallocated + num allocations.
 	// Use the grow rules specified for this memory (in m_nGrowSize)
 	int nAllocationRequested = m_nAllocationCount + num;
@@ -271,6 +313,11 @@ void CUtlMemory<T>::Grow( int num )
 	{
 		m_pMemory = (T*)Plat_Alloc( m_nAllocationCount * sizeof(T) );
 	}
+
+	if (pExternalMemory)
+	{
+		memcpy( m_pMemory, pExternalMemory, nExternalCount * sizeof(T) );
+	}
 }
 
 
@@ -283,13 +330,20 @@ inline void CUtlMemory<T>::EnsureCapacity( int num )
 	if (m_nAllocationCount >= num)
 		return;
 
-	if (IsExternallyAllocated())
+	if (m_nGrowSize == EXTERNAL_BUFFER_MARKER)
 	{
 		// Can't grow a buffer whose memory was externally allocated 
 		Assert(0);
 		return;
 	}
 
+	T* pExternalMemory = 0;
+	int nExternalCount = m_nAllocationCount;
+	if (m_nGrowSize == GROWABLE_EXTERNAL_BUFFER_MARKER)
+	{
+		pExternalMemory = DetachGrowableExternalBuffer();
+	}
+
 	m_nAllocationCount = num;
 	if (m_pMemory)
 	{
@@ -299,6 +353,11 @@ inline void CUtlMemory<T>::EnsureCapacity( int num )
 	{
 		m_pMemory = (T*)Plat_Alloc( m_nAllocationCount * sizeof(T) );
 	}
+
+	if (pExternalMemory)
+	{
+		memcpy( m_pMemory, pExternalMemory, nExternalCount * sizeof(T) );
+	}
 }
 
 
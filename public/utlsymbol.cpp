@@ -13,6 +13,9 @@
 
 #pragma warning (disable:4514)
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
 #include "utlsymbol.h"
 #include "tier0/memdbgon.h"
 
@@ -213,3 +216,378 @@ void CUtlSymbolTable::RemoveAll()
 	m_Strings.RemoveAll();
 }
 
+
+
+
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableMT
+//
+// Each shard's hash table is an array of 32 bit slots: the low 16 bits hold
+// the symbol and the high 16 bits hold part of the string's hash, which is
+// never 0, so an empty slot is 0. A slot is filled with a single aligned
+// write after the symbol's string has been stored, so a lock-free reader
+// either sees the whole entry or nothing. When a shard's table grows, the
+// new table is filled before it's published, and the old one is kept until
+// RemoveAll so readers that are still probing it are safe. This relies on
+// x86 not reordering writes with other writes. Without threads (Linux) the
+// locks do nothing.
+//-----------------------------------------------------------------------------
+
+#define SYMBOL_SHARD_MASK		( UTL_SYMBOL_TABLE_MT_SHARDS - 1 )
+#define SYMBOL_SHARD_BITS		4		// log2 of UTL_SYMBOL_TABLE_MT_SHARDS
+#define SYMBOL_POOL_SIZE		4096	// string storage is allocated in blocks this big
+#define SYMBOL_MAX_ID			( UTL_INVAL_SYMBOL - 1 )
+
+struct CUtlSymbolTableMT::Lock_t
+{
+#ifdef _WIN32
+	Lock_t()		{ InitializeCriticalSection( &m_CS ); }
+	~Lock_t()		{ DeleteCriticalSection( &m_CS ); }
+	void Lock()		{ EnterCriticalSection( &m_CS ); }
+	void Unlock()	{ LeaveCriticalSection( &m_CS ); }
+
+	CRITICAL_SECTION m_CS;
+#else
+	void Lock()		{}
+	void Unlock()	{}
+#endif
+};
+
+struct CUtlSymbolTableMT::Table_t
+{
+	Table_t			*m_pRetired;	// tables this one replaced
+	int				m_nMask;		// size - 1
+	volatile unsigned int m_Slots[1];
+};
+
+struct CUtlSymbolTableMT::Shard_t
+{
+	Table_t * volatile m_pTable;
+	int				m_nCount;
+
+	// string storage
+	char			*m_pPool;
+	int				m_nPoolUsed;
+	int				m_nPoolSize;
+	CUtlVector<char*> m_Pools;
+
+	Lock_t			m_Lock;		// held while a string is added
+};
+
+CUtlSymbolTableMT::Table_t *CUtlSymbolTableMT::AllocTable( int size )
+{
+	int nBytes = sizeof( Table_t ) + ( size - 1 ) * sizeof( unsigned int );
+	Table_t *pTable = (Table_t *)malloc( nBytes );
+	memset( pTable, 0, nBytes );
+	pTable->m_nMask = size - 1;
+	return pTable;
+}
+
+void CUtlSymbolTableMT::FreeTable( Table_t *pTable )
+{
+	while ( pTable )
+	{
+		Table_t *pRetired = pTable->m_pRetired;
+		free( pTable );
+		pTable = pRetired;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// constructor, destructor
+//-----------------------------------------------------------------------------
+
+CUtlSymbolTableMT::CUtlSymbolTableMT( int growSize, int initSize, bool caseInsensitive )
+{
+	m_bCaseInsensitive = caseInsensitive;
+	m_nSymbols = 0;
+	memset( m_pEntryPages, 0, sizeof( m_pEntryPages ) );
+
+	// Keep the tables at most half full
+	int perShard = ( initSize * 2 ) / UTL_SYMBOL_TABLE_MT_SHARDS;
+	m_nInitTableSize = 8;
+	while ( m_nInitTableSize < perShard )
+	{
+		m_nInitTableSize <<= 1;
+	}
+
+	m_pSymbolLock = new Lock_t;
+	m_pShards = new Shard_t[UTL_SYMBOL_TABLE_MT_SHARDS];
+	for ( int i = 0; i < UTL_SYMBOL_TABLE_MT_SHARDS; i++ )
+	{
+		Shard_t &shard = m_pShards[i];
+		shard.m_pTable = AllocTable( m_nInitTableSize );
+		shard.m_nCount = 0;
+		shard.m_pPool = NULL;
+		shard.m_nPoolUsed = 0;
+		shard.m_nPoolSize = 0;
+	}
+}
+
+CUtlSymbolTableMT::~CUtlSymbolTableMT()
+{
+	RemoveAll();
+
+	for ( int i = 0; i < UTL_SYMBOL_TABLE_MT_SHARDS; i++ )
+	{
+		FreeTable( m_pShards[i].m_pTable );
+	}
+	delete [] m_pShards;
+	delete m_pSymbolLock;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hashing and comparison, which have to agree on case sensitivity
+//-----------------------------------------------------------------------------
+
+unsigned int CUtlSymbolTableMT::HashString( char const* pString ) const
+{
+	// FNV-1a
+	unsigned int hash = 2166136261U;
+	if ( m_bCaseInsensitive )
+	{
+		for ( ; *pString; ++pString )
+		{
+			unsigned char c = (unsigned char)*pString;
+			if ( c >= 'A' && c <= 'Z' )
+			{
+				c += 'a' - 'A';
+			}
+			hash = ( hash ^ c ) * 16777619U;
+		}
+	}
+	else
+	{
+		for ( ; *pString; ++pString )
+		{
+			hash = ( hash ^ (unsigned char)*pString ) * 16777619U;
+		}
+	}
+	return hash;
+}
+
+bool CUtlSymbolTableMT::StringsMatch( char const* pString, char const* pSymbolString ) const
+{
+	if ( m_bCaseInsensitive )
+		return strcmpi( pString, pSymbolString ) == 0;
+	return strcmp( pString, pSymbolString ) == 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Probes a shard's table. The low bits of the hash picked the shard, the
+// middle bits pick the slot and the high 16 bits are kept in the slot.
+//-----------------------------------------------------------------------------
+
+static inline unsigned int SymbolSlotTag( unsigned int hash )
+{
+	unsigned int tag = hash >> 16;
+	return tag ? tag : 1;
+}
+
+UtlSymId_t CUtlSymbolTableMT::FindInTable( Table_t *pTable, unsigned int hash, char const* pString ) const
+{
+	unsigned int tag = SymbolSlotTag( hash );
+	int i = ( hash >> SYMBOL_SHARD_BITS ) & pTable->m_nMask;
+	while ( 1 )
+	{
+		unsigned int slot = pTable->m_Slots[i];
+		if ( !slot )
+			return UTL_INVAL_SYMBOL;
+
+		if ( ( slot >> 16 ) == tag )
+		{
+			UtlSymId_t id = (UtlSymId_t)( slot & 0xFFFF );
+			if ( StringsMatch( pString, m_pEntryPages[id >> ENTRY_PAGE_BITS][id & ( ENTRY_PAGE_SIZE - 1 )] ) )
+				return id;
+		}
+
+		i = ( i + 1 ) & pTable->m_nMask;
+	}
+}
+
+void CUtlSymbolTableMT::InsertInTable( Table_t *pTable, unsigned int hash, UtlSymId_t id )
+{
+	int i = ( hash >> SYMBOL_SHARD_BITS ) & pTable->m_nMask;
+	while ( pTable->m_Slots[i] )
+	{
+		i = ( i + 1 ) & pTable->m_nMask;
+	}
+	pTable->m_Slots[i] = ( SymbolSlotTag( hash ) << 16 ) | id;
+}
+
+
+//-----------------------------------------------------------------------------
+// Doubles the size of a shard's table. Called with the shard locked.
+//-----------------------------------------------------------------------------
+
+void CUtlSymbolTableMT::GrowShard( Shard_t &shard )
+{
+	Table_t *pOld = shard.m_pTable;
+	Table_t *pNew = AllocTable( ( pOld->m_nMask + 1 ) * 2 );
+
+	for ( int i = 0; i <= pOld->m_nMask; i++ )
+	{
+		unsigned int slot = pOld->m_Slots[i];
+		if ( slot )
+		{
+			UtlSymId_t id = (UtlSymId_t)( slot & 0xFFFF );
+			InsertInTable( pNew, HashString( String( id ) ), id );
+		}
+	}
+
+	pNew->m_pRetired = pOld;
+	shard.m_pTable = pNew;
+}
+
+
+//-----------------------------------------------------------------------------
+// Stores a copy of a string. Called with the shard locked.
+//-----------------------------------------------------------------------------
+
+char *CUtlSymbolTableMT::AllocString( Shard_t &shard, int len )
+{
+	if ( shard.m_nPoolUsed + len > shard.m_nPoolSize )
+	{
+		shard.m_nPoolSize = ( len > SYMBOL_POOL_SIZE ) ? len : SYMBOL_POOL_SIZE;
+		shard.m_pPool = (char *)malloc( shard.m_nPoolSize );
+		shard.m_nPoolUsed = 0;
+		shard.m_Pools.AddToTail( shard.m_pPool );
+	}
+
+	char *pString = shard.m_pPool + shard.m_nPoolUsed;
+	shard.m_nPoolUsed += len;
+	return pString;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hands out the next symbol number for a string
+//-----------------------------------------------------------------------------
+
+UtlSymId_t CUtlSymbolTableMT::AllocSymbol( char const* pString )
+{
+	m_pSymbolLock->Lock();
+
+	if ( m_nSymbols > SYMBOL_MAX_ID )
+	{
+		m_pSymbolLock->Unlock();
+		Assert( !"CUtlSymbolTableMT: too many symbols" );
+		return UTL_INVAL_SYMBOL;
+	}
+
+	UtlSymId_t id = (UtlSymId_t)m_nSymbols;
+	int page = id >> ENTRY_PAGE_BITS;
+	if ( !m_pEntryPages[page] )
+	{
+		m_pEntryPages[page] = (char const* volatile *)malloc( ENTRY_PAGE_SIZE * sizeof( char const* ) );
+	}
+	m_pEntryPages[page][id & ( ENTRY_PAGE_SIZE - 1 )] = pString;
+	++m_nSymbols;
+
+	m_pSymbolLock->Unlock();
+	return id;
+}
+
+
+CUtlSymbol CUtlSymbolTableMT::Find( char const* pString )
+{
+	if (!pString)
+		return CUtlSymbol();
+
+	unsigned int hash = HashString( pString );
+	Shard_t &shard = m_pShards[hash & SYMBOL_SHARD_MASK];
+	return CUtlSymbol( FindInTable( shard.m_pTable, hash, pString ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds and/or creates a symbol based on the string
+//-----------------------------------------------------------------------------
+
+CUtlSymbol CUtlSymbolTableMT::AddString( char const* pString )
+{
+	if (!pString) 
+		return CUtlSymbol( UTL_INVAL_SYMBOL );
+
+	unsigned int hash = HashString( pString );
+	Shard_t &shard = m_pShards[hash & SYMBOL_SHARD_MASK];
+
+	UtlSymId_t id = FindInTable( shard.m_pTable, hash, pString );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	shard.m_Lock.Lock();
+
+	// Someone may have added it since we looked
+	id = FindInTable( shard.m_pTable, hash, pString );
+	if ( id == UTL_INVAL_SYMBOL )
+	{
+		int len = strlen( pString ) + 1;
+		char *pCopy = AllocString( shard, len );
+		memcpy( pCopy, pString, len );
+
+		id = AllocSymbol( pCopy );
+		if ( id != UTL_INVAL_SYMBOL )
+		{
+			if ( ( shard.m_nCount + 1 ) * 2 > shard.m_pTable->m_nMask + 1 )
+			{
+				GrowShard( shard );
+			}
+			InsertInTable( shard.m_pTable, hash, id );
+			++shard.m_nCount;
+		}
+	}
+
+	shard.m_Lock.Unlock();
+	return CUtlSymbol( id );
+}
+
+
+//-----------------------------------------------------------------------------
+// Look up the string associated with a particular symbol
+//-----------------------------------------------------------------------------
+
+char const* CUtlSymbolTableMT::String( CUtlSymbol id ) const
+{
+	if (!id.IsValid()) 
+		return "";
+
+	Assert( (UtlSymId_t)id < m_nSymbols );
+	return m_pEntryPages[(UtlSymId_t)id >> ENTRY_PAGE_BITS][(UtlSymId_t)id & ( ENTRY_PAGE_SIZE - 1 )];
+}
+
+
+//-----------------------------------------------------------------------------
+// Remove all symbols in the table.
+//-----------------------------------------------------------------------------
+
+void CUtlSymbolTableMT::RemoveAll()
+{
+	for ( int i = 0; i < UTL_SYMBOL_TABLE_MT_SHARDS; i++ )
+	{
+		Shard_t &shard = m_pShards[i];
+
+		FreeTable( shard.m_pTable );
+		shard.m_pTable = AllocTable( m_nInitTableSize );
+		shard.m_nCount = 0;
+
+		for ( int j = 0; j < shard.m_Pools.Count(); j++ )
+		{
+			free( shard.m_Pools[j] );
+		}
+		shard.m_Pools.Purge();
+		shard.m_pPool = NULL;
+		shard.m_nPoolUsed = 0;
+		shard.m_nPoolSize = 0;
+	}
+
+	for ( int page = 0; page < ENTRY_PAGE_COUNT; page++ )
+	{
+		free( (void *)m_pEntryPages[page] );
+		m_pEntryPages[page] = NULL;
+	}
+	m_nSymbols = 0;
+}
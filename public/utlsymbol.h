@@ -120,4 +120,73 @@ protected:
 };
 
 
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableMT:
+// description:
+//    Drop-in replacement for CUtlSymbolTable that several threads can use at
+//    once. Strings are found through an open addressing hash table that's split
+//    into shards. Find, String, and AddString of a string that's already in the
+//    table don't take any locks; adding a new string locks only its shard.
+//    Symbols are numbered in the order strings are added, and neither symbols
+//    nor strings ever move, so a symbol stays valid until RemoveAll.
+//-----------------------------------------------------------------------------
+
+#define UTL_SYMBOL_TABLE_MT_SHARDS		16		// must be a power of two
+
+class CUtlSymbolTableMT
+{
+public:
+	// constructor, destructor
+	CUtlSymbolTableMT( int growSize = 0, int initSize = 32, bool caseInsensitive = false );
+	~CUtlSymbolTableMT();
+
+	// Finds and/or creates a symbol based on the string
+	CUtlSymbol AddString( char const* pString );
+
+	// Finds the symbol for pString
+	CUtlSymbol Find( char const* pString );
+
+	// Look up the string associated with a particular symbol
+	char const* String( CUtlSymbol id ) const;
+
+	// Remove all symbols in the table. No other thread may be using the table.
+	void  RemoveAll();
+
+	// Number of symbols in the table
+	int GetNumStrings() const { return m_nSymbols; }
+
+protected:
+	struct Table_t;
+	struct Shard_t;
+	struct Lock_t;
+
+	enum
+	{
+		ENTRY_PAGE_BITS = 8,
+		ENTRY_PAGE_SIZE = ( 1 << ENTRY_PAGE_BITS ),
+		ENTRY_PAGE_COUNT = ( 1 << ( 16 - ENTRY_PAGE_BITS ) ),
+	};
+
+	static Table_t *AllocTable( int size );
+	static void FreeTable( Table_t *pTable );
+	unsigned int HashString( char const* pString ) const;
+	bool StringsMatch( char const* pString, char const* pSymbolString ) const;
+	UtlSymId_t FindInTable( Table_t *pTable, unsigned int hash, char const* pString ) const;
+	void InsertInTable( Table_t *pTable, unsigned int hash, UtlSymId_t id );
+	void GrowShard( Shard_t &shard );
+	char *AllocString( Shard_t &shard, int len );
+	UtlSymId_t AllocSymbol( char const* pString );
+
+	Shard_t *m_pShards;
+	Lock_t *m_pSymbolLock;	// held while a symbol number is handed out
+
+	// symbol -> string, in pages that are allocated as needed and never move
+	char const* volatile *m_pEntryPages[ENTRY_PAGE_COUNT];
+	volatile int m_nSymbols;
+
+	int m_nInitTableSize;
+	bool m_bCaseInsensitive;
+};
+
+
 #endif // UTLSYMBOL_H
@@ -605,4 +605,56 @@ void CUtlVector<T>::SetGrowSize( int size )
 }
 
 
+//-----------------------------------------------------------------------------
+// The CUtlVectorFixedGrowable class:
+// A CUtlVector with room for MAX_SIZE elements inside it, for the short lists
+// that get built and thrown away every call. It only goes to the heap once
+// it grows past MAX_SIZE, and it can be passed anywhere a CUtlVector can.
+//-----------------------------------------------------------------------------
+
+template< class T, int MAX_SIZE >
+class CUtlVectorFixedGrowable : public CUtlVector< T >
+{
+public:
+	CUtlVectorFixedGrowable()
+	{
+		this->m_Memory.SetGrowableExternalBuffer( (T*)m_FixedMemory, MAX_SIZE );
+		this->ResetDbgInfo();
+	}
+
+	~CUtlVectorFixedGrowable()
+	{
+		// Destruct the elements while the fixed memory is still ours
+		this->RemoveAll();
+	}
+
+	CUtlVectorFixedGrowable< T, MAX_SIZE >& operator=( const CUtlVector< T > &other )
+	{
+		this->CopyArray( other.Base(), other.Count() );
+		return *this;
+	}
+
+	CUtlVectorFixedGrowable< T, MAX_SIZE >& operator=( const CUtlVectorFixedGrowable< T, MAX_SIZE > &other )
+	{
+		this->CopyArray( other.Base(), other.Count() );
+		return *this;
+	}
+
+	// Frees any heap memory and goes back to the fixed memory
+	void Purge()
+	{
+		CUtlVector< T >::Purge();
+		this->m_Memory.SetGrowableExternalBuffer( (T*)m_FixedMemory, MAX_SIZE );
+		this->ResetDbgInfo();
+	}
+
+private:
+	// Can't copy this unless we explicitly do it!
+	CUtlVectorFixedGrowable( CUtlVectorFixedGrowable< T, MAX_SIZE > const& vec ) { Assert(0); }
+
+	// Doubles so the elements are aligned as if they came from the heap
+	double m_FixedMemory[ ( MAX_SIZE * sizeof(T) + sizeof(double) - 1 ) / sizeof(double) ];
+};
+
+
 #endif // CCVECTOR_H
@@ -120,7 +120,7 @@ class CPhysPolysoup;
 class ICollisionQuery;
 class IVPhysicsKeyParser;
 
-#define VPHYSICS_COLLISION_INTERFACE_VERSION	"VPhysicsCollision007"
+#define VPHYSICS_COLLISION_INTERFACE_VERSION	"VPhysicsCollision008"
 
 class IPhysicsCollision
 {
@@ -211,8 +211,18 @@ public:
 
 	// UNDONE: Move this up when changing the interface version
 	virtual void TraceBox( const Ray_t &ray, unsigned int contentsMask, IConvexInfo *pConvexInfo, const CPhysCollide *pCollide, const Vector &collideOrigin, const QAngle &collideAngles, trace_t *ptr ) = 0;
+
+	// Like VCollideLoad, but the solids and key values point into pBuffer instead of being copied.
+	// Before each solid's size, the read position is rounded up so the solid data lands on a
+	// VCOLLIDE_INPLACE_ALIGN byte boundary.  pBuffer must stay valid (and unchanged) until
+	// VCollideUnloadInPlace is called.  Used to share read-only collision data between processes.
+	virtual void			VCollideLoadInPlace( vcollide_t *pOutput, int solidCount, const char *pBuffer, int size ) = 0;
+	// destroys a vcollide_t created by VCollideLoadInPlace; the buffer is left alone
+	virtual void			VCollideUnloadInPlace( vcollide_t *pVCollide ) = 0;
 };
 
+#define VCOLLIDE_INPLACE_ALIGN	32
+
 // this can be used to post-process a collision model
 class ICollisionQuery
 {
@@ -16,6 +16,15 @@
 typedef int HKeySymbol;
 #define INVALID_KEY_SYMBOL (-1)
 
+// time spent in KeyValues::LoadFromFile, split by whether the binary cache was used
+struct KeyValuesLoadStats_t
+{
+	int		m_nTextLoads;
+	float	m_flTextTime;
+	int		m_nCacheLoads;
+	float	m_flCacheTime;
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Interface to shared data repository for KeyValues (included in vgui_controls.lib)
 //			allows for central data storage point of KeyValues symbol table
@@ -35,6 +44,20 @@ public:
 	// symbol table access (used for key names)
 	virtual HKeySymbol GetSymbolForString(const char *name) = 0;
 	virtual const char *GetStringForSymbol(HKeySymbol symbol) = 0;
+
+	// enables the binary cache KeyValues::LoadFromFile keeps under kvcache/ (off by default,
+	// the caller must make sure the directory exists in the write path)
+	virtual void SetBinaryCacheEnabled(bool bEnabled) = 0;
+	virtual bool IsBinaryCacheEnabled() = 0;
+
+	// load time accounting for KeyValues::LoadFromFile
+	virtual void AddLoadTime(bool bFromCache, float flSeconds) = 0;
+	virtual void GetLoadStats(KeyValuesLoadStats_t &stats) = 0;
+
+	// the KeyValues memory pool is shared by every thread; this gives its completely free
+	// blobs back to the system (after a map change) and returns the bytes freed
+	virtual int ReleaseFreeMemory() = 0;
+	virtual void ReportMemoryStats(void (*pfnReport)(char const *pMsg, ...)) = 0;
 };
 
 VSTDLIB_INTERFACE IKeyValuesSystem *KeyValuesSystem();
@@ -0,0 +1,740 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Sampling heap profiler for the release allocator
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include "tier0/memprofile.h"
+#include "tier0/dbg.h"
+
+#if defined( _WIN32 ) && !defined( _DEBUG )
+
+#define WIN_32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The stack is walked from here through the frame pointers
+#pragma optimize( "y", off )
+
+
+//-----------------------------------------------------------------------------
+// Rather than looking at every allocation, each thread counts down a random
+// interval averaging the sample rate in bytes, and the allocation that takes
+// it past zero is sampled and stands for all the bytes in the interval(s) it
+// finished.  So big allocations are always seen, and the estimate of live
+// bytes per site comes out right on average whatever the mix of sizes is.
+//
+// Sampled allocations are kept in a hash by address so frees can find them.
+// Frees of anything else only cost a look at one bucket head.
+//
+// The profiler's own memory comes straight from the CRT so it's never sampled.
+//-----------------------------------------------------------------------------
+
+#define MEMPROFILE_MIN_SAMPLE_BYTES		256
+#define MEMPROFILE_MAX_FRAMES			16
+#define MEMPROFILE_MAX_SITES			32768
+#define MEMPROFILE_DBG_INFO_DEPTH		8
+#define MEMPROFILE_DBG_NAME_LENGTH		48
+#define MEMPROFILE_SAMPLE_HASH_BITS		16
+#define MEMPROFILE_SAMPLE_HASH_SIZE		( 1 << MEMPROFILE_SAMPLE_HASH_BITS )
+#define MEMPROFILE_SITE_HASH_SIZE		4096
+#define MEMPROFILE_SAMPLE_BLOCK			1024
+
+struct MemProfileSite_t
+{
+	MemProfileSite_t	*m_pNextInHash;
+	unsigned long		m_nHash;
+	char				m_DbgName[MEMPROFILE_DBG_NAME_LENGTH];	// "file(line)" from PushAllocDbgInfo, or empty
+	int					m_nFrames;
+	void				*m_pFrames[MEMPROFILE_MAX_FRAMES];		// Innermost first
+	int					m_nLiveBytes;
+	int					m_nLiveSamples;
+	int					m_nMarkBytes;
+	__int64				m_nTotalBytes;
+};
+
+struct MemProfileSample_t
+{
+	MemProfileSample_t	*m_pNext;
+	void				*m_pMem;
+	MemProfileSite_t	*m_pSite;
+	int					m_nWeight;
+};
+
+struct MemProfileThread_t
+{
+	long				m_nBytesUntilSample;
+	unsigned long		m_nSeed;
+	int					m_nDbgInfoDepth;
+	const char			*m_pDbgFileName[MEMPROFILE_DBG_INFO_DEPTH];
+	int					m_nDbgLine[MEMPROFILE_DBG_INFO_DEPTH];
+};
+
+static __declspec(thread) MemProfileThread_t s_MemProfileThread;
+
+// memstd.cpp checks these before calling in
+volatile bool g_bMemProfileActive = false;
+volatile long g_nMemProfileSamples = 0;
+
+static bool s_bInitialized = false;
+static CRITICAL_SECTION s_MemProfileLock;
+static long s_nSampleBytes = MEMPROFILE_DEFAULT_SAMPLE_BYTES;
+static bool s_bMarked = false;
+
+static const char *s_pTier0Base;
+static unsigned long s_nTier0Size;
+
+static MemProfileSample_t **s_pSampleHash;
+static MemProfileSample_t *s_pFreeSamples;
+
+static MemProfileSite_t *s_pSiteHash[MEMPROFILE_SITE_HASH_SIZE];
+static int s_nSites;
+static MemProfileSite_t s_OverflowSite;		// Charged once there are too many sites
+
+
+//-----------------------------------------------------------------------------
+// Allocation debug info, the release allocator passes it through to here
+//-----------------------------------------------------------------------------
+void MemProfile_PushAllocDbgInfo( const char *pFileName, int nLine )
+{
+	MemProfileThread_t &thread = s_MemProfileThread;
+	if ( thread.m_nDbgInfoDepth < MEMPROFILE_DBG_INFO_DEPTH )
+	{
+		thread.m_pDbgFileName[thread.m_nDbgInfoDepth] = pFileName;
+		thread.m_nDbgLine[thread.m_nDbgInfoDepth] = nLine;
+	}
+	++thread.m_nDbgInfoDepth;
+}
+
+void MemProfile_PopAllocDbgInfo()
+{
+	MemProfileThread_t &thread = s_MemProfileThread;
+	if ( thread.m_nDbgInfoDepth > 0 )
+	{
+		--thread.m_nDbgInfoDepth;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Walks the frame pointer chain, leaving out the frames in tier0 at the top.
+// Modules built without frame pointers are skipped over or end the walk, so
+// stacks through them come out shorter but they're still a usable key.
+//-----------------------------------------------------------------------------
+static int CaptureStack( void **pFrames, int nMaxFrames )
+{
+	NT_TIB *pTib;
+	void **pFrame;
+	__asm
+	{
+		mov eax, fs:[18h]
+		mov pTib, eax
+		mov pFrame, ebp
+	}
+
+	int nFrames = 0;
+	bool bInTier0 = true;
+	while ( nFrames < nMaxFrames )
+	{
+		if ( (void *)pFrame < pTib->StackLimit || (void *)( pFrame + 2 ) > pTib->StackBase || ( (unsigned long)pFrame & 3 ) )
+			break;
+
+		void *pReturn = pFrame[1];
+		if ( !pReturn )
+			break;
+
+		if ( !bInTier0 || (unsigned long)( (const char *)pReturn - s_pTier0Base ) >= s_nTier0Size )
+		{
+			bInTier0 = false;
+			pFrames[nFrames++] = pReturn;
+		}
+
+		void **pNext = (void **)pFrame[0];
+		if ( pNext <= pFrame )
+			break;
+		pFrame = pNext;
+	}
+
+	return nFrames;
+}
+
+static void FormatAddress( const void *pAddress, char *pBuf, int nBufLen )
+{
+	MEMORY_BASIC_INFORMATION info;
+	char pModuleName[MAX_PATH];
+	if ( VirtualQuery( pAddress, &info, sizeof( info ) ) && info.AllocationBase &&
+		GetModuleFileName( (HMODULE)info.AllocationBase, pModuleName, sizeof( pModuleName ) ) )
+	{
+		const char *pName = strrchr( pModuleName, '\\' );
+		pName = ( pName ) ? pName + 1 : pModuleName;
+		_snprintf( pBuf, nBufLen, "%s+0x%x", pName, (const char *)pAddress - (const char *)info.AllocationBase );
+	}
+	else
+	{
+		_snprintf( pBuf, nBufLen, "0x%08x", pAddress );
+	}
+	pBuf[nBufLen - 1] = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Sites and samples, called with the lock held
+//-----------------------------------------------------------------------------
+static inline unsigned int SampleBucket( const void *pMem )
+{
+	return ( ( (unsigned long)pMem >> 3 ) * 2654435761U ) >> ( 32 - MEMPROFILE_SAMPLE_HASH_BITS );
+}
+
+static MemProfileSite_t *FindOrAddSite( void **pFrames, int nFrames, const char *pDbgFile, int nDbgLine )
+{
+	unsigned long nHash = (unsigned long)pDbgFile * 31 + nDbgLine;
+	for ( int i = 0; i < nFrames; i++ )
+	{
+		nHash = ( nHash * 33 ) ^ (unsigned long)pFrames[i];
+	}
+
+	char pDbgName[MEMPROFILE_DBG_NAME_LENGTH];
+	pDbgName[0] = 0;
+	if ( pDbgFile )
+	{
+		_snprintf( pDbgName, sizeof( pDbgName ), "%s(%d)", pDbgFile, nDbgLine );
+		pDbgName[sizeof( pDbgName ) - 1] = 0;
+	}
+
+	MemProfileSite_t **ppBucket = &s_pSiteHash[nHash % MEMPROFILE_SITE_HASH_SIZE];
+	MemProfileSite_t *pSite;
+	for ( pSite = *ppBucket; pSite; pSite = pSite->m_pNextInHash )
+	{
+		if ( pSite->m_nHash == nHash && pSite->m_nFrames == nFrames &&
+			!memcmp( pSite->m_pFrames, pFrames, nFrames * sizeof( void * ) ) &&
+			!strcmp( pSite->m_DbgName, pDbgName ) )
+		{
+			return pSite;
+		}
+	}
+
+	if ( s_nSites >= MEMPROFILE_MAX_SITES )
+		return &s_OverflowSite;
+
+	pSite = (MemProfileSite_t *)calloc( 1, sizeof( MemProfileSite_t ) );
+	if ( !pSite )
+		return &s_OverflowSite;
+
+	pSite->m_nHash = nHash;
+	strcpy( pSite->m_DbgName, pDbgName );
+	pSite->m_nFrames = nFrames;
+	memcpy( pSite->m_pFrames, pFrames, nFrames * sizeof( void * ) );
+	pSite->m_pNextInHash = *ppBucket;
+	*ppBucket = pSite;
+	++s_nSites;
+	return pSite;
+}
+
+static MemProfileSample_t *NewSample()
+{
+	if ( !s_pFreeSamples )
+	{
+		MemProfileSample_t *pBlock = (MemProfileSample_t *)malloc( MEMPROFILE_SAMPLE_BLOCK * sizeof( MemProfileSample_t ) );
+		if ( !pBlock )
+			return NULL;
+
+		for ( int i = 0; i < MEMPROFILE_SAMPLE_BLOCK; i++ )
+		{
+			pBlock[i].m_pNext = s_pFreeSamples;
+			s_pFreeSamples = &pBlock[i];
+		}
+	}
+
+	MemProfileSample_t *pSample = s_pFreeSamples;
+	s_pFreeSamples = pSample->m_pNext;
+	return pSample;
+}
+
+
+//-----------------------------------------------------------------------------
+// Allocator hooks
+//-----------------------------------------------------------------------------
+static long NextSampleInterval( MemProfileThread_t &thread )
+{
+	if ( !thread.m_nSeed )
+	{
+		thread.m_nSeed = GetCurrentThreadId();
+	}
+	thread.m_nSeed = thread.m_nSeed * 1103515245 + 12345;
+	return s_nSampleBytes / 2 + (long)( ( thread.m_nSeed >> 8 ) % (unsigned long)s_nSampleBytes );
+}
+
+static void SampleAlloc( void *pMem, int nWeight )
+{
+	void *pFrames[MEMPROFILE_MAX_FRAMES];
+	int nFrames = CaptureStack( pFrames, MEMPROFILE_MAX_FRAMES );
+
+	const char *pDbgFile = NULL;
+	int nDbgLine = 0;
+	MemProfileThread_t &thread = s_MemProfileThread;
+	if ( thread.m_nDbgInfoDepth > 0 )
+	{
+		int i = min( thread.m_nDbgInfoDepth, MEMPROFILE_DBG_INFO_DEPTH ) - 1;
+		pDbgFile = thread.m_pDbgFileName[i];
+		nDbgLine = thread.m_nDbgLine[i];
+	}
+
+	EnterCriticalSection( &s_MemProfileLock );
+
+	MemProfileSample_t *pSample = NewSample();
+	if ( pSample )
+	{
+		MemProfileSite_t *pSite = FindOrAddSite( pFrames, nFrames, pDbgFile, nDbgLine );
+		pSite->m_nLiveBytes += nWeight;
+		pSite->m_nLiveSamples++;
+		pSite->m_nTotalBytes += nWeight;
+
+		pSample->m_pMem = pMem;
+		pSample->m_pSite = pSite;
+		pSample->m_nWeight = nWeight;
+
+		MemProfileSample_t **ppBucket = &s_pSampleHash[SampleBucket( pMem )];
+		pSample->m_pNext = *ppBucket;
+		*ppBucket = pSample;
+		InterlockedIncrement( &g_nMemProfileSamples );
+	}
+
+	LeaveCriticalSection( &s_MemProfileLock );
+}
+
+void MemProfile_OnAlloc( void *pMem, size_t nSize )
+{
+	MemProfileThread_t &thread = s_MemProfileThread;
+	thread.m_nBytesUntilSample -= (long)nSize;
+	if ( thread.m_nBytesUntilSample >= 0 )
+		return;
+
+	// Big allocations can finish several intervals
+	int nWeight = 0;
+	do
+	{
+		long nInterval = NextSampleInterval( thread );
+		thread.m_nBytesUntilSample += nInterval;
+		nWeight += nInterval;
+	}
+	while ( thread.m_nBytesUntilSample < 0 );
+
+	if ( pMem )
+	{
+		SampleAlloc( pMem, nWeight );
+	}
+}
+
+void MemProfile_OnFree( void *pMem )
+{
+	// No lock needed to see the bucket's empty; if pMem was sampled it's in there
+	MemProfileSample_t **ppBucket = &s_pSampleHash[SampleBucket( pMem )];
+	if ( !*ppBucket )
+		return;
+
+	EnterCriticalSection( &s_MemProfileLock );
+
+	for ( MemProfileSample_t **ppSample = ppBucket; *ppSample; ppSample = &(*ppSample)->m_pNext )
+	{
+		MemProfileSample_t *pSample = *ppSample;
+		if ( pSample->m_pMem == pMem )
+		{
+			*ppSample = pSample->m_pNext;
+			pSample->m_pSite->m_nLiveBytes -= pSample->m_nWeight;
+			pSample->m_pSite->m_nLiveSamples--;
+			pSample->m_pNext = s_pFreeSamples;
+			s_pFreeSamples = pSample;
+			InterlockedDecrement( &g_nMemProfileSamples );
+			break;
+		}
+	}
+
+	LeaveCriticalSection( &s_MemProfileLock );
+}
+
+
+//-----------------------------------------------------------------------------
+// Control
+//-----------------------------------------------------------------------------
+void MemProfile_Start( int nSampleBytes )
+{
+	if ( !s_bInitialized )
+	{
+		s_pSampleHash = (MemProfileSample_t **)calloc( MEMPROFILE_SAMPLE_HASH_SIZE, sizeof( MemProfileSample_t * ) );
+		if ( !s_pSampleHash )
+		{
+			Warning( "Couldn't start the heap profiler, out of memory\n" );
+			return;
+		}
+
+		InitializeCriticalSection( &s_MemProfileLock );
+		strcpy( s_OverflowSite.m_DbgName, "<too many sites>" );
+
+		// Frames in tier0 itself are left off the stacks
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery( (void *)&CaptureStack, &info, sizeof( info ) );
+		const IMAGE_DOS_HEADER *pDosHeader = (const IMAGE_DOS_HEADER *)info.AllocationBase;
+		const IMAGE_NT_HEADERS *pNtHeaders = (const IMAGE_NT_HEADERS *)( (const char *)pDosHeader + pDosHeader->e_lfanew );
+		s_pTier0Base = (const char *)pDosHeader;
+		s_nTier0Size = pNtHeaders->OptionalHeader.SizeOfImage;
+
+		s_bInitialized = true;
+	}
+
+	s_nSampleBytes = max( nSampleBytes, MEMPROFILE_MIN_SAMPLE_BYTES );
+	g_bMemProfileActive = true;
+	Msg( "Heap profiler sampling every %d bytes\n", s_nSampleBytes );
+}
+
+void MemProfile_Stop()
+{
+	g_bMemProfileActive = false;
+}
+
+bool MemProfile_IsActive()
+{
+	return g_bMemProfileActive;
+}
+
+void MemProfile_Reset()
+{
+	if ( !s_bInitialized )
+		return;
+
+	EnterCriticalSection( &s_MemProfileLock );
+
+	for ( int i = 0; i < MEMPROFILE_SAMPLE_HASH_SIZE; i++ )
+	{
+		while ( s_pSampleHash[i] )
+		{
+			MemProfileSample_t *pSample = s_pSampleHash[i];
+			s_pSampleHash[i] = pSample->m_pNext;
+			pSample->m_pNext = s_pFreeSamples;
+			s_pFreeSamples = pSample;
+		}
+	}
+	g_nMemProfileSamples = 0;
+
+	for ( int j = 0; j < MEMPROFILE_SITE_HASH_SIZE; j++ )
+	{
+		while ( s_pSiteHash[j] )
+		{
+			MemProfileSite_t *pSite = s_pSiteHash[j];
+			s_pSiteHash[j] = pSite->m_pNextInHash;
+			free( pSite );
+		}
+	}
+	s_nSites = 0;
+
+	s_OverflowSite.m_nLiveBytes = s_OverflowSite.m_nLiveSamples = s_OverflowSite.m_nMarkBytes = 0;
+	s_OverflowSite.m_nTotalBytes = 0;
+	s_bMarked = false;
+
+	LeaveCriticalSection( &s_MemProfileLock );
+}
+
+void MemProfile_Mark()
+{
+	if ( !s_bInitialized )
+		return;
+
+	EnterCriticalSection( &s_MemProfileLock );
+
+	for ( int i = 0; i < MEMPROFILE_SITE_HASH_SIZE; i++ )
+	{
+		for ( MemProfileSite_t *pSite = s_pSiteHash[i]; pSite; pSite = pSite->m_pNextInHash )
+		{
+			pSite->m_nMarkBytes = pSite->m_nLiveBytes;
+		}
+	}
+	s_OverflowSite.m_nMarkBytes = s_OverflowSite.m_nLiveBytes;
+	s_bMarked = true;
+
+	LeaveCriticalSection( &s_MemProfileLock );
+}
+
+
+//-----------------------------------------------------------------------------
+// Reports.  The sites are copied out under the lock and printed after, since
+// printing allocates.
+//-----------------------------------------------------------------------------
+static MemProfileSite_t *CopySites( int &nSites )
+{
+	nSites = 0;
+	if ( !s_bInitialized )
+	{
+		Msg( "The heap profiler hasn't been started\n" );
+		return NULL;
+	}
+
+	EnterCriticalSection( &s_MemProfileLock );
+
+	MemProfileSite_t *pSites = (MemProfileSite_t *)malloc( ( s_nSites + 1 ) * sizeof( MemProfileSite_t ) );
+	if ( pSites )
+	{
+		for ( int i = 0; i < MEMPROFILE_SITE_HASH_SIZE; i++ )
+		{
+			for ( MemProfileSite_t *pSite = s_pSiteHash[i]; pSite; pSite = pSite->m_pNextInHash )
+			{
+				pSites[nSites++] = *pSite;
+			}
+		}
+		if ( s_OverflowSite.m_nTotalBytes )
+		{
+			pSites[nSites++] = s_OverflowSite;
+		}
+	}
+
+	LeaveCriticalSection( &s_MemProfileLock );
+	return pSites;
+}
+
+static int SiteLiveBytesSortFunc( const void *p1, const void *p2 )
+{
+	return ( (const MemProfileSite_t *)p2 )->m_nLiveBytes - ( (const MemProfileSite_t *)p1 )->m_nLiveBytes;
+}
+
+static void PrintTotals( const MemProfileSite_t *pSites, int nSites )
+{
+	int nLiveBytes = 0, nMarkBytes = 0;
+	for ( int i = 0; i < nSites; i++ )
+	{
+		nLiveBytes += pSites[i].m_nLiveBytes;
+		nMarkBytes += pSites[i].m_nMarkBytes;
+	}
+
+	Msg( "Heap profile: about %dk live in %d sites, sampling every %d bytes%s\n",
+		nLiveBytes / 1024, nSites, s_nSampleBytes, g_bMemProfileActive ? "" : " (stopped)" );
+	if ( s_bMarked )
+	{
+		Msg( "Growth since mark: %dk\n", ( nLiveBytes - nMarkBytes ) / 1024 );
+	}
+}
+
+void MemProfile_DumpFlat( int nMaxSites )
+{
+	int nSites;
+	MemProfileSite_t *pSites = CopySites( nSites );
+	if ( !pSites )
+		return;
+
+	qsort( pSites, nSites, sizeof( MemProfileSite_t ), SiteLiveBytesSortFunc );
+
+	PrintTotals( pSites, nSites );
+	Msg( "Live(k)\tGrowth(k)\tTotal(k)\tSamples\tSite\n" );
+
+	char pAddress[MAX_PATH + 16];
+	for ( int i = 0; i < nSites && i < nMaxSites; i++ )
+	{
+		const MemProfileSite_t &site = pSites[i];
+		Msg( "%.1f\t%.1f\t%.1f\t%d\t%s\n",
+			site.m_nLiveBytes / 1024.0f,
+			( site.m_nLiveBytes - site.m_nMarkBytes ) / 1024.0f,
+			(float)( site.m_nTotalBytes / 1024.0 ),
+			site.m_nLiveSamples,
+			site.m_DbgName[0] ? site.m_DbgName : ( site.m_nFrames ? "" : "<no stack>" ) );
+
+		for ( int j = 0; j < site.m_nFrames; j++ )
+		{
+			FormatAddress( site.m_pFrames[j], pAddress, sizeof( pAddress ) );
+			Msg( "\t\t\t\t  %s\n", pAddress );
+		}
+	}
+
+	free( pSites );
+}
+
+
+//-------------------------------------
+
+struct MemProfileNode_t
+{
+	const void	*m_pAddress;	// NULL for a leaf naming the site's debug info
+	const char	*m_pName;
+	int			m_nLiveBytes;
+	int			m_nGrowthBytes;
+	int			m_nFirstChild;
+	int			m_nNextSibling;
+};
+
+static MemProfileNode_t *s_pTreeNodes;
+static int s_nTreeNodes;
+static int s_nMaxTreeNodes;
+
+static int FindOrAddChild( int nParent, const void *pAddress, const char *pName )
+{
+	int i;
+	for ( i = s_pTreeNodes[nParent].m_nFirstChild; i >= 0; i = s_pTreeNodes[i].m_nNextSibling )
+	{
+		if ( s_pTreeNodes[i].m_pAddress == pAddress && ( pAddress || !strcmp( s_pTreeNodes[i].m_pName, pName ) ) )
+			return i;
+	}
+
+	if ( s_nTreeNodes == s_nMaxTreeNodes )
+	{
+		int nMaxNodes = s_nMaxTreeNodes * 2;
+		MemProfileNode_t *pNodes = (MemProfileNode_t *)realloc( s_pTreeNodes, nMaxNodes * sizeof( MemProfileNode_t ) );
+		if ( !pNodes )
+			return -1;
+		s_pTreeNodes = pNodes;
+		s_nMaxTreeNodes = nMaxNodes;
+	}
+
+	i = s_nTreeNodes++;
+	MemProfileNode_t &node = s_pTreeNodes[i];
+	node.m_pAddress = pAddress;
+	node.m_pName = pName;
+	node.m_nLiveBytes = 0;
+	node.m_nGrowthBytes = 0;
+	node.m_nFirstChild = -1;
+	node.m_nNextSibling = s_pTreeNodes[nParent].m_nFirstChild;
+	s_pTreeNodes[nParent].m_nFirstChild = i;
+	return i;
+}
+
+static int AddToTree( int nParent, const void *pAddress, const char *pName, const MemProfileSite_t &site )
+{
+	int nNode = FindOrAddChild( nParent, pAddress, pName );
+	if ( nNode >= 0 )
+	{
+		s_pTreeNodes[nNode].m_nLiveBytes += site.m_nLiveBytes;
+		s_pTreeNodes[nNode].m_nGrowthBytes += site.m_nLiveBytes - site.m_nMarkBytes;
+	}
+	return nNode;
+}
+
+static int NodeLiveBytesSortFunc( const void *p1, const void *p2 )
+{
+	return s_pTreeNodes[*(const int *)p2].m_nLiveBytes - s_pTreeNodes[*(const int *)p1].m_nLiveBytes;
+}
+
+static void PrintTreeNode( int nNode, int nDepth, int nMinBytes )
+{
+	const MemProfileNode_t &node = s_pTreeNodes[nNode];
+
+	char pAddress[MAX_PATH + 16];
+	if ( node.m_pAddress )
+	{
+		FormatAddress( node.m_pAddress, pAddress, sizeof( pAddress ) );
+	}
+	Msg( "%.1f\t%.1f\t%*s%s\n", node.m_nLiveBytes / 1024.0f, node.m_nGrowthBytes / 1024.0f,
+		nDepth * 2, "", node.m_pAddress ? pAddress : node.m_pName );
+
+	int nChildren = 0;
+	int i;
+	for ( i = node.m_nFirstChild; i >= 0; i = s_pTreeNodes[i].m_nNextSibling )
+	{
+		++nChildren;
+	}
+
+	int *pChildren = (int *)_alloca( nChildren * sizeof( int ) );
+	nChildren = 0;
+	for ( i = node.m_nFirstChild; i >= 0; i = s_pTreeNodes[i].m_nNextSibling )
+	{
+		pChildren[nChildren++] = i;
+	}
+	qsort( pChildren, nChildren, sizeof( int ), NodeLiveBytesSortFunc );
+
+	for ( i = 0; i < nChildren; i++ )
+	{
+		if ( s_pTreeNodes[pChildren[i]].m_nLiveBytes >= nMinBytes && s_pTreeNodes[pChildren[i]].m_nLiveBytes > 0 )
+		{
+			PrintTreeNode( pChildren[i], nDepth + 1, nMinBytes );
+		}
+	}
+}
+
+void MemProfile_DumpTree( float flMinPercent )
+{
+	int nSites;
+	MemProfileSite_t *pSites = CopySites( nSites );
+	if ( !pSites )
+		return;
+
+	s_nMaxTreeNodes = 1024;
+	s_pTreeNodes = (MemProfileNode_t *)malloc( s_nMaxTreeNodes * sizeof( MemProfileNode_t ) );
+	if ( !s_pTreeNodes )
+	{
+		free( pSites );
+		return;
+	}
+
+	MemProfileNode_t &root = s_pTreeNodes[0];
+	root.m_pAddress = NULL;
+	root.m_pName = "<all>";
+	root.m_nLiveBytes = root.m_nGrowthBytes = 0;
+	root.m_nFirstChild = root.m_nNextSibling = -1;
+	s_nTreeNodes = 1;
+
+	// Outermost caller first, then the debug info scope as the leaf
+	for ( int i = 0; i < nSites; i++ )
+	{
+		const MemProfileSite_t &site = pSites[i];
+		s_pTreeNodes[0].m_nLiveBytes += site.m_nLiveBytes;
+		s_pTreeNodes[0].m_nGrowthBytes += site.m_nLiveBytes - site.m_nMarkBytes;
+
+		int nNode = 0;
+		for ( int j = site.m_nFrames - 1; j >= 0 && nNode >= 0; j-- )
+		{
+			nNode = AddToTree( nNode, site.m_pFrames[j], NULL, site );
+		}
+
+		if ( nNode >= 0 && ( site.m_DbgName[0] || !site.m_nFrames ) )
+		{
+			AddToTree( nNode, NULL, site.m_DbgName[0] ? site.m_DbgName : "<no stack>", site );
+		}
+	}
+
+	PrintTotals( pSites, nSites );
+	Msg( "Live(k)\tGrowth(k)\tCaller\n" );
+	PrintTreeNode( 0, 0, (int)( s_pTreeNodes[0].m_nLiveBytes * flMinPercent / 100.0f ) );
+
+	free( s_pTreeNodes );
+	s_pTreeNodes = NULL;
+	free( pSites );
+}
+
+#else // _WIN32 && !_DEBUG
+
+static void MemProfile_Unsupported()
+{
+	Msg( "The heap profiler is only in release builds on Win32\n" );
+}
+
+void MemProfile_Start( int nSampleBytes )
+{
+	MemProfile_Unsupported();
+}
+
+void MemProfile_Stop()
+{
+}
+
+bool MemProfile_IsActive()
+{
+	return false;
+}
+
+void MemProfile_Reset()
+{
+}
+
+void MemProfile_Mark()
+{
+}
+
+void MemProfile_DumpFlat( int nMaxSites )
+{
+	MemProfile_Unsupported();
+}
+
+void MemProfile_DumpTree( float flMinPercent )
+{
+	MemProfile_Unsupported();
+}
+
+#endif // _WIN32 && !_DEBUG
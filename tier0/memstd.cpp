@@ -7,11 +7,416 @@
 
 #ifndef _DEBUG
 
+#ifdef _WIN32
+#define WIN_32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
 #include <malloc.h>
+#include <string.h>
 #include "tier0/dbg.h"
 #include "tier0/memalloc.h"
 
 
+#ifdef _WIN32
+
+//-----------------------------------------------------------------------------
+// Small block heap, turned on with -smallblockheap.
+//
+// Allocations up to SBH_MAX_SIZE are rounded up to one of a fixed set of size
+// classes and carved out of 64k pages that each hold one class.  All the pages
+// come out of a single reserved range of address space, so whether a pointer
+// belongs to us is a subtraction and a compare, and its size class is a table
+// lookup on its page.  Everything else goes to the CRT as before, as does
+// anything asked for once the range is used up.
+//
+// Each thread keeps a free list per size class that it allocates from and
+// frees to without any locking.  When a thread's list gets long it hands a
+// batch of SBH_BATCH_SIZE blocks to a central lock-free stack for the class,
+// and when it runs dry it takes a batch back (or carves up a fresh page).
+//
+// Blocks in the cache of a thread that exits aren't reused; threads in the
+// engine live as long as the process.
+//-----------------------------------------------------------------------------
+
+#define SBH_PAGE_SHIFT		16
+#define SBH_PAGE_SIZE		( 1 << SBH_PAGE_SHIFT )
+#define SBH_MAX_SIZE		1024
+#define SBH_NUM_CLASSES		28
+#define SBH_BATCH_SIZE		32
+#define SBH_MAX_RESERVE		( 256 * 1024 * 1024 )
+#define SBH_MIN_RESERVE		( 32 * 1024 * 1024 )
+#define SBH_MAX_PAGES		( SBH_MAX_RESERVE / SBH_PAGE_SIZE )
+
+static const unsigned short s_SBHClassSizes[SBH_NUM_CLASSES] =
+{
+	8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96, 104, 112, 120, 128,
+	160, 192, 224, 256,
+	320, 384, 448, 512,
+	640, 768, 896, 1024,
+};
+
+struct SBHFreeBlock_t
+{
+	SBHFreeBlock_t	*m_pNext;		// Next block in the list or batch
+	SBHFreeBlock_t	*m_pNextBatch;	// Next batch on a central stack, only in a batch's first block
+};
+
+// The sequence number changes on every push and pop, so a batch that was
+// popped and pushed back while another thread was looking at the stack can't
+// be mistaken for the head that thread saw.
+union SBHCentralStack_t
+{
+	struct
+	{
+		SBHFreeBlock_t	*m_pHead;
+		unsigned long	m_nSequence;
+	};
+	__int64 m_Value;
+};
+
+struct SBHSizeClass_t
+{
+	volatile SBHCentralStack_t m_Central;
+	volatile long	m_nPages;
+	volatile long	m_nCentralBlocks;
+	volatile long	m_nAllocs;			// Threads add theirs in whenever they move a batch
+};
+
+struct SBHThreadCache_t
+{
+	SBHFreeBlock_t	*m_pHead[SBH_NUM_CLASSES];
+	int				m_nCount[SBH_NUM_CLASSES];
+	int				m_nAllocs[SBH_NUM_CLASSES];
+};
+
+static __declspec(thread) SBHThreadCache_t s_SBHThreadCache;
+
+
+//-------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable:4035)	// The result is left in edx:eax
+
+static __int64 SBH_CompareExchange64( volatile __int64 *pDest, __int64 value, __int64 comperand )
+{
+	__asm
+	{
+		lea esi, comperand
+		lea edi, value
+
+		mov eax, [esi]
+		mov edx, 4[esi]
+		mov ebx, [edi]
+		mov ecx, 4[edi]
+		mov esi, pDest
+		lock CMPXCHG8B [esi]
+	}
+}
+
+#pragma warning(pop)
+
+
+//-----------------------------------------------------------------------------
+// Has no constructor on purpose: it's used by allocations made before static
+// constructors run, and works from the zeroed state.
+//-----------------------------------------------------------------------------
+class CSmallBlockHeap
+{
+public:
+	// The first allocation is always made on the main thread while starting up
+	bool IsEnabled()
+	{
+		if ( m_nState == SBH_STATE_UNKNOWN )
+		{
+			Startup();
+		}
+		return ( m_nState == SBH_STATE_ON );
+	}
+
+	bool Owns( const void *pMem ) const
+	{
+		return ( (unsigned long)( (const char *)pMem - m_pBase ) < m_nReserved );
+	}
+
+	void *Alloc( size_t nSize );
+	void Free( void *pMem );
+	size_t GetSize( const void *pMem ) const
+	{
+		return s_SBHClassSizes[GetClass( pMem )];
+	}
+
+	void DumpStats();
+
+private:
+	enum
+	{
+		SBH_STATE_UNKNOWN = 0,
+		SBH_STATE_OFF,
+		SBH_STATE_ON,
+	};
+
+	int GetClass( const void *pMem ) const
+	{
+		return m_PageClass[( (const char *)pMem - m_pBase ) >> SBH_PAGE_SHIFT];
+	}
+
+	void Startup();
+	bool Refill( int nClass );
+	bool NewPage( int nClass );
+	void Spill( int nClass );
+	void FlushAllocCount( int nClass );
+
+	void PushBatch( int nClass, SBHFreeBlock_t *pBatch );
+	SBHFreeBlock_t *PopBatch( int nClass );
+
+	SBHSizeClass_t	m_Classes[SBH_NUM_CLASSES];
+	int				m_nState;
+	char			*m_pBase;
+	unsigned long	m_nReserved;
+	volatile long	m_nNextPage;
+	unsigned char	m_SizeToClass[( SBH_MAX_SIZE >> 3 ) + 1];	// Indexed by size in 8 byte units, rounded up
+	unsigned char	m_PageClass[SBH_MAX_PAGES];
+};
+
+static CSmallBlockHeap s_SmallBlockHeap;
+
+
+//-------------------------------------
+
+void CSmallBlockHeap::Startup()
+{
+	m_nState = SBH_STATE_OFF;
+
+	const char *pCmdLine = GetCommandLine();
+	const char *pParm = ( pCmdLine ) ? strstr( pCmdLine, "-smallblockheap" ) : NULL;
+	if ( !pParm || ( pParm[15] != 0 && pParm[15] != ' ' ) )
+		return;
+
+	int nClass = 0;
+	for ( int i = 0; i <= ( SBH_MAX_SIZE >> 3 ); i++ )
+	{
+		while ( s_SBHClassSizes[nClass] < i * 8 )
+		{
+			nClass++;
+		}
+		m_SizeToClass[i] = nClass;
+	}
+
+	// Pages are only committed as they're needed, so take as much address space as we can get
+	for ( m_nReserved = SBH_MAX_RESERVE; m_nReserved >= SBH_MIN_RESERVE; m_nReserved >>= 1 )
+	{
+		m_pBase = (char *)VirtualAlloc( NULL, m_nReserved, MEM_RESERVE, PAGE_NOACCESS );
+		if ( m_pBase )
+		{
+			m_nState = SBH_STATE_ON;
+			return;
+		}
+	}
+
+	m_nReserved = 0;
+}
+
+//-------------------------------------
+
+inline void *CSmallBlockHeap::Alloc( size_t nSize )
+{
+	int nClass = m_SizeToClass[( nSize + 7 ) >> 3];
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+
+	SBHFreeBlock_t *pBlock = cache.m_pHead[nClass];
+	if ( !pBlock )
+	{
+		if ( !Refill( nClass ) )
+			return NULL;
+		pBlock = cache.m_pHead[nClass];
+	}
+
+	cache.m_pHead[nClass] = pBlock->m_pNext;
+	cache.m_nCount[nClass]--;
+	cache.m_nAllocs[nClass]++;
+	return pBlock;
+}
+
+//-------------------------------------
+
+inline void CSmallBlockHeap::Free( void *pMem )
+{
+	int nClass = GetClass( pMem );
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+
+	SBHFreeBlock_t *pBlock = (SBHFreeBlock_t *)pMem;
+	pBlock->m_pNext = cache.m_pHead[nClass];
+	cache.m_pHead[nClass] = pBlock;
+
+	if ( ++cache.m_nCount[nClass] >= 2 * SBH_BATCH_SIZE )
+	{
+		Spill( nClass );
+	}
+}
+
+//-------------------------------------
+// Gives this thread's empty list for the class a batch from the central stack or a new page
+
+bool CSmallBlockHeap::Refill( int nClass )
+{
+	FlushAllocCount( nClass );
+
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+	SBHFreeBlock_t *pBatch = PopBatch( nClass );
+	if ( pBatch )
+	{
+		InterlockedExchangeAdd( &m_Classes[nClass].m_nCentralBlocks, -SBH_BATCH_SIZE );
+		cache.m_pHead[nClass] = pBatch;
+		cache.m_nCount[nClass] = SBH_BATCH_SIZE;
+		return true;
+	}
+
+	return NewPage( nClass );
+}
+
+//-------------------------------------
+
+bool CSmallBlockHeap::NewPage( int nClass )
+{
+	// Pages are never given back, so once the range is used up it stays used up
+	if ( m_nNextPage >= (long)( m_nReserved >> SBH_PAGE_SHIFT ) )
+		return false;
+
+	long nPage = InterlockedIncrement( &m_nNextPage ) - 1;
+	if ( nPage >= (long)( m_nReserved >> SBH_PAGE_SHIFT ) )
+		return false;
+
+	char *pPage = m_pBase + ( nPage << SBH_PAGE_SHIFT );
+	if ( !VirtualAlloc( pPage, SBH_PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE ) )
+		return false;
+
+	m_PageClass[nPage] = nClass;
+	InterlockedIncrement( &m_Classes[nClass].m_nPages );
+
+	// The whole page goes to this thread, it'll hand out batches as it frees them
+	int nSize = s_SBHClassSizes[nClass];
+	int nBlocks = SBH_PAGE_SIZE / nSize;
+	for ( int i = 0; i < nBlocks - 1; i++ )
+	{
+		( (SBHFreeBlock_t *)( pPage + i * nSize ) )->m_pNext = (SBHFreeBlock_t *)( pPage + ( i + 1 ) * nSize );
+	}
+	( (SBHFreeBlock_t *)( pPage + ( nBlocks - 1 ) * nSize ) )->m_pNext = NULL;
+
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+	cache.m_pHead[nClass] = (SBHFreeBlock_t *)pPage;
+	cache.m_nCount[nClass] = nBlocks;
+	return true;
+}
+
+//-------------------------------------
+// Moves a batch from this thread's list for the class to the central stack
+
+void CSmallBlockHeap::Spill( int nClass )
+{
+	FlushAllocCount( nClass );
+
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+	SBHFreeBlock_t *pBatch = cache.m_pHead[nClass];
+	SBHFreeBlock_t *pLast = pBatch;
+	for ( int i = 1; i < SBH_BATCH_SIZE; i++ )
+	{
+		pLast = pLast->m_pNext;
+	}
+
+	cache.m_pHead[nClass] = pLast->m_pNext;
+	cache.m_nCount[nClass] -= SBH_BATCH_SIZE;
+	pLast->m_pNext = NULL;
+
+	PushBatch( nClass, pBatch );
+	InterlockedExchangeAdd( &m_Classes[nClass].m_nCentralBlocks, SBH_BATCH_SIZE );
+}
+
+//-------------------------------------
+
+void CSmallBlockHeap::FlushAllocCount( int nClass )
+{
+	SBHThreadCache_t &cache = s_SBHThreadCache;
+	if ( cache.m_nAllocs[nClass] )
+	{
+		InterlockedExchangeAdd( &m_Classes[nClass].m_nAllocs, cache.m_nAllocs[nClass] );
+		cache.m_nAllocs[nClass] = 0;
+	}
+}
+
+//-------------------------------------
+// The head is read as two halves, so it may be torn, but then the compare
+// exchange fails and we go around again.  Any pointer we read was a block in
+// a committed page at some point, and pages stay committed, so following it
+// is always safe.
+
+void CSmallBlockHeap::PushBatch( int nClass, SBHFreeBlock_t *pBatch )
+{
+	volatile SBHCentralStack_t &central = m_Classes[nClass].m_Central;
+	SBHCentralStack_t oldHead, newHead;
+	do
+	{
+		oldHead.m_Value = central.m_Value;
+		pBatch->m_pNextBatch = oldHead.m_pHead;
+		newHead.m_pHead = pBatch;
+		newHead.m_nSequence = oldHead.m_nSequence + 1;
+	}
+	while ( SBH_CompareExchange64( &central.m_Value, newHead.m_Value, oldHead.m_Value ) != oldHead.m_Value );
+}
+
+SBHFreeBlock_t *CSmallBlockHeap::PopBatch( int nClass )
+{
+	volatile SBHCentralStack_t &central = m_Classes[nClass].m_Central;
+	SBHCentralStack_t oldHead, newHead;
+	do
+	{
+		oldHead.m_Value = central.m_Value;
+		if ( !oldHead.m_pHead )
+			return NULL;
+		newHead.m_pHead = oldHead.m_pHead->m_pNextBatch;
+		newHead.m_nSequence = oldHead.m_nSequence + 1;
+	}
+	while ( SBH_CompareExchange64( &central.m_Value, newHead.m_Value, oldHead.m_Value ) != oldHead.m_Value );
+
+	return oldHead.m_pHead;
+}
+
+//-------------------------------------
+
+void CSmallBlockHeap::DumpStats()
+{
+	if ( m_nState != SBH_STATE_ON )
+	{
+		Msg( "Small block heap is off (run with -smallblockheap)\n" );
+		return;
+	}
+
+	long nPages = min( m_nNextPage, (long)( m_nReserved >> SBH_PAGE_SHIFT ) );
+	Msg( "Small block heap: %d of %d pages committed (%dk)\n", nPages, m_nReserved >> SBH_PAGE_SHIFT, ( nPages * SBH_PAGE_SIZE ) / 1024 );
+	Msg( "Size\tPages\tCommitted(k)\tIn use(k)\tCentral free(k)\tAllocations\n" );
+
+	for ( int i = 0; i < SBH_NUM_CLASSES; i++ )
+	{
+		const SBHSizeClass_t &sizeClass = m_Classes[i];
+		if ( !sizeClass.m_nPages )
+			continue;
+
+		// In use counts blocks sitting in threads' lists, there's no reaching those from here
+		int nSize = s_SBHClassSizes[i];
+		int nBlocks = sizeClass.m_nPages * ( SBH_PAGE_SIZE / nSize );
+		Msg( "%d\t%d\t%d\t%.1f\t%.1f\t%d\n",
+			nSize,
+			sizeClass.m_nPages,
+			( sizeClass.m_nPages * SBH_PAGE_SIZE ) / 1024,
+			( ( nBlocks - sizeClass.m_nCentralBlocks ) * nSize ) / 1024.0f,
+			( sizeClass.m_nCentralBlocks * nSize ) / 1024.0f,
+			sizeClass.m_nAllocs );
+	}
+}
+
+#endif // _WIN32
+
+
 //-----------------------------------------------------------------------------
 // NOTE! This should never be called directly from leaf code
 // Just use new,delete,malloc,free etc. They will call into this eventually
@@ -50,7 +455,7 @@ public:
 			int nLine, const char * szModule, const char * pMsg );
 	virtual int heapchk();
 
-	virtual void DumpStats() {}
+	virtual void DumpStats();
 
 private:
 };
@@ -68,27 +473,134 @@ IMemAlloc *g_pActualAlloc = &s_StdMemAlloc;
 #endif
 
 
+#ifdef _WIN32
+
+//-----------------------------------------------------------------------------
+// Heap profiler hooks, see memprofile.cpp
+//-----------------------------------------------------------------------------
+extern volatile bool g_bMemProfileActive;
+extern volatile long g_nMemProfileSamples;
+
+void MemProfile_OnAlloc( void *pMem, size_t nSize );
+void MemProfile_OnFree( void *pMem );
+void MemProfile_PushAllocDbgInfo( const char *pFileName, int nLine );
+void MemProfile_PopAllocDbgInfo();
+
+
+//-----------------------------------------------------------------------------
+// Picks between the small block heap and the CRT
+//-----------------------------------------------------------------------------
+static inline void *InternalAlloc( size_t nSize )
+{
+	if ( nSize <= SBH_MAX_SIZE && s_SmallBlockHeap.IsEnabled() )
+	{
+		void *pMem = s_SmallBlockHeap.Alloc( nSize );
+		if ( pMem )
+			return pMem;
+	}
+	return malloc( nSize );
+}
+
+static inline void *InternalRealloc( void *pMem, size_t nSize )
+{
+	if ( !pMem )
+		return InternalAlloc( nSize );
+
+	if ( s_SmallBlockHeap.Owns( pMem ) )
+	{
+		if ( nSize == 0 )
+		{
+			s_SmallBlockHeap.Free( pMem );
+			return NULL;
+		}
+
+		size_t nOldSize = s_SmallBlockHeap.GetSize( pMem );
+		if ( nSize <= nOldSize )
+			return pMem;
+
+		// Growing, which may move it to a bigger class or out to the CRT
+		void *pNewMem = InternalAlloc( nSize );
+		if ( pNewMem )
+		{
+			memcpy( pNewMem, pMem, nOldSize );
+			s_SmallBlockHeap.Free( pMem );
+		}
+		return pNewMem;
+	}
+
+	return realloc( pMem, nSize );
+}
+
+static inline void InternalFree( void *pMem )
+{
+	if ( s_SmallBlockHeap.Owns( pMem ) )
+	{
+		s_SmallBlockHeap.Free( pMem );
+		return;
+	}
+	free( pMem );
+}
+
+#endif // _WIN32
+
+
 //-----------------------------------------------------------------------------
 // Release versions
 //-----------------------------------------------------------------------------
 void *CStdMemAlloc::Alloc( size_t nSize )
 {
+#ifdef _WIN32
+	void *pMem = InternalAlloc( nSize );
+	if ( g_bMemProfileActive )
+	{
+		MemProfile_OnAlloc( pMem, nSize );
+	}
+	return pMem;
+#elif _LINUX
 	return malloc( nSize );
+#endif
 }
 
 void *CStdMemAlloc::Realloc( void *pMem, size_t nSize )
 {
+#ifdef _WIN32
+	// A sampled block stops being tracked before anyone else can be handed its address
+	if ( g_nMemProfileSamples && pMem )
+	{
+		MemProfile_OnFree( pMem );
+	}
+
+	void *pNewMem = InternalRealloc( pMem, nSize );
+	if ( g_bMemProfileActive && nSize )
+	{
+		MemProfile_OnAlloc( pNewMem, nSize );
+	}
+	return pNewMem;
+#elif _LINUX
 	return realloc( pMem, nSize );
+#endif
 }
 
 void CStdMemAlloc::Free( void *pMem )
 {
+#ifdef _WIN32
+	if ( g_nMemProfileSamples && pMem )
+	{
+		MemProfile_OnFree( pMem );
+	}
+	InternalFree( pMem );
+#elif _LINUX
 	free( pMem );
+#endif
 }
 
 void *CStdMemAlloc::Expand( void *pMem, size_t nSize )
 {
 #ifdef _WIN32
+	if ( s_SmallBlockHeap.Owns( pMem ) )
+	{
+		return ( nSize <= s_SmallBlockHeap.GetSize( pMem ) ) ? pMem : NULL;
+	}
 	return _expand( pMem, nSize );
 #elif _LINUX
 	return realloc( pMem, nSize );
@@ -101,26 +613,22 @@ void *CStdMemAlloc::Expand( void *pMem, size_t nSize )
 //-----------------------------------------------------------------------------
 void *CStdMemAlloc::Alloc( size_t nSize, const char *pFileName, int nLine )
 {
-	return malloc( nSize );
+	return Alloc( nSize );
 }
 
 void *CStdMemAlloc::Realloc( void *pMem, size_t nSize, const char *pFileName, int nLine )
 {
-	return realloc( pMem, nSize );
+	return Realloc( pMem, nSize );
 }
 
 void  CStdMemAlloc::Free( void *pMem, const char *pFileName, int nLine )
 {
-	free( pMem );
+	Free( pMem );
 }
 
 void *CStdMemAlloc::Expand( void *pMem, size_t nSize, const char *pFileName, int nLine )
 {
-#ifdef _WIN32
-	return _expand( pMem, nSize );
-#elif _LINUX
-	return realloc( pMem, nSize );
-#endif
+	return Expand( pMem, nSize );
 }
 
 
@@ -130,6 +638,8 @@ void *CStdMemAlloc::Expand( void *pMem, size_t nSize, const char *pFileName, int
 size_t CStdMemAlloc::GetSize( void *pMem )
 {
 #ifdef _WIN32
+	if ( s_SmallBlockHeap.Owns( pMem ) )
+		return s_SmallBlockHeap.GetSize( pMem );
 	return _msize( pMem );
 #elif _LINUX
 	Assert( "GetSize() not implemented");
@@ -142,10 +652,16 @@ size_t CStdMemAlloc::GetSize( void *pMem )
 //-----------------------------------------------------------------------------
 void CStdMemAlloc::PushAllocDbgInfo( const char *pFileName, int nLine )
 {
+#ifdef _WIN32
+	MemProfile_PushAllocDbgInfo( pFileName, nLine );
+#endif
 }
 
 void CStdMemAlloc::PopAllocDbgInfo()
 {
+#ifdef _WIN32
+	MemProfile_PopAllocDbgInfo();
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -197,6 +713,16 @@ int CStdMemAlloc::CrtDbgReport( int nRptType, const char * szFile,
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// Stat output
+//-----------------------------------------------------------------------------
+void CStdMemAlloc::DumpStats()
+{
+#ifdef _WIN32
+	s_SmallBlockHeap.DumpStats();
+#endif
+}
+
 int CStdMemAlloc::heapchk()
 {
 #ifdef _WIN32
@@ -152,6 +152,10 @@ SOURCE=.\memdbg.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\memprofile.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\memstd.cpp
 # End Source File
 # Begin Source File
@@ -208,6 +212,10 @@ SOURCE=..\Public\tier0\memdbgon.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\Public\tier0\memprofile.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\Public\tier0\platform.h
 # End Source File
 # Begin Source File
@@ -222,6 +230,10 @@ SOURCE=..\Public\tier0\vcrmode.h
 
 SOURCE=..\Public\tier0\vprof.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\Public\tier0\vproftrace.h
+# End Source File
 # End Group
 # Begin Group "DESKey"
 
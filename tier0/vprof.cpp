@@ -16,6 +16,7 @@
 #pragma warning(disable:4530)
 #include <map>
 #include <vector>
+#include <stdio.h>
 #include <algorithm>
 #pragma warning(pop)
 
@@ -28,9 +29,34 @@ using namespace std;
 
 #ifdef VPROF_ENABLED
 
+//-----------------------------------------------------------------------------
+// Guards the rare operations that other threads share with the primary
+// thread: adding budget groups, allocating nodes and registering threads.
+// Must be constructed before g_VProfCurrentProfile.
+
+class CVProfLock
+{
+public:
+#ifdef _WIN32
+	CVProfLock()	{ InitializeCriticalSection( &m_CriticalSection ); }
+	~CVProfLock()	{ DeleteCriticalSection( &m_CriticalSection ); }
+	void Lock()		{ EnterCriticalSection( &m_CriticalSection ); }
+	void Unlock()	{ LeaveCriticalSection( &m_CriticalSection ); }
+
+private:
+	CRITICAL_SECTION m_CriticalSection;
+#else
+	void Lock()		{}
+	void Unlock()	{}
+#endif
+};
+
+static CVProfLock g_VProfLock;
+
 //-----------------------------------------------------------------------------
 
 CVProfile g_VProfCurrentProfile;
+CVProfTrace g_VProfTrace;
 
 #ifdef _WIN32
 
@@ -176,7 +202,10 @@ static CMemoryRegion g_NodeMemRegion( 0x400000, 0x10000 );
 
 void *CVProfNode::operator new( size_t bytes )
 {
-	return g_NodeMemRegion.Alloc( bytes );
+	g_VProfLock.Lock();
+	void *pResult = g_NodeMemRegion.Alloc( bytes );
+	g_VProfLock.Unlock();
+	return pResult;
 }
 
 //-------------------------------------
@@ -384,6 +413,44 @@ static bool PeakOverAverageCompare( const TimeSums_t &lhs, const TimeSums_t &rhs
 	return ( lhsPoA > rhsPoA );
 }
 
+//-------------------------------------
+// Adds each node's time less children to its budget group.  Groups past
+// nBudgetGroups are counted as unaccounted.
+
+static void SumBudgetGroupTimes( CVProfNode *pNode, double *pTimes, int nBudgetGroups, bool bPrevFrame )
+{
+	for ( ; pNode; pNode = pNode->GetSibling() )
+	{
+		int budgetGroupID = pNode->GetBudgetGroupID();
+		if ( budgetGroupID >= nBudgetGroups )
+			budgetGroupID = VPROF_BUDGET_GROUP_ID_UNACCOUNTED;
+
+		pTimes[budgetGroupID] += ( bPrevFrame ) ? pNode->GetPrevTimeLessChildren() : pNode->GetTotalTimeLessChildren();
+
+		if ( pNode->GetChild() )
+		{
+			SumBudgetGroupTimes( pNode->GetChild(), pTimes, nBudgetGroups, bPrevFrame );
+		}
+	}
+}
+
+//-------------------------------------
+
+static void DumpBudgetGroupTimes( const double *pTimes, int nBudgetGroups, int nFrames )
+{
+	Msg( "  Budget group                             Time    Avg/frame\n" );
+	Msg( "  ------------------------------ ------------ ------------\n" );
+	for ( int i = 0; i < nBudgetGroups; i++ )
+	{
+		if ( pTimes[i] <= 0.0 )
+			continue;
+
+		Msg( "  %30s%13.3f%13.3f\n", g_VProfCurrentProfile.GetBudgetGroupName( i ), pTimes[i], ( nFrames ) ? pTimes[i] / (double)nFrames : 0.0 );
+	}
+}
+
+//-------------------------------------
+
 map<CVProfNode *, double> 	g_TimesLessChildren;
 map<const char *, unsigned> g_TimeSumsMap;
 vector<TimeSums_t> 			g_TimeSums;
@@ -563,6 +630,11 @@ void CVProfile::OutputReport( VProfReportType_t type, const char *pszStartNode,
 			double timeAccountedFor = 100.0 - ( m_Root.GetTotalTimeLessChildren() / m_Root.GetTotalTime() );
 			Msg( "%.0f pct of time accounted for\n", min( 100.0, timeAccountedFor ) );
 			Msg( "\n" );
+
+			if ( m_pThreads )
+			{
+				OutputThreadReport();
+			}
 		}
 
 		if ( pszStartNode == NULL )
@@ -623,6 +695,220 @@ void CVProfile::OutputReport( VProfReportType_t type, const char *pszStartNode,
 
 }
 
+//-------------------------------------
+
+void CVProfile::OutputThreadReport()
+{
+	Msg( "-- Budget group times by thread --\n" );
+
+	int nBudgetGroups = GetNumBudgetGroups();
+	vector<double> times( nBudgetGroups, 0.0 );
+	SumBudgetGroupTimes( m_Root.GetChild(), &times[0], nBudgetGroups, false );
+	Msg( "Primary thread, %d frames\n", NumFramesSampled() );
+	DumpBudgetGroupTimes( &times[0], nBudgetGroups, NumFramesSampled() );
+
+	if ( nBudgetGroups > VPROF_MAX_THREAD_BUDGET_GROUPS )
+		nBudgetGroups = VPROF_MAX_THREAD_BUDGET_GROUPS;
+
+	for ( CVProfThread *pThread = m_pThreads; pThread; pThread = pThread->GetNext() )
+	{
+		for ( int i = 0; i < nBudgetGroups; i++ )
+		{
+			times[i] = pThread->GetBudgetGroupTime( i );
+		}
+		Msg( "Thread 0x%x, %d frames\n", pThread->GetThreadID(), pThread->NumFramesSampled() );
+		DumpBudgetGroupTimes( &times[0], nBudgetGroups, pThread->NumFramesSampled() );
+	}
+	Msg( "\n" );
+}
+
+//=============================================================================
+
+#ifdef _WIN32
+
+// The profile of the current thread, if it isn't the primary thread
+static __declspec(thread) CVProfThread *g_pVProfThread = NULL;
+
+//-------------------------------------
+
+void CVProfile::EnterThreadScope( const char *pszName, int detailLevel, const char *pBudgetGroupName )
+{
+	CVProfThread *pThread = g_pVProfThread;
+	if ( !pThread )
+	{
+		if ( m_enabled == 0 )
+			return;
+
+		// Threads are only ever added at the head, so the primary thread can
+		// walk the list without taking the lock.  They're kept until shutdown
+		// so their times stay in the report after the thread exits.
+		pThread = new CVProfThread( GetCurrentThreadId() );
+		g_VProfLock.Lock();
+		pThread->m_pNext = m_pThreads;
+		m_pThreads = pThread;
+		g_VProfLock.Unlock();
+
+		g_pVProfThread = pThread;
+	}
+
+	// if became disabled, need to unwind back to root before stopping
+	if ( m_enabled != 0 || !pThread->AtRoot() )
+	{
+		pThread->EnterScope( pszName, detailLevel, pBudgetGroupName );
+	}
+}
+
+//-------------------------------------
+
+void CVProfile::ExitThreadScope()
+{
+	CVProfThread *pThread = g_pVProfThread;
+	if ( pThread && !pThread->AtRoot() )
+	{
+		pThread->ExitScope();
+	}
+}
+
+#endif
+
+//-------------------------------------
+
+void CVProfile::MergeThreads()
+{
+	for ( CVProfThread *pThread = m_pThreads; pThread; pThread = pThread->GetNext() )
+	{
+		pThread->Merge();
+	}
+
+	if ( m_bNumBudgetGroupsChanged )
+	{
+		m_bNumBudgetGroupsChanged = false;
+		if( m_pNumBudgetGroupsChangedCallBack )
+		{
+			(*m_pNumBudgetGroupsChangedCallBack)();
+		}
+	}
+}
+
+//-------------------------------------
+
+void CVProfile::ResetThreads()
+{
+	// The threads reset their own trees when they see this change
+	++m_nResetSerial;
+
+	for ( CVProfThread *pThread = m_pThreads; pThread; pThread = pThread->GetNext() )
+	{
+		pThread->ResetTotals();
+	}
+}
+
+//=============================================================================
+
+CVProfThread::CVProfThread( unsigned long threadID )
+ :	m_Root( "Root", 0, NULL, VPROF_BUDGETGROUP_OTHER_UNACCOUNTED ),
+	m_pCurNode( &m_Root ),
+	m_nFrameSerial( g_VProfCurrentProfile.m_nFrameSerial ),
+	m_nResetSerial( g_VProfCurrentProfile.m_nResetSerial ),
+	m_nPublished( 0 ),
+	m_nMerged( 0 ),
+	m_ThreadID( threadID ),
+	m_pNext( NULL )
+{
+	memset( m_FrameTimes, 0, sizeof( m_FrameTimes ) );
+	ResetTotals();
+}
+
+//-------------------------------------
+
+void CVProfThread::EnterScope( const char *pszName, int detailLevel, const char *pBudgetGroupName )
+{
+	CatchUp();
+
+	if ( pszName != m_pCurNode->GetName() ) 
+	{
+		m_pCurNode = m_pCurNode->GetSubNode( pszName, detailLevel, pBudgetGroupName );
+	}
+	m_pCurNode->EnterScope();
+}
+
+//-------------------------------------
+
+void CVProfThread::ExitScope()
+{
+	// ExitScope will indicate whether we should back up to our parent (we may
+	// be profiling a recursive function)
+	if ( m_pCurNode->ExitScope() ) 
+	{
+		m_pCurNode = m_pCurNode->GetParent();
+	}
+}
+
+//-------------------------------------
+// Called by the thread itself to follow the primary thread's resets and frames
+
+void CVProfThread::CatchUp()
+{
+	if ( m_nResetSerial != g_VProfCurrentProfile.m_nResetSerial )
+	{
+		m_nResetSerial = g_VProfCurrentProfile.m_nResetSerial;
+		m_Root.Reset();
+	}
+
+	if ( m_nFrameSerial == g_VProfCurrentProfile.m_nFrameSerial )
+		return;
+
+	m_nFrameSerial = g_VProfCurrentProfile.m_nFrameSerial;
+	m_Root.MarkFrame();
+
+	// Fill the buffer the primary thread isn't reading, then publish it.  The
+	// primary thread merges before it bumps m_nFrameSerial, so it's done with
+	// the other buffer before we can come back around to it.
+	int nPublish = m_nPublished + 1;
+	double *pTimes = m_FrameTimes[nPublish & 1];
+	memset( pTimes, 0, sizeof( m_FrameTimes[0] ) );
+	SumBudgetGroupTimes( m_Root.GetChild(), pTimes, VPROF_MAX_THREAD_BUDGET_GROUPS, true );
+#ifdef _WIN32
+	InterlockedExchange( (long *)&m_nPublished, nPublish );
+#else
+	m_nPublished = nPublish;
+#endif
+}
+
+//-------------------------------------
+// Called by the primary thread
+
+void CVProfThread::Merge()
+{
+	int nPublished = m_nPublished;
+	if ( nPublished == m_nMerged )
+		return;
+
+	const double *pTimes = m_FrameTimes[nPublished & 1];
+	for ( int i = 0; i < VPROF_MAX_THREAD_BUDGET_GROUPS; i++ )
+	{
+		m_TotalTimes[i] += pTimes[i];
+	}
+	m_nMerged = nPublished;
+	m_nFramesMerged++;
+}
+
+//-------------------------------------
+
+void CVProfThread::ResetTotals()
+{
+	memset( m_TotalTimes, 0, sizeof( m_TotalTimes ) );
+	m_nFramesMerged = 0;
+}
+
+//-------------------------------------
+
+double CVProfThread::GetBudgetGroupTime( int budgetGroupID )
+{
+	Assert( budgetGroupID >= 0 );
+	return ( budgetGroupID < VPROF_MAX_THREAD_BUDGET_GROUPS ) ? m_TotalTimes[budgetGroupID] : 0.0;
+}
+
 //=============================================================================
 
 CVProfile::CVProfile() 
@@ -631,7 +917,11 @@ CVProfile::CVProfile()
  	m_nFrames( 0 ),
  	m_enabled( 0 ),
  	m_pausedEnabledDepth( 0 ),
-	m_fAtRoot( true )
+	m_fAtRoot( true ),
+	m_bNumBudgetGroupsChanged( false ),
+	m_pThreads( NULL ),
+	m_nFrameSerial( 0 ),
+	m_nResetSerial( 0 )
 {
 	// Go ahead and allocate 32 slots for budget group names
 	m_pBudgetGroupNames = ( char ** )malloc( sizeof( char * ) * 32 );
@@ -665,6 +955,13 @@ CVProfile::CVProfile()
 
 CVProfile::~CVProfile()
 {
+	while ( m_pThreads )
+	{
+		CVProfThread *pNext = m_pThreads->GetNext();
+		delete m_pThreads;
+		m_pThreads = pNext;
+	}
+
 #ifdef _WIN32
 	CVProfNode::FreeAll();
 #endif
@@ -724,18 +1021,31 @@ int CVProfile::FindBudgetGroupName( const char *pBudgetGroupName )
 	return -1;
 }
 
+// Called with g_VProfLock held.  Other threads may be reading the names
+// without it, so the old array is never freed out from under them and the
+// count only goes up once the new name is in place.
 int CVProfile::AddBudgetGroupName( const char *pBudgetGroupName )
 {
 	char *pNewString = ( char * )malloc( strlen( pBudgetGroupName ) + 1 );
 	strcpy( pNewString, pBudgetGroupName );
 	if( m_nBudgetGroupNames + 1 > m_nBudgetGroupNamesAllocated )
 	{
+		char **pNewNames = ( char ** )malloc( sizeof( char * ) * m_nBudgetGroupNamesAllocated * 2 );
+		memcpy( pNewNames, m_pBudgetGroupNames, sizeof( char * ) * m_nBudgetGroupNames );
+		m_pBudgetGroupNames = pNewNames;
 		m_nBudgetGroupNamesAllocated *= 2;
-		m_pBudgetGroupNames = ( char ** )realloc( m_pBudgetGroupNames, sizeof( char * ) * m_nBudgetGroupNamesAllocated );
 	}
 
 	m_pBudgetGroupNames[m_nBudgetGroupNames] = pNewString;
 	m_nBudgetGroupNames++;
+
+#ifdef _WIN32
+	if ( !Plat_IsPrimaryThread() )
+	{
+		m_bNumBudgetGroupsChanged = true;
+		return m_nBudgetGroupNames - 1;
+	}
+#endif
 	if( m_pNumBudgetGroupsChangedCallBack )
 	{
 		(*m_pNumBudgetGroupsChangedCallBack)();
@@ -748,7 +1058,14 @@ int CVProfile::BudgetGroupNameToBudgetGroupID( const char *pBudgetGroupName )
 	int budgetGroupID = FindBudgetGroupName( pBudgetGroupName );
 	if( budgetGroupID == -1 )
 	{
-		budgetGroupID = AddBudgetGroupName( pBudgetGroupName );
+		g_VProfLock.Lock();
+		// Another thread may have added it while we waited
+		budgetGroupID = FindBudgetGroupName( pBudgetGroupName );
+		if( budgetGroupID == -1 )
+		{
+			budgetGroupID = AddBudgetGroupName( pBudgetGroupName );
+		}
+		g_VProfLock.Unlock();
 	}
 	return budgetGroupID;
 }
@@ -763,5 +1080,188 @@ void CVProfile::RegisterNumBudgetGroupsChangedCallBack( void (*pCallBack)(void)
 	m_pNumBudgetGroupsChangedCallBack = pCallBack;
 }
 
+//=============================================================================
+
+CVProfTrace::CVProfTrace()
+ :	m_bRecording( false ),
+	m_bWrapped( false ),
+	m_pEvents( NULL ),
+	m_nEventsMask( 0 ),
+	m_nNext( 0 )
+{
+}
+
+CVProfTrace::~CVProfTrace()
+{
+	m_bRecording = false;
+	free( m_pEvents );
+}
+
+//-------------------------------------
+
+void CVProfTrace::Start( int nEvents )
+{
+	if ( m_bRecording )
+		return;
+
+	unsigned long nSize = 1;
+	while ( nSize < (unsigned long)nEvents )
+	{
+		nSize <<= 1;
+	}
+
+	if ( !m_pEvents || nSize != m_nEventsMask + 1 )
+	{
+		free( m_pEvents );
+		m_pEvents = ( Event_t * )malloc( sizeof( Event_t ) * nSize );
+		if ( !m_pEvents )
+			return;
+		m_nEventsMask = nSize - 1;
+	}
+
+	m_nNext = 0;
+	m_bWrapped = false;
+	m_bRecording = true;
+}
+
+//-------------------------------------
+
+void CVProfTrace::Stop()
+{
+	m_bRecording = false;
+}
+
+//-------------------------------------
+
+void CVProfTrace::Record( int type, const char *pszName, const char *pBudgetGroupName )
+{
+#ifdef _WIN32
+	// Each thread's events are claimed in the order it recorded them, which
+	// is all the converter needs to pair up its enters and exits
+	unsigned long n = (unsigned long)InterlockedIncrement( (long *)&m_nNext ) - 1;
+	unsigned long threadID = GetCurrentThreadId();
+#else
+	unsigned long n = m_nNext++;
+	unsigned long threadID = 0;
+#endif
+
+	unsigned long i = n & m_nEventsMask;
+	if ( i == m_nEventsMask )
+	{
+		m_bWrapped = true;
+	}
+
+	CCycleCount time;
+	time.Sample();
+
+	Event_t *pEvent = &m_pEvents[i];
+	pEvent->m_Time = time.m_Int64;
+	pEvent->m_pszName = pszName;
+	pEvent->m_pszBudgetGroupName = pBudgetGroupName;
+	pEvent->m_ThreadID = threadID;
+	pEvent->m_Type = type;
+}
+
+//-------------------------------------
+
+bool CVProfTrace::WriteFile( const char *pFilename, float flSeconds )
+{
+	if ( !m_pEvents )
+		return false;
+
+	FILE *fp = fopen( pFilename, "wb" );
+	if ( !fp )
+		return false;
+
+	// A thread that was already past its IsRecording() test may still land
+	// an event while we copy, which at worst garbles that one event
+	bool bWasRecording = m_bRecording;
+	m_bRecording = false;
+
+	unsigned long nNext = m_nNext;
+	unsigned long nEvents = ( m_bWrapped ) ? m_nEventsMask + 1 : nNext;
+	unsigned long nFirst = nNext - nEvents;
+
+	// Back up from the newest event to the start of the window
+	if ( nEvents )
+	{
+		__int64 cutoff = m_pEvents[( nNext - 1 ) & m_nEventsMask].m_Time - (__int64)( flSeconds * (double)g_ClockSpeed );
+		unsigned long n = nNext;
+		while ( n != nFirst && m_pEvents[( n - 1 ) & m_nEventsMask].m_Time >= cutoff )
+		{
+			n--;
+		}
+		nFirst = n;
+	}
+
+	// Scope names are compared by address, as everywhere else in vprof.  The
+	// name pointers are copied out, since once recording is back on other
+	// threads can reuse the slots they came from
+	map<const char *, unsigned short> nameMap;
+	vector< pair<const char *, const char *> > names;
+	vector<VProfTraceEvent_t> events;
+	events.reserve( nNext - nFirst );
+
+	for ( unsigned long n = nFirst; n != nNext; n++ )
+	{
+		const Event_t &event = m_pEvents[n & m_nEventsMask];
+
+		VProfTraceEvent_t out;
+		out.m_Time = event.m_Time;
+		out.m_ThreadID = event.m_ThreadID;
+		out.m_iName = 0xFFFF;
+		out.m_Type = event.m_Type;
+
+		if ( event.m_Type == VPROF_TRACE_ENTER && event.m_pszName )
+		{
+			map<const char *, unsigned short>::iterator iter = nameMap.find( event.m_pszName );
+			if ( iter != nameMap.end() )
+			{
+				out.m_iName = iter->second;
+			}
+			else if ( names.size() < 0xFFFF )
+			{
+				out.m_iName = (unsigned short)names.size();
+				nameMap.insert( make_pair( event.m_pszName, out.m_iName ) );
+				names.push_back( make_pair( event.m_pszName, event.m_pszBudgetGroupName ) );
+			}
+		}
+
+		events.push_back( out );
+	}
+
+	m_bRecording = bWasRecording;
+
+	VProfTraceHeader_t header;
+	header.m_nID = VPROF_TRACE_ID;
+	header.m_nVersion = VPROF_TRACE_VERSION;
+	header.m_ClockSpeed = g_ClockSpeed;
+	header.m_nNames = names.size();
+	header.m_nEvents = events.size();
+	fwrite( &header, sizeof( header ), 1, fp );
+
+	for ( unsigned i = 0; i < names.size(); i++ )
+	{
+		const char *pszScopeName = names[i].first;
+		const char *pszBudgetGroupName = ( names[i].second ) ? names[i].second : "";
+
+		VProfTraceName_t name;
+		name.m_nScopeLength = strlen( pszScopeName ) + 1;
+		name.m_nBudgetGroupLength = strlen( pszBudgetGroupName ) + 1;
+		fwrite( &name, sizeof( name ), 1, fp );
+		fwrite( pszScopeName, name.m_nScopeLength, 1, fp );
+		fwrite( pszBudgetGroupName, name.m_nBudgetGroupLength, 1, fp );
+	}
+
+	if ( events.size() )
+	{
+		fwrite( &events[0], sizeof( VProfTraceEvent_t ), events.size(), fp );
+	}
+
+	bool bOk = !ferror( fp );
+	fclose( fp );
+	return bOk;
+}
+
 #endif	
 
@@ -0,0 +1,241 @@
+// bitbuf_fuzz.cpp : Checks public/bitbuf.cpp against the bitbuf.cpp it replaced.
+//
+// Each round makes a random sequence of fields and writes it with both versions
+// into a random sized buffer, then reads it back with the same version. The bits
+// written, the overflow flags and every value read back have to match, so the
+// encoding on the wire is the same and the readers agree on it, overflows included.
+//
+// Usage: bitbuf_fuzz [rounds] [seed]
+// Returns 0 if every round matched.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitbuf.h"
+#include "vector.h"
+#include "tier0/dbg.h"
+#include "bitbuf_fuzz.h"
+
+
+#define BITBUF_FUZZ_MAX_REPORTS		5	// Mismatches to describe before just counting them.
+
+
+static unsigned int g_FuzzSeed;
+
+unsigned int FuzzRandom()
+{
+	g_FuzzSeed = g_FuzzSeed * 1103515245 + 12345;
+	return ( g_FuzzSeed >> 8 ) ^ ( g_FuzzSeed << 13 );
+}
+
+
+// Coords around all the edges of the encoding: zero, whole numbers, fractions,
+// values under the resolution and values past the integer range.
+float FuzzCoord()
+{
+	switch ( FuzzRandom() % 6 )
+	{
+	case 0:		return 0.0f;
+	case 1:		return (float)( (int)( FuzzRandom() % 32768 ) - 16384 );
+	case 2:		return ( (int)( FuzzRandom() % 65536 ) - 32768 ) / 64.0f;
+	case 3:		return ( (int)( FuzzRandom() % 2000 ) - 1000 ) / 997.0f * 0.05f;
+	case 4:		return ( (int)( FuzzRandom() % 1000000 ) - 500000 ) / 37.0f;
+	default:	return ( ( FuzzRandom() & 1 ) ? -1.0f : 1.0f ) * ( FuzzRandom() % 64 ) / 32.0f;
+	}
+}
+
+
+// Normals, including exactly +-1, ones slightly past it and ones too small to encode.
+float FuzzNormal()
+{
+	switch ( FuzzRandom() % 4 )
+	{
+	case 0:		return 0.0f;
+	case 1:		return ( FuzzRandom() & 1 ) ? 1.0f : -1.0f;
+	case 2:		return ( (int)( FuzzRandom() % 4000 ) - 2000 ) / 2000.0f * 1.0001f;
+	default:	return ( (int)( FuzzRandom() % 200 ) - 100 ) / 100000.0f;
+	}
+}
+
+
+void MakeFuzzOp( BitBufFuzzOp_t &op )
+{
+	memset( &op, 0, sizeof( op ) );
+	op.m_Type = FuzzRandom() % FUZZ_OP_COUNT;
+
+	op.m_nBits = 1 + FuzzRandom() % 32;
+	if ( op.m_Type == FUZZ_OP_SBITLONG && op.m_nBits < 2 )
+		op.m_nBits = 2;
+
+	// Keep the bit fields in range so WriteUBitLong doesn't assert.
+	unsigned int value = FuzzRandom() ^ ( FuzzRandom() << 16 );
+	if ( op.m_Type == FUZZ_OP_UBITLONG && op.m_nBits < 32 )
+	{
+		value &= ( 1u << op.m_nBits ) - 1;
+	}
+	else if ( op.m_Type == FUZZ_OP_SBITLONG && op.m_nBits < 32 )
+	{
+		int range = 1 << ( op.m_nBits - 1 );
+		value = (unsigned int)( (int)( value % ( 2u * range ) ) - range );
+	}
+	op.m_Value = value;
+
+	int i;
+	for ( i = 0; i < 3; i++ )
+	{
+		if ( op.m_Type == FUZZ_OP_NORMAL || op.m_Type == FUZZ_OP_VEC3NORMAL )
+			op.m_Vec[i] = FuzzNormal();
+		else
+			op.m_Vec[i] = FuzzCoord();
+	}
+
+	if ( op.m_Type == FUZZ_OP_FLOAT )
+		op.m_Vec[0] = (float)(int)value / 3.0f;
+
+	op.m_nBytes = FuzzRandom() % 21;
+	for ( i = 0; i < (int)sizeof( op.m_Bytes ); i++ )
+		op.m_Bytes[i] = (unsigned char)FuzzRandom();
+
+	// WriteBits takes any number of bits, so clear the ones past the end.
+	if ( op.m_Type == FUZZ_OP_BITS )
+	{
+		op.m_nBits = FuzzRandom() % 161;
+		for ( i = 0; i < (int)sizeof( op.m_Bytes ); i++ )
+		{
+			if ( i*8 >= op.m_nBits )
+				op.m_Bytes[i] = 0;
+			else if ( i*8 + 8 > op.m_nBits )
+				op.m_Bytes[i] &= ( 1 << ( op.m_nBits - i*8 ) ) - 1;
+		}
+	}
+
+	int strLen = FuzzRandom() % 20;
+	for ( i = 0; i < strLen; i++ )
+		op.m_Str[i] = (char)( 1 + FuzzRandom() % 255 );
+	op.m_Str[strLen] = 0;
+}
+
+
+// Returns the first bit where the buffers differ, or -1 if they're the same.
+int FindFirstDifferentBit( const unsigned char *pBuf1, const unsigned char *pBuf2, int nBits )
+{
+	for ( int iBit=0; iBit < nBits; iBit++ )
+	{
+		if ( ( ( pBuf1[iBit >> 3] >> ( iBit & 7 ) ) & 1 ) != ( ( pBuf2[iBit >> 3] >> ( iBit & 7 ) ) & 1 ) )
+			return iBit;
+	}
+	return -1;
+}
+
+
+// Compares one round, and describes the first difference if bReport is set.
+bool CompareFuzzResults( const BitBufFuzzResult_t &result, const unsigned char *pBuf,
+	const BitBufFuzzResult_t &baseline, const unsigned char *pBaselineBuf, int iRound, bool bReport )
+{
+	if ( result.m_nBitsWritten != baseline.m_nBitsWritten || result.m_bWriteOverflowed != baseline.m_bWriteOverflowed )
+	{
+		if ( bReport )
+		{
+			printf( "round %d: wrote %d bits (overflowed %d), baseline wrote %d bits (overflowed %d)\n", iRound,
+				result.m_nBitsWritten, result.m_bWriteOverflowed, baseline.m_nBitsWritten, baseline.m_bWriteOverflowed );
+		}
+		return false;
+	}
+
+	// The contents of an overflowed buffer aren't defined, only the flag is.
+	if ( result.m_bWriteOverflowed )
+		return true;
+
+	int iBit = FindFirstDifferentBit( pBuf, pBaselineBuf, result.m_nBitsWritten );
+	if ( iBit != -1 )
+	{
+		if ( bReport )
+			printf( "round %d: bit %d of %d differs from the baseline\n", iRound, iBit, result.m_nBitsWritten );
+		return false;
+	}
+
+	if ( result.m_nValues != baseline.m_nValues || result.m_bReadOverflowed != baseline.m_bReadOverflowed )
+	{
+		if ( bReport )
+		{
+			printf( "round %d: read %d values (overflowed %d), baseline read %d values (overflowed %d)\n", iRound,
+				result.m_nValues, result.m_bReadOverflowed, baseline.m_nValues, baseline.m_bReadOverflowed );
+		}
+		return false;
+	}
+
+	for ( int i=0; i < result.m_nValues; i++ )
+	{
+		if ( result.m_Values[i] != baseline.m_Values[i] )
+		{
+			if ( bReport )
+				printf( "round %d: value %d read back as %f, baseline read %f\n", iRound, i, result.m_Values[i], baseline.m_Values[i] );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+SpewRetval_t FuzzSpewFunc( SpewType_t type, char const *pMsg )
+{
+	printf( "%s", pMsg );
+
+	if( type == SPEW_ERROR )
+		return SPEW_ABORT;
+	else
+		return SPEW_CONTINUE;
+}
+
+
+#define BITBUF_FUZZ_RUN_FUNC	RunBitBufFuzzOps
+#include "bitbuf_fuzz_run.h"
+
+
+int main(int argc, char* argv[])
+{
+	SpewOutputFunc( FuzzSpewFunc );
+
+	int nRounds = 20000;
+	if ( argc >= 2 )
+		nRounds = atoi( argv[1] );
+
+	g_FuzzSeed = 12345;
+	if ( argc >= 3 )
+		g_FuzzSeed = strtoul( argv[2], NULL, 10 );
+
+	if ( nRounds <= 0 )
+	{
+		printf( "Usage: bitbuf_fuzz [rounds] [seed]\n" );
+		return 1;
+	}
+
+	static BitBufFuzzOp_t ops[BITBUF_FUZZ_MAX_OPS];
+	static BitBufFuzzResult_t result, baseline;
+
+	// bf_write needs dword aligned buffers.
+	static unsigned long buf[BITBUF_FUZZ_MAX_BYTES / 4], baselineBuf[BITBUF_FUZZ_MAX_BYTES / 4];
+
+	int nMismatches = 0;
+	for ( int iRound=0; iRound < nRounds; iRound++ )
+	{
+		int nOps = 1 + FuzzRandom() % BITBUF_FUZZ_MAX_OPS;
+		for ( int i=0; i < nOps; i++ )
+			MakeFuzzOp( ops[i] );
+
+		// Every tenth round gets a buffer small enough to overflow.
+		int nBytes = 4 * ( 1 + FuzzRandom() % ( ( iRound % 10 ) == 0 ? 40 : BITBUF_FUZZ_MAX_BYTES / 4 ) );
+
+		memset( buf, 0xCD, sizeof( buf ) );
+		memset( baselineBuf, 0xCD, sizeof( baselineBuf ) );
+		RunBitBufFuzzOps( ops, nOps, (unsigned char*)buf, nBytes, result );
+		RunBitBufFuzzOpsBaseline( ops, nOps, (unsigned char*)baselineBuf, nBytes, baseline );
+
+		if ( !CompareFuzzResults( result, (unsigned char*)buf, baseline, (unsigned char*)baselineBuf, iRound, nMismatches < BITBUF_FUZZ_MAX_REPORTS ) )
+			++nMismatches;
+	}
+
+	printf( "%d rounds, %d mismatches\n", nRounds, nMismatches );
+	return ( nMismatches == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: The field sequences bitbuf_fuzz writes with both bitbufs, and what
+//			it compares afterwards.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef BITBUF_FUZZ_H
+#define BITBUF_FUZZ_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+#define BITBUF_FUZZ_MAX_OPS		300
+#define BITBUF_FUZZ_MAX_BYTES	( 4 * 2048 )
+#define BITBUF_FUZZ_MAX_VALUES	( BITBUF_FUZZ_MAX_OPS * 24 )
+
+enum BitBufFuzzOpType_t
+{
+	FUZZ_OP_UBITLONG = 0,
+	FUZZ_OP_SBITLONG,
+	FUZZ_OP_ONEBIT,
+	FUZZ_OP_COORD,
+	FUZZ_OP_VEC3COORD,
+	FUZZ_OP_NORMAL,
+	FUZZ_OP_VEC3NORMAL,
+	FUZZ_OP_BYTES,
+	FUZZ_OP_STRING,
+	FUZZ_OP_CHAR,
+	FUZZ_OP_SHORT,
+	FUZZ_OP_LONG,
+	FUZZ_OP_FLOAT,
+	FUZZ_OP_BITS,
+
+	FUZZ_OP_COUNT
+};
+
+struct BitBufFuzzOp_t
+{
+	int				m_Type;
+	unsigned int	m_Value;
+	int				m_nBits;		// For the bit fields, and the length for FUZZ_OP_BITS
+	float			m_Vec[3];
+	unsigned char	m_Bytes[24];
+	int				m_nBytes;
+	char			m_Str[24];
+};
+
+struct BitBufFuzzResult_t
+{
+	int				m_nBitsWritten;
+	bool			m_bWriteOverflowed;
+	bool			m_bReadOverflowed;
+	int				m_nValues;
+	double			m_Values[BITBUF_FUZZ_MAX_VALUES];	// Everything read back, in order
+};
+
+// Writes the ops into pBuf, then reads them back into result.
+void RunBitBufFuzzOps( const BitBufFuzzOp_t *pOps, int nOps, unsigned char *pBuf, int nBytes, BitBufFuzzResult_t &result );
+void RunBitBufFuzzOpsBaseline( const BitBufFuzzOp_t *pOps, int nOps, unsigned char *pBuf, int nBytes, BitBufFuzzResult_t &result );
+
+
+#endif // BITBUF_FUZZ_H
@@ -0,0 +1,142 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: The body of RunBitBufFuzzOps.  bitbuf_fuzz.cpp and
+//			bitbuf_baseline.cpp each include it once, after defining
+//			BITBUF_FUZZ_RUN_FUNC, so the same code runs against whichever
+//			bf_write and bf_read the file sees.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef BITBUF_FUZZ_RUN_FUNC
+#error "Define BITBUF_FUZZ_RUN_FUNC before including bitbuf_fuzz_run.h"
+#endif
+
+
+void BITBUF_FUZZ_RUN_FUNC( const BitBufFuzzOp_t *pOps, int nOps, unsigned char *pBuf, int nBytes, BitBufFuzzResult_t &result )
+{
+	int i, j;
+
+	bf_write buf( pBuf, nBytes );
+	buf.SetAssertOnOverflow( false );
+	for ( i = 0; i < nOps; i++ )
+	{
+		const BitBufFuzzOp_t &op = pOps[i];
+		switch ( op.m_Type )
+		{
+		case FUZZ_OP_UBITLONG:		buf.WriteUBitLong( op.m_Value, op.m_nBits );							break;
+		case FUZZ_OP_SBITLONG:		buf.WriteSBitLong( (int)op.m_Value, op.m_nBits );						break;
+		case FUZZ_OP_ONEBIT:		buf.WriteOneBit( op.m_Value & 1 );										break;
+		case FUZZ_OP_COORD:			buf.WriteBitCoord( op.m_Vec[0] );										break;
+		case FUZZ_OP_VEC3COORD:		buf.WriteBitVec3Coord( Vector( op.m_Vec[0], op.m_Vec[1], op.m_Vec[2] ) );	break;
+		case FUZZ_OP_NORMAL:		buf.WriteBitNormal( op.m_Vec[0] );										break;
+		case FUZZ_OP_VEC3NORMAL:	buf.WriteBitVec3Normal( Vector( op.m_Vec[0], op.m_Vec[1], op.m_Vec[2] ) );	break;
+		case FUZZ_OP_BYTES:			buf.WriteBytes( op.m_Bytes, op.m_nBytes );								break;
+		case FUZZ_OP_STRING:		buf.WriteString( op.m_Str );											break;
+		case FUZZ_OP_CHAR:			buf.WriteChar( (signed char)op.m_Value );								break;
+		case FUZZ_OP_SHORT:			buf.WriteShort( (short)op.m_Value );									break;
+		case FUZZ_OP_LONG:			buf.WriteLong( (int)op.m_Value );										break;
+		case FUZZ_OP_FLOAT:			buf.WriteBitFloat( op.m_Vec[0] );										break;
+		case FUZZ_OP_BITS:			buf.WriteBits( op.m_Bytes, op.m_nBits );								break;
+		}
+	}
+	result.m_nBitsWritten = buf.GetNumBitsWritten();
+	result.m_bWriteOverflowed = buf.IsOverflowed();
+
+	bf_read readBuf( pBuf, nBytes, result.m_nBitsWritten );
+	readBuf.SetAssertOnOverflow( false );
+	int nValues = 0;
+	for ( i = 0; i < nOps; i++ )
+	{
+		const BitBufFuzzOp_t &op = pOps[i];
+		Vector vec;
+		unsigned char bytes[24];
+		char str[64];
+		int nChars;
+
+		switch ( op.m_Type )
+		{
+		case FUZZ_OP_UBITLONG:
+			result.m_Values[nValues++] = readBuf.ReadUBitLong( op.m_nBits );
+			break;
+
+		case FUZZ_OP_SBITLONG:
+			result.m_Values[nValues++] = readBuf.ReadSBitLong( op.m_nBits );
+			break;
+
+		case FUZZ_OP_ONEBIT:
+			result.m_Values[nValues++] = readBuf.ReadOneBit();
+			break;
+
+		case FUZZ_OP_COORD:
+			result.m_Values[nValues++] = readBuf.ReadBitCoord();
+			break;
+
+		case FUZZ_OP_NORMAL:
+			result.m_Values[nValues++] = readBuf.ReadBitNormal();
+			break;
+
+		case FUZZ_OP_VEC3COORD:
+		case FUZZ_OP_VEC3NORMAL:
+			if ( op.m_Type == FUZZ_OP_VEC3COORD )
+			{
+				readBuf.ReadBitVec3Coord( vec );
+			}
+			else
+			{
+				readBuf.ReadBitVec3Normal( vec );
+			}
+			for ( j = 0; j < 3; j++ )
+			{
+				result.m_Values[nValues++] = vec[j];
+			}
+			break;
+
+		case FUZZ_OP_BYTES:
+			memset( bytes, 0, sizeof( bytes ) );
+			readBuf.ReadBytes( bytes, op.m_nBytes );
+			for ( j = 0; j < op.m_nBytes; j++ )
+			{
+				result.m_Values[nValues++] = bytes[j];
+			}
+			break;
+
+		case FUZZ_OP_STRING:
+			nChars = 0;
+			readBuf.ReadString( str, sizeof( str ), false, &nChars );
+			result.m_Values[nValues++] = nChars;
+			for ( j = 0; j < nChars; j++ )
+			{
+				result.m_Values[nValues++] = str[j];
+			}
+			break;
+
+		case FUZZ_OP_CHAR:
+			result.m_Values[nValues++] = readBuf.ReadChar();
+			break;
+
+		case FUZZ_OP_SHORT:
+			result.m_Values[nValues++] = readBuf.ReadShort();
+			break;
+
+		case FUZZ_OP_LONG:
+			result.m_Values[nValues++] = readBuf.ReadLong();
+			break;
+
+		case FUZZ_OP_FLOAT:
+			result.m_Values[nValues++] = readBuf.ReadBitFloat();
+			break;
+
+		case FUZZ_OP_BITS:
+			memset( bytes, 0, sizeof( bytes ) );
+			readBuf.ReadBits( bytes, op.m_nBits );
+			for ( j = 0; j < ( op.m_nBits + 7 ) / 8; j++ )
+			{
+				result.m_Values[nValues++] = bytes[j];
+			}
+			break;
+		}
+	}
+	result.m_nValues = nValues;
+	result.m_bReadOverflowed = readBuf.IsOverflowed();
+}
@@ -29,6 +29,9 @@
 
 extern	int		numthreads;
 
+// True while RunThreadsOn has worker threads going. RunThreadsOn can't be nested.
+extern	qboolean	threaded;
+
 // If set to true, then all the threads that are created are low priority.
 extern bool	g_bLowPriorityThreads;
 
@@ -1,5 +1,6 @@
 
 #include "vbsp.h"
+#include "utlvector.h"
 
 
 int		c_nodes;
@@ -1224,17 +1225,17 @@ void SplitBrushList (bspbrush_t *brushes,
 
 /*
 ================
-BuildTree_r
+SplitNode
+
+Turns the node into a leaf and returns false, or picks a splitter,
+allocates the children and hands back their brush lists.
 ================
 */
-
-
-node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
+static qboolean SplitNode (node_t *node, bspbrush_t *brushes, bspbrush_t *children[2])
 {
 	node_t		*newnode;
 	side_t		*bestside;
 	int			i;
-	bspbrush_t	*children[2];
 
 	if (numthreads == 1)
 		c_nodes++;
@@ -1251,7 +1252,7 @@ node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
 		node->side = NULL;
 		node->planenum = -1;
 		LeafNode (node, brushes);
-		return node;
+		return false;
 	}
 			 
 	// this is a splitplane node
@@ -1272,6 +1273,23 @@ node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
 	SplitBrush (node->volume, node->planenum, &node->children[0]->volume,
 		&node->children[1]->volume);
 
+	return true;
+}
+
+
+/*
+================
+BuildTree_r
+================
+*/
+node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
+{
+	int			i;
+	bspbrush_t	*children[2];
+
+	if (!SplitNode (node, brushes, children))
+		return node;
+
 	// recursively process children
 	for (i=0 ; i<2 ; i++)
 	{
@@ -1280,6 +1298,77 @@ node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
 
 	return node;
 }
+
+
+/*
+================
+Threaded BuildTree
+
+The top of the tree is split on the main thread until there are enough
+independent subtrees to keep the threads busy, then each subtree is
+built by BuildTree_r on whichever thread picks it up. Each subtree only
+depends on its own brushes, volume and parents, so the tree comes out
+the same as the single threaded build.
+================
+*/
+#define	BUILDTREE_THREADED_MIN_BRUSHES	256		// not worth starting threads for less
+#define BUILDTREE_SUBTREES_PER_THREAD	8
+
+struct subtree_t
+{
+	node_t		*node;
+	bspbrush_t	*brushes;
+};
+
+static CUtlVector<subtree_t> s_Subtrees;
+
+static void BuildTreeTop_r (node_t *node, bspbrush_t *brushes, int depth)
+{
+	int			i;
+	bspbrush_t	*children[2];
+
+	if (depth == 0)
+	{
+		int j = s_Subtrees.AddToTail();
+		s_Subtrees[j].node = node;
+		s_Subtrees[j].brushes = brushes;
+		return;
+	}
+
+	if (!SplitNode (node, brushes, children))
+		return;
+
+	for (i=0 ; i<2 ; i++)
+	{
+		BuildTreeTop_r (node->children[i], children[i], depth-1);
+	}
+}
+
+static void BuildSubtree_Thread (int iThread, int iSubtree)
+{
+	subtree_t *pSubtree = &s_Subtrees[iSubtree];
+	BuildTree_r (pSubtree->node, pSubtree->brushes);
+}
+
+static void BuildTree (node_t *node, bspbrush_t *brushes)
+{
+	// Nested RunThreadsOn isn't supported, so the blocks of the world
+	// (which are already built on separate threads) stay single threaded.
+	if (numthreads == 1 || threaded || CountBrushList (brushes) < BUILDTREE_THREADED_MIN_BRUSHES)
+	{
+		BuildTree_r (node, brushes);
+		return;
+	}
+
+	int depth = 0;
+	while ((1 << depth) < numthreads * BUILDTREE_SUBTREES_PER_THREAD)
+		depth++;
+
+	s_Subtrees.RemoveAll();
+	BuildTreeTop_r (node, brushes, depth);
+	RunThreadsOnIndividual (s_Subtrees.Count(), !verbose, BuildSubtree_Thread);
+	s_Subtrees.Purge();
+}
 	  
 
 //===========================================================
@@ -1349,7 +1438,7 @@ tree_t *BrushBSP (bspbrush_t *brushlist, Vector& mins, Vector& maxs)
 
 	tree->headnode = node;
 
-	node = BuildTree_r (node, brushlist);
+	BuildTree (node, brushlist);
 	qprintf ("%5i visible nodes\n", c_nodes/2 - c_nonvis);
 	qprintf ("%5i nonvis nodes\n", c_nonvis);
 	qprintf ("%5i leafs\n", (c_nodes+1)/2);
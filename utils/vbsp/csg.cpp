@@ -170,9 +170,6 @@ int	IntersectionContents (int c1, int c2)
 }
 
 
-int		minplanenums[3];
-int		maxplanenums[3];
-
 /*
 ===============
 ClipBrushToBox
@@ -180,7 +177,8 @@ ClipBrushToBox
 Any planes shared with the box edge will be set to no texinfo
 ===============
 */
-bspbrush_t	*ClipBrushToBox (bspbrush_t *brush, const Vector& clipmins, const Vector& clipmaxs)
+bspbrush_t	*ClipBrushToBox (bspbrush_t *brush, const Vector& clipmins, const Vector& clipmaxs,
+						 const int *minplanenums, const int *maxplanenums)
 {
 	int		i, j;
 	bspbrush_t	*front,	*back;
@@ -227,7 +225,8 @@ bspbrush_t	*ClipBrushToBox (bspbrush_t *brush, const Vector& clipmins, const Vec
 //-----------------------------------------------------------------------------
 // Creates a clipped brush from a map brush
 //-----------------------------------------------------------------------------
-static bspbrush_t *CreateClippedBrush( mapbrush_t *mb, const Vector& clipmins, const Vector& clipmaxs )
+static bspbrush_t *CreateClippedBrush( mapbrush_t *mb, const Vector& clipmins, const Vector& clipmaxs,
+									   const int *minplanenums, const int *maxplanenums )
 {
 	int nNumSides = mb->numsides;
 	if (!nNumSides)
@@ -268,15 +267,16 @@ static bspbrush_t *CreateClippedBrush( mapbrush_t *mb, const Vector& clipmins, c
 	VectorCopy (mb->maxs, newbrush->maxs);
 
 	// carve off anything outside the clip box
-	newbrush = ClipBrushToBox (newbrush, clipmins, clipmaxs);
+	newbrush = ClipBrushToBox (newbrush, clipmins, clipmaxs, minplanenums, maxplanenums);
 	return newbrush;
 }
 
 
 //-----------------------------------------------------------------------------
-// Creates a clipped brush from a map brush
+// Finds the planes of the sides of the clip box. The plane numbers are returned
+// instead of stored off so that blocks can be clipped from several threads.
 //-----------------------------------------------------------------------------
-static void ComputeBoundingPlanes( const Vector& clipmins, const Vector& clipmaxs )
+void ComputeBoundingPlanes( const Vector& clipmins, const Vector& clipmaxs, int *minplanenums, int *maxplanenums )
 {
 	Vector normal;
 	float dist;
@@ -350,19 +350,71 @@ void FixupAreaportalWaterBrushes( bspbrush_t *pList )
 			if ( !pIntersect )
 				continue;
 			FreeBrush( pIntersect );
-			pAreaportal->original->contents |= pWater->original->contents;
+
+			// Only write the shared map brush if it's missing contents; the world
+			// has normally done this already before the block threads start.
+			int nWaterContents = pWater->original->contents;
+			if ( (pAreaportal->original->contents & nWaterContents) != nWaterContents )
+			{
+				pAreaportal->original->contents |= nWaterContents;
+			}
 			CopyMatchingTexinfos( pAreaportal, pWater );
 		}
 	}
 }
 
+
+//-----------------------------------------------------------------------------
+// Same as above, but for whole (unclipped) map brushes. This settles the map
+// brush contents once up front so the block threads only touch their own copies.
+//-----------------------------------------------------------------------------
+void FixupAreaportalWaterBrushes( int startbrush, int endbrush, int detailScreen )
+{
+	bspbrush_t *pList = NULL;
+	for ( int i = startbrush; i < endbrush; i++ )
+	{
+		mapbrush_t *mb = &mapbrushes[i];
+		if ( !mb->numsides || !(mb->contents & (CONTENTS_AREAPORTAL | CONTENTS_WATER)) )
+			continue;
+
+		if ( detailScreen != FULL_DETAIL )
+		{
+			bool onlyDetail = (detailScreen == ONLY_DETAIL);
+			bool detail = (mb->contents & CONTENTS_DETAIL) != 0;
+			if ( onlyDetail ^ detail )
+				continue;
+		}
+
+		bspbrush_t *pNewBrush = AllocBrush( mb->numsides );
+		pNewBrush->original = mb;
+		pNewBrush->numsides = mb->numsides;
+		memcpy( pNewBrush->sides, mb->original_sides, mb->numsides * sizeof(side_t) );
+		for ( int j = 0; j < mb->numsides; j++ )
+		{
+			if ( pNewBrush->sides[j].winding )
+			{
+				pNewBrush->sides[j].winding = CopyWinding( pNewBrush->sides[j].winding );
+			}
+		}
+		VectorCopy( mb->mins, pNewBrush->mins );
+		VectorCopy( mb->maxs, pNewBrush->maxs );
+
+		pNewBrush->next = pList;
+		pList = pNewBrush;
+	}
+
+	FixupAreaportalWaterBrushes( pList );
+	FreeBrushList( pList );
+}
+
 //-----------------------------------------------------------------------------
 // MakeBspBrushList 
 //-----------------------------------------------------------------------------
 // UNDONE: Put detail brushes in a separate brush array and pass that instead of "onlyDetail" ?
 bspbrush_t *MakeBspBrushList (int startbrush, int endbrush, const Vector& clipmins, const Vector& clipmaxs, int detailScreen)
 {
-	ComputeBoundingPlanes( clipmins, clipmaxs );
+	int minplanenums[2], maxplanenums[2];
+	ComputeBoundingPlanes( clipmins, clipmaxs, minplanenums, maxplanenums );
 
 	bspbrush_t	*pBrushList = NULL;
 
@@ -382,7 +434,7 @@ bspbrush_t *MakeBspBrushList (int startbrush, int endbrush, const Vector& clipmi
 			}
 		}
 
-		bspbrush_t *pNewBrush = CreateClippedBrush( mb, clipmins, clipmaxs );
+		bspbrush_t *pNewBrush = CreateClippedBrush( mb, clipmins, clipmaxs, minplanenums, maxplanenums );
 		if ( pNewBrush )
 		{
 			pNewBrush->next = pBrushList;
@@ -399,12 +451,13 @@ bspbrush_t *MakeBspBrushList (int startbrush, int endbrush, const Vector& clipmi
 //-----------------------------------------------------------------------------
 bspbrush_t *MakeBspBrushList (mapbrush_t **pBrushes, int nBrushCount, const Vector& clipmins, const Vector& clipmaxs)
 {
-	ComputeBoundingPlanes( clipmins, clipmaxs );
+	int minplanenums[2], maxplanenums[2];
+	ComputeBoundingPlanes( clipmins, clipmaxs, minplanenums, maxplanenums );
 
 	bspbrush_t	*pBrushList = NULL;
 	for ( int i=0; i < nBrushCount; ++i )
 	{
-		bspbrush_t *pNewBrush = CreateClippedBrush( pBrushes[i], clipmins, clipmaxs );
+		bspbrush_t *pNewBrush = CreateClippedBrush( pBrushes[i], clipmins, clipmaxs, minplanenums, maxplanenums );
 		if ( pNewBrush )
 		{
 			pNewBrush->next = pBrushList;
@@ -35,8 +35,6 @@ int	c_facecollapse;
 int	c_badstartverts;
 
 #define	MAX_SUPERVERTS	512
-int	superverts[MAX_SUPERVERTS];
-int	numsuperverts;
 
 face_t		*edgefaces[MAX_MAP_EDGES][2];
 int		firstmodeledge = 1;
@@ -44,12 +42,33 @@ int		firstmodelface;
 
 int	c_tryedges;
 
-Vector	edge_dir;
-Vector	edge_start;
-vec_t	edge_len;
+// Working state for welding and t-junction fixing. The tjunc pass runs on
+// several nodes at once, so each thread gets its own.
+struct tjuncscratch_t
+{
+	int		superverts[MAX_SUPERVERTS];
+	int		numsuperverts;
+
+	Vector	edge_dir;
+	Vector	edge_start;
+
+	int		num_edge_verts;
+	int		edge_verts[MAX_MAP_VERTS];
+
+	int		c_degenerate;
+	int		c_tjunctions;
+	int		c_faceoverflows;
+	int		c_facecollapse;
+	int		c_badstartverts;
+};
+
+static tjuncscratch_t	s_TJuncScratch[MAX_TOOL_THREADS+1];
 
-int		num_edge_verts;
-int		edge_verts[MAX_MAP_VERTS];
+// Nodes with faces, children first. Used by the threaded per-node passes.
+static CUtlVector<node_t*>	s_FaceNodes;
+
+// Don't bother starting threads for the per-node face passes on small trees.
+#define	MIN_THREADED_FACE_NODES	64
 
 
 float	g_maxLightmapDimension = 32;
@@ -212,16 +231,18 @@ superverts[base] will become face->vertexnums[0], and the others
 will be circularly filled in.
 ==================
 */
-void FaceFromSuperverts (face_t **pListHead, face_t *f, int base)
+static void FaceFromSuperverts (tjuncscratch_t *ts, face_t **pListHead, face_t *f, int base)
 {
 	face_t	*newf;
 	int		remaining;
 	int		i;
+	int		*superverts = ts->superverts;
+	int		numsuperverts = ts->numsuperverts;
 
 	remaining = numsuperverts;
 	while (remaining > MAXEDGES)
 	{	// must split into two faces, because of vertex overload
-		c_faceoverflows++;
+		ts->c_faceoverflows++;
 
 		newf = NewFaceFromFace (f);
 		f->split[0] = newf;
@@ -259,6 +280,7 @@ void EmitFaceVertexes (face_t **pListHead, face_t *f)
 {
 	winding_t	*w;
 	int			i;
+	tjuncscratch_t *ts = &s_TJuncScratch[THREADINDEX_MAIN];
 
 	if (f->merged || f->split[0] || f->split[1])
 		return;
@@ -270,19 +292,19 @@ void EmitFaceVertexes (face_t **pListHead, face_t *f)
 		{	// make every point unique
 			if (numvertexes == MAX_MAP_VERTS)
 				Error ("MAX_MAP_VERTS");
-			superverts[i] = numvertexes;
+			ts->superverts[i] = numvertexes;
 			VectorCopy (w->p[i], dvertexes[numvertexes].point);
 			numvertexes++;
 			c_uniqueverts++;
 			c_totalverts++;
 		}
 		else
-			superverts[i] = GetVertexnum (w->p[i]);
+			ts->superverts[i] = GetVertexnum (w->p[i]);
 	}
-	numsuperverts = w->numpoints;
+	ts->numsuperverts = w->numpoints;
 
 	// this may fragment the face if > MAXEDGES
-	FaceFromSuperverts (pListHead, f, 0);
+	FaceFromSuperverts (ts, pListHead, f, 0);
 }
 
 /*
@@ -332,7 +354,7 @@ FindEdgeVerts
 Uses the hash tables to cut down to a small number
 ==========
 */
-void FindEdgeVerts (Vector& v1, Vector& v2)
+void FindEdgeVerts (tjuncscratch_t *ts, Vector& v1, Vector& v2)
 {
 	int		x1, x2, y1, y2, t;
 	int		x, y;
@@ -378,14 +400,14 @@ void FindEdgeVerts (Vector& v1, Vector& v2)
 	if (y2 >= HASH_SIZE)
 		y2 = HASH_SIZE;
 #endif
-	num_edge_verts = 0;
+	ts->num_edge_verts = 0;
 	for (x=x1 ; x <= x2 ; x++)
 	{
 		for (y=y1 ; y <= y2 ; y++)
 		{
 			for (vnum=hashverts[y*HASH_SIZE+x] ; vnum ; vnum=vertexchain[vnum])
 			{
-				edge_verts[num_edge_verts++] = vnum;
+				ts->edge_verts[ts->num_edge_verts++] = vnum;
 			}
 		}
 	}
@@ -399,13 +421,13 @@ FindEdgeVerts
 Forced a dumb check of everything
 ==========
 */
-void FindEdgeVerts (Vector& v1, Vector& v2)
+void FindEdgeVerts (tjuncscratch_t *ts, Vector& v1, Vector& v2)
 {
 	int		i;
 
-	num_edge_verts = numvertexes-1;
-	for (i=0 ; i<num_edge_verts ; i++)
-		edge_verts[i] = i+1;
+	ts->num_edge_verts = numvertexes-1;
+	for (i=0 ; i<ts->num_edge_verts ; i++)
+		ts->edge_verts[i] = i+1;
 }
 #endif
 
@@ -416,7 +438,7 @@ TestEdge
 Can be recursively reentered
 ==========
 */
-void TestEdge (vec_t start, vec_t end, int p1, int p2, int startvert)
+void TestEdge (tjuncscratch_t *ts, vec_t start, vec_t end, int p1, int p2, int startvert)
 {
 	int		j, k;
 	vec_t	dist;
@@ -428,23 +450,23 @@ void TestEdge (vec_t start, vec_t end, int p1, int p2, int startvert)
 
 	if (p1 == p2)
 	{
-		c_degenerate++;
+		ts->c_degenerate++;
 		return;		// degenerate edge
 	}
 
-	for (k=startvert ; k<num_edge_verts ; k++)
+	for (k=startvert ; k<ts->num_edge_verts ; k++)
 	{
-		j = edge_verts[k];
+		j = ts->edge_verts[k];
 		if (j==p1 || j == p2)
 			continue;
 
 		VectorCopy (dvertexes[j].point, p);
 
-		VectorSubtract (p, edge_start, delta);
-		dist = DotProduct (delta, edge_dir);
+		VectorSubtract (p, ts->edge_start, delta);
+		dist = DotProduct (delta, ts->edge_dir);
 		if (dist <=start || dist >= end)
 			continue;		// off an end
-		VectorMA (edge_start, dist, edge_dir, exact);
+		VectorMA (ts->edge_start, dist, ts->edge_dir, exact);
 		VectorSubtract (p, exact, off);
 		error = off.Length();
 
@@ -452,17 +474,17 @@ void TestEdge (vec_t start, vec_t end, int p1, int p2, int startvert)
 			continue;		// not on the edge
 
 		// break the edge
-		c_tjunctions++;
-		TestEdge (start, dist, p1, j, k+1);
-		TestEdge (dist, end, j, p2, k+1);
+		ts->c_tjunctions++;
+		TestEdge (ts, start, dist, p1, j, k+1);
+		TestEdge (ts, dist, end, j, p2, k+1);
 		return;
 	}
 
 	// the edge p1 to p2 is now free of tjunctions
-	if (numsuperverts >= MAX_SUPERVERTS)
+	if (ts->numsuperverts >= MAX_SUPERVERTS)
 		Error ("MAX_SUPERVERTS");
-	superverts[numsuperverts] = p1;
-	numsuperverts++;
+	ts->superverts[ts->numsuperverts] = p1;
+	ts->numsuperverts++;
 }
 
 /*
@@ -471,7 +493,7 @@ FixFaceEdges
 
 ==================
 */
-void FixFaceEdges (face_t **pList, face_t *f)
+void FixFaceEdges (tjuncscratch_t *ts, face_t **pList, face_t *f)
 {
 	int		p1, p2;
 	int		i;
@@ -483,31 +505,31 @@ void FixFaceEdges (face_t **pList, face_t *f)
 	if (f->merged || f->split[0] || f->split[1])
 		return;
 
-	numsuperverts = 0;
+	ts->numsuperverts = 0;
 
 	for (i=0 ; i<f->numpoints ; i++)
 	{
 		p1 = f->vertexnums[i];
 		p2 = f->vertexnums[(i+1)%f->numpoints];
 
-		VectorCopy (dvertexes[p1].point, edge_start);
+		VectorCopy (dvertexes[p1].point, ts->edge_start);
 		VectorCopy (dvertexes[p2].point, e2);
 
-		FindEdgeVerts (edge_start, e2);
+		FindEdgeVerts (ts, ts->edge_start, e2);
 
-		VectorSubtract (e2, edge_start, edge_dir);
-		len = VectorNormalize (edge_dir);
+		VectorSubtract (e2, ts->edge_start, ts->edge_dir);
+		len = VectorNormalize (ts->edge_dir);
 
-		start[i] = numsuperverts;
-		TestEdge (0, len, p1, p2, 0);
+		start[i] = ts->numsuperverts;
+		TestEdge (ts, 0, len, p1, p2, 0);
 
-		count[i] = numsuperverts - start[i];
+		count[i] = ts->numsuperverts - start[i];
 	}
 
-	if (numsuperverts < 3)
+	if (ts->numsuperverts < 3)
 	{	// entire face collapsed
 		f->numpoints = 0;
-		c_facecollapse++;
+		ts->c_facecollapse++;
 		return;
 	}
 
@@ -522,7 +544,7 @@ void FixFaceEdges (face_t **pList, face_t *f)
 	if (i == f->numpoints)
 	{
 		f->badstartvert = true;
-		c_badstartverts++;
+		ts->c_badstartverts++;
 		base = 0;
 	}
 	else
@@ -531,29 +553,51 @@ void FixFaceEdges (face_t **pList, face_t *f)
 	}
 
 	// this may fragment the face if > MAXEDGES
-	FaceFromSuperverts (pList, f, base);
+	FaceFromSuperverts (ts, pList, f, base);
 }
 
 /*
 ==================
-FixEdges_r
+Per-node face passes
+
+Merging, subdividing and t-junction fixing only touch the faces on
+one node (plus read-only map data), so nodes can go to separate threads
+without changing the results.
 ==================
 */
-void FixEdges_r (node_t *node)
+static void AddFaceNodes_r (node_t *node)
 {
-	int		i;
-	face_t	*f;
-
 	if (node->planenum == PLANENUM_LEAF)
-	{
 		return;
-	}
 
-	for (f=node->faces ; f ; f=f->next)
-		FixFaceEdges (&node->faces, f);
+	AddFaceNodes_r (node->children[0]);
+	AddFaceNodes_r (node->children[1]);
 
-	for (i=0 ; i<2 ; i++)
-		FixEdges_r (node->children[i]);
+	if (node->faces)
+		s_FaceNodes.AddToTail (node);
+}
+
+// Fills in s_FaceNodes and returns true if it's worth running threads on them.
+static qboolean BuildFaceNodeList (node_t *headnode)
+{
+	s_FaceNodes.RemoveAll ();
+	AddFaceNodes_r (headnode);
+
+	return numthreads > 1 && !threaded && s_FaceNodes.Count() >= MIN_THREADED_FACE_NODES;
+}
+
+/*
+==================
+FixEdges_Thread
+==================
+*/
+static void FixEdges_Thread (int iThread, int iNode)
+{
+	node_t	*node = s_FaceNodes[iNode];
+	face_t	*f;
+
+	for (f=node->faces ; f ; f=f->next)
+		FixFaceEdges (&s_TJuncScratch[iThread], &node->faces, f);
 }
 
 
@@ -566,7 +610,7 @@ void FixLeafFaceEdges( face_t **ppLeafFaceList )
 
 	for ( f = *ppLeafFaceList; f; f = f->next )
 	{
-		FixFaceEdges( ppLeafFaceList, f );
+		FixFaceEdges( &s_TJuncScratch[THREADINDEX_MAIN], ppLeafFaceList, f );
 	}
 }
 
@@ -579,7 +623,20 @@ FixTjuncs
 
 face_t *FixTjuncs (node_t *headnode, face_t *pLeafFaceList)
 {
+	int		i;
+
+	for (i=0 ; i<MAX_TOOL_THREADS+1 ; i++)
+	{
+		tjuncscratch_t *ts = &s_TJuncScratch[i];
+		ts->c_degenerate = 0;
+		ts->c_tjunctions = 0;
+		ts->c_faceoverflows = 0;
+		ts->c_facecollapse = 0;
+		ts->c_badstartverts = 0;
+	}
+
 	// snap and merge all vertexes
+	// (this has to stay single threaded since it numbers the vertexes)
 	qprintf ("---- snap verts ----\n");
 	memset (hashverts, 0, sizeof(hashverts));
 	memset (vertexchain, 0, sizeof(vertexchain));
@@ -598,7 +655,16 @@ face_t *FixTjuncs (node_t *headnode, face_t *pLeafFaceList)
 	c_tjunctions = 0;
 	if (!notjunc)
 	{
-		FixEdges_r (headnode);
+		if (BuildFaceNodeList (headnode))
+		{
+			RunThreadsOnIndividual (s_FaceNodes.Count(), !verbose, FixEdges_Thread);
+		}
+		else
+		{
+			for (i=0 ; i<s_FaceNodes.Count() ; i++)
+				FixEdges_Thread (THREADINDEX_MAIN, i);
+		}
+		s_FaceNodes.Purge ();
 
 		// UNDONE: What we really want to do here is not add any world-only tjuncs to the details
 		// But you'd have to know which verts were in each set in the hash in order to build the
@@ -611,6 +677,15 @@ face_t *FixTjuncs (node_t *headnode, face_t *pLeafFaceList)
 		EmitLeafFaceVertexes( &pLeafFaceList );
 	}
 
+	for (i=0 ; i<MAX_TOOL_THREADS+1 ; i++)
+	{
+		tjuncscratch_t *ts = &s_TJuncScratch[i];
+		c_degenerate += ts->c_degenerate;
+		c_tjunctions += ts->c_tjunctions;
+		c_faceoverflows += ts->c_faceoverflows;
+		c_facecollapse += ts->c_facecollapse;
+		c_badstartverts += ts->c_badstartverts;
+	}
 
 	qprintf ("%i unique from %i\n", c_uniqueverts, c_totalverts);
 	qprintf ("%5i edges degenerated\n", c_degenerate);
@@ -638,7 +713,8 @@ face_t	*AllocFace (void)
 	f->id = s_FaceId;
 	++s_FaceId;
 
-	c_faces++;
+	if (numthreads == 1)
+		c_faces++;
 
 	return f;
 }
@@ -660,7 +736,8 @@ void FreeFace (face_t *f)
 	if (f->w)
 		FreeWinding (f->w);
 	free (f);
-	c_faces--;
+	if (numthreads == 1)
+		c_faces--;
 }
 
 
@@ -904,7 +981,6 @@ face_t *TryMerge (face_t *f1, face_t *f2, Vector& planenormal)
 	if (!nw)
 		return NULL;
 
-	c_merge++;
 	newf = NewFaceFromFace (f1);
 	newf->w = nw;
 
@@ -1008,8 +1084,6 @@ void SubdivideFace (face_t **pFaceList, face_t *f)
 				break;
 			
 		// split it
-			c_subdivide++;
-			
 			luxelsPerWorldUnit = VectorNormalize (temp);	
 
 			dist = ( mins + g_maxLightmapDimension - 1 ) / luxelsPerWorldUnit;
@@ -1186,12 +1260,7 @@ void MakeFaces_r (node_t *node)
 		MakeFaces_r (node->children[0]);
 		MakeFaces_r (node->children[1]);
 
-		// merge together all visible faces on the node
-		if (!nomerge)
-			MergeFaceList(&node->faces);
-		if (!nosubdiv)
-			SubdivideFaceList(&node->faces);
-
+		// the faces on the node get merged and subdivided in MakeFaces
 		return;
 	}
 
@@ -1550,6 +1619,23 @@ void SplitSubdividedFaces( face_t *pLeafFaceList, node_t *headnode )
 
 #pragma optimize( "", on )
 
+/*
+============
+MergeNodeFaces_Thread
+
+Merge together all visible faces on the node
+============
+*/
+static void MergeNodeFaces_Thread (int iThread, int iNode)
+{
+	node_t	*node = s_FaceNodes[iNode];
+
+	if (!nomerge)
+		MergeFaceList(&node->faces);
+	if (!nosubdiv)
+		SubdivideFaceList(&node->faces);
+}
+
 /*
 ============
 MakeFaces
@@ -1557,6 +1643,9 @@ MakeFaces
 */
 void MakeFaces (node_t *node)
 {
+	int		i;
+	face_t	*f;
+
 	qprintf ("--- MakeFaces ---\n");
 	c_merge = 0;
 	c_subdivide = 0;
@@ -1564,6 +1653,33 @@ void MakeFaces (node_t *node)
 
 	MakeFaces_r (node);
 
+	// a node's faces all come from portals in the leafs below it, so
+	// they're complete now and each node can be merged on its own
+	if (BuildFaceNodeList (node))
+	{
+		RunThreadsOnIndividual (s_FaceNodes.Count(), !verbose, MergeNodeFaces_Thread);
+	}
+	else
+	{
+		for (i=0 ; i<s_FaceNodes.Count() ; i++)
+			MergeNodeFaces_Thread (THREADINDEX_MAIN, i);
+	}
+
+	// merged and split faces stay on the list, so count them afterwards
+	// (each merge marks two faces)
+	for (i=0 ; i<s_FaceNodes.Count() ; i++)
+	{
+		for (f=s_FaceNodes[i]->faces ; f ; f=f->next)
+		{
+			if (f->merged)
+				c_merge++;
+			if (f->split[0])
+				c_subdivide++;
+		}
+	}
+	c_merge /= 2;
+	s_FaceNodes.Purge ();
+
 	qprintf ("%5i makefaces\n", c_nodefaces);
 	qprintf ("%5i merged\n", c_merge);
 	qprintf ("%5i subdivided\n", c_subdivide);
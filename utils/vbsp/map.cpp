@@ -294,10 +294,13 @@ void SnapPlane(Vector &normal, vec_t &dist, const Vector &p0, const Vector &p1,
 =============
 FindFloatPlane
 
+The block threads only ever find planes that were created before they
+started (see CreateBlockPlanes), but lock anyway so a new plane can't
+be half-built while another thread walks the hash chains.
 =============
 */
 #ifndef USE_HASHING
-int		FindFloatPlane (Vector& normal, vec_t dist)
+static int FindFloatPlaneLocked (Vector& normal, vec_t dist)
 {
 	int		i;
 	plane_t	*p;
@@ -312,7 +315,7 @@ int		FindFloatPlane (Vector& normal, vec_t dist)
 	return CreateNewFloatPlane (normal, dist);
 }
 #else
-int		FindFloatPlane (Vector& normal, vec_t dist)
+static int FindFloatPlaneLocked (Vector& normal, vec_t dist)
 {
 	int		i;
 	plane_t	*p;
@@ -337,6 +340,14 @@ int		FindFloatPlane (Vector& normal, vec_t dist)
 }
 #endif
 
+int		FindFloatPlane (Vector& normal, vec_t dist)
+{
+	ThreadLock();
+	int planenum = FindFloatPlaneLocked (normal, dist);
+	ThreadUnlock();
+	return planenum;
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: Builds a plane normal and distance from three points on the plane.
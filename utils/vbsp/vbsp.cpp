@@ -125,6 +125,52 @@ node_t	*BlockTree (int xl, int yl, int xh, int yh)
 	return node;
 }
 
+/*
+============
+GetBlockBounds
+
+============
+*/
+static void GetBlockBounds (int blocknum, int *xblock, int *yblock, Vector& mins, Vector& maxs)
+{
+	*yblock = block_yl + blocknum / (block_xh-block_xl+1);
+	*xblock = block_xl + blocknum % (block_xh-block_xl+1);
+
+	// HLTOOLS: Should be fixed now
+	mins[0] = *xblock*1024;
+	mins[1] = *yblock*1024;
+	mins[2] = MIN_COORD_INTEGER;
+	maxs[0] = (*xblock+1)*1024;
+	maxs[1] = (*yblock+1)*1024;
+	maxs[2] = MAX_COORD_INTEGER;
+}
+
+/*
+============
+CreateBlockPlanes
+
+Creates every plane the block threads will look up, in block order.
+Plane numbers then don't depend on the order the threads run in.
+============
+*/
+static void CreateBlockPlanes (void)
+{
+	int			blocknum, xblock, yblock;
+	int			minplanenums[2], maxplanenums[2];
+	Vector		mins, maxs;
+	bspbrush_t	*b;
+
+	for (blocknum = 0 ; blocknum < (block_xh-block_xl+1)*(block_yh-block_yl+1) ; blocknum++)
+	{
+		GetBlockBounds (blocknum, &xblock, &yblock, mins, maxs);
+
+		// same order as MakeBspBrushList, then BrushBSP
+		ComputeBoundingPlanes (mins, maxs, minplanenums, maxplanenums);
+		b = BrushFromBounds (mins, maxs);
+		FreeBrush (b);
+	}
+}
+
 /*
 ============
 ProcessBlock_Thread
@@ -140,19 +186,10 @@ void ProcessBlock_Thread (int threadnum, int blocknum)
 	tree_t		*tree;
 	node_t		*node;
 
-	yblock = block_yl + blocknum / (block_xh-block_xl+1);
-	xblock = block_xl + blocknum % (block_xh-block_xl+1);
+	GetBlockBounds (blocknum, &xblock, &yblock, mins, maxs);
 
 	qprintf ("############### block %2i,%2i ###############\n", xblock, yblock);
 
-	// HLTOOLS: Should be fixed now
-	mins[0] = xblock*1024;
-	mins[1] = yblock*1024;
-	mins[2] = MIN_COORD_INTEGER;
-	maxs[0] = (xblock+1)*1024;
-	maxs[1] = (yblock+1)*1024;
-	maxs[2] = MAX_COORD_INTEGER;
-
 	// the makelist and chopbrushes could be cached between the passes...
 	brushes = MakeBspBrushList (brush_start, brush_end, mins, maxs, NO_DETAIL);
 	if (!brushes)
@@ -219,6 +256,10 @@ void ProcessWorldModel (void)
 	if (block_yh > BLOCKS_MAX)
 		block_yh = BLOCKS_MAX;
 
+	// Everything the blocks share has to be settled before the block threads start.
+	CreateBlockPlanes ();
+	FixupAreaportalWaterBrushes (brush_start, brush_end, NO_DETAIL);
+
 	for (optimize = 0 ; optimize <= 1 ; optimize++)
 	{
 		qprintf ("--------------------------------------------\n");
@@ -311,6 +352,7 @@ void ProcessWorldModel (void)
 	// This unifies the vertex list for all edges (splits collinear edges to remove t-junctions)
 	// It also welds the list of vertices out of each winding/portal and rounds nearly integer verts to integer
 	pLeafFaceList = FixTjuncs (tree->headnode, pLeafFaceList);
+	Msg("FixTjuncs done (%d)\n", (int)(I_FloatTime() - start) );
 
 	// this merges all of the solid nodes that have separating planes
 	if (!noprune)
@@ -322,6 +364,7 @@ void ProcessWorldModel (void)
 	Msg( "SplitSubdividedFaces...\n" );
 //	SplitSubdividedFaces( tree->headnode );
 	
+	start = I_FloatTime();
 	Msg("WriteBSP...\n");
 	WriteBSP (tree->headnode, pLeafFaceList);
 	Msg("done (%d)\n", (int)(I_FloatTime() - start) );
@@ -887,7 +930,6 @@ int main (int argc, char **argv)
 	}
 
 	ThreadSetDefault ();
-	numthreads = 1;		// multiple threads aren't helping...
 	
 	CmdLib_InitFileSystem( argv[i], true );
 
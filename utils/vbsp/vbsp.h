@@ -353,6 +353,8 @@ bspbrush_t *ChopBrushes (bspbrush_t *head);
 bspbrush_t *InitialBrushList (bspbrush_t *list);
 bspbrush_t *OptimizedBrushList (bspbrush_t *list);
 void FixupAreaportalWaterBrushes( bspbrush_t *pList );
+void FixupAreaportalWaterBrushes( int startbrush, int endbrush, int detailScreen );
+void ComputeBoundingPlanes( const Vector& clipmins, const Vector& clipmaxs, int *minplanenums, int *maxplanenums );
 
 void WriteBrushMap (char *name, bspbrush_t *list);
 
@@ -370,6 +372,7 @@ void SplitBrush (bspbrush_t *brush, int planenum,
 tree_t *AllocTree (void);
 node_t *AllocNode (void);
 bspbrush_t *AllocBrush (int numsides);
+bspbrush_t *BrushFromBounds (Vector& mins, Vector& maxs);
 int	CountBrushList (bspbrush_t *brushes);
 void FreeBrush (bspbrush_t *brushes);
 vec_t BrushVolume (bspbrush_t *brush);
@@ -16,6 +16,7 @@
 
 
 class IThreadedTCPSocket;
+class IChannel;
 
 
 class CTCPPacket
@@ -34,6 +35,7 @@ public:
 
 private:
 	friend class CThreadedTCPSocket;
+	friend class CThreadedChannelSocket;
 	~CTCPPacket(); // Use Release(), not delete.
 
 	int m_UserData;
@@ -166,4 +168,12 @@ ITCPConnectSocket* ThreadedTCP_CreateConnector(
 void ThreadedTCP_EnableTimeouts( bool bEnable );
 
 
+// Wraps an IChannel that's already connected (like a shared memory channel to a local process)
+// so it can be used anywhere an IThreadedTCPSocket is. A thread receives from the channel and
+// hands packets to pHandler. pHandler->Init is called before this returns.
+//
+// The socket owns the channel and releases it when the socket is released.
+IThreadedTCPSocket* ThreadedTCP_CreateChannelSocket( IChannel *pChannel, ITCPSocketHandler *pHandler );
+
+
 #endif // ITHREADEDTCPSOCKET_H
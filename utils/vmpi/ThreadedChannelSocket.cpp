@@ -0,0 +1,162 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: IThreadedTCPSocket on top of an IChannel.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include <windows.h>
+#include "IThreadedTCPSocket.h"
+#include "ichannel.h"
+#include "threadhelpers.h"
+#include "tier0/dbg.h"
+
+
+#define CHANNEL_RECV_TIMEOUT	0.05	// Seconds. How often the receive thread checks if it should exit.
+
+
+// ---------------------------------------------------------------------------------------- //
+// CThreadedChannelSocket. The channel does the sending itself (it's thread-safe), and
+// this runs a thread that receives packets from it and passes them to the handler just
+// like CThreadedTCPSocket does.
+// ---------------------------------------------------------------------------------------- //
+
+class CThreadedChannelSocket : public IThreadedTCPSocket
+{
+public:
+
+	CThreadedChannelSocket( IChannel *pChannel, ITCPSocketHandler *pHandler )
+	{
+		m_pChannel = pChannel;
+		m_pHandler = pHandler;
+		m_hRecvThread = NULL;
+		m_bShutdown = false;
+		m_bError = false;
+	}
+
+	virtual ~CThreadedChannelSocket()
+	{
+		Term();
+	}
+
+	bool Init()
+	{
+		m_pHandler->Init( this );
+
+		DWORD dwRecvThreadID = 0;
+		m_hRecvThread = CreateThread( NULL, 0, &CThreadedChannelSocket::StaticRecvThreadFn, this, 0, &dwRecvThreadID );
+		return m_hRecvThread != NULL;
+	}
+
+	void Term()
+	{
+		if ( m_hRecvThread )
+		{
+			m_bShutdown = true;
+			WaitForSingleObject( m_hRecvThread, INFINITE );
+			CloseHandle( m_hRecvThread );
+			m_hRecvThread = NULL;
+		}
+
+		if ( m_pChannel )
+		{
+			m_pChannel->Release();
+			m_pChannel = NULL;
+		}
+	}
+
+
+// IThreadedTCPSocket implementation.
+public:
+
+	virtual void Release()
+	{
+		delete this;
+	}
+
+	virtual CIPAddr GetRemoteAddr() const
+	{
+		return CIPAddr( 127, 0, 0, 1, 0 );
+	}
+
+	virtual bool IsValid()
+	{
+		return !m_bError;
+	}
+
+	virtual bool Send( const void *pData, int len )
+	{
+		return SendChunks( &pData, &len, 1 );
+	}
+
+	virtual bool SendChunks( void const * const *pChunks, const int *pChunkLengths, int nChunks )
+	{
+		if ( m_bError )
+			return false;
+
+		return m_pChannel->SendChunks( pChunks, pChunkLengths, nChunks );
+	}
+
+
+private:
+
+	static DWORD WINAPI StaticRecvThreadFn( LPVOID pParameter )
+	{
+		return ((CThreadedChannelSocket*)pParameter)->RecvThreadFn();
+	}
+
+	DWORD RecvThreadFn()
+	{
+		CUtlVector<unsigned char> data;
+		while ( !m_bShutdown )
+		{
+			if ( m_pChannel->Recv( data, CHANNEL_RECV_TIMEOUT ) )
+			{
+				CTCPPacket *pPacket = (CTCPPacket*)malloc( sizeof( CTCPPacket ) - 1 + data.Count() );
+				pPacket->m_UserData = 0;
+				pPacket->m_Len = data.Count();
+				memcpy( pPacket->m_Data, data.Base(), data.Count() );
+
+				// The handler frees it.
+				m_pHandler->OnPacketReceived( pPacket );
+			}
+			else if ( !m_pChannel->IsConnected() )
+			{
+				CUtlVector<char> reason;
+				m_pChannel->GetDisconnectReason( reason );
+				if ( reason.Count() == 0 )
+					reason.CopyArray( "", 1 );
+
+				m_bError = true;
+				m_pHandler->OnError( ITCPSocketHandler::SocketError, reason.Base() );
+				break;
+			}
+		}
+
+		return 0;
+	}
+
+
+private:
+
+	IChannel			*m_pChannel;
+	ITCPSocketHandler	*m_pHandler;
+	HANDLE				m_hRecvThread;
+	volatile bool		m_bShutdown;
+	volatile bool		m_bError;
+};
+
+
+IThreadedTCPSocket* ThreadedTCP_CreateChannelSocket( IChannel *pChannel, ITCPSocketHandler *pHandler )
+{
+	CThreadedChannelSocket *pSocket = new CThreadedChannelSocket( pChannel, pHandler );
+	if ( pSocket->Init() )
+	{
+		return pSocket;
+	}
+	else
+	{
+		pSocket->Release();
+		return NULL;
+	}
+}
@@ -0,0 +1,385 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Shared memory IChannel for VMPI workers running on the master's machine.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include <windows.h>
+#include "shm_channel.h"
+#include "threadhelpers.h"
+#include "vstdlib/strtools.h"
+#include "tier0/dbg.h"
+
+
+#define SHM_CHANNEL_VERSION		1
+#define SHM_WAIT_INTERVAL		50	// Check on the other process this often (in milliseconds) while waiting.
+
+
+// Each direction gets one of these. Only the writer moves m_WritePos and only the reader
+// moves m_ReadPos. They count total bytes so (m_WritePos - m_ReadPos) is the number of bytes
+// waiting, even after they wrap around.
+typedef struct
+{
+	volatile unsigned long	m_WritePos;
+	volatile unsigned long	m_ReadPos;
+	volatile long			m_bClosed;	// The writer sets this when it releases the channel.
+} ShmRing_t;
+
+
+// This sits at the start of the shared memory section. The ring data follows it.
+typedef struct
+{
+	int			m_Version;
+	int			m_RingSize;
+	ShmRing_t	m_Rings[2];	// The master writes into ring 0 and the worker writes into ring 1.
+} ShmChannelHeader_t;
+
+
+// -------------------------------------------------------------------------------- //
+// CSharedMemoryChannel.
+// -------------------------------------------------------------------------------- //
+
+class CSharedMemoryChannel : public IChannel
+{
+public:
+
+	CSharedMemoryChannel()
+	{
+		m_hMapping = NULL;
+		m_pHeader = NULL;
+		m_pSendRing = m_pRecvRing = NULL;
+		m_pSendData = m_pRecvData = NULL;
+		m_RingSize = 0;
+		m_hSendDataEvent = m_hSendSpaceEvent = NULL;
+		m_hRecvDataEvent = m_hRecvSpaceEvent = NULL;
+		m_hPeerProcess = NULL;
+		m_bConnected = true;
+	}
+
+	virtual ~CSharedMemoryChannel()
+	{
+		Term();
+	}
+
+	bool Init( const char *pName, bool bCreate, void *hPeerProcess, int nBufferSize )
+	{
+		if ( bCreate )
+		{
+			DWORD totalSize = sizeof( ShmChannelHeader_t ) + nBufferSize * 2;
+			m_hMapping = CreateFileMapping( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, totalSize, pName );
+			if ( !m_hMapping || GetLastError() == ERROR_ALREADY_EXISTS )
+				return false;
+		}
+		else
+		{
+			m_hMapping = OpenFileMapping( FILE_MAP_ALL_ACCESS, FALSE, pName );
+			if ( !m_hMapping )
+				return false;
+		}
+
+		m_pHeader = (ShmChannelHeader_t*)MapViewOfFile( m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+		if ( !m_pHeader )
+			return false;
+
+		// The pagefile-backed section starts out zeroed.
+		if ( bCreate )
+		{
+			m_pHeader->m_RingSize = nBufferSize;
+			m_pHeader->m_Version = SHM_CHANNEL_VERSION;
+		}
+		else if ( m_pHeader->m_Version != SHM_CHANNEL_VERSION )
+		{
+			return false;
+		}
+
+		m_RingSize = m_pHeader->m_RingSize;
+
+		int iSend = bCreate ? 0 : 1;
+		int iRecv = !iSend;
+		unsigned char *pRingData = (unsigned char*)( m_pHeader + 1 );
+
+		m_pSendRing = &m_pHeader->m_Rings[iSend];
+		m_pRecvRing = &m_pHeader->m_Rings[iRecv];
+		m_pSendData = pRingData + iSend * m_RingSize;
+		m_pRecvData = pRingData + iRecv * m_RingSize;
+
+		// CreateEvent opens the event if the other side already made it.
+		m_hSendDataEvent = CreateRingEvent( pName, "data", iSend );
+		m_hSendSpaceEvent = CreateRingEvent( pName, "space", iSend );
+		m_hRecvDataEvent = CreateRingEvent( pName, "data", iRecv );
+		m_hRecvSpaceEvent = CreateRingEvent( pName, "space", iRecv );
+
+		if ( !m_hSendDataEvent || !m_hSendSpaceEvent || !m_hRecvDataEvent || !m_hRecvSpaceEvent )
+			return false;
+
+		// Only take the process handle once nothing else can fail.
+		m_hPeerProcess = (HANDLE)hPeerProcess;
+		return true;
+	}
+
+	void Term()
+	{
+		if ( m_pSendRing )
+		{
+			// Let the other side know we're gone.
+			InterlockedExchange( &m_pSendRing->m_bClosed, 1 );
+			if ( m_hSendDataEvent )
+				SetEvent( m_hSendDataEvent );
+
+			m_pSendRing = m_pRecvRing = NULL;
+		}
+
+		if ( m_pHeader )
+		{
+			UnmapViewOfFile( m_pHeader );
+			m_pHeader = NULL;
+		}
+
+		CloseEvent( m_hSendDataEvent );
+		CloseEvent( m_hSendSpaceEvent );
+		CloseEvent( m_hRecvDataEvent );
+		CloseEvent( m_hRecvSpaceEvent );
+
+		if ( m_hMapping )
+		{
+			CloseHandle( m_hMapping );
+			m_hMapping = NULL;
+		}
+
+		if ( m_hPeerProcess )
+		{
+			CloseHandle( m_hPeerProcess );
+			m_hPeerProcess = NULL;
+		}
+	}
+
+	virtual void		Release()
+	{
+		delete this;
+	}
+
+	virtual bool	Send( const void *pData, int len )
+	{
+		const void *pChunks[1] = { pData };
+		int chunkLengths[1] = { len };
+		return SendChunks( pChunks, chunkLengths, 1 );
+	}
+
+	virtual bool	SendChunks( void const * const *pChunks, const int *pChunkLengths, int nChunks )
+	{
+		// Several threads can send at once, but the messages can't get interleaved.
+		CCriticalSectionLock csLock( &m_SendCS );
+		csLock.Lock();
+
+		int i;
+		int totalLength = 0;
+		for ( i=0; i < nChunks; i++ )
+			totalLength += pChunkLengths[i];
+
+		if ( !WriteBytes( &totalLength, sizeof( totalLength ) ) )
+			return false;
+
+		for ( i=0; i < nChunks; i++ )
+		{
+			if ( !WriteBytes( pChunks[i], pChunkLengths[i] ) )
+				return false;
+		}
+
+		return true;
+	}
+
+	virtual bool	Recv( CUtlVector<unsigned char> &data, double flTimeout )
+	{
+		// Wait for the length of the next message.
+		DWORD startTime = GetTickCount();
+		DWORD timeout = (DWORD)( flTimeout * 1000 );
+		int len;
+		while ( RecvBytesWaiting() < sizeof( len ) )
+		{
+			if ( !CheckPeer() )
+				return false;
+
+			DWORD delta = GetTickCount() - startTime;
+			if ( delta >= timeout )
+				return false;
+
+			WaitForSingleObject( m_hRecvDataEvent, min( timeout - delta, SHM_WAIT_INTERVAL ) );
+		}
+
+		// Once the length is there, the rest of the message is on its way.
+		if ( !ReadBytes( &len, sizeof( len ) ) )
+			return false;
+
+		data.SetSize( len );
+		return ReadBytes( data.Base(), len );
+	}
+
+	virtual bool	IsConnected()
+	{
+		return CheckPeer();
+	}
+
+	virtual void	GetDisconnectReason( CUtlVector<char> &reason )
+	{
+		reason.CopyArray( m_DisconnectReason.Base(), m_DisconnectReason.Count() );
+	}
+
+
+private:
+
+	HANDLE CreateRingEvent( const char *pName, const char *pType, int iRing )
+	{
+		char eventName[256];
+		Q_snprintf( eventName, sizeof( eventName ), "%s_%s%d", pName, pType, iRing );
+		return CreateEvent( NULL, FALSE, FALSE, eventName );
+	}
+
+	void CloseEvent( HANDLE &hEvent )
+	{
+		if ( hEvent )
+		{
+			CloseHandle( hEvent );
+			hEvent = NULL;
+		}
+	}
+
+	unsigned long RecvBytesWaiting() const
+	{
+		return m_pRecvRing->m_WritePos - m_pRecvRing->m_ReadPos;
+	}
+
+	void Disconnect( const char *pReason )
+	{
+		if ( m_bConnected )
+		{
+			m_bConnected = false;
+			m_DisconnectReason.CopyArray( pReason, strlen( pReason ) + 1 );
+		}
+	}
+
+	// Returns false if the other side is gone. Anything it sent before it went away
+	// still gets read out first.
+	bool CheckPeer()
+	{
+		if ( !m_bConnected )
+			return false;
+
+		if ( RecvBytesWaiting() == 0 )
+		{
+			if ( m_pRecvRing->m_bClosed )
+				Disconnect( "Shared memory channel closed by the other process." );
+			else if ( m_hPeerProcess && WaitForSingleObject( m_hPeerProcess, 0 ) == WAIT_OBJECT_0 )
+				Disconnect( "Process on the other end of the shared memory channel exited." );
+		}
+
+		return m_bConnected;
+	}
+
+	bool WriteBytes( const void *pData, int len )
+	{
+		const unsigned char *pIn = (const unsigned char*)pData;
+		while ( len > 0 )
+		{
+			if ( !m_bConnected )
+				return false;
+
+			unsigned long writePos = m_pSendRing->m_WritePos;
+			int space = m_RingSize - (int)( writePos - m_pSendRing->m_ReadPos );
+			if ( space == 0 )
+			{
+				// Wait for the reader to make room.
+				if ( m_pRecvRing->m_bClosed || (m_hPeerProcess && WaitForSingleObject( m_hPeerProcess, 0 ) == WAIT_OBJECT_0) )
+				{
+					Disconnect( "Process on the other end of the shared memory channel went away while sending." );
+					return false;
+				}
+
+				WaitForSingleObject( m_hSendSpaceEvent, SHM_WAIT_INTERVAL );
+				continue;
+			}
+
+			int offset = (int)( writePos % m_RingSize );
+			int nBytes = min( len, min( space, m_RingSize - offset ) );
+			memcpy( &m_pSendData[offset], pIn, nBytes );
+
+			// The interlocked write makes sure the data is there before the reader sees the new position.
+			InterlockedExchange( (volatile long*)&m_pSendRing->m_WritePos, (long)( writePos + nBytes ) );
+			SetEvent( m_hSendDataEvent );
+
+			pIn += nBytes;
+			len -= nBytes;
+		}
+
+		return true;
+	}
+
+	bool ReadBytes( void *pData, int len )
+	{
+		unsigned char *pOut = (unsigned char*)pData;
+		while ( len > 0 )
+		{
+			unsigned long readPos = m_pRecvRing->m_ReadPos;
+			int nWaiting = (int)( m_pRecvRing->m_WritePos - readPos );
+			if ( nWaiting == 0 )
+			{
+				if ( !CheckPeer() )
+					return false;
+
+				WaitForSingleObject( m_hRecvDataEvent, SHM_WAIT_INTERVAL );
+				continue;
+			}
+
+			int offset = (int)( readPos % m_RingSize );
+			int nBytes = min( len, min( nWaiting, m_RingSize - offset ) );
+			memcpy( pOut, &m_pRecvData[offset], nBytes );
+
+			InterlockedExchange( (volatile long*)&m_pRecvRing->m_ReadPos, (long)( readPos + nBytes ) );
+			SetEvent( m_hRecvSpaceEvent );
+
+			pOut += nBytes;
+			len -= nBytes;
+		}
+
+		return true;
+	}
+
+
+private:
+
+	HANDLE				m_hMapping;
+	ShmChannelHeader_t	*m_pHeader;
+	int					m_RingSize;
+
+	ShmRing_t			*m_pSendRing;
+	ShmRing_t			*m_pRecvRing;
+	unsigned char		*m_pSendData;
+	unsigned char		*m_pRecvData;
+
+	HANDLE				m_hSendDataEvent;	// We set this when we write.
+	HANDLE				m_hSendSpaceEvent;	// The other side sets this when it reads what we wrote.
+	HANDLE				m_hRecvDataEvent;
+	HANDLE				m_hRecvSpaceEvent;
+
+	HANDLE				m_hPeerProcess;
+
+	CCriticalSection	m_SendCS;
+	volatile bool		m_bConnected;
+	CUtlVector<char>	m_DisconnectReason;
+};
+
+
+IChannel* CreateSharedMemoryChannel( const char *pName, bool bCreate, void *hPeerProcess, int nBufferSize )
+{
+	CSharedMemoryChannel *pChannel = new CSharedMemoryChannel;
+	if ( pChannel->Init( pName, bCreate, hPeerProcess, nBufferSize ) )
+	{
+		return pChannel;
+	}
+	else
+	{
+		Warning( "CreateSharedMemoryChannel( %s ) failed.\n", pName );
+		pChannel->Release();
+		return NULL;
+	}
+}
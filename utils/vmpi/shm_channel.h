@@ -0,0 +1,37 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: IChannel that talks to another process on the same machine through
+//			a pair of ring buffers in a named shared memory section.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+#include "ichannel.h"
+
+
+#define SHM_CHANNEL_DEFAULT_SIZE	(1024*1024*4)	// Bytes in each direction.
+
+
+// The master creates the channel (bCreate = true) before the worker process runs,
+// and the worker opens it by name (bCreate = false). nBufferSize is ignored when opening.
+//
+// hPeerProcess is a process handle for the other side. If it's non-NULL, the channel
+// disconnects when that process goes away, and the channel closes the handle when it's released.
+//
+// Returns NULL if the shared memory or its events can't be created. In that case, the
+// caller still owns hPeerProcess.
+IChannel* CreateSharedMemoryChannel(
+	const char *pName,
+	bool bCreate,
+	void *hPeerProcess,
+	int nBufferSize = SHM_CHANNEL_DEFAULT_SIZE );
+
+
+#endif // SHM_CHANNEL_H
@@ -0,0 +1,420 @@
+// shm_channel_test.cpp : Loopback test for the shared memory IChannel.
+//
+// The master starts a copy of itself as a worker, then sends it random packets through
+// a CreateSharedMemoryChannel channel. The worker echoes each one back and the master
+// checks that it got the same bytes. The ring is kept small so packets wrap around it
+// and are bigger than it. After that, it checks that both ways of losing the worker
+// (releasing the channel, and the process exiting) show up as a disconnect.
+//
+// Last, it starts workers with the command line -mpi_Local gives them and has them
+// parse it the way vrad and vvis do, which wants the bsp file as the last argument.
+//
+// Usage: shm_channel_test [number of packets]
+// Returns 0 if everything passed.
+
+#include "stdafx.h"
+#include "shm_channel.h"
+#include "vmpi.h"
+#include "threadhelpers.h"
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "vstdlib/random.h"
+#include "vstdlib/strtools.h"
+
+
+#define TEST_RING_SIZE			(1024*64)
+#define TEST_MAX_PACKET_SIZE	(TEST_RING_SIZE*3)
+#define TEST_RECV_TIMEOUT		10		// Seconds to wait for the worker before giving up.
+
+
+// What the worker does once it's connected.
+enum
+{
+	WORKER_ECHO=0,	// Echo packets until it gets an empty one, then release the channel.
+	WORKER_EXIT		// Exit right away without releasing the channel.
+};
+
+
+CCriticalSection g_MsgCS;
+
+
+SpewRetval_t MySpewFunc( SpewType_t type, char const *pMsg )
+{
+	CCriticalSectionLock csLock( &g_MsgCS );
+	csLock.Lock();
+
+		printf( "%s", pMsg );
+		OutputDebugString( pMsg );
+
+	csLock.Unlock();
+
+	if( type == SPEW_ASSERT )
+		return SPEW_DEBUGGER;
+	else if( type == SPEW_ERROR )
+		return SPEW_ABORT;
+	else
+		return SPEW_CONTINUE;
+}
+
+
+void GetTestChannelName( char *pOut, int outLen, unsigned long masterProcessID, int mode )
+{
+	Q_snprintf( pOut, outLen, "shm_channel_test_%lu_%d", masterProcessID, mode );
+}
+
+
+// -------------------------------------------------------------------------------- //
+// Worker side.
+// -------------------------------------------------------------------------------- //
+
+int RunWorker( unsigned long masterProcessID, int mode )
+{
+	HANDLE hMaster = OpenProcess( SYNCHRONIZE, FALSE, masterProcessID );
+	if ( !hMaster )
+		return 1;
+
+	char channelName[128];
+	GetTestChannelName( channelName, sizeof( channelName ), masterProcessID, mode );
+	IChannel *pChannel = CreateSharedMemoryChannel( channelName, false, hMaster );
+	if ( !pChannel )
+	{
+		CloseHandle( hMaster );
+		return 1;
+	}
+
+	if ( mode == WORKER_EXIT )
+	{
+		// Let the master know we're connected, then go away without telling the channel.
+		char c = 0;
+		pChannel->Send( &c, 1 );
+		ExitProcess( 0 );
+	}
+
+	CUtlVector<unsigned char> data;
+	while ( 1 )
+	{
+		if ( !pChannel->Recv( data, TEST_RECV_TIMEOUT ) )
+		{
+			pChannel->Release();
+			return 1;
+		}
+
+		if ( data.Count() == 0 )
+			break;
+
+		if ( !pChannel->Send( data.Base(), data.Count() ) )
+		{
+			pChannel->Release();
+			return 1;
+		}
+	}
+
+	pChannel->Release();
+	return 0;
+}
+
+
+// Parses the arguments like RunVRAD and RunVVis do. Returns 0 if it ends on the bsp file.
+int RunCommandLineWorker( int argc, char **argv )
+{
+	int i;
+	for ( i=1; i < argc; i++ )
+	{
+		if ( stricmp( argv[i], "-bounce" ) == 0 )
+		{
+			if ( ++i >= argc )
+				return 1;
+		}
+		else if ( stricmp( argv[i], "-fast" ) == 0 )
+		{
+		}
+		else if ( !Q_strncasecmp( argv[i], "-mpi", 4 ) || !Q_strncasecmp( argv[i-1], "-mpi", 4 ) )
+		{
+			// Any other args that start with -mpi are ok too.
+			if ( i == argc - 1 )
+				break;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// The tools would print their usage here.
+	if ( i != argc - 1 || !Q_stristr( argv[i], ".bsp" ) )
+		return 1;
+
+	unsigned long masterProcessID;
+	int iWorker;
+	if ( sscanf( VMPI_FindArg( argc, argv, "-mpi_LocalWorker", "" ), "%lu:%d", &masterProcessID, &iWorker ) != 2 )
+		return 1;
+
+	// The master's -mpi_Local would start more workers.
+	if ( VMPI_FindArg( argc, argv, "-mpi_Local", NULL ) )
+		return 1;
+
+	return 0;
+}
+
+
+// -------------------------------------------------------------------------------- //
+// Master side.
+// -------------------------------------------------------------------------------- //
+
+// Starts a worker in the given mode and returns the channel to it.
+IChannel* StartWorker( int mode, HANDLE *phProcess )
+{
+	unsigned long masterProcessID = GetCurrentProcessId();
+
+	char exeFilename[MAX_PATH];
+	if ( !GetModuleFileName( GetModuleHandle( NULL ), exeFilename, sizeof( exeFilename ) ) )
+		Error( "GetModuleFileName failed." );
+
+	char cmdLine[1024];
+	Q_snprintf( cmdLine, sizeof( cmdLine ), "\"%s\" -worker %lu %d", exeFilename, masterProcessID, mode );
+
+	STARTUPINFO si;
+	memset( &si, 0, sizeof( si ) );
+	si.cb = sizeof( si );
+
+	PROCESS_INFORMATION pi;
+	memset( &pi, 0, sizeof( pi ) );
+
+	// Same as VMPI: the channel has to exist before the worker runs.
+	if ( !CreateProcess( exeFilename, cmdLine, NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL, &si, &pi ) )
+		Error( "CreateProcess( %s ) failed.\n", exeFilename );
+
+	// The channel closes its copy of the process handle, so keep one for ourselves.
+	HANDLE hChannelProcess;
+	DuplicateHandle( GetCurrentProcess(), pi.hProcess, GetCurrentProcess(), &hChannelProcess, 0, FALSE, DUPLICATE_SAME_ACCESS );
+
+	char channelName[128];
+	GetTestChannelName( channelName, sizeof( channelName ), masterProcessID, mode );
+	IChannel *pChannel = CreateSharedMemoryChannel( channelName, true, hChannelProcess, TEST_RING_SIZE );
+	if ( !pChannel )
+		Error( "CreateSharedMemoryChannel( %s ) failed.\n", channelName );
+
+	ResumeThread( pi.hThread );
+	CloseHandle( pi.hThread );
+
+	*phProcess = pi.hProcess;
+	return pChannel;
+}
+
+
+bool WaitForDisconnect( IChannel *pChannel, const char *pTestName )
+{
+	CUtlVector<unsigned char> data;
+	if ( pChannel->Recv( data, TEST_RECV_TIMEOUT ) )
+	{
+		Msg( "%s: got a packet after the worker went away.\n", pTestName );
+		return false;
+	}
+
+	if ( pChannel->IsConnected() )
+	{
+		Msg( "%s: channel still connected after the worker went away.\n", pTestName );
+		return false;
+	}
+
+	CUtlVector<char> reason;
+	pChannel->GetDisconnectReason( reason );
+	Msg( "%s: disconnected (%s)\n", pTestName, reason.Count() ? reason.Base() : "no reason" );
+	return true;
+}
+
+
+bool TestEcho( int nPackets )
+{
+	HANDLE hProcess;
+	IChannel *pChannel = StartWorker( WORKER_ECHO, &hProcess );
+
+	CCycleCount cnt;
+	cnt.Sample();
+	CUniformRandomStream randomStream;
+	randomStream.SetSeed( cnt.GetMicroseconds() );
+
+	CUtlVector<unsigned char> sendBuf, recvBuf;
+	sendBuf.SetSize( TEST_MAX_PACKET_SIZE );
+
+	bool bPassed = true;
+	__int64 totalBytes = 0;
+	CCycleCount startTime;
+	startTime.Sample();
+
+	for ( int iPacket=0; iPacket < nPackets; iPacket++ )
+	{
+		int size = randomStream.RandomInt( 1, TEST_MAX_PACKET_SIZE );
+		for ( int i=0; i < size; i++ )
+			sendBuf[i] = (unsigned char)randomStream.RandomInt( 0, 255 );
+
+		// Use SendChunks for every other packet so both paths get covered.
+		bool bSent;
+		if ( iPacket & 1 )
+		{
+			int split = randomStream.RandomInt( 0, size );
+			const void *pChunks[2] = { sendBuf.Base(), sendBuf.Base() + split };
+			int chunkLengths[2] = { split, size - split };
+			bSent = pChannel->SendChunks( pChunks, chunkLengths, 2 );
+		}
+		else
+		{
+			bSent = pChannel->Send( sendBuf.Base(), size );
+		}
+
+		if ( !bSent )
+		{
+			Msg( "echo: Send failed on packet %d.\n", iPacket );
+			bPassed = false;
+			break;
+		}
+
+		if ( !pChannel->Recv( recvBuf, TEST_RECV_TIMEOUT ) )
+		{
+			Msg( "echo: Recv failed on packet %d.\n", iPacket );
+			bPassed = false;
+			break;
+		}
+
+		if ( recvBuf.Count() != size || memcmp( recvBuf.Base(), sendBuf.Base(), size ) != 0 )
+		{
+			Msg( "echo: packet %d (%d bytes) came back as %d different bytes.\n", iPacket, size, recvBuf.Count() );
+			bPassed = false;
+			break;
+		}
+
+		totalBytes += size;
+	}
+
+	if ( bPassed )
+	{
+		CCycleCount curTime, elapsed;
+		curTime.Sample();
+		CCycleCount::Sub( curTime, startTime, elapsed );
+		Msg( "echo: %d packets, %dk round trip, %dk/sec\n", nPackets, (int)(totalBytes / 1024), (int)((totalBytes / 1024) / max( elapsed.GetSeconds(), 0.001 )) );
+
+		// An empty packet tells the worker to release its end.
+		pChannel->Send( NULL, 0 );
+		bPassed = WaitForDisconnect( pChannel, "echo" );
+	}
+
+	pChannel->Release();
+
+	if ( WaitForSingleObject( hProcess, TEST_RECV_TIMEOUT * 1000 ) != WAIT_OBJECT_0 )
+	{
+		Msg( "echo: worker didn't exit.\n" );
+		TerminateProcess( hProcess, 1 );
+		bPassed = false;
+	}
+	else
+	{
+		DWORD exitCode = 1;
+		GetExitCodeProcess( hProcess, &exitCode );
+		if ( exitCode != 0 )
+		{
+			Msg( "echo: worker failed (exit code %lu).\n", exitCode );
+			bPassed = false;
+		}
+	}
+
+	CloseHandle( hProcess );
+	return bPassed;
+}
+
+
+bool TestPeerExit()
+{
+	HANDLE hProcess;
+	IChannel *pChannel = StartWorker( WORKER_EXIT, &hProcess );
+
+	// The worker sends one byte before it exits, and that still has to come through.
+	bool bPassed = true;
+	CUtlVector<unsigned char> data;
+	if ( !pChannel->Recv( data, TEST_RECV_TIMEOUT ) || data.Count() != 1 )
+	{
+		Msg( "exit: didn't get the worker's packet.\n" );
+		bPassed = false;
+	}
+	else
+	{
+		bPassed = WaitForDisconnect( pChannel, "exit" );
+	}
+
+	pChannel->Release();
+	WaitForSingleObject( hProcess, TEST_RECV_TIMEOUT * 1000 );
+	CloseHandle( hProcess );
+	return bPassed;
+}
+
+
+bool TestWorkerCommandLine( int argc, char **argv, const char *pTestName )
+{
+	char exeFilename[MAX_PATH];
+	if ( !GetModuleFileName( GetModuleHandle( NULL ), exeFilename, sizeof( exeFilename ) ) )
+		Error( "GetModuleFileName failed." );
+
+	char cmdLine[4096];
+	VMPI_GetLocalWorkerCommandLine( exeFilename, argc, argv, GetCurrentProcessId(), 1, cmdLine, sizeof( cmdLine ) );
+
+	STARTUPINFO si;
+	memset( &si, 0, sizeof( si ) );
+	si.cb = sizeof( si );
+
+	PROCESS_INFORMATION pi;
+	memset( &pi, 0, sizeof( pi ) );
+
+	if ( !CreateProcess( exeFilename, cmdLine, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi ) )
+		Error( "CreateProcess( %s ) failed.\n", exeFilename );
+	CloseHandle( pi.hThread );
+
+	DWORD exitCode = 1;
+	if ( WaitForSingleObject( pi.hProcess, TEST_RECV_TIMEOUT * 1000 ) != WAIT_OBJECT_0 )
+		TerminateProcess( pi.hProcess, 1 );
+	else
+		GetExitCodeProcess( pi.hProcess, &exitCode );
+	CloseHandle( pi.hProcess );
+
+	if ( exitCode != 0 )
+	{
+		Msg( "%s: the worker couldn't parse %s\n", pTestName, cmdLine );
+		return false;
+	}
+	return true;
+}
+
+
+bool TestWorkerCommandLines()
+{
+	// How vrad and vvis get run with -mpi_Local, with and without a worker count.
+	char *vradArgs[] = { "vrad.exe", "-mpi", "-mpi_Local", "2", "-bounce", "8", "-fast", "c:\\maps\\test map.bsp" };
+	char *vvisArgs[] = { "vvis.exe", "-fast", "-mpi", "-mpi_Local", "2fort.bsp" };
+
+	bool bPassed = TestWorkerCommandLine( ARRAYSIZE( vradArgs ), vradArgs, "cmdline" );
+	bPassed = TestWorkerCommandLine( ARRAYSIZE( vvisArgs ), vvisArgs, "cmdline" ) && bPassed;
+	return bPassed;
+}
+
+
+int main(int argc, char* argv[])
+{
+	SpewOutputFunc( MySpewFunc );
+
+	if ( argc == 4 && stricmp( argv[1], "-worker" ) == 0 )
+		return RunWorker( strtoul( argv[2], NULL, 10 ), atoi( argv[3] ) );
+
+	if ( VMPI_FindArg( argc, argv, "-mpi_LocalWorker", NULL ) )
+		return RunCommandLineWorker( argc, argv );
+
+	int nPackets = 500;
+	if ( argc >= 2 )
+		nPackets = max( atoi( argv[1] ), 1 );
+
+	bool bEcho = TestEcho( nPackets );
+	bool bExit = TestPeerExit();
+	bool bCmdLine = TestWorkerCommandLines();
+
+	Msg( "echo: %s\n", bEcho ? "passed" : "FAILED" );
+	Msg( "exit: %s\n", bExit ? "passed" : "FAILED" );
+	Msg( "cmdline: %s\n", bCmdLine ? "passed" : "FAILED" );
+	return (bEcho && bExit && bCmdLine) ? 0 : 1;
+}
@@ -22,6 +22,7 @@
 #include "vmpi_distribute_work.h"
 #include "filesystem.h"
 #include "checksum_md5.h"
+#include "shm_channel.h"
 
 
 #define DEFAULT_MAX_WORKERS	32	// Unless they specify -mpi_MaxWorkers, it will stop accepting workers after it gets this many.
@@ -76,6 +77,9 @@ bool g_bMPI_NoStats = false;
 
 bool g_bMPIAllowDropIn = false;
 
+bool g_bMPILocal = false;
+char g_LocalSessionName[64] = "";
+
 
 // ---------------------------------------------------------------------------------------- //
 // Classes.
@@ -966,6 +970,189 @@ bool InitMaster( int argc, char **argv, const char *pDependencyFilename )
 }
 
 
+// ---------------------------------------------------------------------------------------- //
+// Local sessions (-mpi_Local). The master starts the workers itself on this machine and
+// talks to them through shared memory channels instead of TCP, so there's no vmpi_service,
+// broadcasting, or dependency directory involved.
+// ---------------------------------------------------------------------------------------- //
+
+static void GetLocalChannelName( char *pOut, int outLen, unsigned long masterProcessID, int iWorker )
+{
+	Q_snprintf( pOut, outLen, "VMPI_%lu_%d", masterProcessID, iWorker );
+}
+
+
+static void AppendCommandLineArg( char *pCmdLine, int maxLen, const char *pArg )
+{
+	Q_strncat( pCmdLine, " ", maxLen );
+	if ( strchr( pArg, ' ' ) )
+	{
+		Q_strncat( pCmdLine, "\"", maxLen );
+		Q_strncat( pCmdLine, pArg, maxLen );
+		Q_strncat( pCmdLine, "\"", maxLen );
+	}
+	else
+	{
+		Q_strncat( pCmdLine, pArg, maxLen );
+	}
+}
+
+
+void VMPI_GetLocalWorkerCommandLine( const char *pExeFilename, int argc, char **argv, unsigned long masterProcessID, int iWorker, char *pCmdLine, int maxLen )
+{
+	// The tools want the bsp file last, so the channel to connect to goes right after
+	// the exe name, the same place vmpi_service puts -mpi_worker.
+	char workerArg[64];
+	Q_snprintf( workerArg, sizeof( workerArg ), "%lu:%d", masterProcessID, iWorker );
+	Q_snprintf( pCmdLine, maxLen, "\"%s\"", pExeFilename );
+	AppendCommandLineArg( pCmdLine, maxLen, "-mpi_LocalWorker" );
+	AppendCommandLineArg( pCmdLine, maxLen, workerArg );
+
+	// Then the rest of ours, minus -mpi_Local and its worker count.
+	for ( int i=1; i < argc; i++ )
+	{
+		if ( stricmp( argv[i], "-mpi_Local" ) == 0 )
+		{
+			if ( (i+2) < argc && isdigit( argv[i+1][0] ) )
+				++i;
+			continue;
+		}
+		AppendCommandLineArg( pCmdLine, maxLen, argv[i] );
+	}
+}
+
+
+static bool StartLocalWorker( int argc, char **argv, int iWorker )
+{
+	unsigned long masterProcessID = GetCurrentProcessId();
+
+	char exeFilename[MAX_PATH];
+	if ( !GetModuleFileName( GetModuleHandle( NULL ), exeFilename, sizeof( exeFilename ) ) )
+		Error( "GetModuleFileName failed." );
+
+	char cmdLine[4096];
+	VMPI_GetLocalWorkerCommandLine( exeFilename, argc, argv, masterProcessID, iWorker, cmdLine, sizeof( cmdLine ) );
+
+	// The channel has to exist before the worker tries to open it.
+	char channelName[128];
+	GetLocalChannelName( channelName, sizeof( channelName ), masterProcessID, iWorker );
+	
+	STARTUPINFO si;
+	memset( &si, 0, sizeof( si ) );
+	si.cb = sizeof( si );
+
+	PROCESS_INFORMATION pi;
+	memset( &pi, 0, sizeof( pi ) );
+
+	// Start it suspended so the channel can own the process handle before the worker runs.
+	DWORD dwFlags = CREATE_SUSPENDED | (g_iVMPIVerboseLevel >= 1 ? CREATE_NEW_CONSOLE : CREATE_NO_WINDOW);
+	if ( !CreateProcess( exeFilename, cmdLine, NULL, NULL, FALSE, dwFlags, NULL, NULL, &si, &pi ) )
+	{
+		Warning( "CreateProcess( %s ) failed for local worker %d.\n", exeFilename, iWorker );
+		return false;
+	}
+
+	IChannel *pChannel = CreateSharedMemoryChannel( channelName, true, pi.hProcess );
+	if ( !pChannel )
+	{
+		TerminateProcess( pi.hProcess, 1 );
+		CloseHandle( pi.hProcess );
+		CloseHandle( pi.hThread );
+		return false;
+	}
+
+	CVMPIConnectionCreator connectionCreator;
+	ITCPSocketHandler *pHandler = connectionCreator.CreateNewHandler();
+	if ( !ThreadedTCP_CreateChannelSocket( pChannel, pHandler ) )
+		Error( "ThreadedTCP_CreateChannelSocket failed for local worker %d.", iWorker );
+
+	ResumeThread( pi.hThread );
+	CloseHandle( pi.hThread );
+	return true;
+}
+
+
+bool InitMasterLocal( int argc, char **argv )
+{
+	g_bMPIMaster = true;
+	g_bMPILocal = true;
+
+	ParseOptions( argc, argv );
+
+	// Default to a worker for each processor but the one the master is on.
+	int nWorkers = atoi( VMPI_FindArg( argc, argv, "-mpi_Local", "" ) );
+	if ( nWorkers <= 0 )
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		nWorkers = max( (int)info.dwNumberOfProcessors - 1, 1 );
+	}
+	nWorkers = clamp( nWorkers, 1, MAX_VMPI_CONNECTIONS - 1 );
+
+	Q_snprintf( g_LocalSessionName, sizeof( g_LocalSessionName ), "VMPI_%lu", GetCurrentProcessId() );
+
+	// Add ourselves as the first process (rank 0).
+	CVMPIConnectionCreator connectionCreator;
+	connectionCreator.CreateNewHandler();
+
+	Msg( "Starting %d local workers... ", nWorkers );
+	for ( int iWorker=1; iWorker <= nWorkers; iWorker++ )
+	{
+		if ( StartLocalWorker( argc, argv, iWorker ) )
+			Msg( "%d.. ", g_nConnections-1 );
+	}
+	Msg( "\n" );
+
+	return g_nConnections > 1;
+}
+
+
+bool MPI_Init_LocalWorker( int argc, char **argv, const char *pWorkerArg )
+{
+	g_bMPIMaster = false;
+	g_bMPILocal = true;
+
+	ParseOptions( argc, argv );
+
+	unsigned long masterProcessID = 0;
+	int iWorker = 0;
+	if ( sscanf( pWorkerArg, "%lu:%d", &masterProcessID, &iWorker ) != 2 )
+		Error( "Invalid -mpi_LocalWorker argument: %s", pWorkerArg );
+
+	Q_snprintf( g_LocalSessionName, sizeof( g_LocalSessionName ), "VMPI_%lu", masterProcessID );
+
+	// Watch the master so we quit if it dies.
+	HANDLE hMaster = OpenProcess( SYNCHRONIZE, FALSE, masterProcessID );
+	if ( !hMaster )
+		return false;
+
+	char channelName[128];
+	GetLocalChannelName( channelName, sizeof( channelName ), masterProcessID, iWorker );
+	IChannel *pChannel = CreateSharedMemoryChannel( channelName, false, hMaster );
+	if ( !pChannel )
+	{
+		CloseHandle( hMaster );
+		return false;
+	}
+
+	// The master is connection 0.
+	CVMPIConnectionCreator connectionCreator;
+	return ThreadedTCP_CreateChannelSocket( pChannel, connectionCreator.CreateNewHandler() ) != NULL;
+}
+
+
+bool VMPI_IsLocalSession()
+{
+	return g_bMPILocal;
+}
+
+
+const char* VMPI_GetLocalSessionName()
+{
+	return g_LocalSessionName;
+}
+
+
 bool VMPI_Init( int argc, char **argv, const char *pDependencyFilename )
 {
 	// Init event objects.
@@ -985,6 +1172,14 @@ bool VMPI_Init( int argc, char **argv, const char *pDependencyFilename )
 	#endif
 
 
+	// Were we started by a master on this machine?
+	const char *pLocalWorker = VMPI_FindArg( argc, argv, "-mpi_LocalWorker", NULL );
+	if ( pLocalWorker )
+		return MPI_Init_LocalWorker( argc, argv, pLocalWorker );
+
+	if ( VMPI_FindArg( argc, argv, "-mpi_Local", NULL ) )
+		return InitMasterLocal( argc, argv );
+
 	// Were we launched by the vmpi service as a worker?
 	bool bWorker = false;
 	int ip[4], port = 0;
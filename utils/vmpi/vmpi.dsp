@@ -123,6 +123,14 @@ SOURCE=.\messbuf.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\shm_channel.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ThreadedChannelSocket.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ThreadedTCPSocket.cpp
 # End Source File
 # Begin Source File
@@ -171,6 +179,10 @@ SOURCE=.\messbuf.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\shm_channel.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\tcpsocket.h
 # End Source File
 # Begin Source File
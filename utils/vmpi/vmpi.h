@@ -50,6 +50,7 @@ extern bool	g_bUseMPI;
 extern bool g_bMPIMaster;	// Set to true if we're the master in a VMPI session.
 extern int g_iVMPIVerboseLevel; // Higher numbers make it spit out more data.
 extern bool g_bMPI_NoStats;
+extern bool g_bMPILocal;	// Set to true if the workers are processes on the master's machine (-mpi_Local).
 
 // These can be watched or modified to check bandwidth statistics.
 extern int g_nBytesSent;
@@ -71,6 +72,16 @@ void VMPI_Finalize();
 // Note: this number can change on the master.
 int VMPI_GetCurrentNumberOfConnections();
 
+// In a local session (-mpi_Local [worker count]), the master starts the workers on its own machine and
+// they talk through shared memory. The session name is the same in the master and all its workers
+// and can be used to name other shared objects.
+bool VMPI_IsLocalSession();
+const char* VMPI_GetLocalSessionName();
+
+// Builds the command line the master runs a local worker with: the exe, -mpi_LocalWorker and
+// its channel, then the master's own arguments without -mpi_Local, so the bsp file stays last.
+void VMPI_GetLocalWorkerCommandLine( const char *pExeFilename, int argc, char **argv, unsigned long masterProcessID, int iWorker, char *pCmdLine, int maxLen );
+
 
 // Dispatch messages until it gets one with the specified packet ID.
 // If subPacketID is not set to -1, then the second byte must match that as well.
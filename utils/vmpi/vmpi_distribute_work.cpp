@@ -32,12 +32,24 @@ typedef unsigned short WUIndexType;
 #define DW_SUBPACKETID_MASTER_FINISHED	2
 #define DW_SUBPACKETID_WU_RESULTS		4
 #define DW_SUBPACKETID_WU_ASSIGNMENT	5
+#define DW_SUBPACKETID_WUS_COMPLETED	6
 
 // The master sends a list of which work units have been completed either N times per second or
 // when a certain # of work units have been completed.
 #define COMPLETED_WU_BATCH_SIZE	128
 #define COMPLETED_WU_INTERVAL	200 // Send WU list out 5x / second.
 
+// Work units are handed out in batches that should take a worker about this long (in seconds).
+// Until a worker has finished DW_MIN_WUS_FOR_RATE work units, we don't know how fast it is,
+// so it gets DW_FIRST_BATCH_SIZE.
+#define DW_BATCH_TARGET_TIME	4.0
+#define DW_MIN_WUS_FOR_RATE		4
+#define DW_FIRST_BATCH_SIZE		16
+
+// When the unassigned work units run out, idle workers take half of the largest partition. Once
+// the largest partition is this small, they run copies of its work units instead.
+#define DW_MIN_SPLIT_WUS		4
+
 
 class CWorkerInfo
 {
@@ -68,6 +80,8 @@ public:
 	int m_iWUInfo;	// Index into m_WUInfo.
 	int m_iPartition;		// Which partition it's in.
 	int m_iPartitionListIndex;	// Index into its partition's m_WUs.
+	double m_flAssignTime;	// When it was first given to a worker (-1 if it hasn't been yet).
+	bool m_bSpeculative;	// Set if a second worker was given a copy of it.
 };
 
 
@@ -75,7 +89,8 @@ class CPartitionInfo
 {
 public:
 	int m_iPartition;	// Index into m_Partitions.
-	int m_iWorker; // Who owns this partition?
+	int m_iWorker; // Who owns this partition? (-1 if nobody does).
+	int m_nRefillAt;	// Give the worker another batch when it gets down to this many WUs.
 	CUtlLinkedList<WUIndexType,int> m_WUs;	// Which WUs are in this partition?
 };
 
@@ -90,6 +105,14 @@ public:
 	CUtlLinkedList<CPartitionInfo*,int> m_Partitions;	
 	CUtlVector<CWULookupInfo> m_WULookup;		// Map work unit index to CWorkUnitInfo.
 	CUtlLinkedList<CWorkUnitInfo,int> m_WUInfo;	// Sorted with most elegible WU at the head.
+
+	CUtlVector<double> m_WorkerStartTime;	// When each worker got its first batch (0 if it hasn't yet).
+
+	// Once work units are being run speculatively, the workers are told which ones are done
+	// so the slower copy can be skipped.
+	bool m_bSpeculating;
+	CUtlVector<WUIndexType> m_CompletedWUs;
+	DWORD m_LastCompletedWUsTime;
 };
 
 
@@ -116,6 +139,11 @@ CUtlVector<int>	g_wuCountByProcess;
 
 int g_nWUs;				// How many work units there were this time around.
 int g_nDuplicatedWUs;	// How many times a worker sent results for a work unit that was already completed.
+int g_nSpeculativeWUs;	// How many work units were given to a second worker while the first still had them.
+int g_nSpeculativeWins;	// How many of those the second worker finished first.
+
+CUtlVector<float> g_WULatencies;	// Seconds from when each WU was handed out until its results came in.
+CUtlVector<float> g_WUFinishTimes;	// When each WU's results came in, relative to g_flMPIStartTime.
 
 // Set to true if Error() is called and we want to exit early. vrad and vvis check for this in their
 // thread functions, so the workers quit early when the master is done rather than finishing up
@@ -129,6 +157,60 @@ CCriticalSection g_TestCS;
 
 
 
+int SortFloats( const void *elem1, const void *elem2 )
+{
+	float a = *((const float*)elem1);
+	float b = *((const float*)elem2);
+	if ( a < b )
+		return -1;
+	else if ( a == b )
+		return 0;
+	else
+		return 1;
+}
+
+
+// Returns the value that flPercent of the (sorted) values are below.
+float GetPercentile( const CUtlVector<float> &sorted, float flPercent )
+{
+	if ( sorted.Count() == 0 )
+		return 0;
+
+	int index = (int)( sorted.Count() * flPercent / 100.0f );
+	return sorted[ clamp( index, 0, sorted.Count() - 1 ) ];
+}
+
+
+void ShowTailLatencyStats( double flTimeSpent )
+{
+	if ( g_WULatencies.Count() == 0 )
+		return;
+
+	CUtlVector<float> sorted;
+	sorted.CopyArray( g_WULatencies.Base(), g_WULatencies.Count() );
+	qsort( sorted.Base(), sorted.Count(), sizeof( float ), SortFloats );
+
+	float flTotal = 0;
+	for ( int i=0; i < sorted.Count(); i++ )
+		flTotal += sorted[i];
+
+	Msg( "WU latency (sec) : %.2f avg, %.2f 50%%, %.2f 90%%, %.2f 99%%, %.2f max\n", 
+		flTotal / sorted.Count(),
+		GetPercentile( sorted, 50 ),
+		GetPercentile( sorted, 90 ),
+		GetPercentile( sorted, 99 ),
+		sorted[sorted.Count()-1] );
+
+	// How long the stragglers held everyone up.
+	int iTailStart = (int)( g_WUFinishTimes.Count() * 0.95f );
+	iTailStart = clamp( iTailStart, 0, g_WUFinishTimes.Count() - 1 );
+	float flTailTime = g_WUFinishTimes[g_WUFinishTimes.Count()-1] - g_WUFinishTimes[iTailStart];
+	Msg( "Last 5%% of WUs   : %.2f sec (%.1f%% of total time)\n", flTailTime, flTailTime * 100.0f / flTimeSpent );
+
+	Msg( "Speculative WUs  : %d (%d finished first by the second worker)\n", g_nSpeculativeWUs, g_nSpeculativeWins );
+}
+
+
 int SortByWUCount( const void *elem1, const void *elem2 )
 {
 	int a = g_wuCountByProcess[ *((const int*)elem1) ];
@@ -163,6 +245,7 @@ void ShowMPIStats(
 		if ( g_bMPIMaster )
 		{
 			Msg( "Duplicated WUs   : %d (%.1f%%)\n", g_nDuplicatedWUs, (float)g_nDuplicatedWUs * 100.0f / g_nWUs );
+			ShowTailLatencyStats( flTimeSpent );
 
 			Msg( "WU count by proc:\n" );
 
@@ -229,6 +312,7 @@ CPartitionInfo* AddPartition( CDSInfo *pInfo, int iWorker )
 	CPartitionInfo *pNew = new CPartitionInfo;
 	pNew->m_iPartition = pInfo->m_MasterInfo.m_Partitions.AddToTail( pNew );
 	pNew->m_iWorker = iWorker;
+	pNew->m_nRefillAt = 0;
 	return pNew;
 }
 
@@ -245,6 +329,45 @@ int FindLargestPartition( CMasterInfo *pMasterInfo )
 }
 
 
+int CountUnownedWUs( CMasterInfo *pMasterInfo )
+{
+	int nWUs = 0;
+	FOR_EACH_LL( pMasterInfo->m_Partitions, i )
+	{
+		if ( pMasterInfo->m_Partitions[i]->m_iWorker == -1 )
+			nWUs += pMasterInfo->m_Partitions[i]->m_WUs.Count();
+	}
+	return nWUs;
+}
+
+
+// Figures out how many work units to give a worker at once.
+int CalcBatchSize( CDSInfo *pInfo, int iWorker )
+{
+	CMasterInfo *pMasterInfo = &pInfo->m_MasterInfo;
+
+	// Never give out more than a share of what's left so the last batches are small
+	// and everyone finishes at about the same time.
+	int nWorkers = max( VMPI_GetCurrentNumberOfConnections() - 1, 1 );
+	int nBatch = max( CountUnownedWUs( pMasterInfo ) / (nWorkers * 2), 1 );
+
+	// Size the batch by how fast this worker has been going.
+	int nDone = g_wuCountByProcess[iWorker];
+	double flElapsed = Plat_FloatTime() - pMasterInfo->m_WorkerStartTime[iWorker];
+	if ( nDone >= DW_MIN_WUS_FOR_RATE && flElapsed > 0 )
+	{
+		int nForTime = (int)( nDone * DW_BATCH_TARGET_TIME / flElapsed );
+		nBatch = min( nBatch, max( nForTime, 1 ) );
+	}
+	else
+	{
+		nBatch = min( nBatch, DW_FIRST_BATCH_SIZE );
+	}
+
+	return nBatch;
+}
+
+
 void VMPI_DistributeWork_DisconnectHandler( int procID, const char *pReason )
 {
 	if ( g_bMasterDistributingWork )
@@ -276,6 +399,9 @@ void TransferWUs( CDSInfo *pInfo, CPartitionInfo *pFrom, CPartitionInfo *pTo, in
 		pFrom->m_WUs.Remove( iHead );
 
 		pMasterInfo->m_WULookup[iWU].m_iPartition = pTo->m_iPartition;
+		if ( pTo->m_iWorker != -1 && pMasterInfo->m_WULookup[iWU].m_flAssignTime < 0 )
+			pMasterInfo->m_WULookup[iWU].m_flAssignTime = Plat_FloatTime();
+
 		if ( bReverse )
 			pMasterInfo->m_WULookup[iWU].m_iPartitionListIndex = pTo->m_WUs.AddToHead( (WUIndexType)iWU );
 		else
@@ -284,6 +410,37 @@ void TransferWUs( CDSInfo *pInfo, CPartitionInfo *pFrom, CPartitionInfo *pTo, in
 }
 
 
+// Moves the next batch of unowned work units into the worker's partition and sends it the new list.
+void TopUpPartition( CDSInfo *pInfo, CPartitionInfo *pPartition )
+{
+	CMasterInfo *pMasterInfo = &pInfo->m_MasterInfo;
+
+	int nBatch = CalcBatchSize( pInfo, pPartition->m_iWorker );
+	int nMoved = 0;
+	while ( nMoved < nBatch )
+	{
+		int iUnowned = FindPartitionByWorker( pMasterInfo, -1 );
+		if ( iUnowned == -1 )
+			break;
+
+		CPartitionInfo *pUnowned = pMasterInfo->m_Partitions[iUnowned];
+		int nWUs = min( nBatch - nMoved, pUnowned->m_WUs.Count() );
+		TransferWUs( pInfo, pUnowned, pPartition, nWUs, false );
+		nMoved += nWUs;
+
+		if ( pUnowned->m_WUs.Count() == 0 )
+		{
+			delete pUnowned;
+			pMasterInfo->m_Partitions.Remove( iUnowned );
+		}
+	}
+
+	// Ask for more a little before it runs out so its threads don't sit idle waiting on us.
+	pPartition->m_nRefillAt = nBatch / 4;
+	SendPartitionToWorker( pInfo, pPartition, pPartition->m_iWorker );
+}
+
+
 void AssignWUsToWorker( CDSInfo *pInfo, int iWorker )
 {
 	CMasterInfo *pMasterInfo = &pInfo->m_MasterInfo;
@@ -292,70 +449,116 @@ void AssignWUsToWorker( CDSInfo *pInfo, int iWorker )
 	int iPrevious = FindPartitionByWorker( pMasterInfo, iWorker );
 	if ( iPrevious != -1 )
 	{
-		delete pMasterInfo->m_Partitions[iPrevious];
-		pMasterInfo->m_Partitions.Remove( iPrevious );
+		CPartitionInfo *pPrevious = pMasterInfo->m_Partitions[iPrevious];
+		if ( pPrevious->m_WUs.Count() == 0 )
+		{
+			delete pPrevious;
+			pMasterInfo->m_Partitions.Remove( iPrevious );
+		}
+		else
+		{
+			pPrevious->m_iWorker = -1;
+		}
 	}
 
 	if ( g_iVMPIVerboseLevel >= 1 )
 		Msg( "A" );
 
-	// Any partitions yet?
-	if ( pMasterInfo->m_Partitions.Count() == 0 )
+	if ( pMasterInfo->m_WorkerStartTime[iWorker] == 0 )
+		pMasterInfo->m_WorkerStartTime[iWorker] = Plat_FloatTime();
+
+	// Hand out a batch of the unowned WUs if there are any left.
+	if ( FindPartitionByWorker( pMasterInfo, -1 ) != -1 )
+	{
+		CPartitionInfo *pPartition = AddPartition( pInfo, iWorker );
+		TopUpPartition( pInfo, pPartition );
+		return;
+	}
+
+	// Everything's been handed out. Find the largest remaining partition.
+	int iLargest = FindLargestPartition( pMasterInfo );
+	if ( iLargest == pMasterInfo->m_Partitions.InvalidIndex() )
+		return;
+
+	CPartitionInfo *pPartition = pMasterInfo->m_Partitions[iLargest];
+	if ( pPartition->m_WUs.Count() == 0 )
+		return;
+
+	int iOldWorker = pPartition->m_iWorker;
+	if ( pPartition->m_WUs.Count() > DW_MIN_SPLIT_WUS )
 	{
-		// None. Assign all of the work units to this worker.
-		CPartitionInfo *pPartition = new CPartitionInfo;
-		int iPartition = pMasterInfo->m_Partitions.AddToTail( pPartition );
+		// Split it in twain.
+		int nNew1 = max( 0, pPartition->m_WUs.Count() / 2 - 1 );
+		int nNew2 = pPartition->m_WUs.Count() - nNew1;
 
-		pPartition->m_iWorker = iWorker;
-		for ( WUIndexType i=0; i < pInfo->m_nWorkUnits; i++ )
+		// Send half to the old worker.
+		if ( nNew1 )
 		{
-			pMasterInfo->m_WULookup[i].m_iPartition = iPartition;
-			pMasterInfo->m_WULookup[i].m_iPartitionListIndex = pPartition->m_WUs.AddToTail( i );
+			CPartitionInfo *pNew1 = AddPartition( pInfo, iOldWorker );
+			TransferWUs( pInfo, pPartition, pNew1, nNew1, false );
+			SendPartitionToWorker( pInfo, pNew1, iOldWorker );
 		}
 
-		// Now send this guy the WU list in his partition.
-		SendPartitionToWorker( pInfo, pPartition, iWorker );
+		// Send half to the new worker.
+		CPartitionInfo *pNew2 = AddPartition( pInfo, iWorker );
+		TransferWUs( pInfo, pPartition, pNew2, nNew2, false );
+		SendPartitionToWorker( pInfo, pNew2, iWorker );
 	}
 	else
 	{
-		// Find an unowned partition.
-		int iUnowned = FindPartitionByWorker( pMasterInfo, -1 );
-		if ( iUnowned == -1 )
+		// These are the last few WUs and the old worker is probably in the middle of them,
+		// so taking them away wouldn't help. Have this worker run copies too, and take whichever
+		// results come back first. The old worker isn't told, so it keeps going on them.
+		if ( g_iVMPIVerboseLevel >= 1 )
+			Msg( "S" );
+
+		FOR_EACH_LL( pPartition->m_WUs, i )
 		{
-			// Find the largest remaining partition.
-			int iLargest = FindLargestPartition( pMasterInfo );
-			CPartitionInfo *pPartition = pMasterInfo->m_Partitions[iLargest];
-				
-				int iOldWorker = pPartition->m_iWorker;
+			CWULookupInfo *pLookup = &pMasterInfo->m_WULookup[ pPartition->m_WUs[i] ];
+			if ( !pLookup->m_bSpeculative )
+			{
+				pLookup->m_bSpeculative = true;
+				++g_nSpeculativeWUs;
+			}
+		}
 
-				// Split it in twain.
-				int nNew1 = max( 0, pPartition->m_WUs.Count() / 2 - 1 );
-				int nNew2 = pPartition->m_WUs.Count() - nNew1;
+		CPartitionInfo *pNew = AddPartition( pInfo, iWorker );
+		TransferWUs( pInfo, pPartition, pNew, pPartition->m_WUs.Count(), false );
+		SendPartitionToWorker( pInfo, pNew, iWorker );
 
-				// Send half to the old worker.
-				if ( nNew1 )
-				{
-					CPartitionInfo *pNew1 = AddPartition( pInfo, iOldWorker );
-					TransferWUs( pInfo, pPartition, pNew1, nNew1, false );
-					SendPartitionToWorker( pInfo, pNew1, iOldWorker );
-				}
+		pMasterInfo->m_bSpeculating = true;
+	}
 
-				// Send half to the new worker.
-				CPartitionInfo *pNew2 = AddPartition( pInfo, iWorker );
-				TransferWUs( pInfo, pPartition, pNew2, nNew2, false );
-				SendPartitionToWorker( pInfo, pNew2, iWorker );
+	Assert( pPartition->m_WUs.Count() == 0 );
+	delete pPartition;
+	pMasterInfo->m_Partitions.Remove( iLargest );
+}
 
-			Assert( pPartition->m_WUs.Count() == 0 );
-			delete pPartition;
-			pMasterInfo->m_Partitions.Remove( iLargest );
-		}
-		else
-		{
-			CPartitionInfo *pPartition = pMasterInfo->m_Partitions[iUnowned];
-			pPartition->m_iWorker = iWorker;
-			SendPartitionToWorker( pInfo, pPartition, iWorker );
-		}
+
+// Once WUs are running in two places, tell the workers which ones are done so they can
+// skip the ones they haven't started yet.
+void SendCompletedWUs( CDSInfo *pInfo )
+{
+	CMasterInfo *pMasterInfo = &pInfo->m_MasterInfo;
+	if ( pMasterInfo->m_CompletedWUs.Count() == 0 )
+		return;
+
+	DWORD curTime = Plat_MSTime();
+	if ( pMasterInfo->m_CompletedWUs.Count() < COMPLETED_WU_BATCH_SIZE &&
+		curTime - pMasterInfo->m_LastCompletedWUsTime < COMPLETED_WU_INTERVAL )
+	{
+		return;
 	}
+
+	char cPacketID[2] = { pInfo->m_cPacketID, DW_SUBPACKETID_WUS_COMPLETED };
+	VMPI_Send3Chunks( 
+		cPacketID, sizeof( cPacketID ), 
+		&g_iCurDSInfo, sizeof( g_iCurDSInfo ),
+		pMasterInfo->m_CompletedWUs.Base(), pMasterInfo->m_CompletedWUs.Count() * sizeof( WUIndexType ),
+		VMPI_SEND_TO_ALL );
+
+	pMasterInfo->m_CompletedWUs.RemoveAll();
+	pMasterInfo->m_LastCompletedWUsTime = curTime;
 }
 
 
@@ -429,6 +632,24 @@ bool DistributeWorkDispatch( MessageBuffer *pBuf, int iSource, int iPacketID )
 			return true;
 		}
 
+		case DW_SUBPACKETID_WUS_COMPLETED:
+		{
+			if ( iCurDW == g_iCurDSInfo && !g_bMPIMaster )
+			{
+				// Mark them taken so the threads skip them if they haven't started them yet.
+				int nIndices = (pBuf->getLen() - pBuf->getOffset()) / sizeof( WUIndexType );
+				for ( int i=0; i < nIndices; i++ )
+				{
+					WUIndexType iWU;
+					pBuf->read( &iWU, sizeof( iWU ) );
+					if ( iWU < pWorkerInfo->m_WorkUnitsTaken.Count() )
+						InterlockedIncrement( &pWorkerInfo->m_WorkUnitsTaken[iWU] );
+				}
+			}
+
+			return true;
+		}
+
 		case DW_SUBPACKETID_WU_RESULTS:
 		{
 			// We only care about work results for the iteration we're in.
@@ -462,6 +683,11 @@ bool DistributeWorkDispatch( MessageBuffer *pBuf, int iSource, int iPacketID )
 				pMasterInfo->m_WUInfo.Remove( pLookup->m_iWUInfo );
 				pLookup->m_iWUInfo = -1;	
 
+				double flCurTime = Plat_FloatTime();
+				if ( pLookup->m_flAssignTime >= 0 )
+					g_WULatencies.AddToTail( (float)( flCurTime - pLookup->m_flAssignTime ) );
+				g_WUFinishTimes.AddToTail( (float)( flCurTime - g_flMPIStartTime ) );
+
 				// Let the master process the incoming WU data.
 				pMasterInfo->m_ReceiveFn( iWorkUnit, pBuf, iSource );
 
@@ -471,20 +697,43 @@ bool DistributeWorkDispatch( MessageBuffer *pBuf, int iSource, int iPacketID )
 				CPartitionInfo *pPartition = pMasterInfo->m_Partitions[iPartition];
 				pPartition->m_WUs.Remove( pLookup->m_iPartitionListIndex );
 
+				// A speculative copy is always in the second worker's partition.
+				if ( pLookup->m_bSpeculative && pPartition->m_iWorker == iSource )
+					++g_nSpeculativeWins;
+
+				if ( pMasterInfo->m_bSpeculating )
+					pMasterInfo->m_CompletedWUs.AddToTail( iWorkUnit );
+
 
 				// Give the worker some new work if need be.
+				int iPartitionWorker = pPartition->m_iWorker;
 				if ( pPartition->m_WUs.Count() == 0 )
 				{
-					int iPartitionWorker = pPartition->m_iWorker;
 					delete pPartition;
 					pMasterInfo->m_Partitions.Remove( iPartition );
 			
 					// If there are any more WUs remaining, give the worker from this partition some more of them.		
-					if ( pMasterInfo->m_WUInfo.Count() > 0 )
+					if ( pMasterInfo->m_WUInfo.Count() > 0 && iPartitionWorker != -1 )
 					{
 						AssignWUsToWorker( pInfo, iPartitionWorker );
 					}
 				}
+				else if ( pPartition->m_WUs.Count() <= pPartition->m_nRefillAt && 
+					iPartitionWorker != -1 &&
+					FindPartitionByWorker( pMasterInfo, -1 ) != -1 )
+				{
+					TopUpPartition( pInfo, pPartition );
+				}
+
+				// If this came from a worker that had its WUs copied to someone else, it's out of work now.
+				if ( iSource != iPartitionWorker && 
+					FindPartitionByWorker( pMasterInfo, iSource ) == -1 &&
+					pMasterInfo->m_WUInfo.Count() > 0 )
+				{
+					AssignWUsToWorker( pInfo, iSource );
+				}
+
+				SendCompletedWUs( pInfo );
 
 
 				UpdatePacifier( (float)(pInfo->m_nWorkUnits - pMasterInfo->m_WUInfo.Count()) / pInfo->m_nWorkUnits );
@@ -534,14 +783,28 @@ void DistributeWork_Master( CDSInfo *pInfo, ReceiveWorkUnitFn receiveFn )
 	CMasterInfo *pMasterInfo = &pInfo->m_MasterInfo;
 	pMasterInfo->m_ReceiveFn = receiveFn;
 
+	int i;
+	pMasterInfo->m_bSpeculating = false;
+	pMasterInfo->m_LastCompletedWUsTime = Plat_MSTime();
+	pMasterInfo->m_WorkerStartTime.SetCount( g_wuCountByProcess.Count() );
+	for ( i=0; i < pMasterInfo->m_WorkerStartTime.Count(); i++ )
+		pMasterInfo->m_WorkerStartTime[i] = 0;
+
+	// All the WUs start out in one unowned partition. Workers get batches out of it as they need them.
+	CPartitionInfo *pUnowned = AddPartition( pInfo, -1 );
+
 	pMasterInfo->m_WULookup.SetCount( pInfo->m_nWorkUnits );
-	for ( int i=0; i < pInfo->m_nWorkUnits; i++ )
+	for ( i=0; i < pInfo->m_nWorkUnits; i++ )
 	{
 		CWorkUnitInfo info;
 		info.m_iWorkUnit = i;
 		
-		pMasterInfo->m_WULookup[i].m_iWUInfo = pMasterInfo->m_WUInfo.AddToTail( info );
-		pMasterInfo->m_WULookup[i].m_iPartition = -222222;
+		CWULookupInfo *pLookup = &pMasterInfo->m_WULookup[i];
+		pLookup->m_iWUInfo = pMasterInfo->m_WUInfo.AddToTail( info );
+		pLookup->m_iPartition = pUnowned->m_iPartition;
+		pLookup->m_iPartitionListIndex = pUnowned->m_WUs.AddToTail( (WUIndexType)i );
+		pLookup->m_flAssignTime = -1;
+		pLookup->m_bSpeculative = false;
 	}
 
 
@@ -550,6 +813,7 @@ void DistributeWork_Master( CDSInfo *pInfo, ReceiveWorkUnitFn receiveFn )
 		while ( pMasterInfo->m_WUInfo.Count() > 0 )
 		{
 			VMPI_DispatchNextMessage( 200 );
+			SendCompletedWUs( pInfo );
 		}
 	g_bMasterDistributingWork = false;
 		
@@ -696,6 +960,10 @@ double DistributeWork(
 
 	g_nWUs = nWorkUnits;
 	g_nDuplicatedWUs = 0;
+	g_nSpeculativeWUs = 0;
+	g_nSpeculativeWins = 0;
+	g_WULatencies.RemoveAll();
+	g_WUFinishTimes.RemoveAll();
 
 	// Setup stats info.
 	g_flMPIStartTime = Plat_FloatTime();
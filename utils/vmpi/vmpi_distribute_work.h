@@ -29,6 +29,9 @@ bool DistributeWorkDispatch( MessageBuffer *pBuf, int iSource, int iPacketID );
 
 // This is the function vrad and vvis use to divide the work units and send them out.
 // It maintains a sliding window of work units so it can always keep the clients busy.
+// Each worker gets batches sized by how fast it's been going, and when only a few work units
+// are left, idle workers run copies of them and the first results to come back are used.
+// So processFn can be called for the same work unit on more than one worker.
 //
 // The workers implement processFn to do the job work in a work unit.
 // This function must send back a packet formatted with:
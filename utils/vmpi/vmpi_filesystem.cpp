@@ -1269,11 +1269,203 @@ private:
 };
 
 
+// -------------------------------------------------------------------------------------------------------------- //
+// In a local session, the master puts each file the workers ask for into a named shared memory section
+// and the workers map it straight into their address space. There's no compression or multicasting, and
+// all the workers read the same physical pages.
+// -------------------------------------------------------------------------------------------------------------- //
+
+class CSharedFile
+{
+public:
+	const char* GetFilename() { return m_Filename.Base(); }
+
+public:
+	CUtlVector<char> m_Filename;
+	HANDLE m_hMapping;
+	char *m_pData;
+	unsigned long m_Size;
+};
+
+
+class CSharedFileCache
+{
+public:
+	~CSharedFileCache()
+	{
+		Term();
+	}
+
+	void Term()
+	{
+		for ( int i=0; i < m_Files.Count(); i++ )
+		{
+			CSharedFile *pFile = m_Files[i];
+			UnmapViewOfFile( pFile->m_pData );
+			CloseHandle( pFile->m_hMapping );
+			delete pFile;
+		}
+		m_Files.Purge();
+	}
+
+	// Master: loads the file into a shared section if it isn't already and returns its ID.
+	int FindOrAddFile( const char *pFilename )
+	{
+		int iFile = FindFile( pFilename );
+		if ( iFile != -1 )
+			return iFile;
+
+		FILE *fp = fopen( pFilename, "rb" );
+		if ( !fp )
+			return -1;
+
+		fseek( fp, 0, SEEK_END );
+		unsigned long fileLength = ftell( fp );
+		fseek( fp, 0, SEEK_SET );
+
+		// Read it right into the shared memory.
+		CSharedFile *pFile = CreateSharedFile( pFilename, m_Files.Count(), fileLength );
+		if ( pFile )
+			fread( pFile->m_pData, 1, fileLength, fp );
+
+		fclose( fp );
+		return pFile ? m_Files.AddToTail( pFile ) : -1;
+	}
+
+	void CreateVirtualFile( const char *pFilename, const void *pData, unsigned long fileLength )
+	{
+		if ( FindFile( pFilename ) != -1 )
+			Error( "CSharedFileCache::CreateVirtualFile( %s ) - file already exists!", pFilename );
+
+		CSharedFile *pFile = CreateSharedFile( pFilename, m_Files.Count(), fileLength );
+		if ( !pFile )
+			Error( "CSharedFileCache::CreateVirtualFile( %s ) - can't create shared memory.", pFilename );
+
+		memcpy( pFile->m_pData, pData, fileLength );
+		m_Files.AddToTail( pFile );
+	}
+
+	CSharedFile* GetFile( int iFile )
+	{
+		return m_Files[iFile];
+	}
+
+	// Worker: asks the master for the file and maps its shared section.
+	CSharedFile* OpenWorkerFile( const char *pFilename )
+	{
+		int iFile = FindFile( pFilename );
+		if ( iFile != -1 )
+			return m_Files[iFile];
+
+		unsigned char packetID[2] = { VMPI_PACKETID_FILESYSTEM, VMPI_FSPACKETID_FILE_REQUEST };
+		void *pChunks[2] = { packetID, (void*)pFilename };
+		int chunkLengths[2]  = { sizeof( packetID ), strlen( pFilename ) + 1 };
+		VMPI_SendChunks( pChunks, chunkLengths, ARRAYSIZE( pChunks ), 0 );
+
+		// The response has the file ID and its size.
+		MessageBuffer mb;
+		int iSource;
+		VMPI_DispatchUntil( &mb, &iSource, VMPI_PACKETID_FILESYSTEM, VMPI_FSPACKETID_FILE_RESPONSE, true );
+		
+		int fileID = *((int*)&mb.data[2]);
+		if ( fileID == -1 )
+			return NULL;
+
+		char sectionName[256];
+		GetSectionName( sectionName, sizeof( sectionName ), fileID );
+
+		HANDLE hMapping = OpenFileMapping( FILE_MAP_READ, FALSE, sectionName );
+		if ( !hMapping )
+		{
+			Warning( "OpenFileMapping( %s ) failed for '%s'\n", sectionName, pFilename );
+			return NULL;
+		}
+
+		char *pData = (char*)MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+		if ( !pData )
+		{
+			Warning( "MapViewOfFile( %s ) failed for '%s'\n", sectionName, pFilename );
+			CloseHandle( hMapping );
+			return NULL;
+		}
+
+		CSharedFile *pFile = new CSharedFile;
+		pFile->m_Filename.CopyArray( pFilename, strlen( pFilename ) + 1 );
+		pFile->m_hMapping = hMapping;
+		pFile->m_pData = pData;
+		pFile->m_Size = *((unsigned long*)&mb.data[6]);
+		m_Files.AddToTail( pFile );
+
+		if ( g_iVMPIVerboseLevel >= 1 )
+			Msg( "Mapped '%s' (%dk)\n", pFilename, (pFile->m_Size + 511) / 1024 );
+
+		return pFile;
+	}
+
+	unsigned long GetTotalBytes() const
+	{
+		unsigned long total = 0;
+		for ( int i=0; i < m_Files.Count(); i++ )
+			total += m_Files[i]->m_Size;
+		return total;
+	}
+
+
+private:
+
+	int FindFile( const char *pFilename )
+	{
+		for ( int i=0; i < m_Files.Count(); i++ )
+		{
+			if ( stricmp( m_Files[i]->GetFilename(), pFilename ) == 0 )
+				return i;
+		}
+		return -1;
+	}
+
+	void GetSectionName( char *pOut, int outLen, int fileID )
+	{
+		Q_snprintf( pOut, outLen, "%s_file%d", VMPI_GetLocalSessionName(), fileID );
+	}
+
+	CSharedFile* CreateSharedFile( const char *pFilename, int fileID, unsigned long fileLength )
+	{
+		char sectionName[256];
+		GetSectionName( sectionName, sizeof( sectionName ), fileID );
+
+		// Sections can't be empty.
+		HANDLE hMapping = CreateFileMapping( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, max( fileLength, 1 ), sectionName );
+		if ( !hMapping )
+			return NULL;
+
+		char *pData = (char*)MapViewOfFile( hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+		if ( !pData )
+		{
+			CloseHandle( hMapping );
+			return NULL;
+		}
+
+		CSharedFile *pFile = new CSharedFile;
+		pFile->m_Filename.CopyArray( pFilename, strlen( pFilename ) + 1 );
+		pFile->m_hMapping = hMapping;
+		pFile->m_pData = pData;
+		pFile->m_Size = fileLength;
+		return pFile;
+	}
+
+
+private:
+	// On the master, the index is the file ID.
+	CUtlVector<CSharedFile*> m_Files;
+};
+
+
 class CVMPIFileSystem : public IBaseFileSystem
 {
 public:
 	CMasterMulticastThread m_MasterThread;
 	CWorkerMulticastListener m_Listener;
+	CSharedFileCache m_SharedFiles;
 
 	CIPAddr m_MulticastIP;
 
@@ -1297,7 +1489,12 @@ public:
 		// Pick a random IP in the multicast range (224.0.0.2 to 239.255.255.255);
 		if ( g_bUseMPI )
 		{
-			if ( g_bMPIMaster )
+			// Local workers map the files out of shared memory, so there's nothing to multicast.
+			if ( VMPI_IsLocalSession() )
+			{
+				return true;
+			}
+			else if ( g_bMPIMaster )
 			{
 				CCycleCount cnt;
 				cnt.Sample();
@@ -1341,6 +1538,7 @@ public:
 	{
 		m_MasterThread.Term();
 		m_Listener.Term();
+		m_SharedFiles.Term();
 	}
 
 
@@ -1359,6 +1557,19 @@ public:
 			return (FileHandle_t)pFile;
 		}
 
+		// In a local session, the workers will map the same copy of the data that we read.
+		if ( VMPI_IsLocalSession() )
+		{
+			int iFile = m_SharedFiles.FindOrAddFile( pFilename );
+			if ( iFile == -1 )
+				return FILESYSTEM_INVALID_HANDLE;
+
+			CSharedFile *pShared = m_SharedFiles.GetFile( iFile );
+			CVMPIFile_Memory *pFile = new CVMPIFile_Memory;
+			pFile->Init( pShared->m_pData, pShared->m_Size );
+			return (FileHandle_t)pFile;
+		}
+
 		// Have our multicast thread load all the data so it's there when workers want it.
 		int iFile = m_MasterThread.FindOrAddFile( pFilename );
 		if ( iFile == -1 )
@@ -1379,6 +1590,17 @@ public:
 		if ( bWriteAccess )
 			return FILESYSTEM_INVALID_HANDLE;
 
+		if ( VMPI_IsLocalSession() )
+		{
+			CSharedFile *pShared = m_SharedFiles.OpenWorkerFile( pFilename );
+			if ( !pShared )
+				return FILESYSTEM_INVALID_HANDLE;
+
+			CVMPIFile_Memory *pOut = new CVMPIFile_Memory;
+			pOut->Init( pShared->m_pData, pShared->m_Size );
+			return (FileHandle_t)pOut;
+		}
+
 		// Do we have this file's data already?
 		CWorkerFile *pFile = m_Listener.FindWorkerFile( pFilename );
 		if ( !pFile || !pFile->IsReadyToRead() )
@@ -1566,7 +1788,9 @@ void VMPI_FileSystem_Term()
 	{
 		g_VMPIFileSystem.Term();
 
-		if ( g_bMPIMaster )
+		if ( VMPI_IsLocalSession() )
+			Msg( "Shared memory files: %dk\n", (g_VMPIFileSystem.m_SharedFiles.GetTotalBytes() + 511) / 1024 );
+		else if ( g_bMPIMaster )
 			Msg( "Multicast send: %dk\n", (g_nMulticastBytesSent + 511) / 1024 );
 		else
 			Msg( "Multicast recv: %dk\n", (g_nMulticastBytesReceived + 511) / 1024 );
@@ -1588,7 +1812,10 @@ CreateInterfaceFn VMPI_FileSystem_GetFactory()
 
 void VMPI_FileSystem_CreateVirtualFile( const char *pFilename, const void *pData, unsigned long fileLength )
 {
-	g_VMPIFileSystem.m_MasterThread.CreateVirtualFile( pFilename, pData, fileLength );
+	if ( VMPI_IsLocalSession() )
+		g_VMPIFileSystem.m_SharedFiles.CreateVirtualFile( pFilename, pData, fileLength );
+	else
+		g_VMPIFileSystem.m_MasterThread.CreateVirtualFile( pFilename, pData, fileLength );
 }
 
 
@@ -1606,6 +1833,20 @@ bool FileSystemRecv( MessageBuffer *pBuf, int iSource, int iPacketID )
 			if ( g_iVMPIVerboseLevel >= 2 )
 				Msg( "Client %d requested '%s'\n", iSource, pFilename );
 
+			if ( VMPI_IsLocalSession() )
+			{
+				// Local workers map the file themselves, so they need its size too.
+				int fileID = g_VMPIFileSystem.m_SharedFiles.FindOrAddFile( pFilename );
+				unsigned long fileSize = (fileID == -1) ? 0 : g_VMPIFileSystem.m_SharedFiles.GetFile( fileID )->m_Size;
+
+				unsigned char cPacket[2] = { VMPI_PACKETID_FILESYSTEM, VMPI_FSPACKETID_FILE_RESPONSE };
+				void *pChunks[3] = { cPacket, &fileID, &fileSize };
+				int chunkLen[3] = { sizeof( cPacket ), sizeof( fileID ), sizeof( fileSize ) };
+
+				VMPI_SendChunks( pChunks, chunkLen, ARRAYSIZE( pChunks ), iSource );
+				return true;
+			}
+
 			int fileID = g_VMPIFileSystem.m_MasterThread.AddFileRequest( pFilename, iSource );
 			
 			// Send back the file ID.
@@ -0,0 +1,245 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Converts a trace written by vprof_trace_dump to the Chrome trace
+//			event JSON format, which chrome://tracing and other timeline
+//			viewers load.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#pragma warning(disable:4786)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "tier0/vproftrace.h"
+
+using namespace std;
+
+
+struct TraceName_t
+{
+	const char *m_pScope;
+	const char *m_pBudgetGroup;
+};
+
+
+void Usage( void )
+{
+	printf( "Usage: vproftrace2json trace.vpt [trace.json]\n" );
+	exit( -1 );
+}
+
+unsigned char *LoadFile( const char *pFilename, int *pSize )
+{
+	FILE *fp = fopen( pFilename, "rb" );
+	if ( !fp )
+		return NULL;
+
+	fseek( fp, 0, SEEK_END );
+	int size = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+
+	unsigned char *pData = new unsigned char[size];
+	if ( fread( pData, 1, size, fp ) != (size_t)size )
+	{
+		delete [] pData;
+		fclose( fp );
+		return NULL;
+	}
+
+	fclose( fp );
+	*pSize = size;
+	return pData;
+}
+
+void WriteJSONString( FILE *fp, const char *pString )
+{
+	fputc( '"', fp );
+	for ( ; *pString; pString++ )
+	{
+		if ( *pString == '"' || *pString == '\\' )
+		{
+			fputc( '\\', fp );
+			fputc( *pString, fp );
+		}
+		else if ( (unsigned char)*pString < ' ' )
+		{
+			fprintf( fp, "\\u%04x", (unsigned char)*pString );
+		}
+		else
+		{
+			fputc( *pString, fp );
+		}
+	}
+	fputc( '"', fp );
+}
+
+void WriteEvent( FILE *fp, bool *pFirst, const char *pPhase, const TraceName_t *pName, double timestamp, unsigned long threadID )
+{
+	fprintf( fp, ( *pFirst ) ? "\n" : ",\n" );
+	*pFirst = false;
+
+	fprintf( fp, "{\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":%lu", pPhase, timestamp, threadID );
+	if ( !strcmp( pPhase, "i" ) )
+	{
+		// Frame marks go across every thread
+		fprintf( fp, ",\"s\":\"g\"" );
+	}
+	if ( pName )
+	{
+		fprintf( fp, ",\"name\":" );
+		WriteJSONString( fp, pName->m_pScope );
+		if ( *pName->m_pBudgetGroup )
+		{
+			fprintf( fp, ",\"cat\":" );
+			WriteJSONString( fp, pName->m_pBudgetGroup );
+		}
+	}
+	fprintf( fp, "}" );
+}
+
+int main( int argc, char **argv )
+{
+	if ( argc != 2 && argc != 3 )
+	{
+		Usage();
+	}
+
+	const char *pSrcFileName = argv[1];
+	char dstFileName[1024];
+	if ( argc == 3 )
+	{
+		strncpy( dstFileName, argv[2], sizeof( dstFileName ) - 1 );
+		dstFileName[sizeof( dstFileName ) - 1] = 0;
+	}
+	else
+	{
+		strncpy( dstFileName, pSrcFileName, sizeof( dstFileName ) - 6 );
+		dstFileName[sizeof( dstFileName ) - 6] = 0;
+		char *pExt = strrchr( dstFileName, '.' );
+		if ( pExt && !strchr( pExt, '/' ) && !strchr( pExt, '\\' ) )
+		{
+			*pExt = 0;
+		}
+		strcat( dstFileName, ".json" );
+	}
+
+	int size;
+	unsigned char *pData = LoadFile( pSrcFileName, &size );
+	if ( !pData )
+	{
+		printf( "error loading %s\n", pSrcFileName );
+		exit( -1 );
+	}
+
+	const VProfTraceHeader_t *pHeader = (const VProfTraceHeader_t *)pData;
+	if ( size < sizeof( VProfTraceHeader_t ) || pHeader->m_nID != VPROF_TRACE_ID || pHeader->m_nVersion != VPROF_TRACE_VERSION )
+	{
+		printf( "%s isn't a version %d vprof trace\n", pSrcFileName, VPROF_TRACE_VERSION );
+		exit( -1 );
+	}
+
+	// Names
+	unsigned char *pCur = pData + sizeof( VProfTraceHeader_t );
+	unsigned char *pEnd = pData + size;
+	vector<TraceName_t> names( pHeader->m_nNames );
+	int i;
+	for ( i = 0; i < pHeader->m_nNames; i++ )
+	{
+		const VProfTraceName_t *pName = (const VProfTraceName_t *)pCur;
+		if ( pCur + sizeof( VProfTraceName_t ) > pEnd ||
+			 pCur + sizeof( VProfTraceName_t ) + pName->m_nScopeLength + pName->m_nBudgetGroupLength > pEnd )
+		{
+			printf( "%s is truncated\n", pSrcFileName );
+			exit( -1 );
+		}
+
+		pCur += sizeof( VProfTraceName_t );
+		names[i].m_pScope = (const char *)pCur;
+		pCur += pName->m_nScopeLength;
+		names[i].m_pBudgetGroup = (const char *)pCur;
+		pCur += pName->m_nBudgetGroupLength;
+	}
+
+	const VProfTraceEvent_t *pEvents = (const VProfTraceEvent_t *)pCur;
+	if ( pCur + pHeader->m_nEvents * sizeof( VProfTraceEvent_t ) > pEnd )
+	{
+		printf( "%s is truncated\n", pSrcFileName );
+		exit( -1 );
+	}
+
+	FILE *fp = fopen( dstFileName, "w" );
+	if ( !fp )
+	{
+		printf( "error writing %s\n", dstFileName );
+		exit( -1 );
+	}
+
+	// Times are written in microseconds from the first event
+	__int64 startTime = ( pHeader->m_nEvents ) ? pEvents[0].m_Time : 0;
+	double microsecondsPerCycle = 1000000.0 / (double)pHeader->m_ClockSpeed;
+	double lastTimestamp = 0.0;
+
+	// The buffer wrapped around somewhere in the oldest thread scopes, so an
+	// exit on a thread with nothing entered closes a scope we never saw
+	map<unsigned long, int> depths;
+	TraceName_t unknownName = { "?", "" };
+	TraceName_t frameName = { "Frame", "" };
+
+	fprintf( fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+	bool bFirst = true;
+	for ( i = 0; i < pHeader->m_nEvents; i++ )
+	{
+		const VProfTraceEvent_t &event = pEvents[i];
+		double timestamp = (double)( event.m_Time - startTime ) * microsecondsPerCycle;
+		if ( timestamp > lastTimestamp )
+		{
+			lastTimestamp = timestamp;
+		}
+
+		switch ( event.m_Type )
+		{
+		case VPROF_TRACE_ENTER:
+			{
+				const TraceName_t *pName = ( event.m_iName < names.size() ) ? &names[event.m_iName] : &unknownName;
+				WriteEvent( fp, &bFirst, "B", pName, timestamp, event.m_ThreadID );
+				depths[event.m_ThreadID]++;
+			}
+			break;
+
+		case VPROF_TRACE_EXIT:
+			{
+				int &depth = depths[event.m_ThreadID];
+				if ( depth > 0 )
+				{
+					WriteEvent( fp, &bFirst, "E", NULL, timestamp, event.m_ThreadID );
+					depth--;
+				}
+			}
+			break;
+
+		case VPROF_TRACE_FRAME:
+			WriteEvent( fp, &bFirst, "i", &frameName, timestamp, event.m_ThreadID );
+			break;
+		}
+	}
+
+	// Close whatever was still open when the trace was written
+	for ( map<unsigned long, int>::iterator iter = depths.begin(); iter != depths.end(); ++iter )
+	{
+		for ( ; iter->second > 0; iter->second-- )
+		{
+			WriteEvent( fp, &bFirst, "E", NULL, lastTimestamp, iter->first );
+		}
+	}
+
+	fprintf( fp, "\n]}\n" );
+	fclose( fp );
+
+	printf( "Wrote %d events from %s to %s\n", pHeader->m_nEvents, pSrcFileName, dstFileName );
+	delete [] pData;
+	return 0;
+}
@@ -23,6 +23,10 @@
 #define INCREMENTALFILE_VERSION	31241
 
 
+// Returns true if the two lights would light the world identically.
+bool CompareLights( dworldlight_t *a, dworldlight_t *b );
+
+
 class CIncLight;
 
 
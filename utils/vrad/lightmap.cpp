@@ -14,6 +14,7 @@
 #include <bumpvects.h>
 #include "utlvector.h"
 #include "vmpi.h"
+#include "relightcache.h"
 
 
 enum
@@ -2557,6 +2558,18 @@ void BuildFacelights (int iThread, int facenum)
 	CalcPoints( &l, fl, facenum );
 	InitSampleInfo( l, iThread, sampleInfo );
 
+	// Nothing that affects this face changed since the last compile?
+	if( RelightCache_RestoreFace( facenum, sampleInfo.m_NormalCount ) )
+	{
+		if( dumppatches )
+		{
+			DumpSamples( facenum, fl );
+		}
+
+		FreeSampleWindings( fl );
+		return;
+	}
+
 	// always allocate style 0 lightmap
 	f->styles[0] = 0;
 	AllocateLightstyleSamples( fl, 0, sampleInfo.m_NormalCount );
@@ -145,6 +145,9 @@ struct SampleInfo_t
 
 extern void InitLightinfo( lightinfo_t *l, int facenum );
 
+// Returns the index of the face's edge'th vertex.
+int EdgeVertex( dface_t *f, int edge );
+
 void FreeDLights();
 
 
@@ -0,0 +1,496 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Memory-bounded direct lighting (-maxmem).
+//
+//			BuildFacelights leaves every face's per-sample light arrays in
+//			memory until FinalLightFace, which is where most of vrad's memory
+//			goes on big maps. Everything else FinalLightFace needs (sample
+//			positions, luxels, patches) is small compared to the light arrays,
+//			so those stay resident and only the light arrays get paged.
+//
+//			A face's light arrays are read by its own FinalLightFace and by the
+//			FinalLightFace of each face that lists it as a neighbor (the
+//			displacement sample hash only accepts neighbors too). Once all of
+//			those have run, the arrays are freed for good.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <io.h>
+#endif
+
+#include "vrad.h"
+#include "lightmap.h"
+#include "lightpager.h"
+#include "utllinkedlist.h"
+
+
+struct PagedFace_t
+{
+	int				m_nBytes;			// size of all the light arrays
+	int				m_nFileOffset;		// -1 if it hasn't been written to the scratch file yet
+	int				m_nLocks;
+	int				m_nUsesLeft;		// FinalLightFace calls that still read this face
+	int				m_iLRU;				// index in s_LRU, or invalid if locked or not resident
+	unsigned short	m_AllocatedMask;	// which light[style][normal] arrays exist
+	bool			m_bResident;
+	bool			m_bBuilt;
+};
+
+
+static bool								s_bActive = false;
+static int								s_nMaxBytes = 0;
+static char								s_ScratchFilename[_MAX_PATH];
+static FileHandle_t						s_hScratch = FILESYSTEM_INVALID_HANDLE;
+static int								s_nScratchSize = 0;
+
+static CUtlVector<PagedFace_t>			s_Faces;
+static CUtlVector<int>					s_FaceOrder;
+static CUtlLinkedList<int, int>			s_LRU;		// resident unlocked faces, oldest first
+
+static int								s_nResidentBytes = 0;
+static int								s_nPeakResidentBytes = 0;
+static int								s_nPageOuts = 0;
+static int								s_nPageIns = 0;
+
+
+static float BytesToMB( double flBytes )
+{
+	return (float)( flBytes / (1024.0 * 1024.0) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Peak memory use of the whole process, 0 if the platform can't tell us.
+//-----------------------------------------------------------------------------
+static float GetPeakProcessMemoryMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+		return BytesToMB( counters.PeakWorkingSetSize );
+#endif
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Face order: walk the world BSP front to back and take the faces in the
+// order the leaves reference them, then pick up the brush model faces.
+//-----------------------------------------------------------------------------
+static void AddFaceToOrder( int facenum, CUtlVector<bool> &added )
+{
+	if( added[facenum] )
+		return;
+
+	added[facenum] = true;
+	s_FaceOrder.AddToTail( facenum );
+}
+
+
+static void AddNodeFacesToOrder_R( int iNode, CUtlVector<bool> &added )
+{
+	if( iNode < 0 )
+	{
+		dleaf_t *pLeaf = &dleafs[-1 - iNode];
+		for( int i=0; i < pLeaf->numleaffaces; i++ )
+			AddFaceToOrder( dleaffaces[pLeaf->firstleafface + i], added );
+		return;
+	}
+
+	dnode_t *pNode = &dnodes[iNode];
+	AddNodeFacesToOrder_R( pNode->children[0], added );
+	AddNodeFacesToOrder_R( pNode->children[1], added );
+}
+
+
+static void BuildFaceOrder()
+{
+	int i;
+
+	CUtlVector<bool> added;
+	added.SetSize( numfaces );
+	for( i=0; i < numfaces; i++ )
+		added[i] = false;
+
+	s_FaceOrder.Purge();
+	s_FaceOrder.EnsureCapacity( numfaces );
+
+	AddNodeFacesToOrder_R( dmodels[0].headnode, added );
+
+	for( i=0; i < numfaces; i++ )
+		AddFaceToOrder( i, added );
+}
+
+
+//-----------------------------------------------------------------------------
+// Paging. These are all called inside ThreadLock.
+//-----------------------------------------------------------------------------
+static void UpdateResidentBytes( int nDelta )
+{
+	s_nResidentBytes += nDelta;
+	if( s_nResidentBytes > s_nPeakResidentBytes )
+		s_nPeakResidentBytes = s_nResidentBytes;
+}
+
+
+static void FreeFaceLight( int facenum )
+{
+	facelight_t *fl = &facelight[facenum];
+	for( int k=0; k < MAXLIGHTMAPS; k++ )
+	{
+		for( int n=0; n < NUM_BUMP_VECTS+1; n++ )
+		{
+			if( fl->light[k][n] )
+			{
+				free( fl->light[k][n] );
+				fl->light[k][n] = NULL;
+			}
+		}
+	}
+
+	PagedFace_t *pFace = &s_Faces[facenum];
+	if( pFace->m_iLRU != s_LRU.InvalidIndex() )
+	{
+		s_LRU.Remove( pFace->m_iLRU );
+		pFace->m_iLRU = s_LRU.InvalidIndex();
+	}
+
+	pFace->m_bResident = false;
+	UpdateResidentBytes( -pFace->m_nBytes );
+}
+
+
+static void PageOutFace( int facenum )
+{
+	PagedFace_t *pFace = &s_Faces[facenum];
+	Assert( pFace->m_bResident && pFace->m_nLocks == 0 );
+
+	// The light doesn't change after BuildFacelights so it only needs to be written once.
+	if( pFace->m_nFileOffset == -1 )
+	{
+		facelight_t *fl = &facelight[facenum];
+
+		pFace->m_nFileOffset = s_nScratchSize;
+		g_pFileSystem->Seek( s_hScratch, s_nScratchSize, FILESYSTEM_SEEK_HEAD );
+		for( int k=0; k < MAXLIGHTMAPS; k++ )
+		{
+			for( int n=0; n < NUM_BUMP_VECTS+1; n++ )
+			{
+				if( fl->light[k][n] )
+				{
+					int nBytes = fl->numsamples * sizeof( Vector );
+					if( g_pFileSystem->Write( fl->light[k][n], nBytes, s_hScratch ) != nBytes )
+						Error( "Error writing to %s\n", s_ScratchFilename );
+				}
+			}
+		}
+		s_nScratchSize += pFace->m_nBytes;
+	}
+
+	FreeFaceLight( facenum );
+	++s_nPageOuts;
+}
+
+
+static void PageInFace( int facenum )
+{
+	PagedFace_t *pFace = &s_Faces[facenum];
+	Assert( !pFace->m_bResident && pFace->m_nFileOffset != -1 );
+
+	facelight_t *fl = &facelight[facenum];
+
+	g_pFileSystem->Seek( s_hScratch, pFace->m_nFileOffset, FILESYSTEM_SEEK_HEAD );
+	for( int k=0; k < MAXLIGHTMAPS; k++ )
+	{
+		for( int n=0; n < NUM_BUMP_VECTS+1; n++ )
+		{
+			if( !( pFace->m_AllocatedMask & ( 1 << ( k * (NUM_BUMP_VECTS+1) + n ) ) ) )
+				continue;
+
+			int nBytes = fl->numsamples * sizeof( Vector );
+			fl->light[k][n] = ( Vector* )malloc( nBytes );
+			if( !fl->light[k][n] )
+				Error( "PageInFace: out of memory" );
+
+			if( g_pFileSystem->Read( fl->light[k][n], nBytes, s_hScratch ) != nBytes )
+				Error( "Error reading from %s\n", s_ScratchFilename );
+		}
+	}
+
+	pFace->m_bResident = true;
+	UpdateResidentBytes( pFace->m_nBytes );
+	++s_nPageIns;
+}
+
+
+static void PageOutOverBudget()
+{
+	while( s_nResidentBytes > s_nMaxBytes )
+	{
+		int iHead = s_LRU.Head();
+		if( iHead == s_LRU.InvalidIndex() )
+			break;	// everything left is locked
+
+		PageOutFace( s_LRU[iHead] );
+	}
+}
+
+
+static void ReleaseFace( int facenum )
+{
+	PagedFace_t *pFace = &s_Faces[facenum];
+	if( !pFace->m_bResident || pFace->m_nLocks > 0 )
+		return;
+
+	if( pFace->m_nUsesLeft <= 0 )
+	{
+		// Nobody is going to read this one again.
+		FreeFaceLight( facenum );
+	}
+	else if( pFace->m_iLRU == s_LRU.InvalidIndex() )
+	{
+		pFace->m_iLRU = s_LRU.AddToTail( facenum );
+	}
+}
+
+
+static void LockOneFace( int facenum )
+{
+	PagedFace_t *pFace = &s_Faces[facenum];
+	if( !pFace->m_bBuilt || !pFace->m_nBytes )
+		return;
+
+	if( !pFace->m_bResident )
+		PageInFace( facenum );
+
+	if( pFace->m_iLRU != s_LRU.InvalidIndex() )
+	{
+		s_LRU.Remove( pFace->m_iLRU );
+		pFace->m_iLRU = s_LRU.InvalidIndex();
+	}
+
+	++pFace->m_nLocks;
+}
+
+
+static void UnlockOneFace( int facenum )
+{
+	PagedFace_t *pFace = &s_Faces[facenum];
+	if( !pFace->m_bBuilt || !pFace->m_nBytes )
+		return;
+
+	Assert( pFace->m_nLocks > 0 );
+	--pFace->m_nLocks;
+	ReleaseFace( facenum );
+}
+
+
+//-----------------------------------------------------------------------------
+// Public interface.
+//-----------------------------------------------------------------------------
+void LightPager_Init( int nMaxMemMB, char const *pScratchFilename )
+{
+	int i;
+
+	s_bActive = true;
+	s_nMaxBytes = nMaxMemMB * 1024 * 1024;
+	Q_strncpy( s_ScratchFilename, pScratchFilename, sizeof( s_ScratchFilename ) );
+
+	s_hScratch = g_pFileSystem->Open( s_ScratchFilename, "w+b" );
+	if( s_hScratch == FILESYSTEM_INVALID_HANDLE )
+		Error( "Unable to create scratch file %s\n", s_ScratchFilename );
+	s_nScratchSize = 0;
+
+	s_Faces.SetSize( numfaces );
+	for( i=0; i < numfaces; i++ )
+	{
+		PagedFace_t *pFace = &s_Faces[i];
+		pFace->m_nBytes = 0;
+		pFace->m_nFileOffset = -1;
+		pFace->m_nLocks = 0;
+		pFace->m_nUsesLeft = 0;
+		pFace->m_iLRU = s_LRU.InvalidIndex();
+		pFace->m_AllocatedMask = 0;
+		pFace->m_bResident = false;
+		pFace->m_bBuilt = false;
+	}
+
+	// Count who's going to read each face in FinalLightFace.
+	for( i=0; i < numfaces; i++ )
+	{
+		++s_Faces[i].m_nUsesLeft;
+
+		faceneighbor_t *fn = &faceneighbor[i];
+		for( int j=0; j < fn->numneighbors; j++ )
+			++s_Faces[fn->neighbor[j]].m_nUsesLeft;
+	}
+
+	BuildFaceOrder();
+
+	s_nResidentBytes = s_nPeakResidentBytes = 0;
+	s_nPageOuts = s_nPageIns = 0;
+
+	Msg( "Paging direct lighting with a %d MB budget\n", nMaxMemMB );
+}
+
+
+bool LightPager_IsActive()
+{
+	return s_bActive;
+}
+
+
+int LightPager_GetFace( int iWorkUnit )
+{
+	return s_bActive ? s_FaceOrder[iWorkUnit] : iWorkUnit;
+}
+
+
+void LightPager_FaceBuilt( int facenum )
+{
+	if( !s_bActive )
+		return;
+
+	// Figure out what BuildFacelights allocated. Nothing touches this face's
+	// light arrays but the thread that built it until it's in the LRU.
+	facelight_t *fl = &facelight[facenum];
+	PagedFace_t *pFace = &s_Faces[facenum];
+
+	int nBytes = 0;
+	unsigned short mask = 0;
+	for( int k=0; k < MAXLIGHTMAPS; k++ )
+	{
+		for( int n=0; n < NUM_BUMP_VECTS+1; n++ )
+		{
+			if( fl->light[k][n] )
+			{
+				mask |= 1 << ( k * (NUM_BUMP_VECTS+1) + n );
+				nBytes += fl->numsamples * sizeof( Vector );
+			}
+		}
+	}
+
+	ThreadLock();
+
+	pFace->m_nBytes = nBytes;
+	pFace->m_AllocatedMask = mask;
+	pFace->m_bBuilt = true;
+	if( nBytes )
+	{
+		pFace->m_bResident = true;
+		UpdateResidentBytes( nBytes );
+		pFace->m_iLRU = s_LRU.AddToTail( facenum );
+		PageOutOverBudget();
+	}
+
+	ThreadUnlock();
+}
+
+
+void LightPager_LockFace( int facenum, bool bNeighbors )
+{
+	if( !s_bActive )
+		return;
+
+	ThreadLock();
+
+	LockOneFace( facenum );
+	if( bNeighbors )
+	{
+		faceneighbor_t *fn = &faceneighbor[facenum];
+		for( int j=0; j < fn->numneighbors; j++ )
+			LockOneFace( fn->neighbor[j] );
+	}
+
+	PageOutOverBudget();
+
+	ThreadUnlock();
+}
+
+
+void LightPager_UnlockFace( int facenum, bool bNeighbors )
+{
+	if( !s_bActive )
+		return;
+
+	ThreadLock();
+
+	UnlockOneFace( facenum );
+	if( bNeighbors )
+	{
+		faceneighbor_t *fn = &faceneighbor[facenum];
+		for( int j=0; j < fn->numneighbors; j++ )
+			UnlockOneFace( fn->neighbor[j] );
+	}
+
+	PageOutOverBudget();
+
+	ThreadUnlock();
+}
+
+
+void LightPager_FaceFinalized( int facenum )
+{
+	if( !s_bActive )
+		return;
+
+	ThreadLock();
+
+	--s_Faces[facenum].m_nUsesLeft;
+	ReleaseFace( facenum );
+
+	faceneighbor_t *fn = &faceneighbor[facenum];
+	for( int j=0; j < fn->numneighbors; j++ )
+	{
+		--s_Faces[fn->neighbor[j]].m_nUsesLeft;
+		ReleaseFace( fn->neighbor[j] );
+	}
+
+	ThreadUnlock();
+}
+
+
+void LightPager_ReportPass( char const *pPassName, float flSeconds )
+{
+	if( !s_bActive )
+		return;
+
+	Msg( "%s: %d faces in %.1f seconds (%.0f faces/sec)\n", pPassName, numfaces, flSeconds,
+		flSeconds > 0 ? numfaces / flSeconds : 0.0f );
+	Msg( "    light samples: %.1f MB resident, %.1f MB peak, %.1f MB in %s\n",
+		BytesToMB( s_nResidentBytes ), BytesToMB( s_nPeakResidentBytes ),
+		BytesToMB( s_nScratchSize ), s_ScratchFilename );
+	Msg( "    %d faces paged out, %d paged in\n", s_nPageOuts, s_nPageIns );
+
+	float flPeakMB = GetPeakProcessMemoryMB();
+	if( flPeakMB > 0 )
+	{
+		Msg( "    peak process memory: %.1f MB\n", flPeakMB );
+	}
+}
+
+
+void LightPager_Shutdown()
+{
+	if( !s_bActive )
+		return;
+
+	for( int i=0; i < numfaces; i++ )
+	{
+		if( s_Faces[i].m_bResident )
+			FreeFaceLight( i );
+	}
+
+	g_pFileSystem->Close( s_hScratch );
+	s_hScratch = FILESYSTEM_INVALID_HANDLE;
+	_unlink( s_ScratchFilename );
+
+	s_Faces.Purge();
+	s_FaceOrder.Purge();
+	s_LRU.Purge();
+	s_bActive = false;
+}
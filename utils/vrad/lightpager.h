@@ -0,0 +1,48 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Memory-bounded direct lighting (-maxmem). Faces are lit in BSP leaf
+//			order so neighbors finish close together, and once the per-sample
+//			light arrays go over budget the least recently used ones are paged
+//			out to a scratch file and read back when FinalLightFace needs them.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef LIGHTPAGER_H
+#define LIGHTPAGER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+// Turns on paging with a budget of nMaxMemMB megabytes for the sample light arrays.
+// Must be called after RadWorld_Start and before BuildFacelights.
+void LightPager_Init( int nMaxMemMB, char const *pScratchFilename );
+
+// Returns true if -maxmem was specified.
+bool LightPager_IsActive();
+
+// Maps a work unit index to a face number in spatially coherent order.
+int LightPager_GetFace( int iWorkUnit );
+
+// Called after BuildFacelights is done with a face. Its light arrays become
+// candidates for paging out.
+void LightPager_FaceBuilt( int facenum );
+
+// Makes sure the light arrays of the face (and its neighbors if bNeighbors is set)
+// are in memory and keeps them there until the matching unlock.
+void LightPager_LockFace( int facenum, bool bNeighbors );
+void LightPager_UnlockFace( int facenum, bool bNeighbors );
+
+// Called after FinalLightFace is done with a face. Light arrays that no other
+// face will read anymore are freed.
+void LightPager_FaceFinalized( int facenum );
+
+// Prints throughput and memory use for a pass over all the faces.
+void LightPager_ReportPass( char const *pPassName, float flSeconds );
+
+// Frees everything and deletes the scratch file.
+void LightPager_Shutdown();
+
+
+#endif // LIGHTPAGER_H
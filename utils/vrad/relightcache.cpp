@@ -0,0 +1,796 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Command-line incremental relighting (-inc).
+//
+// After the direct lighting pass, the sample lighting of every face and the
+// direct light on its patches are written to <mapname>.vrc along with the
+// lights that produced them and a hash of each face's geometry. On the next
+// compile with -inc the cache is diffed against the current map:
+//
+//	- lights that were added, removed or changed relight every face that is
+//	  in their PVS and close enough for them to contribute.
+//	- faces whose geometry changed (or that were removed) relight every face
+//	  that can see them, since they may cast or stop casting shadows.
+//
+// All other faces get their direct lighting copied out of the cache instead
+// of being traced. The bounce pass is then rerun from the restored patch state.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#include <io.h>
+#include "vrad.h"
+#include "lightmap.h"
+#include "incremental.h"
+#include "relightcache.h"
+#include "lightpager.h"
+#include "gamebspfile.h"
+#include "checksum_crc.h"
+#include "utlbuffer.h"
+
+
+#define RELIGHTCACHE_VERSION		1
+
+// Light contributions below this (in lightmap units) are considered invisible
+// when figuring out how far a changed light can reach.
+#define RELIGHT_MIN_CONTRIBUTION	0.01f
+
+
+extern float minchop;
+extern int g_nDXLevel;
+
+int GetVisCache( int lastoffset, int cluster, byte *pvs );
+
+
+struct CachedPatch_t
+{
+	Vector	m_TotalLight;
+	Vector	m_DirectLight;
+	Vector	m_SampleLight;
+	float	m_flSampleArea;
+};
+
+struct CachedFace_t
+{
+	CRC32_t	m_Hash;
+	Vector	m_Center;
+	int		m_nSamples;
+	int		m_nNormals;
+	byte	m_Styles[MAXLIGHTMAPS];
+	int		m_iFirstLight;		// index into s_CachedLight
+	int		m_iFirstPatch;		// index into s_CachedPatches
+	int		m_nPatches;
+	bool	m_bUsed;
+};
+
+struct LightHash_t
+{
+	CRC32_t	m_Hash;
+	int		m_iLight;
+};
+
+
+static bool							s_bActive = false;
+static char							s_CacheFilename[MAX_PATH];
+
+// State loaded from the previous compile.
+static CUtlVector<dworldlight_t>	s_CachedLights;
+static CUtlVector<CachedFace_t>		s_CachedFaces;
+static CUtlVector<Vector>			s_CachedLight;
+static CUtlVector<CachedPatch_t>	s_CachedPatches;
+
+// Per face in the current map.
+static CUtlVector<CRC32_t>			s_FaceHash;
+static CUtlVector<Vector>			s_FaceMins;
+static CUtlVector<Vector>			s_FaceMaxs;
+static CUtlVector<Vector>			s_FaceCenter;		// just in front of the face
+static CUtlVector<int>				s_FaceCluster;		// cluster of s_FaceCenter
+static CUtlVector<int>				s_FaceToCached;		// -1 if the face must be relit
+
+
+// -------------------------------------------------------------------------------- //
+// Static helpers.
+// -------------------------------------------------------------------------------- //
+
+static int FaceNormalCount( int facenum )
+{
+	return (texinfo[dfaces[facenum].texinfo].flags & SURF_BUMPLIGHT) ? NUM_BUMP_VECTS + 1 : 1;
+}
+
+
+static int CountFacePatches( int facenum )
+{
+	int nPatches = 0;
+	for( int ndxPatch = facePatches[facenum]; ndxPatch != facePatches.InvalidIndex(); ndxPatch = patches[ndxPatch].ndxNext )
+		++nPatches;
+
+	return nPatches;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hashes everything about a face that affects its direct lighting or the
+// shadows it casts: plane, texturing, lightmap layout and vertex positions.
+//-----------------------------------------------------------------------------
+static CRC32_t ComputeFaceHash( int facenum )
+{
+	dface_t *f = &dfaces[facenum];
+	texinfo_t *tx = &texinfo[f->texinfo];
+
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, &dplanes[f->planenum], sizeof( dplane_t ) );
+	CRC32_ProcessBuffer( &crc, tx, sizeof( texinfo_t ) );
+	if( tx->texdata >= 0 )
+		CRC32_ProcessBuffer( &crc, &dtexdata[tx->texdata], sizeof( dtexdata_t ) );
+
+	CRC32_ProcessBuffer( &crc, f->m_LightmapTextureMinsInLuxels, sizeof( f->m_LightmapTextureMinsInLuxels ) );
+	CRC32_ProcessBuffer( &crc, f->m_LightmapTextureSizeInLuxels, sizeof( f->m_LightmapTextureSizeInLuxels ) );
+	CRC32_ProcessBuffer( &crc, &face_offset[facenum], sizeof( Vector ) );
+
+	for( int i=0; i < f->numedges; i++ )
+	{
+		CRC32_ProcessBuffer( &crc, &dvertexes[EdgeVertex( f, i )].point, sizeof( Vector ) );
+	}
+
+	if( f->dispinfo != -1 )
+	{
+		ddispinfo_t *pDisp = &g_dispinfo[f->dispinfo];
+		CRC32_ProcessBuffer( &crc, &pDisp->startPosition, sizeof( Vector ) );
+		CRC32_ProcessBuffer( &crc, &pDisp->power, sizeof( int ) );
+
+		for( int iVert=0; iVert < pDisp->NumVerts(); iVert++ )
+		{
+			CDispVert *pVert = &g_DispVerts[pDisp->m_iDispVertStart + iVert];
+			CRC32_ProcessBuffer( &crc, &pVert->m_vVector, sizeof( Vector ) );
+			CRC32_ProcessBuffer( &crc, &pVert->m_flDist, sizeof( float ) );
+		}
+	}
+
+	CRC32_Final( &crc );
+	return crc;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hashes the command-line options and map data that affect every face. If
+// any of these change, the whole cache is thrown away.
+//-----------------------------------------------------------------------------
+static CRC32_t ComputeSettingsHash()
+{
+	CRC32_t crc;
+	CRC32_Init( &crc );
+
+	int iSettings[] =
+	{
+		RELIGHTCACHE_VERSION,
+		do_extra,
+		extrapasses,
+		do_fast,
+		do_centersamples,
+		do_dispblend,
+		numbounce > 0,
+		g_nDXLevel
+	};
+	CRC32_ProcessBuffer( &crc, iSettings, sizeof( iSettings ) );
+
+	float flSettings[] =
+	{
+		ambient[0], ambient[1], ambient[2],
+		smoothing_threshold,
+		maxchop,
+		minchop
+	};
+	CRC32_ProcessBuffer( &crc, flSettings, sizeof( flSettings ) );
+
+	// Static props cast shadows.
+	GameLumpHandle_t hStaticProps = GetGameLumpHandle( GAMELUMP_STATIC_PROPS );
+	if( hStaticProps != InvalidGameLump() && GetGameLump( hStaticProps ) )
+	{
+		CRC32_ProcessBuffer( &crc, GetGameLump( hStaticProps ), GameLumpSize( hStaticProps ) );
+	}
+
+	CRC32_Final( &crc );
+	return crc;
+}
+
+
+static CRC32_t ComputeLightHash( dworldlight_t const &light )
+{
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, (void*)&light.origin, sizeof( Vector ) );
+	CRC32_Final( &crc );
+	return crc;
+}
+
+
+static int LightHashCompare( const void *a, const void *b )
+{
+	CRC32_t hashA = ((LightHash_t const*)a)->m_Hash;
+	CRC32_t hashB = ((LightHash_t const*)b)->m_Hash;
+	return (hashA < hashB) ? -1 : (hashA > hashB);
+}
+
+
+static int FaceHashCompare( const void *a, const void *b )
+{
+	CRC32_t hashA = s_CachedFaces[*(int const*)a].m_Hash;
+	CRC32_t hashB = s_CachedFaces[*(int const*)b].m_Hash;
+	return (hashA < hashB) ? -1 : (hashA > hashB);
+}
+
+
+//-----------------------------------------------------------------------------
+// Returns the distance beyond which the light can't add more than
+// RELIGHT_MIN_CONTRIBUTION to a sample. Mirrors the falloff in GatherSampleLight.
+//-----------------------------------------------------------------------------
+static float LightInfluenceRadius( dworldlight_t const &light )
+{
+	float flMaxIntensity = max( light.intensity[0], max( light.intensity[1], light.intensity[2] ) );
+	float flCutoff = flMaxIntensity / RELIGHT_MIN_CONTRIBUTION;
+
+	switch( light.type )
+	{
+		case emit_surface:
+			// 1 / dist^2
+			return (float)sqrt( flCutoff );
+
+		case emit_point:
+		case emit_spotlight:
+		{
+			// 1 / (constant + linear * dist + quadratic * dist^2)
+			float a = light.quadratic_attn;
+			float b = light.linear_attn;
+			float c = light.constant_attn - flCutoff;
+			if( c >= 0 )
+				return 0;
+
+			if( a > 0 )
+				return (float)( ( -b + sqrt( b*b - 4*a*c ) ) / ( 2*a ) );
+
+			if( b > 0 )
+				return -c / b;
+
+			// No falloff.
+			return FLT_MAX;
+		}
+	}
+
+	return FLT_MAX;
+}
+
+
+static float DistanceToFaceSqr( int facenum, Vector const &vPoint )
+{
+	float flDistSqr = 0;
+	for( int i=0; i < 3; i++ )
+	{
+		float flDelta = 0;
+		if( vPoint[i] < s_FaceMins[facenum][i] )
+			flDelta = s_FaceMins[facenum][i] - vPoint[i];
+		else if( vPoint[i] > s_FaceMaxs[facenum][i] )
+			flDelta = vPoint[i] - s_FaceMaxs[facenum][i];
+
+		flDistSqr += flDelta * flDelta;
+	}
+	return flDistSqr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Marks the faces in the PVS that are within flRadius of vOrigin (or all of
+// them if pOrigin is null) as needing to be relit. Returns the number of faces
+// that weren't marked already.
+//-----------------------------------------------------------------------------
+static int MarkFacesInPVS( byte const *pvs, Vector const *pOrigin, float flRadius, CUtlVector<byte> &relight )
+{
+	CUtlVector<byte> inPVS;
+	inPVS.SetSize( numfaces );
+	memset( inPVS.Base(), 0, numfaces );
+
+	int i;
+	for( i=1; i < numleafs; i++ )
+	{
+		int iCluster = dleafs[i].cluster;
+		if( iCluster < 0 || !( pvs[iCluster>>3] & (1 << (iCluster & 7)) ) )
+			continue;
+
+		for( int iFace=0; iFace < dleafs[i].numleaffaces; iFace++ )
+		{
+			int index = dleaffaces[dleafs[i].firstleafface + iFace];
+			assert( index < numfaces );
+			inPVS[index] = 1;
+		}
+	}
+
+	// Displacements aren't in the leaf face lists.
+	for( i=0; i < numfaces; i++ )
+	{
+		if( ValidDispFace( &dfaces[i] ) )
+		{
+			int iCluster = s_FaceCluster[i];
+			if( iCluster < 0 || ( pvs[iCluster>>3] & (1 << (iCluster & 7)) ) )
+				inPVS[i] = 1;
+		}
+	}
+
+	float flRadiusSqr = flRadius * flRadius;
+	int nMarked = 0;
+	for( i=0; i < numfaces; i++ )
+	{
+		if( !inPVS[i] || relight[i] )
+			continue;
+
+		if( pOrigin && flRadius != FLT_MAX && DistanceToFaceSqr( i, *pOrigin ) > flRadiusSqr )
+			continue;
+
+		relight[i] = 1;
+		++nMarked;
+	}
+
+	return nMarked;
+}
+
+
+static int MarkFacesForLight( dworldlight_t const &light, byte const *pvs, CUtlVector<byte> &relight )
+{
+	// Sky lights reach everything that can see the sky.
+	if( light.type == emit_skylight || light.type == emit_skyambient )
+	{
+		memset( relight.Base(), 1, relight.Count() );
+		return numfaces;
+	}
+
+	return MarkFacesInPVS( pvs, &light.origin, LightInfluenceRadius( light ), relight );
+}
+
+
+static void ComputeFaceBounds( int facenum )
+{
+	dface_t *f = &dfaces[facenum];
+	if( facePatches[facenum] != facePatches.InvalidIndex() )
+	{
+		patch_t *pPatch = &patches[facePatches[facenum]];
+		s_FaceMins[facenum] = pPatch->face_mins;
+		s_FaceMaxs[facenum] = pPatch->face_maxs;
+	}
+	else
+	{
+		ClearBounds( s_FaceMins[facenum], s_FaceMaxs[facenum] );
+		for( int i=0; i < f->numedges; i++ )
+		{
+			AddPointToBounds( dvertexes[EdgeVertex( f, i )].point, s_FaceMins[facenum], s_FaceMaxs[facenum] );
+		}
+	}
+
+	// Step off the face so the point doesn't land in solid.
+	VectorAdd( s_FaceMins[facenum], s_FaceMaxs[facenum], s_FaceCenter[facenum] );
+	VectorScale( s_FaceCenter[facenum], 0.5f, s_FaceCenter[facenum] );
+	VectorAdd( s_FaceCenter[facenum], dplanes[f->planenum].normal, s_FaceCenter[facenum] );
+	s_FaceCluster[facenum] = ClusterFromPoint( s_FaceCenter[facenum] );
+}
+
+
+static bool CanRead( CUtlBuffer &buf, int nBytes )
+{
+	return nBytes >= 0 && buf.TellGet() + nBytes <= buf.TellPut();
+}
+
+
+static void PurgeCache()
+{
+	s_CachedLights.Purge();
+	s_CachedFaces.Purge();
+	s_CachedLight.Purge();
+	s_CachedPatches.Purge();
+}
+
+
+static bool ParseCache( CUtlBuffer &buf, CRC32_t settingsHash )
+{
+	if( !CanRead( buf, sizeof( int ) * 2 ) )
+		return false;
+
+	if( buf.GetInt() != RELIGHTCACHE_VERSION || buf.GetUnsignedInt() != settingsHash )
+		return false;
+
+	// Lights.
+	int nLights = buf.GetInt();
+	if( !CanRead( buf, nLights * sizeof( dworldlight_t ) ) )
+		return false;
+
+	s_CachedLights.SetSize( nLights );
+	buf.Get( s_CachedLights.Base(), nLights * sizeof( dworldlight_t ) );
+
+	// Faces.
+	if( !CanRead( buf, sizeof( int ) ) )
+		return false;
+
+	int nFaces = buf.GetInt();
+	if( nFaces < 0 || nFaces > MAX_MAP_FACES )
+		return false;
+
+	s_CachedFaces.SetSize( nFaces );
+	for( int i=0; i < nFaces; i++ )
+	{
+		CachedFace_t &face = s_CachedFaces[i];
+		if( !CanRead( buf, sizeof( CRC32_t ) + sizeof( Vector ) + sizeof( int ) * 2 + MAXLIGHTMAPS ) )
+			return false;
+
+		face.m_Hash = buf.GetUnsignedInt();
+		buf.Get( &face.m_Center, sizeof( Vector ) );
+		face.m_nSamples = buf.GetInt();
+		face.m_nNormals = buf.GetInt();
+		buf.Get( face.m_Styles, MAXLIGHTMAPS );
+		face.m_bUsed = false;
+
+		if( face.m_nSamples < 0 || face.m_nNormals < 1 || face.m_nNormals > NUM_BUMP_VECTS + 1 )
+			return false;
+
+		int nStyles = 0;
+		for( int k=0; k < MAXLIGHTMAPS; k++ )
+		{
+			if( face.m_Styles[k] != 255 )
+				++nStyles;
+		}
+
+		int nLight = nStyles * face.m_nNormals * face.m_nSamples;
+		if( !CanRead( buf, nLight * sizeof( Vector ) ) )
+			return false;
+
+		face.m_iFirstLight = s_CachedLight.AddMultipleToTail( nLight );
+		buf.Get( s_CachedLight.Base() + face.m_iFirstLight, nLight * sizeof( Vector ) );
+
+		if( !CanRead( buf, sizeof( int ) ) )
+			return false;
+
+		face.m_nPatches = buf.GetInt();
+		if( !CanRead( buf, face.m_nPatches * sizeof( CachedPatch_t ) ) )
+			return false;
+
+		face.m_iFirstPatch = s_CachedPatches.AddMultipleToTail( face.m_nPatches );
+		buf.Get( s_CachedPatches.Base() + face.m_iFirstPatch, face.m_nPatches * sizeof( CachedPatch_t ) );
+	}
+
+	return true;
+}
+
+
+static bool LoadCache( CRC32_t settingsHash )
+{
+	FileHandle_t fp = g_pFileSystem->Open( s_CacheFilename, "rb" );
+	if( fp == FILESYSTEM_INVALID_HANDLE )
+		return false;
+
+	int size = g_pFileSystem->Size( fp );
+	CUtlBuffer buf( 0, size );
+	bool bRead = ( g_pFileSystem->Read( buf.Base(), size, fp ) == size );
+	g_pFileSystem->Close( fp );
+	if( !bRead )
+		return false;
+
+	buf.SeekPut( CUtlBuffer::SEEK_HEAD, size );
+	if( ParseCache( buf, settingsHash ) )
+		return true;
+
+	// It's from another version of vrad, other settings or other map data, or it
+	// was cut short. It can never be used, so don't leave it lying around.
+	Msg( "Removing stale relight cache %s\n", s_CacheFilename );
+	_unlink( s_CacheFilename );
+	return false;
+}
+
+
+// -------------------------------------------------------------------------------- //
+// Interface.
+// -------------------------------------------------------------------------------- //
+
+void RelightCache_Init( char const *pCacheFilename )
+{
+	Q_strncpy( s_CacheFilename, pCacheFilename, sizeof( s_CacheFilename ) );
+	s_bActive = true;
+}
+
+
+bool RelightCache_IsActive()
+{
+	return s_bActive;
+}
+
+
+void RelightCache_Prepare()
+{
+	if( !s_bActive )
+		return;
+
+	double flStart = I_FloatTime();
+
+	int i;
+	s_FaceHash.SetSize( numfaces );
+	s_FaceMins.SetSize( numfaces );
+	s_FaceMaxs.SetSize( numfaces );
+	s_FaceCenter.SetSize( numfaces );
+	s_FaceCluster.SetSize( numfaces );
+	s_FaceToCached.SetSize( numfaces );
+	for( i=0; i < numfaces; i++ )
+	{
+		s_FaceHash[i] = ComputeFaceHash( i );
+		ComputeFaceBounds( i );
+		s_FaceToCached[i] = -1;
+	}
+
+	PurgeCache();
+	if( !LoadCache( ComputeSettingsHash() ) )
+	{
+		PurgeCache();
+		Msg( "No usable relight cache in %s, relighting all faces.\n", s_CacheFilename );
+		return;
+	}
+
+	CUtlVector<byte> relight;
+	relight.SetSize( numfaces );
+	memset( relight.Base(), 0, numfaces );
+
+	byte pvs[MAX_MAP_CLUSTERS/8];
+
+	// Match faces by their geometry.
+	CUtlVector<int> sortedFaces;
+	sortedFaces.SetSize( s_CachedFaces.Count() );
+	for( i=0; i < sortedFaces.Count(); i++ )
+		sortedFaces[i] = i;
+
+	qsort( sortedFaces.Base(), sortedFaces.Count(), sizeof( int ), FaceHashCompare );
+
+	CUtlVector<Vector> changedGeometry;
+	for( i=0; i < numfaces; i++ )
+	{
+		int lo = 0, hi = sortedFaces.Count();
+		while( lo < hi )
+		{
+			int mid = (lo + hi) / 2;
+			if( s_CachedFaces[sortedFaces[mid]].m_Hash < s_FaceHash[i] )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		// Duplicate hashes are ambiguous, so those faces get relit.
+		if( lo < sortedFaces.Count() && s_CachedFaces[sortedFaces[lo]].m_Hash == s_FaceHash[i] &&
+			( lo+1 == sortedFaces.Count() || s_CachedFaces[sortedFaces[lo+1]].m_Hash != s_FaceHash[i] ) &&
+			!s_CachedFaces[sortedFaces[lo]].m_bUsed )
+		{
+			s_FaceToCached[i] = sortedFaces[lo];
+			s_CachedFaces[sortedFaces[lo]].m_bUsed = true;
+		}
+		else
+		{
+			changedGeometry.AddToTail( s_FaceCenter[i] );
+		}
+	}
+
+	for( i=0; i < s_CachedFaces.Count(); i++ )
+	{
+		if( !s_CachedFaces[i].m_bUsed )
+			changedGeometry.AddToTail( s_CachedFaces[i].m_Center );
+	}
+
+	// Anything that can see a changed face may be shadowed differently now.
+	if( changedGeometry.Count() )
+	{
+		CUtlVector<byte> aggregate;
+		aggregate.SetSize( (dvis->numclusters/8) + 1 );
+		memset( aggregate.Base(), 0, aggregate.Count() );
+
+		for( i=0; i < changedGeometry.Count(); i++ )
+		{
+			GetVisCache( -1, ClusterFromPoint( changedGeometry[i] ), pvs );
+			for( int j=0; j < aggregate.Count(); j++ )
+				aggregate[j] |= pvs[j];
+		}
+
+		MarkFacesInPVS( aggregate.Base(), NULL, FLT_MAX, relight );
+	}
+
+	// Match lights.
+	CUtlVector<LightHash_t> sortedLights;
+	sortedLights.SetSize( s_CachedLights.Count() );
+	for( i=0; i < s_CachedLights.Count(); i++ )
+	{
+		sortedLights[i].m_Hash = ComputeLightHash( s_CachedLights[i] );
+		sortedLights[i].m_iLight = i;
+	}
+	qsort( sortedLights.Base(), sortedLights.Count(), sizeof( LightHash_t ), LightHashCompare );
+
+	CUtlVector<byte> lightMatched;
+	lightMatched.SetSize( s_CachedLights.Count() );
+	memset( lightMatched.Base(), 0, lightMatched.Count() );
+
+	int nChangedLights = 0;
+	for( directlight_t *dl=activelights; dl != NULL; dl = dl->next )
+	{
+		CRC32_t hash = ComputeLightHash( dl->light );
+
+		int lo = 0, hi = sortedLights.Count();
+		while( lo < hi )
+		{
+			int mid = (lo + hi) / 2;
+			if( sortedLights[mid].m_Hash < hash )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		bool bMatched = false;
+		for( ; lo < sortedLights.Count() && sortedLights[lo].m_Hash == hash; lo++ )
+		{
+			int iLight = sortedLights[lo].m_iLight;
+			if( !lightMatched[iLight] && CompareLights( &dl->light, &s_CachedLights[iLight] ) )
+			{
+				lightMatched[iLight] = 1;
+				bMatched = true;
+				break;
+			}
+		}
+
+		if( !bMatched )
+		{
+			// New or changed light.
+			MarkFacesForLight( dl->light, dl->pvs, relight );
+			++nChangedLights;
+		}
+	}
+
+	for( i=0; i < s_CachedLights.Count(); i++ )
+	{
+		if( lightMatched[i] )
+			continue;
+
+		// Removed light. Its old light has to be taken off of everything it reached.
+		GetVisCache( -1, ClusterFromPoint( s_CachedLights[i].origin ), pvs );
+		MarkFacesForLight( s_CachedLights[i], pvs, relight );
+		++nChangedLights;
+	}
+
+	int nReused = 0;
+	for( i=0; i < numfaces; i++ )
+	{
+		if( relight[i] )
+			s_FaceToCached[i] = -1;
+		else if( s_FaceToCached[i] != -1 )
+			++nReused;
+	}
+
+	Msg( "Relight cache: %d light changes and %d face changes, reusing %d of %d faces (%.1f seconds)\n",
+		nChangedLights, changedGeometry.Count(), nReused, numfaces, I_FloatTime() - flStart );
+}
+
+
+bool RelightCache_RestoreFace( int facenum, int nNormals )
+{
+	if( !s_bActive || facenum >= s_FaceToCached.Count() || s_FaceToCached[facenum] == -1 )
+		return false;
+
+	CachedFace_t const &cached = s_CachedFaces[s_FaceToCached[facenum]];
+	facelight_t *fl = &facelight[facenum];
+	if( cached.m_nSamples != fl->numsamples || cached.m_nNormals != nNormals ||
+		cached.m_nPatches != CountFacePatches( facenum ) )
+	{
+		return false;
+	}
+
+	dface_t *f = &dfaces[facenum];
+	Vector const *pSrc = s_CachedLight.Base() + cached.m_iFirstLight;
+	for( int k=0; k < MAXLIGHTMAPS; k++ )
+	{
+		f->styles[k] = cached.m_Styles[k];
+		if( f->styles[k] == 255 )
+			continue;
+
+		for( int n=0; n < nNormals; n++ )
+		{
+			fl->light[k][n] = ( Vector* )malloc( fl->numsamples * sizeof( Vector ) );
+			memcpy( fl->light[k][n], pSrc, fl->numsamples * sizeof( Vector ) );
+			pSrc += fl->numsamples;
+		}
+	}
+
+	CachedPatch_t const *pPatchSrc = s_CachedPatches.Base() + cached.m_iFirstPatch;
+	for( int ndxPatch = facePatches[facenum]; ndxPatch != facePatches.InvalidIndex(); ndxPatch = patches[ndxPatch].ndxNext )
+	{
+		patch_t *pPatch = &patches[ndxPatch];
+		pPatch->totallight = pPatchSrc->m_TotalLight;
+		pPatch->directlight = pPatchSrc->m_DirectLight;
+		pPatch->samplelight = pPatchSrc->m_SampleLight;
+		pPatch->samplearea = pPatchSrc->m_flSampleArea;
+		++pPatchSrc;
+	}
+
+	return true;
+}
+
+
+void RelightCache_Save()
+{
+	if( !s_bActive )
+		return;
+
+	// The source data isn't needed anymore.
+	PurgeCache();
+
+	CUtlBuffer buf;
+	buf.PutInt( RELIGHTCACHE_VERSION );
+	buf.PutUnsignedInt( ComputeSettingsHash() );
+
+	int nLights = 0;
+	directlight_t *dl;
+	for( dl=activelights; dl != NULL; dl = dl->next )
+		++nLights;
+
+	buf.PutInt( nLights );
+	for( dl=activelights; dl != NULL; dl = dl->next )
+		buf.Put( &dl->light, sizeof( dworldlight_t ) );
+
+	buf.PutInt( numfaces );
+	for( int i=0; i < numfaces; i++ )
+	{
+		dface_t *f = &dfaces[i];
+		facelight_t *fl = &facelight[i];
+		int nNormals = FaceNormalCount( i );
+
+		LightPager_LockFace( i, false );
+
+		buf.PutUnsignedInt( s_FaceHash[i] );
+		buf.Put( &s_FaceCenter[i], sizeof( Vector ) );
+		buf.PutInt( fl->numsamples );
+		buf.PutInt( nNormals );
+		buf.Put( f->styles, MAXLIGHTMAPS );
+
+		for( int k=0; k < MAXLIGHTMAPS; k++ )
+		{
+			if( f->styles[k] == 255 )
+				continue;
+
+			for( int n=0; n < nNormals; n++ )
+			{
+				if( fl->light[k][n] )
+				{
+					buf.Put( fl->light[k][n], fl->numsamples * sizeof( Vector ) );
+				}
+				else
+				{
+					Vector vZero( 0, 0, 0 );
+					for( int iSample=0; iSample < fl->numsamples; iSample++ )
+						buf.Put( &vZero, sizeof( Vector ) );
+				}
+			}
+		}
+
+		LightPager_UnlockFace( i, false );
+
+		buf.PutInt( CountFacePatches( i ) );
+		for( int ndxPatch = facePatches[i]; ndxPatch != facePatches.InvalidIndex(); ndxPatch = patches[ndxPatch].ndxNext )
+		{
+			patch_t *pPatch = &patches[ndxPatch];
+
+			CachedPatch_t cachedPatch;
+			cachedPatch.m_TotalLight = pPatch->totallight;
+			cachedPatch.m_DirectLight = pPatch->directlight;
+			cachedPatch.m_SampleLight = pPatch->samplelight;
+			cachedPatch.m_flSampleArea = pPatch->samplearea;
+			buf.Put( &cachedPatch, sizeof( cachedPatch ) );
+		}
+	}
+
+	FileHandle_t fp = g_pFileSystem->Open( s_CacheFilename, "wb" );
+	if( fp == FILESYSTEM_INVALID_HANDLE )
+	{
+		Warning( "Unable to write relight cache %s\n", s_CacheFilename );
+		return;
+	}
+
+	g_pFileSystem->Write( buf.Base(), buf.TellPut(), fp );
+	g_pFileSystem->Close( fp );
+
+	Msg( "Wrote relight cache %s (%.1f MB)\n", s_CacheFilename, buf.TellPut() / (1024.0f * 1024.0f) );
+}
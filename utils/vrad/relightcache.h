@@ -0,0 +1,40 @@
+//========= Copyright  1996-2003, Valve LLC, All rights reserved. ============
+//
+// Purpose: Command-line incremental relighting (-inc). The direct lighting
+//			of every face is cached next to the map after a compile, and the
+//			next compile only relights faces that changed lights or changed
+//			geometry can reach. Bounces are rerun from the cached patch state.
+//
+// $NoKeywords: $
+//=============================================================================
+
+#ifndef RELIGHTCACHE_H
+#define RELIGHTCACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+
+// Turns on incremental relighting. Must be called after the BSP is loaded.
+void RelightCache_Init( char const *pCacheFilename );
+
+// Returns true if -inc was specified.
+bool RelightCache_IsActive();
+
+// Loads the previous compile's cache and diffs its lights and face geometry
+// against the current map. Must be called after CreateDirectLights and
+// before BuildFacelights.
+void RelightCache_Prepare();
+
+// Called by BuildFacelights after the sample points have been built. If the face
+// wasn't touched by anything that changed, this copies the cached direct lighting
+// into facelight[facenum] and the face's patches and returns true.
+// This is threadsafe as long as each face is only restored by one thread.
+bool RelightCache_RestoreFace( int facenum, int nNormals );
+
+// Writes the direct lighting of all faces out so the next compile can reuse it.
+// Must be called after BuildFacelights and before the lights are deleted.
+void RelightCache_Save();
+
+
+#endif // RELIGHTCACHE_H
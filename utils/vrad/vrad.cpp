@@ -17,6 +17,8 @@
 #include "vmpi.h"
 #include "macro_texture.h"
 #include "vmpi_tools_shared.h"
+#include "relightcache.h"
+#include "lightpager.h"
 
 
 #define ALLOWOPTIONS (0 || _DEBUG)
@@ -83,6 +85,10 @@ char		level_lights[MAX_PATH] = "";
 
 char		vismatfile[_MAX_PATH] = "";
 char		incrementfile[_MAX_PATH] = "";
+char		relightfile[_MAX_PATH] = "";
+bool		g_bRelightChanged = false;	// -inc: only relight what changed since the last compile
+char		lightpagerfile[_MAX_PATH] = "";
+int			g_nMaxLightMemMB = 0;		// -maxmem: page direct lighting out past this many MB
 
 IIncremental *g_pIncremental = 0;
 bool		g_bInterrupt = false;	// Wsed with background lighting in WC. Tells VRAD
@@ -1597,6 +1603,27 @@ void MakeAllScales (void)
 }
 
 
+//-----------------------------------------------------------------------------
+// With -maxmem, faces are handed out in spatially coherent order and their
+// direct lighting may be paged out between BuildFacelights and FinalLightFace.
+//-----------------------------------------------------------------------------
+static void BuildFacelightsPaged( int iThread, int iWorkUnit )
+{
+	int facenum = LightPager_GetFace( iWorkUnit );
+	BuildFacelights( iThread, facenum );
+	LightPager_FaceBuilt( facenum );
+}
+
+static void FinalLightFacePaged( int iThread, int iWorkUnit )
+{
+	int facenum = LightPager_GetFace( iWorkUnit );
+	LightPager_LockFace( facenum, true );
+	FinalLightFace( iThread, facenum );
+	LightPager_UnlockFace( facenum, true );
+	LightPager_FaceFinalized( facenum );
+}
+
+
 bool RadWorld_Go()
 {
 	g_iCurFace = 0;
@@ -1616,6 +1643,9 @@ bool RadWorld_Go()
 		// likely that all faces are going to be touched by at least one light so don't
 		// waste time here.
 		BuildFacesVisibleToLights( true );
+
+		// With -inc, figure out which faces can reuse last compile's direct lighting.
+		RelightCache_Prepare();
 	}
 
 	// build initial facelights
@@ -1624,6 +1654,14 @@ bool RadWorld_Go()
 		// RunThreadsOnIndividual (numfaces, true, BuildFacelights);
 		RunMPIBuildFacelights();
 	}
+	else if ( g_nMaxLightMemMB > 0 && !g_pIncremental )
+	{
+		LightPager_Init( g_nMaxLightMemMB, lightpagerfile );
+
+		float flStart = I_FloatTime();
+		RunThreadsOnIndividual (numfaces, true, BuildFacelightsPaged);
+		LightPager_ReportPass( "BuildFacelights", I_FloatTime() - flStart );
+	}
 	else 
 	{
 		RunThreadsOnIndividual (numfaces, true, BuildFacelights);
@@ -1633,6 +1671,9 @@ bool RadWorld_Go()
 	if( g_pIncremental && (g_iCurFace != numfaces) )
 		return false;
 
+	// Store the direct lighting before it gets bounced so the next -inc compile can start from it.
+	RelightCache_Save();
+
 	// Figure out the offset into lightmap data for each face.
 	PrecompLightmapOffsets();
 	
@@ -1686,7 +1727,17 @@ bool RadWorld_Go()
 		StaticDispMgr()->EndTimer();
 
 		// blend bounced light into direct light and save
-		RunThreadsOnIndividual (numfaces, true, FinalLightFace);
+		if ( LightPager_IsActive() )
+		{
+			float flStart = I_FloatTime();
+			RunThreadsOnIndividual (numfaces, true, FinalLightFacePaged);
+			LightPager_ReportPass( "FinalLightFace", I_FloatTime() - flStart );
+			LightPager_Shutdown();
+		}
+		else
+		{
+			RunThreadsOnIndividual (numfaces, true, FinalLightFace);
+		}
 		Msg("FinalLightFace Done\n"); fflush(stdout);
 	}
 
@@ -1756,6 +1807,10 @@ void VRAD_LoadBSP( char const *pFilename )
 
 	strcpy(incrementfile, source);
 	DefaultExtension(incrementfile, ".r0");
+	strcpy(relightfile, source);
+	DefaultExtension(relightfile, ".vrc");
+	strcpy(lightpagerfile, source);
+	DefaultExtension(lightpagerfile, ".vrp");
 	DefaultExtension(source, ".bsp");
 
 	GetPlatformMapPath( source, platformPath, g_nDXLevel, MAX_PATH );
@@ -1801,6 +1856,12 @@ void VRAD_LoadBSP( char const *pFilename )
 
 	RadWorld_Start();
 
+	// Setup command-line incremental relighting.
+	if( g_bRelightChanged && !g_pIncremental )
+	{
+		RelightCache_Init( relightfile );
+	}
+
 	// Setup incremental lighting.
 	if( g_pIncremental )
 	{
@@ -2186,6 +2247,22 @@ int RunVRAD( int argc, char **argv )
 		{
 			onlydetail = true;
 		}
+		else if( !stricmp( argv[i], "-inc" ) )
+		{
+			g_bRelightChanged = true;
+		}
+		else if( !stricmp( argv[i], "-maxmem" ) )
+		{
+			if ( ++i < argc )
+			{
+				g_nMaxLightMemMB = atoi( argv[i] );
+			}
+			else
+			{
+				Warning("Error: expected a value after '-maxmem'\n" );
+				return 1;
+			}
+		}
 		else if ( stricmp( argv[i], "-StopOnExit" ) == 0 )
 		{
 			g_bStopOnExit = true;
@@ -2205,8 +2282,20 @@ int RunVRAD( int argc, char **argv )
 		}
 	}
 
+	if ( g_bRelightChanged && g_bUseMPI )
+	{
+		Warning( "-inc is not supported with -mpi, relighting all faces.\n" );
+		g_bRelightChanged = false;
+	}
+
+	if ( g_nMaxLightMemMB > 0 && g_bUseMPI )
+	{
+		Warning( "-maxmem is not supported with -mpi, keeping all direct lighting in memory.\n" );
+		g_nMaxLightMemMB = 0;
+	}
+
 	if (i != argc - 1)
-		Error ( "usage: vrad [-dump] [-inc] [-bounce n] [-threads n] [-verbose] [-terse] [-proj file] [-maxlight n] [-threads n] [-lights file] [-extra] [-smooth n] [-dlightmap] [-fast] [-blendsamples] [-lowpriority] [-StopOnExit] [-mpi] bspfile" );
+		Error ( "usage: vrad [-dump] [-inc] [-maxmem mb] [-bounce n] [-threads n] [-verbose] [-terse] [-proj file] [-maxlight n] [-threads n] [-lights file] [-extra] [-smooth n] [-dlightmap] [-fast] [-blendsamples] [-lowpriority] [-StopOnExit] [-mpi [-mpi_Local n]] bspfile" );
 
 	VRAD_LoadBSP( argv[i] );
 
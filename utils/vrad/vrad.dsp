@@ -54,7 +54,7 @@ BSC32=bscmake.exe
 LINK32=link.exe
 # ADD BASE LINK32 /nologo /dll /machine:I386 /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
 # SUBTRACT BASE LINK32 /pdb:none
-# ADD LINK32 ws2_32.lib /nologo /dll /map /debug /machine:I386 /nodefaultlib:"libcmtd.lib" /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
+# ADD LINK32 ws2_32.lib psapi.lib /nologo /dll /map /debug /machine:I386 /nodefaultlib:"libcmtd.lib" /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
 # SUBTRACT LINK32 /pdb:none
 # Begin Custom Build - Copying
 TargetDir=.\vrad___Win32_Release
@@ -94,7 +94,7 @@ BSC32=bscmake.exe
 LINK32=link.exe
 # ADD BASE LINK32 /nologo /dll /debug /machine:I386 /pdbtype:sept /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
 # SUBTRACT BASE LINK32 /pdb:none
-# ADD LINK32 ws2_32.lib /nologo /dll /debug /machine:I386 /pdbtype:sept /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
+# ADD LINK32 ws2_32.lib psapi.lib /nologo /dll /debug /machine:I386 /pdbtype:sept /libpath:"..\..\lib\common" /libpath:"..\..\lib\public"
 # SUBTRACT LINK32 /pdb:none
 # Begin Custom Build - Copying
 TargetDir=.\vrad___Win32_Debug
@@ -253,6 +253,10 @@ SOURCE=.\lightmap.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\lightpager.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\macro_texture.cpp
 # End Source File
 # Begin Source File
@@ -281,6 +285,10 @@ SOURCE=.\radial.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\relightcache.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\SampleHash.cpp
 # End Source File
 # Begin Source File
@@ -665,6 +673,10 @@ SOURCE=.\lightmap.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\lightpager.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\macro_texture.h
 # End Source File
 # Begin Source File
@@ -693,6 +705,10 @@ SOURCE=.\radial.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\relightcache.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\public\tgaloader.h
 # End Source File
 # Begin Source File
@@ -938,7 +938,7 @@ int RunVVis( int argc, char **argv )
 	}
 
 	if (i != argc - 1)
-		Error ("usage: vvis [-mpi] [-mpi_updates] [-fast] [-v] [-radius_override] [-lowpriority] bspfile");
+		Error ("usage: vvis [-mpi [-mpi_Local n]] [-mpi_updates] [-fast] [-v] [-radius_override] [-lowpriority] bspfile");
 
 	start = I_FloatTime ();
 
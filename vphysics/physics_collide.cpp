@@ -95,6 +95,9 @@ public:
 	virtual void			ThreadContextDestroy( IPhysicsCollision *pThreadContex );
 	virtual unsigned int	ReadStat( int statID ) { return m_traceapi.ReportStatDotProduct(); }
 
+	virtual void			VCollideLoadInPlace( vcollide_t *pOutput, int solidCount, const char *pBuffer, int size );
+	virtual void			VCollideUnloadInPlace( vcollide_t *pVCollide );
+
 private:
 	void InitBBoxCache();
 	bool IsBBoxCache( CPhysCollide *pCollide );
@@ -861,6 +864,42 @@ void CPhysicsCollision::VCollideUnload( vcollide_t *pVCollide )
 	memset( pVCollide, 0, sizeof(*pVCollide) );
 }
 
+// loads a set of solids into a vcollide_t without copying them out of pBuffer
+void CPhysicsCollision::VCollideLoadInPlace( vcollide_t *pOutput, int solidCount, const char *pBuffer, int bufferSize )
+{
+	memset( pOutput, 0, sizeof(*pOutput) );
+	int position = 0;
+
+	pOutput->solidCount = solidCount;
+	pOutput->solids = new CPhysCollide *[solidCount];
+
+	for ( int i = 0; i < solidCount; i++ )
+	{
+		// skip the padding in front of the size so the solid itself is aligned
+		int misalign = (int)( (unsigned int)( pBuffer + position + sizeof(int) ) & (VCOLLIDE_INPLACE_ALIGN-1) );
+		if ( misalign )
+		{
+			position += VCOLLIDE_INPLACE_ALIGN - misalign;
+		}
+
+		int size;
+		memcpy( &size, pBuffer + position, sizeof(int) );
+		position += sizeof(int);
+
+		pOutput->solids[i] = (CPhysCollide *)( pBuffer + position );
+		position += size;
+	}
+
+	pOutput->pKeyValues = const_cast<char *>( pBuffer + position );
+}
+
+// destroys the set of solids created by VCollideLoadInPlace
+void CPhysicsCollision::VCollideUnloadInPlace( vcollide_t *pVCollide )
+{
+	delete[] pVCollide->solids;
+	memset( pVCollide, 0, sizeof(*pVCollide) );
+}
+
 // begins parsing a vcollide.  NOTE: This keeps pointers to the vcollide_t
 // If you delete the vcollide_t and call members of IVCollideParse, it will crash
 IVPhysicsKeyParser *CPhysicsCollision::VPhysicsKeyParserCreate( const char *pKeyData )
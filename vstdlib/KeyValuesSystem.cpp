@@ -10,6 +10,9 @@
 // $NoKeywords: $
 //=============================================================================
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
 #include <vstdlib/IKeyValuesSystem.h>
 #include <KeyValues.h>
 #include "MemPool.h"
@@ -18,6 +21,24 @@
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
 
+//-----------------------------------------------------------------------------
+// Purpose: Guards the load stats, KeyValues files can be loaded on any thread
+//-----------------------------------------------------------------------------
+struct KeyValuesStatsLock_t
+{
+#ifdef _WIN32
+	KeyValuesStatsLock_t()	{ InitializeCriticalSection( &m_CS ); }
+	~KeyValuesStatsLock_t()	{ DeleteCriticalSection( &m_CS ); }
+	void Lock()		{ EnterCriticalSection( &m_CS ); }
+	void Unlock()	{ LeaveCriticalSection( &m_CS ); }
+
+	CRITICAL_SECTION m_CS;
+#else
+	void Lock()		{}
+	void Unlock()	{}
+#endif
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Central storage point for KeyValues memory and symbols
 //-----------------------------------------------------------------------------
@@ -40,11 +61,27 @@ public:
 	HKeySymbol GetSymbolForString(const char *name);
 	const char *GetStringForSymbol(HKeySymbol symbol);
 
+	// binary cache of text KeyValues files
+	void SetBinaryCacheEnabled(bool bEnabled);
+	bool IsBinaryCacheEnabled();
+
+	// load time accounting
+	void AddLoadTime(bool bFromCache, float flSeconds);
+	void GetLoadStats(KeyValuesLoadStats_t &stats);
+
+	// KeyValues memory pool upkeep
+	int ReleaseFreeMemory();
+	void ReportMemoryStats(void (*pfnReport)(char const *pMsg, ...));
+
 private:
-	CMemoryPool *m_pMemPool;
-	CUtlSymbolTable m_SymbolTable;
+	CMemoryPoolMT *m_pMemPool;
+	CUtlSymbolTableMT m_SymbolTable;
 
 	int m_iMaxKeyValuesSize;
+
+	bool m_bBinaryCacheEnabled;
+	KeyValuesLoadStats_t m_LoadStats;
+	KeyValuesStatsLock_t m_LoadStatsLock;
 };
 
 //-----------------------------------------------------------------------------
@@ -62,8 +99,12 @@ IKeyValuesSystem *KeyValuesSystem()
 //-----------------------------------------------------------------------------
 CKeyValuesSystem::CKeyValuesSystem() : m_SymbolTable(0, 1024, true)
 {
-	m_pMemPool = NULL;
 	m_iMaxKeyValuesSize = sizeof(KeyValues);
+	m_bBinaryCacheEnabled = false;
+	memset(&m_LoadStats, 0, sizeof(m_LoadStats));
+
+	// built up front, the first KeyValues can be allocated on any thread
+	m_pMemPool = new CMemoryPoolMT(m_iMaxKeyValuesSize, 1024, CMemoryPool::GROW_FAST, "KeyValues");
 }
 
 //-----------------------------------------------------------------------------
@@ -81,10 +122,8 @@ CKeyValuesSystem::~CKeyValuesSystem()
 //-----------------------------------------------------------------------------
 void CKeyValuesSystem::RegisterSizeofKeyValues(int size)
 {
-	if (size > m_iMaxKeyValuesSize)
-	{
-		m_iMaxKeyValuesSize = size;
-	}
+	// the pool's block size is fixed when it's built, so it can only check
+	Assert(size <= m_iMaxKeyValuesSize);
 }
 
 //-----------------------------------------------------------------------------
@@ -92,12 +131,6 @@ void CKeyValuesSystem::RegisterSizeofKeyValues(int size)
 //-----------------------------------------------------------------------------
 void *CKeyValuesSystem::AllocKeyValuesMemory(int size)
 {
-	// allocate, if we don't have one yet
-	if (!m_pMemPool)
-	{
-		m_pMemPool = new CMemoryPool(m_iMaxKeyValuesSize, 1024);
-	}
-
 	return m_pMemPool->Alloc(size);
 }
 
@@ -125,6 +158,67 @@ const char *CKeyValuesSystem::GetStringForSymbol(HKeySymbol symbol)
 	return m_SymbolTable.String(symbol);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: turns the binary KeyValues cache on or off for every module
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::SetBinaryCacheEnabled(bool bEnabled)
+{
+	m_bBinaryCacheEnabled = bEnabled;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+bool CKeyValuesSystem::IsBinaryCacheEnabled()
+{
+	return m_bBinaryCacheEnabled;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: records how long a KeyValues::LoadFromFile took
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::AddLoadTime(bool bFromCache, float flSeconds)
+{
+	m_LoadStatsLock.Lock();
+	if (bFromCache)
+	{
+		m_LoadStats.m_nCacheLoads++;
+		m_LoadStats.m_flCacheTime += flSeconds;
+	}
+	else
+	{
+		m_LoadStats.m_nTextLoads++;
+		m_LoadStats.m_flTextTime += flSeconds;
+	}
+	m_LoadStatsLock.Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the running load totals; diff two calls to time a stretch of loading
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::GetLoadStats(KeyValuesLoadStats_t &stats)
+{
+	m_LoadStatsLock.Lock();
+	stats = m_LoadStats;
+	m_LoadStatsLock.Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: gives the pool's completely free blobs back, returns the bytes freed
+//-----------------------------------------------------------------------------
+int CKeyValuesSystem::ReleaseFreeMemory()
+{
+	return m_pMemPool->ReleaseFreeBlobs();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reports the KeyValues pool's use
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::ReportMemoryStats(void (*pfnReport)(char const *pMsg, ...))
+{
+	m_pMemPool->ReportStats(pfnReport);
+}
+
 
 // EXPOSE_SINGLE_INTERFACE(CKeyValuesSystem, IKeyValuesSystem, KEYVALUES_INTERFACE_VERSION);
 